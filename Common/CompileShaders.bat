@@ -7,22 +7,47 @@ set VULKAN_OUTPUT_DIR=Vulkan\Shaders\SPIRV
 if not exist "%DX_OUTPUT_DIR%" mkdir "%DX_OUTPUT_DIR%"
 if not exist "%VULKAN_OUTPUT_DIR%" mkdir "%VULKAN_OUTPUT_DIR%"
 
+rem Binaries are committed and overwritten in place. A missing compiler keeps them as they are, a failed compile
+rem stops the build so it never runs against a binary older than its source.
+where fxc >nul 2>nul || goto :skipdx
 echo Compiling for DirectX 12...
-fxc /T vs_5_1 /Fo "%DX_OUTPUT_DIR%\vs_rainbow.cso" DirectX12\Shaders\vs_rainbow.hlsl
-fxc /T ps_5_1 /Fo "%DX_OUTPUT_DIR%\ps_rainbow.cso" DirectX12\Shaders\ps_rainbow.hlsl
-fxc /T vs_5_1 /Fo "%DX_OUTPUT_DIR%\vs_quad.cso" DirectX12\Shaders\vs_quad.hlsl
-fxc /T ps_5_1 /Fo "%DX_OUTPUT_DIR%\ps_quad.cso" DirectX12\Shaders\ps_quad.hlsl
-fxc /T vs_5_1 /Fo "%DX_OUTPUT_DIR%\vs_pbr.cso" DirectX12\Shaders\vs_pbr.hlsl
-fxc /T ps_5_1 /Fo "%DX_OUTPUT_DIR%\ps_pbr.cso" DirectX12\Shaders\ps_pbr.hlsl
+fxc /T vs_5_1 /Fo "%DX_OUTPUT_DIR%\vs_rainbow.cso" DirectX12\Shaders\vs_rainbow.hlsl || goto :failed
+fxc /T ps_5_1 /Fo "%DX_OUTPUT_DIR%\ps_rainbow.cso" DirectX12\Shaders\ps_rainbow.hlsl || goto :failed
+fxc /T vs_5_1 /Fo "%DX_OUTPUT_DIR%\vs_quad.cso" DirectX12\Shaders\vs_quad.hlsl || goto :failed
+fxc /T ps_5_1 /Fo "%DX_OUTPUT_DIR%\ps_quad.cso" DirectX12\Shaders\ps_quad.hlsl || goto :failed
+fxc /T vs_5_1 /Fo "%DX_OUTPUT_DIR%\vs_pbr.cso" DirectX12\Shaders\vs_pbr.hlsl || goto :failed
+fxc /T vs_5_1 /D COMPACT_VERTICES=1 /Fo "%DX_OUTPUT_DIR%\vs_pbr_compact.cso" DirectX12\Shaders\vs_pbr.hlsl || goto :failed
+fxc /T ps_5_1 /Fo "%DX_OUTPUT_DIR%\ps_pbr.cso" DirectX12\Shaders\ps_pbr.hlsl || goto :failed
+goto :vulkan
 
+:skipdx
+echo fxc not found, keeping the committed DirectX 12 binaries.
+
+:vulkan
+where glslangValidator >nul 2>nul || goto :skipvulkan
 echo Compiling for Vulkan...
-glslangValidator -V -S vert -e main -o "%VULKAN_OUTPUT_DIR%\vs_rainbow.spv" Vulkan\Shaders\vs_rainbow.glsl
-glslangValidator -V -S frag -e main -o "%VULKAN_OUTPUT_DIR%\ps_rainbow.spv" Vulkan\Shaders\ps_rainbow.glsl
-glslangValidator -V -S vert -e main -o "%VULKAN_OUTPUT_DIR%\vs_quad.spv" Vulkan\Shaders\vs_quad.glsl
-glslangValidator -V -S frag -e main -o "%VULKAN_OUTPUT_DIR%\ps_quad.spv" Vulkan\Shaders\ps_quad.glsl
-glslangValidator -V -S vert -e main -o "%VULKAN_OUTPUT_DIR%\vs_pbr.spv" Vulkan\Shaders\vs_pbr.glsl
-glslangValidator -V -S frag -e main -o "%VULKAN_OUTPUT_DIR%\ps_pbr.spv" Vulkan\Shaders\ps_pbr.glsl
-glslangValidator -V -S vert -e main -o "%VULKAN_OUTPUT_DIR%\vs_lighting.spv" Vulkan\Shaders\vs_lighting.glsl
-glslangValidator -V -S frag -e main -o "%VULKAN_OUTPUT_DIR%\ps_lighting.spv" Vulkan\Shaders\ps_lighting.glsl
+glslangValidator -V -S vert -e main -o "%VULKAN_OUTPUT_DIR%\vs_rainbow.spv" Vulkan\Shaders\vs_rainbow.glsl || goto :failed
+glslangValidator -V -S frag -e main -o "%VULKAN_OUTPUT_DIR%\ps_rainbow.spv" Vulkan\Shaders\ps_rainbow.glsl || goto :failed
+glslangValidator -V -S vert -e main -o "%VULKAN_OUTPUT_DIR%\vs_quad.spv" Vulkan\Shaders\vs_quad.glsl || goto :failed
+glslangValidator -V -S frag -e main -o "%VULKAN_OUTPUT_DIR%\ps_quad.spv" Vulkan\Shaders\ps_quad.glsl || goto :failed
+glslangValidator -V -S vert -e main -o "%VULKAN_OUTPUT_DIR%\vs_pbr.spv" Vulkan\Shaders\vs_pbr.glsl || goto :failed
+glslangValidator -V -S vert -e main -DCOMPACT_VERTICES -o "%VULKAN_OUTPUT_DIR%\vs_pbr_compact.spv" Vulkan\Shaders\vs_pbr.glsl || goto :failed
+glslangValidator -V --target-env vulkan1.3 -S task -e main -o "%VULKAN_OUTPUT_DIR%\ts_meshlet.spv" Vulkan\Shaders\ts_meshlet.glsl || goto :failed
+glslangValidator -V --target-env vulkan1.3 -S mesh -e main -o "%VULKAN_OUTPUT_DIR%\ms_meshlet.spv" Vulkan\Shaders\ms_meshlet.glsl || goto :failed
+glslangValidator -V -S frag -e main -o "%VULKAN_OUTPUT_DIR%\ps_pbr.spv" Vulkan\Shaders\ps_pbr.glsl || goto :failed
+glslangValidator -V -S vert -e main -o "%VULKAN_OUTPUT_DIR%\vs_lighting.spv" Vulkan\Shaders\vs_lighting.glsl || goto :failed
+glslangValidator -V -S frag -e main -o "%VULKAN_OUTPUT_DIR%\ps_lighting.spv" Vulkan\Shaders\ps_lighting.glsl || goto :failed
+goto :done
+
+:skipvulkan
+echo glslangValidator not found, keeping the committed Vulkan binaries.
+
+:done
 echo Done!
-pause
+if /i not "%~1"=="nopause" pause
+exit /b 0
+
+:failed
+echo Shader compilation failed.
+if /i not "%~1"=="nopause" pause
+exit /b 1
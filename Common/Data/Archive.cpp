@@ -0,0 +1,161 @@
+#include "Archive.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+#include "LZ4.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    bool InRange(uint64_t offset, uint64_t size, uint64_t limit)
+    {
+        return offset <= limit && size <= limit - offset;
+    }
+}
+
+uint64_t Archive::Hash(const uint8_t* bytes, uint64_t size, uint64_t seed)
+{
+    uint64_t hash = seed;
+    for (uint64_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+std::string Archive::MakeKey(const std::string& path, const std::filesystem::path& root)
+{
+    std::error_code error;
+    std::filesystem::path absolute = std::filesystem::absolute(path, error);
+    if (error)
+        absolute = path;
+    return absolute.lexically_normal().lexically_relative(root).generic_string();
+}
+
+bool Archive::Open(const std::string& path)
+{
+    Close();
+    if (!File.Open(path) || File.GetSize() < sizeof(FileHeader))
+    {
+        Close();
+        return false;
+    }
+
+    const uint8_t* base = File.GetData();
+    Header = reinterpret_cast<const FileHeader*>(base);
+    Entries = reinterpret_cast<const FileEntry*>(base + Header->EntriesOffset);
+    Blocks = reinterpret_cast<const FileBlock*>(base + Header->BlocksOffset);
+    Names = reinterpret_cast<const char*>(base + Header->NamesOffset);
+    Data = base + Header->DataOffset;
+    DataSize = File.GetSize() - std::min(Header->DataOffset, File.GetSize());
+
+    if (!Validate())
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void Archive::Close()
+{
+    File.Close();
+    Header = nullptr;
+    Entries = nullptr;
+    Blocks = nullptr;
+    Names = nullptr;
+    Data = nullptr;
+    DataSize = 0;
+}
+
+bool Archive::Validate() const
+{
+    uint64_t fileSize = File.GetSize();
+    if (Header->Magic != Magic || Header->Version != Version || Header->FileSize != fileSize || Header->BlockSize == 0)
+        return false;
+
+    if (!InRange(Header->EntriesOffset, Header->EntryCount * sizeof(FileEntry), fileSize) ||
+        !InRange(Header->BlocksOffset, Header->BlockCount * sizeof(FileBlock), fileSize) ||
+        Header->NamesOffset > Header->DataOffset || Header->DataOffset > fileSize)
+        return false;
+
+    uint64_t namesSize = Header->DataOffset - Header->NamesOffset;
+    for (uint32_t i = 0; i < Header->EntryCount; i++)
+    {
+        const FileEntry& entry = Entries[i];
+        if (!InRange(entry.NameOffset, entry.NameLength, namesSize) || !InRange(entry.FirstBlock, entry.BlockCount, Header->BlockCount))
+            return false;
+        if (entry.BlockCount != (entry.Size + Header->BlockSize - 1) / Header->BlockSize)
+            return false;
+        if (i > 0 && Entries[i - 1].PathHash >= entry.PathHash)
+            return false;
+    }
+
+    for (uint32_t i = 0; i < Header->BlockCount; i++)
+    {
+        const FileBlock& block = Blocks[i];
+        if (!InRange(block.Offset, block.CompressedSize, DataSize) || block.Method > Compression::LZ4)
+            return false;
+    }
+    return true;
+}
+
+const Archive::FileEntry* Archive::Find(const std::string& key) const
+{
+    if (!Header)
+        return nullptr;
+
+    uint64_t pathHash = Hash(reinterpret_cast<const uint8_t*>(key.data()), key.size());
+    const FileEntry* end = Entries + Header->EntryCount;
+    const FileEntry* entry = std::lower_bound(Entries, end, pathHash, [](const FileEntry& a, uint64_t hash) { return a.PathHash < hash; });
+    if (entry == end || entry->PathHash != pathHash)
+        return nullptr;
+
+    // The packer refuses colliding hashes, the name check only guards against keys that were never packed
+    if (key.compare(0, std::string::npos, Names + entry->NameOffset, entry->NameLength) != 0)
+        return nullptr;
+    return entry;
+}
+
+bool Archive::GetContentHash(const std::string& key, uint64_t& outHash) const
+{
+    const FileEntry* entry = Find(key);
+    if (!entry)
+        return false;
+    outHash = entry->ContentHash;
+    return true;
+}
+
+FileBuffer Archive::Read(const std::string& key) const
+{
+    const FileEntry* entry = Find(key);
+    if (!entry)
+        return {};
+
+    FileBuffer buffer(entry->Size);
+    if (entry->Size == 0)
+        return buffer;
+
+    std::atomic<bool> corrupt = false;
+    uint32_t blockSize = Header->BlockSize;
+    ThreadPool::GetInstance().ParallelFor(entry->BlockCount, [&](uint32_t i)
+    {
+        const FileBlock& block = Blocks[entry->FirstBlock + i];
+        uint64_t offset = static_cast<uint64_t>(i) * blockSize;
+        uint64_t size = std::min<uint64_t>(blockSize, entry->Size - offset);
+        const uint8_t* source = Data + block.Offset;
+
+        if (block.Method == Compression::Stored && block.CompressedSize == size)
+            memcpy(buffer.GetData() + offset, source, size);
+        else if (block.Method != Compression::LZ4 || !LZ4::Decompress(source, block.CompressedSize, buffer.GetData() + offset, size))
+            corrupt = true;
+    });
+
+    if (corrupt)
+        throw std::runtime_error("Corrupt block in archived asset: " + key);
+    return buffer;
+}
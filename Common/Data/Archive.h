@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+#include "AssetIO.h"
+#include "../Windows/MappedFile.h"
+
+// Read side of a packed asset archive. The archive is mapped whole, assets are found through a table of contents sorted
+// by path hash and decompress block by block in parallel on the ThreadPool. Identical files share their blocks, their
+// entries carry the same content hash. Written by ArchivePacker. Reads are safe from any thread once open.
+class Archive
+{
+public:
+
+    static constexpr uint32_t Magic = 0x43524145;       // "EARC"
+    static constexpr uint32_t Version = 1;
+    static constexpr uint32_t DefaultBlockSize = 256 * 1024;
+
+    enum class Compression : uint32_t
+    {
+        Stored,
+        LZ4
+    };
+
+    // File layout: header, entry table sorted by PathHash, block table, name blob, then the 16 byte aligned block data
+    struct FileHeader
+    {
+        uint32_t Magic;
+        uint32_t Version;
+        uint32_t EntryCount;
+        uint32_t BlockCount;
+        uint32_t BlockSize;
+        uint32_t Padding;
+        uint64_t EntriesOffset;
+        uint64_t BlocksOffset;
+        uint64_t NamesOffset;
+        uint64_t DataOffset;
+        uint64_t FileSize;
+    };
+
+    struct FileEntry
+    {
+        uint64_t PathHash;
+        uint64_t ContentHash;
+        uint64_t Size;
+        uint32_t FirstBlock;
+        uint32_t BlockCount;
+        uint32_t NameOffset;
+        uint32_t NameLength;
+    };
+
+    // Every block but an asset's last holds BlockSize bytes once decompressed, Offset is relative to the data section
+    struct FileBlock
+    {
+        uint64_t Offset;
+        uint32_t CompressedSize;
+        Compression Method;
+    };
+
+    static_assert(sizeof(FileHeader) == 64 && sizeof(FileEntry) == 40 && sizeof(FileBlock) == 16, "Archive layout changed, bump Version.");
+
+    static constexpr uint64_t DataAlignment = 16;
+
+    // FNV-1a, the same hash MeshCache and TextureCooker key their cooked files with
+    static uint64_t Hash(const uint8_t* bytes, uint64_t size, uint64_t seed = 0xCBF29CE484222325ULL);
+    // Archive key of path: relative to root, lexically normalised, forward slashes
+    static std::string MakeKey(const std::string& path, const std::filesystem::path& root);
+
+    Archive() = default;
+    Archive(const Archive&) = delete;
+    Archive& operator=(const Archive&) = delete;
+
+    // False when the file is missing, not an archive or its tables point outside it
+    bool Open(const std::string& path);
+    void Close();
+
+    bool Contains(const std::string& key) const         { return Find(key) != nullptr; }
+    uint32_t GetEntryCount() const                      { return Header ? Header->EntryCount : 0; }
+    // Hash of the asset's contents as stored by the packer, false when the archive does not hold it
+    bool GetContentHash(const std::string& key, uint64_t& outHash) const;
+    // Decompresses the asset, invalid when the archive does not hold it. Throws on corrupt blocks.
+    FileBuffer Read(const std::string& key) const;
+
+private:
+
+    MappedFile File;
+    const FileHeader* Header = nullptr;
+    const FileEntry* Entries = nullptr;
+    const FileBlock* Blocks = nullptr;
+    const char* Names = nullptr;
+    const uint8_t* Data = nullptr;
+    uint64_t DataSize = 0;
+
+    const FileEntry* Find(const std::string& key) const;
+    bool Validate() const;
+};
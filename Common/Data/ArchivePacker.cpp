@@ -0,0 +1,193 @@
+#include "ArchivePacker.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+#include "AssetIO.h"
+#include "LZ4.h"
+#include "ThreadPool.h"
+
+ArchivePacker::ArchivePacker(const std::string& rootDirectory, uint32_t blockSize)
+    : Root(std::filesystem::absolute(rootDirectory).lexically_normal()), BlockSize(blockSize ? blockSize : Archive::DefaultBlockSize)
+{
+}
+
+void ArchivePacker::AddFile(const std::string& path)
+{
+    if (std::find(Files.begin(), Files.end(), path) == Files.end())
+        Files.push_back(path);
+}
+
+void ArchivePacker::AddDirectory(const std::string& directory, const std::vector<std::string>& extensions)
+{
+    std::error_code error;
+    std::vector<std::string> found;
+    for (const auto& item : std::filesystem::recursive_directory_iterator(directory, error))
+    {
+        if (!item.is_regular_file())
+            continue;
+        std::string extension = item.path().extension().string();
+        if (extensions.empty() || std::find(extensions.begin(), extensions.end(), extension) != extensions.end())
+            found.push_back(item.path().generic_string());
+    }
+
+    // Directory iteration order is unspecified, sorting keeps archives reproducible
+    std::sort(found.begin(), found.end());
+    for (const std::string& path : found)
+        AddFile(path);
+}
+
+bool ArchivePacker::Write(const std::string& archivePath) const
+{
+    using FileHeader = Archive::FileHeader;
+    using FileEntry = Archive::FileEntry;
+    using FileBlock = Archive::FileBlock;
+
+    std::vector<FileBuffer> contents = AssetIO::GetInstance().ReadFiles(Files);
+    for (size_t i = 0; i < Files.size(); i++)
+    {
+        if (!contents[i].IsValid())
+        {
+            std::cerr << "Failed to read file for archive: " << Files[i] << std::endl;
+            return false;
+        }
+    }
+
+    // Identical contents are stored once, later files point at the first one's blocks
+    std::vector<FileEntry> entries(Files.size());
+    std::vector<std::string> keys(Files.size());
+    std::vector<uint32_t> owners(Files.size());
+    std::unordered_map<uint64_t, uint32_t> firstWithContent;
+    std::unordered_map<uint64_t, uint32_t> keyHashes;
+    std::vector<uint32_t> uniqueFiles;
+    uint32_t blockCount = 0;
+
+    for (uint32_t i = 0; i < Files.size(); i++)
+    {
+        keys[i] = Archive::MakeKey(Files[i], Root);
+        FileEntry& entry = entries[i];
+        entry.PathHash = Archive::Hash(reinterpret_cast<const uint8_t*>(keys[i].data()), keys[i].size());
+        entry.ContentHash = Archive::Hash(contents[i].GetData(), contents[i].GetSize());
+        entry.Size = contents[i].GetSize();
+
+        auto [collision, inserted] = keyHashes.emplace(entry.PathHash, i);
+        if (!inserted)
+        {
+            std::cerr << "Archive keys collide: " << keys[collision->second] << " and " << keys[i] << std::endl;
+            return false;
+        }
+
+        auto duplicate = firstWithContent.find(entry.ContentHash);
+        if (duplicate != firstWithContent.end() && entry.Size > 0 && contents[duplicate->second].GetSize() == entry.Size &&
+            memcmp(contents[duplicate->second].GetData(), contents[i].GetData(), entry.Size) == 0)
+        {
+            owners[i] = duplicate->second;
+            continue;
+        }
+
+        firstWithContent.emplace(entry.ContentHash, i);
+        owners[i] = i;
+        uniqueFiles.push_back(i);
+        entry.FirstBlock = blockCount;
+        entry.BlockCount = static_cast<uint32_t>((entry.Size + BlockSize - 1) / BlockSize);
+        blockCount += entry.BlockCount;
+    }
+
+    for (uint32_t i = 0; i < Files.size(); i++)
+    {
+        entries[i].FirstBlock = entries[owners[i]].FirstBlock;
+        entries[i].BlockCount = entries[owners[i]].BlockCount;
+    }
+
+    // Every block compresses on its own, so the pool takes them in any order
+    struct PendingBlock
+    {
+        uint32_t File;
+        uint64_t Offset;
+        uint64_t Size;
+        std::vector<uint8_t> Compressed;
+        Archive::Compression Method;
+    };
+
+    std::vector<PendingBlock> blocks;
+    blocks.reserve(blockCount);
+    for (uint32_t file : uniqueFiles)
+        for (uint64_t offset = 0; offset < entries[file].Size; offset += BlockSize)
+            blocks.push_back({ file, offset, std::min<uint64_t>(BlockSize, entries[file].Size - offset), {}, Archive::Compression::Stored });
+
+    ThreadPool::GetInstance().ParallelFor(static_cast<uint32_t>(blocks.size()), [&](uint32_t i)
+    {
+        PendingBlock& block = blocks[i];
+        const uint8_t* source = contents[block.File].GetData() + block.Offset;
+        block.Compressed.resize(LZ4::CompressBound(block.Size));
+        size_t compressedSize = LZ4::Compress(source, block.Size, block.Compressed.data(), block.Compressed.size());
+        if (compressedSize > 0 && compressedSize < block.Size)
+        {
+            block.Compressed.resize(compressedSize);
+            block.Method = Archive::Compression::LZ4;
+        }
+        else
+            block.Compressed.assign(source, source + block.Size);
+    });
+
+    std::vector<FileBlock> blockTable(blocks.size());
+    uint64_t dataSize = 0;
+    for (size_t i = 0; i < blocks.size(); i++)
+    {
+        blockTable[i] = { dataSize, static_cast<uint32_t>(blocks[i].Compressed.size()), blocks[i].Method };
+        dataSize += blocks[i].Compressed.size();
+    }
+
+    std::vector<uint32_t> order(Files.size());
+    for (uint32_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return entries[a].PathHash < entries[b].PathHash; });
+
+    std::vector<FileEntry> sortedEntries;
+    std::string names;
+    for (uint32_t i : order)
+    {
+        FileEntry entry = entries[i];
+        entry.NameOffset = static_cast<uint32_t>(names.size());
+        entry.NameLength = static_cast<uint32_t>(keys[i].size());
+        names += keys[i];
+        sortedEntries.push_back(entry);
+    }
+
+    FileHeader header = {};
+    header.Magic = Archive::Magic;
+    header.Version = Archive::Version;
+    header.EntryCount = static_cast<uint32_t>(sortedEntries.size());
+    header.BlockCount = static_cast<uint32_t>(blockTable.size());
+    header.BlockSize = BlockSize;
+    header.EntriesOffset = sizeof(FileHeader);
+    header.BlocksOffset = header.EntriesOffset + sortedEntries.size() * sizeof(FileEntry);
+    header.NamesOffset = header.BlocksOffset + blockTable.size() * sizeof(FileBlock);
+    header.DataOffset = (header.NamesOffset + names.size() + Archive::DataAlignment - 1) / Archive::DataAlignment * Archive::DataAlignment;
+    header.FileSize = header.DataOffset + dataSize;
+
+    std::string temporaryPath = archivePath + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file)
+            return false;
+
+        const char padding[Archive::DataAlignment] = {};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(sortedEntries.data()), sortedEntries.size() * sizeof(FileEntry));
+        file.write(reinterpret_cast<const char*>(blockTable.data()), blockTable.size() * sizeof(FileBlock));
+        file.write(names.data(), names.size());
+        file.write(padding, header.DataOffset - header.NamesOffset - names.size());
+        for (const PendingBlock& block : blocks)
+            file.write(reinterpret_cast<const char*>(block.Compressed.data()), block.Compressed.size());
+        if (!file)
+            return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, archivePath, error);
+    return !error;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "Archive.h"
+
+// Builds an Archive from loose asset files. Files are keyed by their path relative to the root the archive is later
+// mounted at, compressed in BlockSize blocks in parallel and laid out in the order they were added, so a directory
+// reads back sequentially. Blocks LZ4 does not shrink are stored as they are.
+class ArchivePacker
+{
+public:
+
+    explicit ArchivePacker(const std::string& rootDirectory = ".", uint32_t blockSize = Archive::DefaultBlockSize);
+
+    void AddFile(const std::string& path);
+    // Every file below directory whose extension is one of extensions, all files when extensions is empty
+    void AddDirectory(const std::string& directory, const std::vector<std::string>& extensions = {});
+    size_t GetFileCount() const                         { return Files.size(); }
+
+    // False when a file could not be read, two keys collide or the archive could not be written
+    bool Write(const std::string& archivePath) const;
+
+private:
+
+    std::filesystem::path Root;
+    uint32_t BlockSize;
+    std::vector<std::string> Files;
+};
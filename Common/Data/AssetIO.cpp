@@ -0,0 +1,239 @@
+#include "AssetIO.h"
+
+#include <filesystem>
+#include <fstream>
+#include <new>
+
+#include "Archive.h"
+#include "ThreadPool.h"
+#include "../Windows/MappedFile.h"
+#ifdef __linux__
+#include "../Linux/IOUringReader.h"
+#endif
+
+FileBuffer::FileBuffer(uint64_t size)
+{
+    Valid = true;
+    if (size == 0)
+        return;
+
+    Capacity = (size + AssetIO::DirectIOAlignment - 1) / AssetIO::DirectIOAlignment * AssetIO::DirectIOAlignment;
+    Data = static_cast<uint8_t*>(::operator new(Capacity, std::align_val_t(AssetIO::DirectIOAlignment)));
+    Size = size;
+}
+
+FileBuffer::~FileBuffer()
+{
+    Reset();
+}
+
+FileBuffer::FileBuffer(FileBuffer&& other) noexcept
+    : Data(other.Data), Size(other.Size), Capacity(other.Capacity), Valid(other.Valid)
+{
+    other.Data = nullptr;
+    other.Size = 0;
+    other.Capacity = 0;
+    other.Valid = false;
+}
+
+FileBuffer& FileBuffer::operator=(FileBuffer&& other) noexcept
+{
+    if (this == &other)
+        return *this;
+
+    Reset();
+    Data = other.Data;
+    Size = other.Size;
+    Capacity = other.Capacity;
+    Valid = other.Valid;
+    other.Data = nullptr;
+    other.Size = 0;
+    other.Capacity = 0;
+    other.Valid = false;
+    return *this;
+}
+
+void FileBuffer::Reset()
+{
+    if (Data)
+        ::operator delete(Data, std::align_val_t(AssetIO::DirectIOAlignment));
+    Data = nullptr;
+    Size = 0;
+    Capacity = 0;
+    Valid = false;
+}
+
+AssetIO& AssetIO::GetInstance()
+{
+    static AssetIO instance;
+    return instance;
+}
+
+AssetIO::AssetIO()
+{
+#ifdef __linux__
+    if (IOUringReader::IsSupported())
+        ActiveBackend = Backend::IOUring;
+#endif
+}
+
+AssetIO::~AssetIO() = default;
+
+std::vector<FileBuffer> AssetIO::ReadFiles(const std::vector<std::string>& paths)
+{
+    std::vector<FileBuffer> buffers(paths.size());
+    if (paths.empty())
+        return buffers;
+
+    // Archived files decompress straight away, the rest go to the backend as one batch
+    std::vector<std::string> loosePaths;
+    std::vector<size_t> looseIndices;
+    uint32_t archiveFiles = 0;
+    {
+        std::shared_lock<std::shared_mutex> lock(MountMutex);
+        for (size_t i = 0; i < paths.size(); i++)
+        {
+            bool archived = false;
+            for (auto mount = Mounts.rbegin(); mount != Mounts.rend() && !archived; ++mount)
+            {
+                std::string key = Archive::MakeKey(paths[i], mount->Root);
+                if (mount->Source->Contains(key))
+                {
+                    buffers[i] = mount->Source->Read(key);
+                    archived = true;
+                    archiveFiles++;
+                }
+            }
+
+            if (!archived)
+            {
+                loosePaths.push_back(paths[i]);
+                looseIndices.push_back(i);
+            }
+        }
+    }
+
+    uint32_t directReads = 0;
+    if (!loosePaths.empty())
+    {
+        std::vector<FileBuffer> looseBuffers(loosePaths.size());
+        bool read = false;
+#ifdef __linux__
+        // A thread that cannot get its own ring reads through the pool instead
+        if (ActiveBackend == Backend::IOUring)
+            read = IOUringReader::ReadFiles(loosePaths, looseBuffers, directReads);
+#endif
+        if (!read)
+            ReadWithThreadPool(loosePaths, looseBuffers);
+
+        for (size_t i = 0; i < looseIndices.size(); i++)
+            buffers[looseIndices[i]] = std::move(looseBuffers[i]);
+    }
+
+    std::lock_guard<std::mutex> lock(StatisticsMutex);
+    Counters.Batches++;
+    Counters.DirectReads += directReads;
+    Counters.ArchiveFiles += archiveFiles;
+    for (const FileBuffer& buffer : buffers)
+    {
+        Counters.Files++;
+        Counters.Bytes += buffer.GetSize();
+        if (!buffer.IsValid())
+            Counters.MissingFiles++;
+    }
+    return buffers;
+}
+
+FileBuffer AssetIO::ReadFile(const std::string& path)
+{
+    return std::move(ReadFiles({ path })[0]);
+}
+
+bool AssetIO::Exists(const std::string& path)
+{
+    {
+        std::shared_lock<std::shared_mutex> lock(MountMutex);
+        for (const MountedArchive& mount : Mounts)
+            if (mount.Source->Contains(Archive::MakeKey(path, mount.Root)))
+                return true;
+    }
+
+    std::error_code error;
+    return std::filesystem::is_regular_file(path, error);
+}
+
+bool AssetIO::GetContentHash(const std::string& path, uint64_t& outHash)
+{
+    {
+        std::shared_lock<std::shared_mutex> lock(MountMutex);
+        for (auto mount = Mounts.rbegin(); mount != Mounts.rend(); ++mount)
+            if (mount->Source->GetContentHash(Archive::MakeKey(path, mount->Root), outHash))
+                return true;
+    }
+
+    std::error_code error;
+    if (!std::filesystem::is_regular_file(path, error))
+        return false;
+
+    // Empty files cannot be mapped, they hash like the packer hashes them
+    MappedFile file;
+    if (file.Open(path))
+        outHash = Archive::Hash(file.GetData(), file.GetSize());
+    else if (std::filesystem::file_size(path, error) == 0 && !error)
+        outHash = Archive::Hash(nullptr, 0);
+    else
+        return false;
+    return true;
+}
+
+bool AssetIO::Mount(const std::string& archivePath, const std::string& rootDirectory)
+{
+    std::unique_ptr<Archive> archive = std::make_unique<Archive>();
+    if (!archive->Open(archivePath))
+        return false;
+
+    std::unique_lock<std::shared_mutex> lock(MountMutex);
+    Mounts.push_back({ std::move(archive), std::filesystem::absolute(rootDirectory).lexically_normal() });
+    return true;
+}
+
+void AssetIO::UnmountAll()
+{
+    std::unique_lock<std::shared_mutex> lock(MountMutex);
+    Mounts.clear();
+}
+
+AssetIO::Statistics AssetIO::GetStatistics()
+{
+    std::lock_guard<std::mutex> lock(StatisticsMutex);
+    return Counters;
+}
+
+void AssetIO::ReadWithThreadPool(const std::vector<std::string>& paths, std::vector<FileBuffer>& outBuffers)
+{
+    ThreadPool::GetInstance().ParallelFor(static_cast<uint32_t>(paths.size()), [&](uint32_t i)
+    {
+        std::error_code error;
+        if (!std::filesystem::is_regular_file(paths[i], error))
+            return;
+
+        std::ifstream file(paths[i], std::ios::binary | std::ios::ate);
+        if (!file.is_open())
+            return;
+
+        std::streamsize size = file.tellg();
+        if (size < 0)
+            return;
+        if (size == 0)
+        {
+            outBuffers[i] = FileBuffer(0);
+            return;
+        }
+        file.seekg(0, std::ios::beg);
+
+        FileBuffer buffer(static_cast<uint64_t>(size));
+        file.read(reinterpret_cast<char*>(buffer.GetData()), size);
+        buffer.Truncate(static_cast<uint64_t>(file.gcount()));
+        outBuffers[i] = std::move(buffer);
+    });
+}
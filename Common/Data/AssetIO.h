@@ -0,0 +1,112 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+class Archive;
+
+// Contents of a whole file. Storage is aligned and padded to AssetIO::DirectIOAlignment so direct reads can land in it.
+// A default constructed buffer is invalid, a file that was read but holds nothing is a valid buffer of size zero.
+class FileBuffer
+{
+public:
+
+    FileBuffer() = default;
+    explicit FileBuffer(uint64_t size);
+    ~FileBuffer();
+
+    FileBuffer(FileBuffer&& other) noexcept;
+    FileBuffer& operator=(FileBuffer&& other) noexcept;
+    FileBuffer(const FileBuffer&) = delete;
+    FileBuffer& operator=(const FileBuffer&) = delete;
+
+    const uint8_t* GetData() const                      { return Data; }
+    uint8_t* GetData()                                  { return Data; }
+    uint64_t GetSize() const                            { return Size; }
+    uint64_t GetCapacity() const                        { return Capacity; }
+    bool IsEmpty() const                                { return Size == 0; }
+    bool IsValid() const                                { return Valid; }
+
+    // Files that shrank while being read keep what arrived
+    void Truncate(uint64_t size)                        { if (size < Size) Size = size; }
+    void Reset();
+
+private:
+
+    uint8_t* Data = nullptr;
+    uint64_t Size = 0;
+    uint64_t Capacity = 0;
+    bool Valid = false;
+};
+
+// Reads asset files into memory in batches, so decoders work from buffers instead of doing their own blocking reads.
+// Mounted archives are searched first, the most recently mounted winning. Loose files go to io_uring as one submission
+// on Linux, with direct reads for large files, elsewhere or when the kernel refuses io_uring they are read in parallel
+// on the ThreadPool.
+class AssetIO
+{
+public:
+
+    enum class Backend : uint8_t
+    {
+        ThreadPool,
+        IOUring
+    };
+
+    struct Statistics
+    {
+        uint32_t Batches = 0;
+        uint32_t Files = 0;
+        uint32_t MissingFiles = 0;
+        uint32_t DirectReads = 0;
+        uint32_t ArchiveFiles = 0;
+        uint64_t Bytes = 0;
+    };
+
+    static constexpr uint64_t DirectIOAlignment = 4096;
+    // Smaller files go through the page cache, they are often read again soon and direct IO gains nothing on them
+    static constexpr uint64_t DirectReadThreshold = 1024 * 1024;
+
+    static AssetIO& GetInstance();
+
+    // Reads every file completely, results keep the order of paths. Missing or unreadable files come back invalid.
+    // Safe from any thread.
+    std::vector<FileBuffer> ReadFiles(const std::vector<std::string>& paths);
+    FileBuffer ReadFile(const std::string& path);
+
+    // Whether ReadFiles would find path, in a mounted archive or as a loose file
+    bool Exists(const std::string& path);
+    // Archive::Hash of the contents ReadFiles would return for path, without decompressing archived files. Cooked
+    // caches key on it, so they follow whichever copy is actually read. False when path does not exist.
+    bool GetContentHash(const std::string& path, uint64_t& outHash);
+
+    // Serves the files packed relative to rootDirectory from the archive from now on, false when it cannot be opened
+    bool Mount(const std::string& archivePath, const std::string& rootDirectory = ".");
+    void UnmountAll();
+
+    Backend GetBackend() const                          { return ActiveBackend; }
+    Statistics GetStatistics();
+
+private:
+
+    struct MountedArchive
+    {
+        std::unique_ptr<Archive> Source;
+        std::filesystem::path Root;
+    };
+
+    AssetIO();
+    ~AssetIO();
+
+    Backend ActiveBackend = Backend::ThreadPool;
+    std::shared_mutex MountMutex;
+    std::vector<MountedArchive> Mounts;
+    std::mutex StatisticsMutex;
+    Statistics Counters;
+
+    static void ReadWithThreadPool(const std::vector<std::string>& paths, std::vector<FileBuffer>& outBuffers);
+};
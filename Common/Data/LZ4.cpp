@@ -0,0 +1,175 @@
+#include "LZ4.h"
+
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    uint32_t Read32(const uint8_t* bytes)
+    {
+        uint32_t value;
+        memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+
+    // Lengths of 15 and above continue in bytes of 255 until a smaller one
+    uint8_t* WriteLength(uint8_t* output, size_t length)
+    {
+        for (; length >= 255; length -= 255)
+            *output++ = 255;
+        *output++ = static_cast<uint8_t>(length);
+        return output;
+    }
+}
+
+size_t LZ4::Compress(const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t destinationCapacity)
+{
+    if (sourceSize > MaxInputSize)
+        return 0;
+
+    uint8_t* output = destination;
+    const uint8_t* outputEnd = destination + destinationCapacity;
+    size_t anchor = 0;
+
+    // Literals, then the match when matchLength is non zero. Fails when the sequence does not fit.
+    auto emit = [&](size_t literalEnd, uint32_t offset, size_t matchLength) -> bool
+    {
+        size_t literalLength = literalEnd - anchor;
+        size_t worstCase = 1 + literalLength / 255 + 1 + literalLength + 2 + matchLength / 255 + 1;
+        if (worstCase > static_cast<size_t>(outputEnd - output))
+            return false;
+
+        uint8_t* token = output++;
+        *token = static_cast<uint8_t>((literalLength < 15 ? literalLength : 15) << 4);
+        if (literalLength >= 15)
+            output = WriteLength(output, literalLength - 15);
+        if (literalLength > 0)
+            memcpy(output, source + anchor, literalLength);
+        output += literalLength;
+
+        if (matchLength == 0)
+            return true;
+
+        *output++ = static_cast<uint8_t>(offset);
+        *output++ = static_cast<uint8_t>(offset >> 8);
+        size_t encodedMatch = matchLength - MinMatch;
+        *token |= static_cast<uint8_t>(encodedMatch < 15 ? encodedMatch : 15);
+        if (encodedMatch >= 15)
+            output = WriteLength(output, encodedMatch - 15);
+        return true;
+    };
+
+    if (sourceSize >= MatchFindLimit)
+    {
+        // Positions of the last occurrence of each hashed 4 byte sequence, a probe is verified against the source
+        std::vector<uint32_t> table(size_t(1) << HashLog, 0);
+        auto hash = [](uint32_t sequence) { return (sequence * 2654435761u) >> (32 - HashLog); };
+
+        const size_t matchLimit = sourceSize - LastLiterals;
+        const size_t findLimit = sourceSize - MatchFindLimit;
+        size_t position = 0;
+        uint32_t misses = 0;
+
+        while (position <= findLimit)
+        {
+            uint32_t sequence = Read32(source + position);
+            uint32_t& slot = table[hash(sequence)];
+            size_t candidate = slot;
+            slot = static_cast<uint32_t>(position);
+
+            if (candidate >= position || position - candidate > MaxOffset || Read32(source + candidate) != sequence)
+            {
+                // Incompressible runs are skipped faster the longer they go on
+                position += 1 + (misses++ >> 6);
+                continue;
+            }
+            misses = 0;
+
+            while (position > anchor && candidate > 0 && source[position - 1] == source[candidate - 1])
+            {
+                position--;
+                candidate--;
+            }
+
+            size_t matchLength = MinMatch;
+            while (position + matchLength < matchLimit && source[position + matchLength] == source[candidate + matchLength])
+                matchLength++;
+
+            if (!emit(position, static_cast<uint32_t>(position - candidate), matchLength))
+                return 0;
+
+            position += matchLength;
+            anchor = position;
+            if (position - 2 <= findLimit)
+                table[hash(Read32(source + position - 2))] = static_cast<uint32_t>(position - 2);
+        }
+    }
+
+    if (!emit(sourceSize, 0, 0))
+        return 0;
+    return static_cast<size_t>(output - destination);
+}
+
+bool LZ4::Decompress(const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t destinationSize)
+{
+    size_t input = 0;
+    size_t output = 0;
+
+    auto readLength = [&](size_t& length) -> bool
+    {
+        uint8_t byte;
+        do
+        {
+            if (input >= sourceSize)
+                return false;
+            byte = source[input++];
+            length += byte;
+        } while (byte == 255);
+        return true;
+    };
+
+    while (input < sourceSize)
+    {
+        uint8_t token = source[input++];
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(literalLength))
+            return false;
+        if (literalLength > sourceSize - input || literalLength > destinationSize - output)
+            return false;
+        if (literalLength > 0)
+            memcpy(destination + output, source + input, literalLength);
+        input += literalLength;
+        output += literalLength;
+
+        // The last sequence is literals only
+        if (input == sourceSize)
+            return output == destinationSize;
+
+        if (sourceSize - input < 2)
+            return false;
+        size_t offset = source[input] | (static_cast<size_t>(source[input + 1]) << 8);
+        input += 2;
+        if (offset == 0 || offset > output)
+            return false;
+
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLength(matchLength))
+            return false;
+        matchLength += MinMatch;
+        if (matchLength > destinationSize - output)
+            return false;
+
+        // Matches closer than their length repeat the bytes they are still writing
+        uint8_t* target = destination + output;
+        const uint8_t* match = target - offset;
+        if (offset >= matchLength)
+            memcpy(target, match, matchLength);
+        else
+            for (size_t i = 0; i < matchLength; i++)
+                target[i] = match[i];
+        output += matchLength;
+    }
+
+    return false;
+}
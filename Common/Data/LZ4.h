@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// LZ4 block format, the raw sequences without the frame around them. Compression is the greedy single probe hash
+// chain of the reference fast mode, decompression bounds checks every sequence so corrupt input fails instead of
+// writing past the output.
+class LZ4
+{
+public:
+
+    static constexpr size_t MaxInputSize = 0x7E000000;
+
+    // Worst case compressed size of size bytes
+    static size_t CompressBound(size_t size)                { return size + size / 255 + 16; }
+
+    // Returns the compressed size, 0 when the input is too large or destination too small
+    static size_t Compress(const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t destinationCapacity);
+    // Succeeds only when the block decodes to exactly destinationSize bytes
+    static bool Decompress(const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t destinationSize);
+
+private:
+
+    static constexpr uint32_t MinMatch = 4;
+    // The format ends every block with literals, the last match starts at least MatchFindLimit bytes from the end
+    static constexpr size_t LastLiterals = 5;
+    static constexpr size_t MatchFindLimit = 12;
+    static constexpr uint32_t MaxOffset = 65535;
+    static constexpr uint32_t HashLog = 16;
+};
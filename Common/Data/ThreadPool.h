@@ -0,0 +1,166 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed size worker pool
+// ParallelFor has the calling thread take work too, so it is safe to call from inside a job
+class ThreadPool
+{
+    std::vector<std::thread> Workers;
+    std::queue<std::function<void()>> Jobs;
+    std::mutex JobMutex;
+    std::condition_variable JobAvailable;
+    bool Stopping = false;
+
+    struct ParallelForState
+    {
+        std::atomic<uint32_t> NextIndex { 0 };
+        std::atomic<uint32_t> CompletedCount { 0 };
+        uint32_t Count = 0;
+        std::function<void(uint32_t)> Body;
+        // First exception thrown by Body, rethrown on the calling thread once the loop has drained
+        std::atomic<bool> Failed { false };
+        std::mutex ExceptionMutex;
+        std::exception_ptr Exception;
+    };
+
+    static void RunParallelFor(ParallelForState& state)
+    {
+        uint32_t index;
+        while ((index = state.NextIndex.fetch_add(1)) < state.Count)
+        {
+            // Indices still count as completed after a failure, so the caller's wait always ends
+            if (!state.Failed.load(std::memory_order_relaxed))
+            {
+                try
+                {
+                    state.Body(index);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(state.ExceptionMutex);
+                    if (!state.Exception)
+                        state.Exception = std::current_exception();
+                    state.Failed = true;
+                }
+            }
+            if (state.CompletedCount.fetch_add(1) + 1 == state.Count)
+                state.CompletedCount.notify_all();
+        }
+    }
+
+    void WorkerLoop()
+    {
+        while (true)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(JobMutex);
+                JobAvailable.wait(lock, [this] { return Stopping || !Jobs.empty(); });
+                if (Stopping && Jobs.empty())
+                    return;
+
+                job = std::move(Jobs.front());
+                Jobs.pop();
+            }
+            job();
+        }
+    }
+
+public:
+    // threadCount 0 uses every hardware thread except the caller's
+    explicit ThreadPool(uint32_t threadCount = 0)
+    {
+        // hardware_concurrency may report 0 when it cannot tell
+        if (threadCount == 0)
+        {
+            unsigned hardwareThreads = std::thread::hardware_concurrency();
+            threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+        }
+
+        Workers.reserve(threadCount);
+        for (uint32_t i = 0; i < threadCount; i++)
+            Workers.emplace_back([this] { WorkerLoop(); });
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(JobMutex);
+            Stopping = true;
+        }
+        JobAvailable.notify_all();
+
+        for (std::thread& worker : Workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    static ThreadPool& GetInstance()
+    {
+        static ThreadPool instance;
+        return instance;
+    }
+
+    uint32_t GetThreadCount() const { return static_cast<uint32_t>(Workers.size()); }
+
+    template<typename Function>
+    std::future<std::invoke_result_t<Function>> Submit(Function&& function)
+    {
+        using Result = std::invoke_result_t<Function>;
+        std::shared_ptr<std::packaged_task<Result()>> task = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(function));
+        std::future<Result> future = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(JobMutex);
+            Jobs.emplace([task] { (*task)(); });
+        }
+        JobAvailable.notify_one();
+        return future;
+    }
+
+    // Runs body(i) for i in [0, count) across the workers and the caller, returns once every index has run.
+    // If body throws, indices not yet started are skipped and the first exception is rethrown here.
+    void ParallelFor(uint32_t count, std::function<void(uint32_t)> body)
+    {
+        if (count == 0)
+            return;
+
+        std::shared_ptr<ParallelForState> state = std::make_shared<ParallelForState>();
+        state->Count = count;
+        state->Body = std::move(body);
+
+        uint32_t helperCount = std::min(GetThreadCount(), count - 1);
+        {
+            std::lock_guard<std::mutex> lock(JobMutex);
+            for (uint32_t i = 0; i < helperCount; i++)
+                Jobs.emplace([state] { RunParallelFor(*state); });
+        }
+        JobAvailable.notify_all();
+
+        RunParallelFor(*state);
+
+        // Only waits on indices other threads already claimed, helpers that start late find no work
+        uint32_t completed = state->CompletedCount.load();
+        while (completed != count)
+        {
+            state->CompletedCount.wait(completed);
+            completed = state->CompletedCount.load();
+        }
+
+        if (state->Exception)
+            std::rethrow_exception(state->Exception);
+    }
+};
@@ -74,6 +74,7 @@ public:
     ComPtr<ID3D12GraphicsCommandList> GetCommandList() const { return CommandLists[CurrentFrameIndex]; }
     ComPtr<ID3D12GraphicsCommandList> GetTransferCommandList() const { return TransferCommandList; }
     uint32_t GetCurrentFrameIndex() const { return CurrentFrameIndex; }
+    static uint32_t GetFrameCount() { return SwapChainBufferCount; }
     ComPtr<ID3D12DescriptorHeap> GetRenderTargetDescriptorHeap() const { return RenderTargetDescriptorHeap; }
     ComPtr<ID3D12DescriptorHeap> GetDepthStencilDescriptorHeap() const { return DepthStencilDescriptorHeap; }
     UINT GetMSAAQualityLevel(DXGI_FORMAT format, UINT sampleCount);
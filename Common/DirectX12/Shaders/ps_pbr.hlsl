@@ -28,10 +28,11 @@ static float3x3 MakeTBN(float3 n, float3 t, float3 b)
     return float3x3(t, b, n); // columns are T, B, N for mul(TBN, normalTS)
 }
 
-static float3 UNormToNorm(float3 normalSample)
+// z is rebuilt so two channel BC5 maps decode the same as RGBA ones
+static float3 UNormToNorm(float2 normalSample)
 {
-    float3 n = normalSample * 2.0f - 1.0f;
-    return normalize(n);
+    float2 xy = normalSample * 2.0f - 1.0f;
+    return normalize(float3(xy, sqrt(saturate(1.0f - dot(xy, xy)))));
 }
 
 static float3 NormToUNorm(float3 n)
@@ -45,7 +46,7 @@ PSOutput main(VSOutput i)
 
     float3 albedo = gDiffuseTex.Sample(gSamplerLinearWrap, i.UV).rgb;
     
-    float3 normalTS = UNormToNorm(gNormalTex.Sample(gSamplerLinearWrap, i.UV).rgb);
+    float3 normalTS = UNormToNorm(gNormalTex.Sample(gSamplerLinearWrap, i.UV).rg);
     float3x3 TBN = MakeTBN(i.NormalWS, i.TangentWS, i.BinormalWS);
     float3 normalWS = normalize(mul(normalTS, TBN));
 
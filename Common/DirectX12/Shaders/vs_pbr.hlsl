@@ -1,3 +1,14 @@
+#ifdef COMPACT_VERTICES
+// Quantized position with bitangent sign in w, octahedral normal and tangent, half UVs
+// Dequantization is folded into gModel on the CPU
+struct VSInput
+{
+    float4 Position : POSITION;
+    float2 Normal   : NORMAL;
+    float2 Tangent  : TANGENT;
+    float2 UV       : TEXCOORD;
+};
+#else
 struct VSInput
 {
     float3 Position : POSITION;
@@ -6,6 +17,7 @@ struct VSInput
     float3 Binormal : BINORMAL;
     float2 UV       : TEXCOORD;
 };
+#endif
 
 struct VSOutput
 {
@@ -28,20 +40,42 @@ cbuffer ObjectCB : register(b1)
     float4x4 gModel;
 };
 
+#ifdef COMPACT_VERTICES
+float3 DecodeOctahedral(float2 encoded)
+{
+    float3 direction = float3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+    float t = max(-direction.z, 0.0f);
+    direction.xy += (direction.xy >= 0.0f) ? -t : t;
+    return normalize(direction);
+}
+#endif
+
 VSOutput main(VSInput input)
 {
     VSOutput o;
 
-    float4 posWS = mul(float4(input.Position, 1.0f), gModel);
+#ifdef COMPACT_VERTICES
+    float3 position = input.Position.xyz;
+    float3 normal   = DecodeOctahedral(input.Normal);
+    float3 tangent  = DecodeOctahedral(input.Tangent);
+    float3 binormal = cross(normal, tangent) * input.Position.w;
+#else
+    float3 position = input.Position;
+    float3 normal   = input.Normal;
+    float3 tangent  = input.Tangent;
+    float3 binormal = input.Binormal;
+#endif
+
+    float4 posWS = mul(float4(position, 1.0f), gModel);
     o.PositionCS = mul(posWS, gViewProj);
 
     // Transform basis vectors to world space.
     // NOTE: This assumes gModel has no non-uniform scale. If it does, you want inverse-transpose for normals.
     float3x3 m3 = (float3x3)gModel;
 
-    o.NormalWS   = mul(input.Normal,   m3);
-    o.TangentWS  = mul(input.Tangent,  m3);
-    o.BinormalWS = mul(input.Binormal, m3);
+    o.NormalWS   = mul(normal,   m3);
+    o.TangentWS  = mul(tangent,  m3);
+    o.BinormalWS = mul(binormal, m3);
 
     o.UV = input.UV;
     return o;
@@ -11,4 +11,15 @@ inline struct GraphicsSettings
     API APIToUse = Vulkan;
     bool MSAA = false;
     bool HDR = false;
+    bool CompactVertices = false;
+    bool Meshlets = false;
+    bool MeshLODs = false;
+    // Off uploads the source PNGs uncompressed, converted straight into staging memory, for quick texture iteration
+    bool CookTextures = true;
+    // Cooked textures start from a small mip tail and stream levels in and out against the ResidencyManager budget
+    bool TextureStreaming = true;
+    // Reads assets out of Assets.earc when it exists, loose files stay the fallback
+    bool AssetArchive = true;
+    // Packs the loose source assets and shaders into Assets.earc at startup, enable once after assets change
+    bool PackAssetArchive = false;
 } GRAPHICS_SETTINGS;
@@ -0,0 +1,407 @@
+#ifdef __linux__
+#include "IOUringReader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Submission and completion queues mapped from the kernel. Only the owning thread touches it.
+class IOUringReader::Ring
+{
+public:
+
+    Ring() = default;
+    ~Ring();
+
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    bool Open(uint32_t entries);
+    uint32_t GetEntries() const                         { return Entries; }
+    // Set after a fatal io_uring_enter error, GetThreadRing then replaces the ring
+    void MarkFailed()                                   { Failed = true; }
+    bool HasFailed() const                              { return Failed; }
+
+    // Next free submission entry, null when the queue is full
+    io_uring_sqe* GetSQE();
+    // Submits the queued entries and waits until at least waitCount completions are available
+    int Submit(uint32_t waitCount);
+    bool PopCQE(io_uring_cqe& outCQE);
+
+private:
+
+    int Descriptor = -1;
+    uint32_t Entries = 0;
+
+    void* SQMemory = nullptr;
+    size_t SQMemorySize = 0;
+    void* CQMemory = nullptr;
+    size_t CQMemorySize = 0;
+    io_uring_sqe* SQEs = nullptr;
+    size_t SQEsSize = 0;
+
+    uint32_t* SQHead = nullptr;
+    uint32_t* SQTail = nullptr;
+    uint32_t SQMask = 0;
+    uint32_t* SQArray = nullptr;
+    uint32_t* CQHead = nullptr;
+    uint32_t* CQTail = nullptr;
+    uint32_t CQMask = 0;
+    io_uring_cqe* CQEs = nullptr;
+
+    uint32_t LocalTail = 0;
+    uint32_t Unsubmitted = 0;
+    bool Failed = false;
+};
+
+IOUringReader::Ring::~Ring()
+{
+    if (SQEs)
+        munmap(SQEs, SQEsSize);
+    if (CQMemory && CQMemory != SQMemory)
+        munmap(CQMemory, CQMemorySize);
+    if (SQMemory)
+        munmap(SQMemory, SQMemorySize);
+    if (Descriptor >= 0)
+        close(Descriptor);
+}
+
+bool IOUringReader::Ring::Open(uint32_t entries)
+{
+    io_uring_params params {};
+    Descriptor = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (Descriptor < 0)
+        return false;
+
+    Entries = params.sq_entries;
+    SQMemorySize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    CQMemorySize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    // Newer kernels share one mapping between both rings
+    bool singleMapping = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMapping)
+        SQMemorySize = CQMemorySize = std::max(SQMemorySize, CQMemorySize);
+
+    SQMemory = mmap(nullptr, SQMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Descriptor, IORING_OFF_SQ_RING);
+    if (SQMemory == MAP_FAILED)
+    {
+        SQMemory = nullptr;
+        return false;
+    }
+
+    CQMemory = singleMapping ? SQMemory : mmap(nullptr, CQMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Descriptor, IORING_OFF_CQ_RING);
+    if (CQMemory == MAP_FAILED)
+    {
+        CQMemory = nullptr;
+        return false;
+    }
+
+    SQEsSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, SQEsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Descriptor, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+        return false;
+    SQEs = static_cast<io_uring_sqe*>(sqes);
+
+    uint8_t* sq = static_cast<uint8_t*>(SQMemory);
+    SQHead = reinterpret_cast<uint32_t*>(sq + params.sq_off.head);
+    SQTail = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+    SQMask = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+    SQArray = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+
+    uint8_t* cq = static_cast<uint8_t*>(CQMemory);
+    CQHead = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+    CQTail = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+    CQMask = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+    CQEs = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    LocalTail = *SQTail;
+    return true;
+}
+
+io_uring_sqe* IOUringReader::Ring::GetSQE()
+{
+    uint32_t head = std::atomic_ref<uint32_t>(*SQHead).load(std::memory_order_acquire);
+    if (LocalTail - head >= Entries)
+        return nullptr;
+
+    uint32_t index = LocalTail & SQMask;
+    SQArray[index] = index;
+    LocalTail++;
+    Unsubmitted++;
+
+    io_uring_sqe* sqe = &SQEs[index];
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+int IOUringReader::Ring::Submit(uint32_t waitCount)
+{
+    std::atomic_ref<uint32_t>(*SQTail).store(LocalTail, std::memory_order_release);
+
+    int result = static_cast<int>(syscall(__NR_io_uring_enter, Descriptor, Unsubmitted, waitCount, IORING_ENTER_GETEVENTS, nullptr, 0));
+    if (result >= 0)
+        Unsubmitted -= std::min(Unsubmitted, static_cast<uint32_t>(result));
+    return result < 0 ? -errno : result;
+}
+
+bool IOUringReader::Ring::PopCQE(io_uring_cqe& outCQE)
+{
+    uint32_t head = *CQHead;
+    uint32_t tail = std::atomic_ref<uint32_t>(*CQTail).load(std::memory_order_acquire);
+    if (head == tail)
+        return false;
+
+    outCQE = CQEs[head & CQMask];
+    std::atomic_ref<uint32_t>(*CQHead).store(head + 1, std::memory_order_release);
+    return true;
+}
+
+bool IOUringReader::IsSupported()
+{
+    static const bool supported = []()
+    {
+        Ring ring;
+        return ring.Open(QueueDepth);
+    }();
+    return supported;
+}
+
+IOUringReader::Ring* IOUringReader::GetThreadRing()
+{
+    thread_local std::unique_ptr<Ring> ring;
+    if (ring && ring->HasFailed())
+        ring.reset();
+    if (!ring)
+    {
+        std::unique_ptr<Ring> created = std::make_unique<Ring>();
+        if (!created->Open(QueueDepth))
+            return nullptr;
+        ring = std::move(created);
+    }
+    return ring.get();
+}
+
+bool IOUringReader::ReadFiles(const std::vector<std::string>& paths, std::vector<FileBuffer>& outBuffers, uint32_t& outDirectReads)
+{
+    struct OpenFile
+    {
+        int Descriptor = -1;
+        bool Direct = false;
+        bool Failed = false;
+    };
+
+    struct Chunk
+    {
+        uint32_t File = 0;
+        uint64_t Offset = 0;
+        uint32_t Length = 0;
+    };
+
+    outDirectReads = 0;
+    Ring* threadRing = GetThreadRing();
+    if (!threadRing)
+        return false;
+    Ring& ring = *threadRing;
+
+    // Opening is synchronous, the reads of every file then share the ring
+    std::vector<OpenFile> files(paths.size());
+    std::deque<Chunk> pending;
+    for (uint32_t i = 0; i < paths.size(); i++)
+    {
+        int descriptor = open(paths[i].c_str(), O_RDONLY | O_CLOEXEC);
+        if (descriptor < 0)
+            continue;
+
+        struct stat status {};
+        if (fstat(descriptor, &status) != 0 || !S_ISREG(status.st_mode) || status.st_size <= 0)
+        {
+            if (S_ISREG(status.st_mode) && status.st_size == 0)
+                outBuffers[i] = FileBuffer(0);
+            close(descriptor);
+            continue;
+        }
+
+        uint64_t size = static_cast<uint64_t>(status.st_size);
+        files[i].Descriptor = descriptor;
+        outBuffers[i] = FileBuffer(size);
+
+        if (size >= AssetIO::DirectReadThreshold)
+        {
+            int flags = fcntl(descriptor, F_GETFL);
+            if (flags >= 0 && fcntl(descriptor, F_SETFL, flags | O_DIRECT) == 0)
+            {
+                files[i].Direct = true;
+                outDirectReads++;
+            }
+        }
+
+        for (uint64_t offset = 0; offset < size; offset += MaxChunkSize)
+            pending.push_back({ i, offset, static_cast<uint32_t>(std::min<uint64_t>(MaxChunkSize, size - offset)) });
+    }
+
+    auto dropDirect = [&](OpenFile& file)
+    {
+        int flags = fcntl(file.Descriptor, F_GETFL);
+        if (flags >= 0)
+            fcntl(file.Descriptor, F_SETFL, flags & ~O_DIRECT);
+        file.Direct = false;
+    };
+
+    // Completions are matched to their chunk through a slot index in user_data
+    std::vector<Chunk> slots(ring.GetEntries());
+    std::vector<uint8_t> slotBusy(ring.GetEntries(), 0);
+    std::vector<uint32_t> freeSlots(ring.GetEntries());
+    for (uint32_t i = 0; i < freeSlots.size(); i++)
+        freeSlots[i] = static_cast<uint32_t>(freeSlots.size()) - 1 - i;
+    uint32_t inFlight = 0;
+
+    auto isFatal = [](int submitted)
+    {
+        return submitted < 0 && submitted != -EINTR && submitted != -EAGAIN && submitted != -EBUSY;
+    };
+
+    // After a fatal io_uring_enter error the reads still in flight can write into outBuffers. They are cancelled and reaped
+    // before anything is freed, and when the ring cannot even do that the buffers they target are leaked instead.
+    auto abandon = [&]()
+    {
+        std::vector<uint8_t> cancelled(slots.size(), 0);
+        uint32_t failures = 0;
+        while (inFlight > 0 && failures < DrainAttempts)
+        {
+            for (uint32_t slot = 0; slot < slots.size(); slot++)
+            {
+                if (!slotBusy[slot] || cancelled[slot])
+                    continue;
+
+                io_uring_sqe* sqe = ring.GetSQE();
+                if (!sqe)
+                    break;
+                sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                sqe->fd = -1;
+                sqe->addr = slot;
+                sqe->user_data = CancelTag;
+                cancelled[slot] = 1;
+            }
+
+            if (isFatal(ring.Submit(1)))
+                failures++;
+
+            io_uring_cqe cqe;
+            while (ring.PopCQE(cqe))
+            {
+                if (cqe.user_data == CancelTag)
+                    continue;
+                slotBusy[cqe.user_data] = 0;
+                inFlight--;
+            }
+        }
+
+        for (uint32_t slot = 0; slot < slots.size(); slot++)
+            if (slotBusy[slot] && outBuffers[slots[slot].File].GetData())
+                new FileBuffer(std::move(outBuffers[slots[slot].File]));
+        ring.MarkFailed();
+    };
+
+    bool ringFailed = false;
+    while (!pending.empty() || inFlight > 0)
+    {
+        while (!pending.empty() && !freeSlots.empty())
+        {
+            Chunk chunk = pending.front();
+            OpenFile& file = files[chunk.File];
+            if (file.Failed)
+            {
+                pending.pop_front();
+                continue;
+            }
+
+            io_uring_sqe* sqe = ring.GetSQE();
+            if (!sqe)
+                break;
+            pending.pop_front();
+
+            // Direct reads need aligned lengths, the buffer is padded so the tail of the last chunk fits
+            uint32_t length = chunk.Length;
+            if (file.Direct)
+                length = static_cast<uint32_t>((length + AssetIO::DirectIOAlignment - 1) / AssetIO::DirectIOAlignment * AssetIO::DirectIOAlignment);
+
+            uint32_t slot = freeSlots.back();
+            freeSlots.pop_back();
+            slots[slot] = chunk;
+            slotBusy[slot] = 1;
+
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = file.Descriptor;
+            sqe->off = chunk.Offset;
+            sqe->addr = reinterpret_cast<uint64_t>(outBuffers[chunk.File].GetData() + chunk.Offset);
+            sqe->len = length;
+            sqe->user_data = slot;
+            inFlight++;
+        }
+
+        // Chunks of failed files are dropped without a read, waiting with nothing in flight would never return
+        if (inFlight == 0)
+            continue;
+
+        if (isFatal(ring.Submit(1)))
+        {
+            abandon();
+            ringFailed = true;
+            break;
+        }
+
+        io_uring_cqe cqe;
+        while (ring.PopCQE(cqe))
+        {
+            uint32_t slot = static_cast<uint32_t>(cqe.user_data);
+            Chunk chunk = slots[slot];
+            slotBusy[slot] = 0;
+            freeSlots.push_back(slot);
+            inFlight--;
+
+            OpenFile& file = files[chunk.File];
+            int result = cqe.res;
+            if (result == -EAGAIN || result == -EINTR)
+                pending.push_front(chunk);
+            else if (result == -EINVAL && file.Direct)
+            {
+                dropDirect(file);
+                pending.push_front(chunk);
+            }
+            else if (result < 0)
+                file.Failed = true;
+            else if (result == 0)
+                outBuffers[chunk.File].Truncate(chunk.Offset);
+            else if (static_cast<uint32_t>(result) < chunk.Length)
+            {
+                // Short reads continue where they stopped, off alignment only buffered reads can
+                if (file.Direct && result % AssetIO::DirectIOAlignment != 0)
+                    dropDirect(file);
+                pending.push_front({ chunk.File, chunk.Offset + result, chunk.Length - static_cast<uint32_t>(result) });
+            }
+        }
+    }
+
+    // The ring holds its own reference to files with reads still in flight, closing here is safe either way
+    for (uint32_t i = 0; i < files.size(); i++)
+    {
+        if (files[i].Descriptor >= 0)
+            close(files[i].Descriptor);
+        if (files[i].Failed || ringFailed)
+            outBuffers[i].Reset();
+    }
+
+    if (ringFailed)
+        outDirectReads = 0;
+    return !ringFailed;
+}
+#endif
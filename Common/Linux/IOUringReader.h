@@ -0,0 +1,39 @@
+#pragma once
+#ifdef __linux__
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../Data/AssetIO.h"
+
+// AssetIO backend on io_uring, driven through the raw syscalls so no liburing is needed. Every thread gets its own
+// ring, a batch of files is opened up front and their reads go out together, each file split into chunks so large
+// files keep several reads in flight. Files of at least AssetIO::DirectReadThreshold bytes are read with O_DIRECT,
+// falling back to buffered reads where the file system refuses it.
+class IOUringReader
+{
+public:
+
+    // False when the kernel is too old or io_uring is disabled, checked once
+    static bool IsSupported();
+
+    // Fills outBuffers[i] with the contents of paths[i], unreadable files stay invalid, and counts the direct reads.
+    // False without reading anything when this thread cannot get a ring, such as when RLIMIT_MEMLOCK is used up, or
+    // when the ring fails mid-batch. outBuffers are then all invalid and the caller reads the batch another way.
+    static bool ReadFiles(const std::vector<std::string>& paths, std::vector<FileBuffer>& outBuffers, uint32_t& outDirectReads);
+
+private:
+
+    class Ring;
+
+    static constexpr uint32_t QueueDepth = 64;
+    static constexpr uint32_t MaxChunkSize = 8 * 1024 * 1024;
+    // user_data of cancel requests, read requests carry their slot index
+    static constexpr uint64_t CancelTag = UINT64_MAX;
+    // Fatal io_uring_enter errors tolerated while cancelling a failed batch before its buffers are given up
+    static constexpr uint32_t DrainAttempts = 8;
+
+    // Null when the ring cannot be created, the next call tries again
+    static Ring* GetThreadRing();
+};
+#endif
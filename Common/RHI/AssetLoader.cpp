@@ -0,0 +1,249 @@
+#include "AssetLoader.h"
+
+#include <algorithm>
+
+#include "Geometry/GeometryImport.h"
+#include "../Data/ThreadPool.h"
+
+using namespace DirectX;
+
+AssetLoader& AssetLoader::GetInstance()
+{
+    static AssetLoader instance;
+    return instance;
+}
+
+AssetLoader::Handle<Material> AssetLoader::LoadMaterial(const std::string& name, Material::MaterialFormat format, uint32_t pipelineIndex,
+                                                        uint32_t setIndex, float priority)
+{
+    // The closures live in the request, so they reach the result through a plain pointer
+    std::shared_ptr<TypedRequest<Material>> request = std::make_shared<TypedRequest<Material>>();
+    TypedRequest<Material>* typed = request.get();
+    typed->Load = [typed, name, format]() { typed->Result = std::make_unique<Material>(name, format); };
+    typed->Finish = [typed, pipelineIndex, setIndex]() { typed->Result->LoadMaterial(pipelineIndex, setIndex); };
+    typed->Discard = [typed]()
+    {
+        typed->Result->UnloadMaterial();
+        typed->Result.reset();
+    };
+
+    Enqueue(request, priority);
+    return Handle<Material>(std::move(request));
+}
+
+AssetLoader::Handle<Scene> AssetLoader::LoadScene(const std::string& filePath, const std::string& name, const XMMATRIX& transform,
+                                                  const std::vector<std::string>& occluderNodeNames, float priority)
+{
+    XMFLOAT4X4 storedTransform;
+    XMStoreFloat4x4(&storedTransform, transform);
+
+    std::shared_ptr<TypedRequest<Scene>> request = std::make_shared<TypedRequest<Scene>>();
+    TypedRequest<Scene>* typed = request.get();
+    typed->Load = [typed, filePath, name, storedTransform, occluderNodeNames]()
+    {
+        typed->Result = std::make_unique<Scene>(GeometryImport::CreateScene(filePath, name, XMLoadFloat4x4(&storedTransform), occluderNodeNames));
+    };
+    typed->Discard = [typed]()
+    {
+        typed->Result->ReleaseGeometry();
+        typed->Result.reset();
+    };
+
+    Enqueue(request, priority);
+    return Handle<Scene>(std::move(request));
+}
+
+float AssetLoader::DistancePriority(const XMFLOAT3& position, const XMFLOAT3& eye)
+{
+    return -XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&position), XMLoadFloat3(&eye))));
+}
+
+void AssetLoader::Update(double maxMilliseconds)
+{
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    std::chrono::high_resolution_clock::time_point deadline = start + std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(
+        std::chrono::duration<double, std::milli>(maxMilliseconds));
+
+    RenderThread = std::this_thread::get_id();
+    LastStatistics = {};
+
+    Dispatch();
+    RunTasks(deadline);
+    Settle();
+
+    LastStatistics.Queued = static_cast<uint32_t>(Queue.size());
+    LastStatistics.Loading = static_cast<uint32_t>(Running.size());
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+    LastStatistics.Milliseconds = elapsed.count();
+}
+
+void AssetLoader::Flush()
+{
+    for (const std::shared_ptr<Request>& request : Queue)
+        request->CancelRequested = true;
+
+    // Running loads may be waiting on the render thread, so they are served rather than waited on
+    while (!Queue.empty() || !Running.empty())
+        Update();
+}
+
+void AssetLoader::RunOnRenderThread(const std::function<void()>& work)
+{
+    AssetLoader& loader = GetInstance();
+    std::thread::id renderThread = loader.RenderThread;
+    if (renderThread == std::thread::id() || renderThread == std::this_thread::get_id())
+    {
+        work();
+        return;
+    }
+
+    RenderThreadTask task;
+    task.Work = work;
+    std::future<void> done = task.Done.get_future();
+    {
+        std::lock_guard<std::mutex> lock(loader.TaskMutex);
+        loader.Tasks.push_back(&task);
+    }
+    loader.TaskPosted.notify_one();
+    done.get();
+}
+
+void AssetLoader::Enqueue(std::shared_ptr<Request> request, float priority)
+{
+    RenderThread = std::this_thread::get_id();
+    request->Priority = priority;
+    request->Sequence = NextSequence++;
+    Queue.push_back(std::move(request));
+}
+
+void AssetLoader::RunTasks(std::chrono::high_resolution_clock::time_point deadline)
+{
+    bool ranTask = false;
+    while (true)
+    {
+        RenderThreadTask* task;
+        {
+            std::unique_lock<std::mutex> lock(TaskMutex);
+
+            // A load that just posted usually posts again shortly, waiting for it keeps a scene's uploads within few frames
+            if (Tasks.empty() && ranTask)
+            {
+                TaskPosted.wait_until(lock, deadline, [this]()
+                {
+                    return !Tasks.empty() || std::all_of(Running.begin(), Running.end(), [](const std::shared_ptr<Request>& request) { return request->LoadDone.load(); });
+                });
+            }
+            if (Tasks.empty())
+                return;
+
+            task = Tasks.front();
+            Tasks.pop_front();
+        }
+
+        try
+        {
+            task->Work();
+            task->Done.set_value();
+        }
+        catch (...)
+        {
+            task->Done.set_exception(std::current_exception());
+        }
+        ranTask = true;
+        LastStatistics.RenderThreadTasks++;
+
+        if (std::chrono::high_resolution_clock::now() >= deadline)
+            return;
+    }
+}
+
+void AssetLoader::Settle()
+{
+    std::erase_if(Running, [this](const std::shared_ptr<Request>& request)
+    {
+        if (!request->LoadDone)
+            return false;
+
+        if (request->Error)
+            request->CurrentState = State::Failed;
+        else if (request->CancelRequested)
+        {
+            request->Discard();
+            request->CurrentState = State::Cancelled;
+            LastStatistics.Cancelled++;
+        }
+        else
+        {
+            try
+            {
+                if (request->Finish)
+                    request->Finish();
+                request->CurrentState = State::Ready;
+            }
+            catch (...)
+            {
+                request->Error = std::current_exception();
+                request->Discard();
+                request->CurrentState = State::Failed;
+            }
+        }
+
+        LastStatistics.Completed++;
+        request->Load = nullptr;
+        request->Finish = nullptr;
+        request->Discard = nullptr;
+        return true;
+    });
+}
+
+void AssetLoader::Dispatch()
+{
+    std::erase_if(Queue, [this](const std::shared_ptr<Request>& request)
+    {
+        if (!request->CancelRequested)
+            return false;
+        request->CurrentState = State::Cancelled;
+        request->Load = nullptr;
+        request->Finish = nullptr;
+        request->Discard = nullptr;
+        LastStatistics.Cancelled++;
+        return true;
+    });
+
+    // Priorities may change between frames, so the best request is picked fresh each time a slot frees up
+    while (Running.size() < MaxConcurrentLoads && !Queue.empty())
+    {
+        auto best = std::max_element(Queue.begin(), Queue.end(), [](const std::shared_ptr<Request>& a, const std::shared_ptr<Request>& b)
+        {
+            float priorityA = a->Priority;
+            float priorityB = b->Priority;
+            if (priorityA != priorityB)
+                return priorityA < priorityB;
+            return a->Sequence > b->Sequence;
+        });
+
+        std::shared_ptr<Request> request = std::move(*best);
+        Queue.erase(best);
+        request->CurrentState = State::Loading;
+        Running.push_back(request);
+
+        ThreadPool::GetInstance().Submit([this, request]()
+        {
+            try
+            {
+                request->Load();
+            }
+            catch (...)
+            {
+                request->Error = std::current_exception();
+            }
+
+            // Under the lock so a render thread waiting for more tasks sees the load end
+            {
+                std::lock_guard<std::mutex> lock(TaskMutex);
+                request->LoadDone = true;
+            }
+            TaskPosted.notify_one();
+        });
+    }
+}
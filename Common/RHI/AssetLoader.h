@@ -0,0 +1,150 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "Material.h"
+#include "Geometry/Scene.h"
+
+// Loads materials and scenes in the background while the render loop keeps going. Requests wait in a priority queue and
+// run their disk IO and decoding on the ThreadPool, a few at a time so workers stay free for the parallel work inside a
+// load. GPU work of a load, uploads and buffer creation, is handed to the render thread through RunOnRenderThread and
+// runs inside Update under a time budget. Load calls and Update belong to the render thread, handles may be read anywhere.
+class AssetLoader
+{
+public:
+
+    enum class State : uint8_t
+    {
+        Queued,
+        Loading,
+        Ready,
+        Failed,
+        Cancelled
+    };
+
+    struct Request
+    {
+        std::atomic<State> CurrentState { State::Queued };
+        std::atomic<bool> CancelRequested { false };
+        std::atomic<bool> LoadDone { false };
+        std::atomic<float> Priority { 0.0f };
+        uint64_t Sequence = 0;
+        std::exception_ptr Error;
+        // CPU phase on a worker
+        std::function<void()> Load;
+        // GPU phase on the render thread once Load succeeded, may be empty
+        std::function<void()> Finish;
+        // Releases a loaded result nobody wants anymore, on the render thread
+        std::function<void()> Discard;
+    };
+
+    template<typename Asset>
+    struct TypedRequest : Request
+    {
+        std::unique_ptr<Asset> Result;
+    };
+
+    // Shared view of a request. Copies refer to the same load, the loader keeps its own reference until the load settles.
+    template<typename Asset>
+    class Handle
+    {
+    public:
+        Handle() = default;
+
+        bool IsValid() const                        { return Shared != nullptr; }
+        State GetState() const                      { return Shared ? Shared->CurrentState.load() : State::Cancelled; }
+        bool IsReady() const                        { return GetState() == State::Ready; }
+        // The loaded asset once Ready, owned by the handle's request
+        Asset* Get() const                          { return IsReady() ? Shared->Result.get() : nullptr; }
+        // Rethrows the exception that failed the load
+        void Rethrow() const                        { if (GetState() == State::Failed) std::rethrow_exception(Shared->Error); }
+
+        // Higher loads sooner, applies until the load starts
+        void SetPriority(float priority)            { if (Shared) Shared->Priority = priority; }
+        // Queued loads never start, running ones finish their current phase and are then released. No effect once Ready.
+        void Cancel()                               { if (Shared) Shared->CancelRequested = true; }
+
+    private:
+        friend class AssetLoader;
+        explicit Handle(std::shared_ptr<TypedRequest<Asset>> shared) : Shared(std::move(shared)) {}
+        std::shared_ptr<TypedRequest<Asset>> Shared;
+    };
+
+    struct Statistics
+    {
+        uint32_t Queued = 0;
+        uint32_t Loading = 0;
+        uint32_t Completed = 0;
+        uint32_t Cancelled = 0;
+        uint32_t RenderThreadTasks = 0;
+        double Milliseconds = 0.0;
+    };
+
+    static AssetLoader& GetInstance();
+
+    // Material constructor on a worker, LoadMaterial into pipelineIndex's set setIndex on the render thread
+    Handle<Material> LoadMaterial(const std::string& name, Material::MaterialFormat format, uint32_t pipelineIndex, uint32_t setIndex, float priority = 0.0f);
+    // GeometryImport::CreateScene on a worker, its mesh uploads run on the render thread
+    Handle<Scene> LoadScene(const std::string& filePath, const std::string& name, const DirectX::XMMATRIX& transform,
+                            const std::vector<std::string>& occluderNodeNames = {}, float priority = 0.0f);
+
+    // Priority that loads nearer objects first
+    static float DistancePriority(const DirectX::XMFLOAT3& position, const DirectX::XMFLOAT3& eye);
+
+    void SetMaxConcurrentLoads(uint32_t count)      { MaxConcurrentLoads = count ? count : 1; }
+
+    // Once per frame on the render thread. Runs GPU work of loads for up to maxMilliseconds, settles finished loads and
+    // starts queued ones by priority.
+    void Update(double maxMilliseconds = DefaultBudgetMilliseconds);
+    // Cancels everything queued and runs Update until running loads have settled, before tearing the renderer down
+    void Flush();
+
+    // Runs work on the render thread and returns once it ran. Inline on the render thread or before any Update,
+    // from workers it waits for the next Update. Exceptions of work are rethrown to the caller.
+    static void RunOnRenderThread(const std::function<void()>& work);
+
+    const Statistics& GetStatistics() const         { return LastStatistics; }
+
+private:
+
+    struct RenderThreadTask
+    {
+        std::function<void()> Work;
+        std::promise<void> Done;
+    };
+
+    static constexpr uint32_t DefaultMaxConcurrentLoads = 2;
+    static constexpr double DefaultBudgetMilliseconds = 2.0;
+
+    AssetLoader() = default;
+
+    // Render thread only
+    std::vector<std::shared_ptr<Request>> Queue;
+    std::vector<std::shared_ptr<Request>> Running;
+    uint64_t NextSequence = 0;
+    uint32_t MaxConcurrentLoads = DefaultMaxConcurrentLoads;
+    Statistics LastStatistics;
+
+    std::atomic<std::thread::id> RenderThread {};
+    std::mutex TaskMutex;
+    std::condition_variable TaskPosted;
+    std::deque<RenderThreadTask*> Tasks;
+
+    void Enqueue(std::shared_ptr<Request> request, float priority);
+    // Runs posted tasks until the deadline, waiting for the next one while a load keeps posting
+    void RunTasks(std::chrono::high_resolution_clock::time_point deadline);
+    void Settle();
+    void Dispatch();
+};
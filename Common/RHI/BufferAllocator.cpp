@@ -1,7 +1,9 @@
 #include "BufferAllocator.h"
 
+#include <algorithm>
 #include <map>
 
+#include "Image/BlockCompression.h"
 #include "../GraphicsSettings.h"
 #include "../DirectX12/D3DCore.h"
 #include "../Vulkan/VulkanCore.h"
@@ -29,6 +31,61 @@ BufferAllocator* BufferAllocator::GetInstance()
     return Instance;
 }
 
+uint64_t BufferAllocator::ImageDataSize(const ImageDesc& imageDesc)
+{
+    uint64_t size = 0;
+    for (uint32_t mip = 0; mip < imageDesc.MipLevels; mip++)
+        size += BlockCompression::LevelSize(imageDesc.Format, std::max(imageDesc.Width >> mip, 1u), std::max(imageDesc.Height >> mip, 1u));
+    return size;
+}
+
+uint32_t BufferAllocator::ImageRowCount(const ImageDesc& imageDesc, uint32_t mipLevel)
+{
+    uint32_t height = std::max(imageDesc.Height >> mipLevel, 1u);
+    return BlockCompression::IsBlockCompressed(imageDesc.Format) ? (height + 3) / 4 : height;
+}
+
+uint64_t BufferAllocator::CreateImage(ImageDesc imageDesc, bool createDescriptor)
+{
+    if (imageDesc.InitialData == nullptr || imageDesc.Size < ImageDataSize(imageDesc))
+        throw std::runtime_error("CreateImage requires InitialData holding every mip level for the Width/Height/Format/MipLevels.");
+
+    // Offsets of each level inside InitialData
+    std::vector<uint64_t> levelOffsets(imageDesc.MipLevels);
+    uint64_t offset = 0;
+    for (uint32_t mip = 0; mip < imageDesc.MipLevels; mip++)
+    {
+        levelOffsets[mip] = offset;
+        offset += BlockCompression::LevelSize(imageDesc.Format, std::max(imageDesc.Width >> mip, 1u), std::max(imageDesc.Height >> mip, 1u));
+    }
+
+    const uint8_t* source = static_cast<const uint8_t*>(imageDesc.InitialData);
+    return CreateImage(imageDesc, [&](uint8_t* destination, uint32_t mipLevel, uint64_t rowPitch)
+    {
+        uint32_t rows = ImageRowCount(imageDesc, mipLevel);
+        uint64_t levelSize = BlockCompression::LevelSize(imageDesc.Format, std::max(imageDesc.Width >> mipLevel, 1u), std::max(imageDesc.Height >> mipLevel, 1u));
+        uint64_t rowSize = levelSize / rows;
+        const uint8_t* level = source + levelOffsets[mipLevel];
+        
+        if (rowPitch == rowSize)
+        {
+            memcpy(destination, level, levelSize);
+            return;
+        }
+        
+        for (uint32_t row = 0; row < rows; row++)
+            memcpy(destination + row * rowPitch, level + row * rowSize, rowSize);
+    }, createDescriptor);
+}
+
+uint64_t BufferAllocator::RebindDescriptorSet(uint64_t setID, const std::vector<DescriptorSetBinding>& bindings)
+{
+    uint64_t setKey = AllocatedDescriptorSets.at(setID).SetKey;
+    uint64_t previousID = AllocateDescriptorSet(static_cast<uint32_t>(setKey >> 32), static_cast<uint32_t>(setKey), bindings);
+    std::swap(AllocatedDescriptorSets.at(setID), AllocatedDescriptorSets.at(previousID));
+    return previousID;
+}
+
 //================================================//
 // Vulkan                                         //
 //================================================//
@@ -182,7 +239,9 @@ uint64_t VulkanBufferAllocator::CreateBuffer(BufferDesc bufferDesc, bool createD
     VkDevice device = VulkanCore::GetInstance().GetDevice();
     VkPhysicalDevice physicalDevice = VulkanCore::GetInstance().GetPhysicalDevice();
     
-    bool needsDeviceAddress = (bufferDesc.Type == BufferType::Constant || bufferDesc.Type == BufferType::ShaderStorage);
+    // Vertex buffers are also read by address from the mesh shading path
+    bool needsDeviceAddress = (bufferDesc.Type == BufferType::Constant || bufferDesc.Type == BufferType::ShaderStorage ||
+                               bufferDesc.Type == BufferType::Vertex);
     if (needsDeviceAddress)
     {
         bufferFlags |= VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
@@ -221,26 +280,33 @@ uint64_t VulkanBufferAllocator::CreateBuffer(BufferDesc bufferDesc, bool createD
     result = vkBindBufferMemory(device, vulkanBufferData->Buffer, vulkanBufferData->Memory, 0);
     if (result != VK_SUCCESS)
         throw std::runtime_error("Failed to bind vertex buffer memory.");
+    
+    if (needsDeviceAddress)
+    {
+        VkBufferDeviceAddressInfo addressInfo = {};
+        addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+        addressInfo.buffer = vulkanBufferData->Buffer;
+        vulkanBufferData->DeviceAddress = vkGetBufferDeviceAddress(device, &addressInfo);
+    }
 
     bool isHostVisible = (memoryFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
     
     void* mappedAddress = nullptr;
 
+    // Host visible buffers stay persistently mapped so per-frame data can be streamed straight into them
+    if (isHostVisible)
+    {
+        result = vkMapMemory(device, vulkanBufferData->Memory, 0, bufferDesc.Size, 0, &mappedAddress);
+        if (result != VK_SUCCESS)
+            throw std::runtime_error("Failed to map buffer memory.");
+    }
+
     if (bufferDesc.InitialData != nullptr)
     {
         if (isHostVisible)
-        {
-            result = vkMapMemory(device, vulkanBufferData->Memory, 0, bufferDesc.Size, 0, &mappedAddress);
-            if (result != VK_SUCCESS)
-                throw std::runtime_error("Failed to map buffer memory.");
-            
             memcpy(mappedAddress, bufferDesc.InitialData, bufferDesc.Size);
-        }
         else
-        {
-            // Staging
-            CopyToDeviceLocalBuffer(vulkanBufferData->Buffer, bufferDesc.InitialData, bufferDesc.Size);
-        }
+            CopyToDeviceLocalBuffer(vulkanBufferData->Buffer, bufferDesc.InitialData, bufferDesc.Size); // Staging
     }
     
     BufferAllocation allocation;
@@ -269,11 +335,7 @@ uint64_t VulkanBufferAllocator::CreateBuffer(BufferDesc bufferDesc, bool createD
             vkDescriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
         }
         
-        VkBufferDeviceAddressInfo addressInfo{};
-        addressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
-        addressInfo.buffer = vulkanBufferData->Buffer;
-        
-        VkDeviceAddress bufferAddress = vkGetBufferDeviceAddress(device, &addressInfo);
+        VkDeviceAddress bufferAddress = vulkanBufferData->DeviceAddress;
         
         VkDescriptorAddressInfoEXT bufferInfo{};
         bufferInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT;
@@ -300,7 +362,19 @@ uint64_t VulkanBufferAllocator::CreateBuffer(BufferDesc bufferDesc, bool createD
     return CacheBuffer(allocation);
 }
 
-void VulkanBufferAllocator::CopyToDeviceLocalBuffer(VkBuffer dstBuffer, const void* srcData, VkDeviceSize size)
+void VulkanBufferAllocator::UpdateBuffer(uint64_t id, uint64_t offset, const void* data, uint64_t size)
+{
+    const BufferAllocation& allocation = AllocatedBuffers.at(id);
+    if (offset + size > allocation.Size)
+        throw std::runtime_error("Buffer update exceeds the buffer size.");
+    
+    if (allocation.IsMapped)
+        memcpy(static_cast<uint8_t*>(allocation.Address) + offset, data, size);
+    else
+        CopyToDeviceLocalBuffer(static_cast<VulkanBufferData*>(allocation.Buffer)->Buffer, data, size, offset);
+}
+
+void VulkanBufferAllocator::CopyToDeviceLocalBuffer(VkBuffer dstBuffer, const void* srcData, VkDeviceSize size, VkDeviceSize dstOffset)
 {
     VkDevice device = VulkanCore::GetInstance().GetDevice();
     VkPhysicalDevice physicalDevice = VulkanCore::GetInstance().GetPhysicalDevice();
@@ -351,7 +425,7 @@ void VulkanBufferAllocator::CopyToDeviceLocalBuffer(VkBuffer dstBuffer, const vo
 
     VkBufferCopy copyRegion = {};
     copyRegion.srcOffset = 0;
-    copyRegion.dstOffset = 0;
+    copyRegion.dstOffset = dstOffset;
     copyRegion.size = size;
 
     vkCmdCopyBuffer(commandBuffer, stagingBuffer, dstBuffer, 1, &copyRegion);
@@ -373,11 +447,14 @@ void VulkanBufferAllocator::CopyToDeviceLocalBuffer(VkBuffer dstBuffer, const vo
     vkFreeMemory(device, stagingMemory, nullptr);
 }
 
-uint64_t VulkanBufferAllocator::CreateImage(ImageDesc imageDesc, bool createDescriptor)
+uint64_t VulkanBufferAllocator::CreateImage(ImageDesc imageDesc, const ImageWriter& writeData, bool createDescriptor)
 {
     VkDevice device = VulkanCore::GetInstance().GetDevice();
     VkPhysicalDevice physicalDevice = VulkanCore::GetInstance().GetPhysicalDevice();
     
+    imageDesc.Size = ImageDataSize(imageDesc);
+    imageDesc.InitialData = nullptr;
+    
     VkBufferCreateInfo stagingBufferInfo = {};
     stagingBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     stagingBufferInfo.size = imageDesc.Size;
@@ -408,19 +485,36 @@ uint64_t VulkanBufferAllocator::CreateImage(ImageDesc imageDesc, bool createDesc
     
     vkBindBufferMemory(device, stagingBuffer, stagingMemory, 0);
     
+    // Levels tightly packed with tight rows, matching the regions CopyBufferToImage records
     void* mappedData;
     vkMapMemory(device, stagingMemory, 0, imageDesc.Size, 0, &mappedData);
-    memcpy(mappedData, imageDesc.InitialData, imageDesc.Size);
+    uint8_t* levelData = static_cast<uint8_t*>(mappedData);
+    try
+    {
+        for (uint32_t mip = 0; mip < imageDesc.MipLevels; mip++)
+        {
+            uint64_t levelSize = BlockCompression::LevelSize(imageDesc.Format, std::max(imageDesc.Width >> mip, 1u), std::max(imageDesc.Height >> mip, 1u));
+            writeData(levelData, mip, levelSize / ImageRowCount(imageDesc, mip));
+            levelData += levelSize;
+        }
+    }
+    catch (...)
+    {
+        vkUnmapMemory(device, stagingMemory);
+        vkDestroyBuffer(device, stagingBuffer, nullptr);
+        vkFreeMemory(device, stagingMemory, nullptr);
+        throw;
+    }
     vkUnmapMemory(device, stagingMemory);
 
     VulkanImageData* vulkanImageData = new VulkanImageData();
     vulkanImageData->ImageHandle = CreateVulkanImage(imageDesc, &vulkanImageData->Memory);
     
-    TransitionImageLayout(vulkanImageData->ImageHandle, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    TransitionImageLayout(vulkanImageData->ImageHandle, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageDesc.MipLevels);
     
-    CopyBufferToImage(stagingBuffer, vulkanImageData->ImageHandle, imageDesc.Width, imageDesc.Height);
+    CopyBufferToImage(stagingBuffer, vulkanImageData->ImageHandle, imageDesc);
     
-    TransitionImageLayout(vulkanImageData->ImageHandle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    TransitionImageLayout(vulkanImageData->ImageHandle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, imageDesc.MipLevels);
 
     vulkanImageData->ImageView = CreateVulkanImageView(vulkanImageData->ImageHandle, imageDesc);
     
@@ -667,6 +761,9 @@ VulkanBufferAllocator::~VulkanBufferAllocator()
 {
     VkDevice device = VulkanCore::GetInstance().GetDevice();
     
+    // Pending image releases still reach into the descriptor pools
+    VulkanCore::GetInstance().FlushDeferredReleases();
+    
     for (auto& [handle, allocation] : DescriptorSetLayouts)
     {
         vkDestroyDescriptorSetLayout(device, allocation.Layout, nullptr);
@@ -711,15 +808,47 @@ VulkanBufferAllocator::~VulkanBufferAllocator()
 
 void VulkanBufferAllocator::FreeBuffer(uint64_t id)
 {
-    FreeDescriptor(AllocatedBuffers[id].Descriptor, static_cast<DescriptorType>(AllocatedBuffers[id].DescriptorType));
+    VkDevice device = VulkanCore::GetInstance().GetDevice();
+    BufferAllocation& allocation = AllocatedBuffers.at(id);
+    
+    if (allocation.Descriptor)
+        FreeDescriptor(allocation.Descriptor, static_cast<DescriptorType>(allocation.DescriptorType));
+    
+    VulkanBufferData* bufferData = static_cast<VulkanBufferData*>(allocation.Buffer);
+    if (bufferData)
+    {
+        vkDestroyBuffer(device, bufferData->Buffer, nullptr);
+        vkFreeMemory(device, bufferData->Memory, nullptr);
+        delete bufferData;
+    }
+    
+    AllocatedBuffers.erase(id);
 }
 
 void VulkanBufferAllocator::FreeImage(uint64_t id)
 {
-    FreeDescriptor(AllocatedImages[id].Descriptor, static_cast<DescriptorType>(AllocatedImages[id].DescriptorType));
+    ImageAllocation allocation = AllocatedImages.at(id);
+    AllocatedImages.erase(id);
+    
+    // Frames in flight may still sample the image through its descriptor, both go once they complete
+    VulkanCore::GetInstance().DeferRelease([this, allocation]()
+    {
+        VkDevice device = VulkanCore::GetInstance().GetDevice();
+        if (allocation.Descriptor)
+            FreeDescriptor(allocation.Descriptor, static_cast<DescriptorType>(allocation.DescriptorType));
+        
+        VulkanImageData* imageData = static_cast<VulkanImageData*>(allocation.Image);
+        if (imageData)
+        {
+            vkDestroyImageView(device, imageData->ImageView, nullptr);
+            vkDestroyImage(device, imageData->ImageHandle, nullptr);
+            vkFreeMemory(device, imageData->Memory, nullptr);
+            delete imageData;
+        }
+    });
 }
 
-void VulkanBufferAllocator::CopyBufferToImage(VkBuffer stagingBuffer, VkImage dstImage, uint32_t width, uint32_t height)
+void VulkanBufferAllocator::CopyBufferToImage(VkBuffer stagingBuffer, VkImage dstImage, const ImageDesc& imageDesc)
 {
     VkDevice device = VulkanCore::GetInstance().GetDevice();
     VkCommandBuffer commandBuffer = VulkanCore::GetInstance().GetTransferCommandBuffer();
@@ -747,19 +876,30 @@ void VulkanBufferAllocator::CopyBufferToImage(VkBuffer stagingBuffer, VkImage ds
 
     vkBeginCommandBuffer(commandBuffer, &beginInfo);
     
-    VkBufferImageCopy region = {};
-    region.bufferOffset = 0;
-    region.bufferRowLength = 0;
-    region.bufferImageHeight = 0;
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
-    region.imageOffset = {0, 0, 0};
-    region.imageExtent = {width, height, 1};
+    // Mip levels follow each other tightly packed in the staging buffer, block compressed levels in whole blocks
+    std::vector<VkBufferImageCopy> regions(imageDesc.MipLevels);
+    VkDeviceSize bufferOffset = 0;
+    for (uint32_t mip = 0; mip < imageDesc.MipLevels; mip++)
+    {
+        uint32_t width = std::max(imageDesc.Width >> mip, 1u);
+        uint32_t height = std::max(imageDesc.Height >> mip, 1u);
+        
+        VkBufferImageCopy& region = regions[mip];
+        region.bufferOffset = bufferOffset;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = mip;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = {width, height, 1};
+        
+        bufferOffset += BlockCompression::LevelSize(imageDesc.Format, width, height);
+    }
 
     vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, dstImage, 
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
 
     vkEndCommandBuffer(commandBuffer);
     
@@ -777,7 +917,7 @@ void VulkanBufferAllocator::CopyBufferToImage(VkBuffer stagingBuffer, VkImage ds
         throw std::runtime_error("vkWaitForFences failed after submit in CopyBufferToImage().");
 }
 
-void VulkanBufferAllocator::TransitionImageLayout(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout)
+void VulkanBufferAllocator::TransitionImageLayout(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels)
 {
     VkDevice device = VulkanCore::GetInstance().GetDevice();
     VkCommandBuffer commandBuffer = VulkanCore::GetInstance().GetTransferCommandBuffer();
@@ -816,7 +956,7 @@ void VulkanBufferAllocator::TransitionImageLayout(VkImage image, VkImageLayout o
     imageMemoryBarrier.image = image;                                          // image to transition
     imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;// aspect to transition
     imageMemoryBarrier.subresourceRange.baseMipLevel = 0;                      // starting mip level
-    imageMemoryBarrier.subresourceRange.levelCount = 1;                        // number of mip levels
+    imageMemoryBarrier.subresourceRange.levelCount = mipLevels;                // number of mip levels
     imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;                    // starting array layer
     imageMemoryBarrier.subresourceRange.layerCount = 1;                        // number of array layers
 
@@ -878,7 +1018,7 @@ VkImage VulkanBufferAllocator::CreateVulkanImage(ImageDesc imageDesc, VkDeviceMe
     imageInfo.extent.width = imageDesc.Width;               // Width of image
     imageInfo.extent.height = imageDesc.Height;             // Height of image
     imageInfo.extent.depth = 1;                             // Depth (if 3d)
-    imageInfo.mipLevels = 1;                                // Number of mipmap levels
+    imageInfo.mipLevels = imageDesc.MipLevels;              // Number of mipmap levels
     imageInfo.arrayLayers = 1;                              // Number of indices in the image array
     imageInfo.format = VulkanFormat(imageDesc.Format);      // Image format structure of data and colour space
                                                             // Tiling of the image (linear, optimal) how image data is arranged in memory for optimal reading
@@ -1021,6 +1161,15 @@ uint64_t DirectX12BufferAllocator::CreateBuffer(BufferDesc bufferDesc, bool crea
             D3D12_RESOURCE_STATE_GENERIC_READ);
         cmdList->ResourceBarrier(1, &transition2);
     }
+    else
+    {
+        // Leave every buffer in the same state so UpdateBuffer knows what to transition from
+        CD3DX12_RESOURCE_BARRIER transition = CD3DX12_RESOURCE_BARRIER::Transition(
+            defaultBuffer.Get(),
+            D3D12_RESOURCE_STATE_COMMON,
+            D3D12_RESOURCE_STATE_GENERIC_READ);
+        cmdList->ResourceBarrier(1, &transition);
+    }
 
     D3D12_GPU_VIRTUAL_ADDRESS gpuAddress = defaultBuffer->GetGPUVirtualAddress();
 
@@ -1072,16 +1221,58 @@ uint64_t DirectX12BufferAllocator::CreateBuffer(BufferDesc bufferDesc, bool crea
     return CacheBuffer(allocation);
 }
 
-uint64_t DirectX12BufferAllocator::CreateImage(ImageDesc imageDesc, bool createDescriptor)
+void DirectX12BufferAllocator::UpdateBuffer(uint64_t id, uint64_t offset, const void* data, uint64_t size)
+{
+    const BufferAllocation& allocation = AllocatedBuffers.at(id);
+    if (offset + size > allocation.Size)
+        throw std::runtime_error("Buffer update exceeds the buffer size.");
+    
+    ID3D12Device* device = D3DCore::GetInstance().GetDevice().Get();
+    ID3D12GraphicsCommandList* cmdList = D3DCore::GetInstance().GetTransferCommandList().Get();
+    ID3D12Resource* buffer = static_cast<DX12BufferData*>(allocation.Buffer)->Buffer;
+    
+    ComPtr<ID3D12Resource> uploadBuffer;
+    CD3DX12_HEAP_PROPERTIES uploadHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+    CD3DX12_RESOURCE_DESC uploadBufferDesc = CD3DX12_RESOURCE_DESC::Buffer(size);
+    
+    device->CreateCommittedResource(
+        &uploadHeapProperties,
+        D3D12_HEAP_FLAG_NONE,
+        &uploadBufferDesc,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS(uploadBuffer.GetAddressOf())) >> ERROR_HANDLER;
+    
+    D3DCore::GetInstance().DeferUploadBufferRelease(uploadBuffer);
+    
+    void* mappedData = nullptr;
+    uploadBuffer->Map(0, nullptr, &mappedData);
+    memcpy(mappedData, data, size);
+    uploadBuffer->Unmap(0, nullptr);
+    
+    CD3DX12_RESOURCE_BARRIER toCopy = CD3DX12_RESOURCE_BARRIER::Transition(buffer, D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_DEST);
+    cmdList->ResourceBarrier(1, &toCopy);
+    
+    cmdList->CopyBufferRegion(buffer, offset, uploadBuffer.Get(), 0, size);
+    
+    CD3DX12_RESOURCE_BARRIER toRead = CD3DX12_RESOURCE_BARRIER::Transition(buffer, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ);
+    cmdList->ResourceBarrier(1, &toRead);
+}
+
+uint64_t DirectX12BufferAllocator::CreateImage(ImageDesc imageDesc, const ImageWriter& writeData, bool createDescriptor)
 {
     ID3D12Device* device = D3DCore::GetInstance().GetDevice().Get();
     ID3D12GraphicsCommandList* cmdList = D3DCore::GetInstance().GetTransferCommandList().Get();
 
-    if (imageDesc.ArrayLayers != 1 || imageDesc.MipLevels != 1)
-        throw std::runtime_error("DirectX12BufferAllocator::CreateImage currently supports only 1 layer and 1 mip (match Vulkan path later).");
+    if (imageDesc.ArrayLayers != 1 || imageDesc.MipLevels == 0)
+        throw std::runtime_error("DirectX12BufferAllocator::CreateImage currently supports only 1 layer (match Vulkan path later).");
+
+    const bool blockCompressed = BlockCompression::IsBlockCompressed(imageDesc.Format);
+    if (!blockCompressed && imageDesc.Format != Format::R8G8B8A8_UNORM && imageDesc.Format != Format::R8G8B8A8_UNORM_SRGB)
+        throw std::runtime_error("CreateImage upload currently only implemented for R8G8B8A8(_SRGB) and BC formats. Add proper bpp/rowPitch handling for other formats.");
 
-    if (imageDesc.InitialData == nullptr || imageDesc.Size == 0)
-        throw std::runtime_error("DirectX12BufferAllocator::CreateImage requires InitialData + Size (like Vulkan staging upload).");
+    imageDesc.Size = ImageDataSize(imageDesc);
+    imageDesc.InitialData = nullptr;
 
     ComPtr<ID3D12Resource> imageResource;
 
@@ -1110,9 +1301,11 @@ uint64_t DirectX12BufferAllocator::CreateImage(ImageDesc imageDesc, bool createD
     
     ComPtr<ID3D12Resource> uploadBuffer;
 
-    const UINT firstSubresource = 0;
-    const UINT numSubresources = 1;
-    const UINT64 uploadBufferSize = GetRequiredIntermediateSize(imageResource.Get(), firstSubresource, numSubresources);
+    // Upload rows are padded to D3D12_TEXTURE_DATA_PITCH_ALIGNMENT, the writer is handed each level's real pitch
+    const UINT numSubresources = imageDesc.MipLevels;
+    std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints(numSubresources);
+    UINT64 uploadBufferSize = 0;
+    device->GetCopyableFootprints(&textureDesc, 0, numSubresources, 0, footprints.data(), nullptr, nullptr, &uploadBufferSize);
 
     auto uploadHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
     auto uploadDesc = CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize);
@@ -1127,22 +1320,26 @@ uint64_t DirectX12BufferAllocator::CreateImage(ImageDesc imageDesc, bool createD
     
     D3DCore::GetInstance().DeferUploadBufferRelease(uploadBuffer);
     
-    const uint32_t bytesPerPixel =
-        (imageDesc.Format == Format::R8G8B8A8_UNORM || imageDesc.Format == Format::R8G8B8A8_UNORM_SRGB) ? 4u : 0u;
-
-    if (bytesPerPixel == 0)
-        throw std::runtime_error("CreateImage upload currently only implemented for R8G8B8A8(_SRGB). Add proper bpp/rowPitch handling for other formats.");
-
-    const UINT64 expectedSize = static_cast<UINT64>(imageDesc.Width) * static_cast<UINT64>(imageDesc.Height) * bytesPerPixel;
-    if (imageDesc.Size < expectedSize)
-        throw std::runtime_error("ImageDesc::Size is smaller than expected for the provided Width/Height/Format.");
-
-    D3D12_SUBRESOURCE_DATA subresource = {};
-    subresource.pData = imageDesc.InitialData;
-    subresource.RowPitch = static_cast<LONG_PTR>(imageDesc.Width) * bytesPerPixel;
-    subresource.SlicePitch = subresource.RowPitch * imageDesc.Height;
+    uint8_t* mappedData = nullptr;
+    uploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mappedData)) >> ERROR_HANDLER;
+    try
+    {
+        for (UINT mip = 0; mip < numSubresources; mip++)
+            writeData(mappedData + footprints[mip].Offset, mip, footprints[mip].Footprint.RowPitch);
+    }
+    catch (...)
+    {
+        uploadBuffer->Unmap(0, nullptr);
+        throw;
+    }
+    uploadBuffer->Unmap(0, nullptr);
 
-    UpdateSubresources(cmdList, imageResource.Get(), uploadBuffer.Get(), 0, firstSubresource, numSubresources, &subresource);
+    for (UINT mip = 0; mip < numSubresources; mip++)
+    {
+        CD3DX12_TEXTURE_COPY_LOCATION destination(imageResource.Get(), mip);
+        CD3DX12_TEXTURE_COPY_LOCATION source(uploadBuffer.Get(), footprints[mip]);
+        cmdList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+    }
 
     CD3DX12_RESOURCE_BARRIER toShaderRead = CD3DX12_RESOURCE_BARRIER::Transition(
         imageResource.Get(),
@@ -1155,7 +1352,7 @@ uint64_t DirectX12BufferAllocator::CreateImage(ImageDesc imageDesc, bool createD
     srvDesc.Format = DXFormat(imageDesc.Format);
     srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
     srvDesc.Texture2D.MostDetailedMip = 0;
-    srvDesc.Texture2D.MipLevels = 1;
+    srvDesc.Texture2D.MipLevels = imageDesc.MipLevels;
     srvDesc.Texture2D.PlaneSlice = 0;
     srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
     
@@ -1444,6 +1641,19 @@ void DirectX12BufferAllocator::FreeBuffer(uint64_t id)
 
 void DirectX12BufferAllocator::FreeImage(uint64_t id)
 {
-    FreeDescriptor(DXDescriptor(AllocatedImages[id]), static_cast<DescriptorType>(AllocatedImages[id].DescriptorType));
+    ImageAllocation& allocation = AllocatedImages.at(id);
+    
+    if (allocation.Descriptor)
+        FreeDescriptor(DXDescriptor(allocation), static_cast<DescriptorType>(allocation.DescriptorType));
+    
+    // Frames in flight may still sample the texture, the resource goes with the frame's deferred releases
+    DX12ImageData* imageData = static_cast<DX12ImageData*>(allocation.Image);
+    if (imageData)
+    {
+        D3DCore::GetInstance().DeferUploadBufferRelease(imageData->Image);
+        delete imageData;
+    }
+    
+    AllocatedImages.erase(id);
 }
 
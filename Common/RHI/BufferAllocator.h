@@ -1,4 +1,5 @@
 #pragma once
+#include <functional>
 #include <unordered_map>
 #include <map>
 #include "RHIStructures.h"
@@ -25,22 +26,40 @@ protected:
     static BufferAllocator* Instance;
     BufferAllocator() = default;
     
+    // Bytes of all mip levels tightly packed, the layout InitialData is expected in
+    static uint64_t ImageDataSize(const ImageDesc& imageDesc);
+    // Row count of one mip level, rows of 4x4 blocks for block compressed formats
+    static uint32_t ImageRowCount(const ImageDesc& imageDesc, uint32_t mipLevel);
+    
 public:    
     
     uint64_t MakeKey(uint32_t pipelineID, uint32_t setIndex) { return (static_cast<uint64_t>(pipelineID) << 32) | setIndex; }
     static BufferAllocator* GetInstance();
     uint64_t CacheImage(ImageAllocation imageAllocation) {AllocatedImages[NextImageID] = imageAllocation; return NextImageID++;}
     virtual uint64_t CreateBuffer(BufferDesc bufferDesc, bool createDescriptor = false) = 0;
-    virtual uint64_t CreateImage(ImageDesc imageDesc, bool createDescriptor = false) = 0;
+    
+    // Fills one mip level of the staging memory, rows (rows of 4x4 blocks for BC formats) are rowPitch bytes apart
+    using ImageWriter = std::function<void(uint8_t* destination, uint32_t mipLevel, uint64_t rowPitch)>;
+    
+    // Uploads InitialData, a thin ImageWriter over the tightly packed levels
+    uint64_t CreateImage(ImageDesc imageDesc, bool createDescriptor = false);
+    // writeData produces the texels straight into the staging memory so nothing is copied on the CPU beforehand
+    virtual uint64_t CreateImage(ImageDesc imageDesc, const ImageWriter& writeData, bool createDescriptor = false) = 0;
+    // Writes size bytes at offset, mapped buffers are written directly and device local ones through a staging copy
+    virtual void UpdateBuffer(uint64_t id, uint64_t offset, const void* data, uint64_t size) = 0;
     
     virtual ~BufferAllocator() = default;
     virtual void FreeBuffer(uint64_t id) = 0;
+    // Destroys an image made by CreateImage, attachments registered with CacheImage stay owned by their pipeline
     virtual void FreeImage(uint64_t id) = 0;
     
     virtual void RegisterDescriptorSetLayout(uint32_t pipelineID, const ResourceLayout& layout) = 0;
     virtual uint64_t AllocateDescriptorSet(uint32_t pipelineID, uint32_t setIndex, 
                                            const std::vector<DescriptorSetBinding>& bindings) = 0;
     virtual void FreeDescriptorSet(uint64_t setID) = 0;
+    // Points setID at a freshly written set with the same layout, sets in flight are never rewritten. Returns the ID now
+    // holding the previous set, to be freed once no frame in flight uses it.
+    uint64_t RebindDescriptorSet(uint64_t setID, const std::vector<DescriptorSetBinding>& bindings);
     
     ImageAllocation GetImageAllocation(uint64_t id) const { return AllocatedImages.at(id); }
     BufferAllocation GetBufferAllocation(uint64_t id) const { return AllocatedBuffers.at(id); }
@@ -52,7 +71,9 @@ class VulkanBufferAllocator : public BufferAllocator
 public:
     
     uint64_t CreateBuffer(BufferDesc bufferDesc, bool createDescriptor = false) override;
-    uint64_t CreateImage(ImageDesc imageDesc, bool createDescriptor = false) override;
+    using BufferAllocator::CreateImage;
+    uint64_t CreateImage(ImageDesc imageDesc, const ImageWriter& writeData, bool createDescriptor = false) override;
+    void UpdateBuffer(uint64_t id, uint64_t offset, const void* data, uint64_t size) override;
     VulkanBufferAllocator();
     ~VulkanBufferAllocator() override;
     void FreeBuffer(uint64_t id) override;
@@ -107,16 +128,18 @@ private:
     static VkImage CreateVulkanImage(ImageDesc imageDesc, VkDeviceMemory* imageMemory);
     static VkImageView CreateVulkanImageView(VkImage image, ImageDesc imageDesc);
    
-    static void TransitionImageLayout(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout);
-    static void CopyToDeviceLocalBuffer(VkBuffer dstBuffer, const void* srcData, VkDeviceSize size);
-    static void CopyBufferToImage(VkBuffer stagingBuffer, VkImage dstImage, uint32_t width, uint32_t height);
+    static void TransitionImageLayout(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels = 1);
+    static void CopyToDeviceLocalBuffer(VkBuffer dstBuffer, const void* srcData, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+    static void CopyBufferToImage(VkBuffer stagingBuffer, VkImage dstImage, const ImageDesc& imageDesc);
 };
 
 class DirectX12BufferAllocator : public BufferAllocator
 {
 public:
     uint64_t CreateBuffer(BufferDesc bufferDesc, bool createDescriptor = false) override;
-    uint64_t CreateImage(ImageDesc imageDesc, bool createDescriptor = false) override;
+    using BufferAllocator::CreateImage;
+    uint64_t CreateImage(ImageDesc imageDesc, const ImageWriter& writeData, bool createDescriptor = false) override;
+    void UpdateBuffer(uint64_t id, uint64_t offset, const void* data, uint64_t size) override;
     DirectX12BufferAllocator();
     ~DirectX12BufferAllocator() override;
     void FreeBuffer(uint64_t id) override;
@@ -0,0 +1,565 @@
+#include "BVH.h"
+#include "Scene.h"
+#include "../../Data/ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+using namespace DirectX;
+
+namespace
+{
+    float GetAxis(const XMFLOAT3& vector, uint32_t axis)
+    {
+        return axis == 0 ? vector.x : (axis == 1 ? vector.y : vector.z);
+    }
+
+    // Narrows [tMin, tMax] to one slab, false on a miss. A ray parallel to the slab has an infinite inverse, where
+    // 0 * inf would turn the interval into NaN, so it only checks that the origin lies between the planes.
+    bool IntersectSlab(float min, float max, float origin, float inverseDirection, float& tMin, float& tMax)
+    {
+        if (std::isinf(inverseDirection))
+            return origin >= min && origin <= max;
+
+        float t1 = (min - origin) * inverseDirection;
+        float t2 = (max - origin) * inverseDirection;
+        tMin = std::max(tMin, std::min(t1, t2));
+        tMax = std::min(tMax, std::max(t1, t2));
+        return true;
+    }
+
+    // Slab test, returns the entry distance or FLT_MAX on a miss
+    float IntersectBounds(const XMFLOAT3& min, const XMFLOAT3& max, const XMFLOAT3& origin, const XMFLOAT3& inverseDirection, float maxDistance)
+    {
+        float tMin = 0.0f;
+        float tMax = FLT_MAX;
+        if (!IntersectSlab(min.x, max.x, origin.x, inverseDirection.x, tMin, tMax) ||
+            !IntersectSlab(min.y, max.y, origin.y, inverseDirection.y, tMin, tMax) ||
+            !IntersectSlab(min.z, max.z, origin.z, inverseDirection.z, tMin, tMax))
+            return FLT_MAX;
+
+        return (tMax >= tMin && tMin < maxDistance) ? tMin : FLT_MAX;
+    }
+
+    // Trees deeper than the inline stack allows traverse with a heap stack instead
+    template<typename Entry, uint32_t InlineSize>
+    Entry* GetTraversalStack(Entry (&inlineStack)[InlineSize], std::vector<Entry>& heapStack, uint32_t size)
+    {
+        if (size <= InlineSize)
+            return inlineStack;
+
+        heapStack.resize(size);
+        return heapStack.data();
+    }
+}
+
+void BVH::Bounds::Grow(const XMFLOAT3& point)
+{
+    Min.x = std::min(Min.x, point.x);
+    Min.y = std::min(Min.y, point.y);
+    Min.z = std::min(Min.z, point.z);
+    Max.x = std::max(Max.x, point.x);
+    Max.y = std::max(Max.y, point.y);
+    Max.z = std::max(Max.z, point.z);
+}
+
+void BVH::Bounds::Grow(const Bounds& other)
+{
+    if (other.Min.x > other.Max.x)
+        return;
+
+    Grow(other.Min);
+    Grow(other.Max);
+}
+
+float BVH::Bounds::SurfaceArea() const
+{
+    if (Min.x > Max.x)
+        return 0.0f;
+
+    float dx = Max.x - Min.x;
+    float dy = Max.y - Min.y;
+    float dz = Max.z - Min.z;
+    return dx * dy + dy * dz + dz * dx;
+}
+
+void BVH::Build(const std::vector<BoundingBox>& primitiveBounds)
+{
+    TriangleMode = false;
+    TrianglePositions.clear();
+    TriangleIndices.clear();
+
+    SetPrimitiveBounds(primitiveBounds);
+    BuildHierarchy();
+}
+
+void BVH::BuildTriangles(const std::vector<XMFLOAT3>& positions, const std::vector<uint32_t>& indices)
+{
+    if (indices.size() % 3 != 0)
+        throw std::runtime_error("BVH triangle input must be a triangle list.");
+
+    TriangleMode = true;
+    TrianglePositions = positions;
+    TriangleIndices = indices;
+
+    SetTriangleBounds(positions);
+    BuildHierarchy();
+}
+
+void BVH::BuildInstances(const Scene& scene)
+{
+    std::vector<BoundingBox> instanceBounds;
+    GatherInstanceBounds(scene, instanceBounds);
+    Build(instanceBounds);
+}
+
+void BVH::Refit(const std::vector<BoundingBox>& primitiveBounds)
+{
+    if (TriangleMode || primitiveBounds.size() != PrimitiveBounds.size())
+        throw std::runtime_error("Refit primitives do not match the built hierarchy.");
+
+    SetPrimitiveBounds(primitiveBounds);
+    RefitNodes();
+}
+
+void BVH::RefitTriangles(const std::vector<XMFLOAT3>& positions)
+{
+    if (!TriangleMode || positions.size() != TrianglePositions.size())
+        throw std::runtime_error("Refit triangles do not match the built hierarchy.");
+
+    TrianglePositions = positions;
+    SetTriangleBounds(positions);
+    RefitNodes();
+}
+
+void BVH::RefitInstances(const Scene& scene)
+{
+    std::vector<BoundingBox> instanceBounds;
+    GatherInstanceBounds(scene, instanceBounds);
+    Refit(instanceBounds);
+}
+
+bool BVH::Raycast(const BVHRay& ray, BVHHit& outHit) const
+{
+    outHit = BVHHit();
+    if (NodesUsed.load() == 0)
+        return false;
+
+    XMFLOAT3 inverseDirection(1.0f / ray.Direction.x, 1.0f / ray.Direction.y, 1.0f / ray.Direction.z);
+    float closest = ray.MaxDistance;
+
+    struct StackEntry
+    {
+        uint32_t NodeIndex;
+        float Distance;
+    };
+    StackEntry inlineStack[TraversalStackSize];
+    std::vector<StackEntry> heapStack;
+    StackEntry* stack = GetTraversalStack(inlineStack, heapStack, GetTraversalStackSize());
+    uint32_t stackSize = 0;
+
+    float rootDistance = IntersectNode(Nodes[0], ray.Origin, inverseDirection, closest);
+    if (rootDistance == FLT_MAX)
+        return false;
+    stack[stackSize++] = { 0, rootDistance };
+
+    while (stackSize > 0)
+    {
+        StackEntry entry = stack[--stackSize];
+        if (entry.Distance >= closest)
+            continue;
+
+        const Node& node = Nodes[entry.NodeIndex];
+        if (node.Count > 0)
+        {
+            for (uint32_t i = node.LeftFirst; i < node.LeftFirst + node.Count; i++)
+            {
+                uint32_t primitive = PrimitiveIndices[i];
+                float distance = IntersectPrimitive(primitive, ray, inverseDirection, closest);
+                if (distance < closest)
+                {
+                    closest = distance;
+                    outHit.Primitive = primitive;
+                    outHit.Distance = distance;
+                }
+            }
+            continue;
+        }
+
+        // Push the far child first so the near one is visited first and tightens closest early
+        StackEntry left = { node.LeftFirst, IntersectNode(Nodes[node.LeftFirst], ray.Origin, inverseDirection, closest) };
+        StackEntry right = { node.LeftFirst + 1, IntersectNode(Nodes[node.LeftFirst + 1], ray.Origin, inverseDirection, closest) };
+        if (left.Distance < right.Distance)
+            std::swap(left, right);
+
+        if (left.Distance != FLT_MAX)
+            stack[stackSize++] = left;
+        if (right.Distance != FLT_MAX)
+            stack[stackSize++] = right;
+    }
+
+    return outHit.IsHit();
+}
+
+void BVH::RaycastBatch(const std::vector<BVHRay>& rays, std::vector<BVHHit>& outHits)
+{
+    const uint32_t raysPerJob = 256;
+
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    uint32_t rayCount = static_cast<uint32_t>(rays.size());
+    outHits.resize(rayCount);
+    ThreadPool::GetInstance().ParallelFor((rayCount + raysPerJob - 1) / raysPerJob, [&](uint32_t job)
+    {
+        uint32_t end = std::min(rayCount, (job + 1) * raysPerJob);
+        for (uint32_t i = job * raysPerJob; i < end; i++)
+            Raycast(rays[i], outHits[i]);
+    });
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+    LastStatistics.RaysCast = rayCount;
+    LastStatistics.RayMilliseconds = elapsed.count();
+    LastStatistics.RaysPerSecond = elapsed.count() > 0.0 ? rayCount / (elapsed.count() / 1000.0) : 0.0;
+}
+
+void BVH::QueryBox(const BoundingBox& box, std::vector<uint32_t>& outPrimitives) const
+{
+    outPrimitives.clear();
+    if (NodesUsed.load() == 0)
+        return;
+
+    XMFLOAT3 queryMin(box.Center.x - box.Extents.x, box.Center.y - box.Extents.y, box.Center.z - box.Extents.z);
+    XMFLOAT3 queryMax(box.Center.x + box.Extents.x, box.Center.y + box.Extents.y, box.Center.z + box.Extents.z);
+
+    auto overlaps = [&](const XMFLOAT3& min, const XMFLOAT3& max)
+    {
+        return min.x <= queryMax.x && max.x >= queryMin.x &&
+               min.y <= queryMax.y && max.y >= queryMin.y &&
+               min.z <= queryMax.z && max.z >= queryMin.z;
+    };
+
+    uint32_t inlineStack[TraversalStackSize];
+    std::vector<uint32_t> heapStack;
+    uint32_t* stack = GetTraversalStack(inlineStack, heapStack, GetTraversalStackSize());
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0)
+    {
+        const Node& node = Nodes[stack[--stackSize]];
+        if (!overlaps(node.Min, node.Max))
+            continue;
+
+        if (node.Count > 0)
+        {
+            for (uint32_t i = node.LeftFirst; i < node.LeftFirst + node.Count; i++)
+                if (overlaps(PrimitiveBounds[PrimitiveIndices[i]].Min, PrimitiveBounds[PrimitiveIndices[i]].Max))
+                    outPrimitives.push_back(PrimitiveIndices[i]);
+            continue;
+        }
+
+        stack[stackSize++] = node.LeftFirst;
+        stack[stackSize++] = node.LeftFirst + 1;
+    }
+}
+
+void BVH::QuerySphere(const BoundingSphere& sphere, std::vector<uint32_t>& outPrimitives) const
+{
+    outPrimitives.clear();
+    if (NodesUsed.load() == 0)
+        return;
+
+    float radiusSquared = sphere.Radius * sphere.Radius;
+
+    auto overlaps = [&](const XMFLOAT3& min, const XMFLOAT3& max)
+    {
+        float dx = std::max({ min.x - sphere.Center.x, 0.0f, sphere.Center.x - max.x });
+        float dy = std::max({ min.y - sphere.Center.y, 0.0f, sphere.Center.y - max.y });
+        float dz = std::max({ min.z - sphere.Center.z, 0.0f, sphere.Center.z - max.z });
+        return dx * dx + dy * dy + dz * dz <= radiusSquared;
+    };
+
+    uint32_t inlineStack[TraversalStackSize];
+    std::vector<uint32_t> heapStack;
+    uint32_t* stack = GetTraversalStack(inlineStack, heapStack, GetTraversalStackSize());
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0)
+    {
+        const Node& node = Nodes[stack[--stackSize]];
+        if (!overlaps(node.Min, node.Max))
+            continue;
+
+        if (node.Count > 0)
+        {
+            for (uint32_t i = node.LeftFirst; i < node.LeftFirst + node.Count; i++)
+                if (overlaps(PrimitiveBounds[PrimitiveIndices[i]].Min, PrimitiveBounds[PrimitiveIndices[i]].Max))
+                    outPrimitives.push_back(PrimitiveIndices[i]);
+            continue;
+        }
+
+        stack[stackSize++] = node.LeftFirst;
+        stack[stackSize++] = node.LeftFirst + 1;
+    }
+}
+
+void BVH::BuildHierarchy()
+{
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    uint32_t primitiveCount = static_cast<uint32_t>(PrimitiveBounds.size());
+    PrimitiveIndices.resize(primitiveCount);
+    std::iota(PrimitiveIndices.begin(), PrimitiveIndices.end(), 0u);
+
+    // A binary tree with at least one primitive per leaf never needs more than 2n - 1 nodes
+    Nodes.assign(std::max(1u, 2 * primitiveCount - 1), Node {});
+    MaxDepth = 0;
+    if (primitiveCount == 0)
+    {
+        NodesUsed = 0;
+    }
+    else
+    {
+        NodesUsed = 1;
+        Subdivide(0, 0, primitiveCount, 0);
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+    LastStatistics.PrimitiveCount = primitiveCount;
+    LastStatistics.NodeCount = NodesUsed.load();
+    LastStatistics.Depth = MaxDepth.load();
+    LastStatistics.BuildMilliseconds = elapsed.count();
+}
+
+void BVH::Subdivide(uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t depth)
+{
+    uint32_t deepest = MaxDepth.load();
+    while (depth > deepest && !MaxDepth.compare_exchange_weak(deepest, depth))
+    {
+    }
+
+    Bounds bounds;
+    Bounds centroidBounds;
+    for (uint32_t i = first; i < first + count; i++)
+    {
+        bounds.Grow(PrimitiveBounds[PrimitiveIndices[i]]);
+        centroidBounds.Grow(Centroids[PrimitiveIndices[i]]);
+    }
+
+    Node& node = Nodes[nodeIndex];
+    node.Min = bounds.Min;
+    node.Max = bounds.Max;
+    node.LeftFirst = first;
+    node.Count = count;
+
+    if (count <= MaxLeafSize)
+        return;
+
+    // Binned SAH over all three axes, split planes sit between bins
+    float bestCost = FLT_MAX;
+    uint32_t bestAxis = 0;
+    uint32_t bestSplit = 0;
+    for (uint32_t axis = 0; axis < 3; axis++)
+    {
+        float axisMin = GetAxis(centroidBounds.Min, axis);
+        float axisExtent = GetAxis(centroidBounds.Max, axis) - axisMin;
+        if (axisExtent <= 0.0f)
+            continue;
+
+        float scale = BinCount / axisExtent;
+        Bounds binBounds[BinCount];
+        uint32_t binCounts[BinCount] = {};
+        for (uint32_t i = first; i < first + count; i++)
+        {
+            uint32_t primitive = PrimitiveIndices[i];
+            uint32_t bin = std::min(BinCount - 1, static_cast<uint32_t>((GetAxis(Centroids[primitive], axis) - axisMin) * scale));
+            binCounts[bin]++;
+            binBounds[bin].Grow(PrimitiveBounds[primitive]);
+        }
+
+        float leftAreas[BinCount - 1];
+        uint32_t leftCounts[BinCount - 1];
+        Bounds leftBounds;
+        uint32_t leftSum = 0;
+        for (uint32_t i = 0; i < BinCount - 1; i++)
+        {
+            leftSum += binCounts[i];
+            leftBounds.Grow(binBounds[i]);
+            leftCounts[i] = leftSum;
+            leftAreas[i] = leftBounds.SurfaceArea();
+        }
+
+        Bounds rightBounds;
+        uint32_t rightSum = 0;
+        for (uint32_t i = BinCount - 1; i > 0; i--)
+        {
+            rightSum += binCounts[i];
+            rightBounds.Grow(binBounds[i]);
+            if (leftCounts[i - 1] == 0 || rightSum == 0)
+                continue;
+
+            float cost = leftCounts[i - 1] * leftAreas[i - 1] + rightSum * rightBounds.SurfaceArea();
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = i;
+            }
+        }
+    }
+
+    float leafCost = count * bounds.SurfaceArea();
+    if (bestCost == FLT_MAX || (bestCost >= leafCost && count <= ForceSplitSize))
+        return;
+
+    float axisMin = GetAxis(centroidBounds.Min, bestAxis);
+    float scale = BinCount / (GetAxis(centroidBounds.Max, bestAxis) - axisMin);
+    std::vector<uint32_t>::iterator middle = std::partition(PrimitiveIndices.begin() + first, PrimitiveIndices.begin() + first + count,
+        [&](uint32_t primitive)
+        {
+            return std::min(BinCount - 1, static_cast<uint32_t>((GetAxis(Centroids[primitive], bestAxis) - axisMin) * scale)) < bestSplit;
+        });
+
+    uint32_t leftCount = static_cast<uint32_t>(middle - (PrimitiveIndices.begin() + first));
+    if (leftCount == 0 || leftCount == count)
+        return;
+
+    // Children are always allocated after their parent, which RefitNodes relies on
+    uint32_t leftChild = NodesUsed.fetch_add(2);
+    node.LeftFirst = leftChild;
+    node.Count = 0;
+
+    if (count >= ParallelBuildThreshold)
+    {
+        ThreadPool::GetInstance().ParallelFor(2, [&](uint32_t side)
+        {
+            if (side == 0)
+                Subdivide(leftChild, first, leftCount, depth + 1);
+            else
+                Subdivide(leftChild + 1, first + leftCount, count - leftCount, depth + 1);
+        });
+    }
+    else
+    {
+        Subdivide(leftChild, first, leftCount, depth + 1);
+        Subdivide(leftChild + 1, first + leftCount, count - leftCount, depth + 1);
+    }
+}
+
+void BVH::RefitNodes()
+{
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    for (uint32_t i = NodesUsed.load(); i-- > 0;)
+    {
+        Node& node = Nodes[i];
+        Bounds bounds;
+
+        if (node.Count > 0)
+        {
+            for (uint32_t p = node.LeftFirst; p < node.LeftFirst + node.Count; p++)
+                bounds.Grow(PrimitiveBounds[PrimitiveIndices[p]]);
+        }
+        else
+        {
+            for (uint32_t child = node.LeftFirst; child < node.LeftFirst + 2; child++)
+            {
+                bounds.Grow(Nodes[child].Min);
+                bounds.Grow(Nodes[child].Max);
+            }
+        }
+
+        node.Min = bounds.Min;
+        node.Max = bounds.Max;
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+    LastStatistics.RefitMilliseconds = elapsed.count();
+}
+
+void BVH::SetPrimitiveBounds(const std::vector<BoundingBox>& primitiveBounds)
+{
+    PrimitiveBounds.resize(primitiveBounds.size());
+    Centroids.resize(primitiveBounds.size());
+
+    for (size_t i = 0; i < primitiveBounds.size(); i++)
+    {
+        const BoundingBox& box = primitiveBounds[i];
+        PrimitiveBounds[i].Min = XMFLOAT3(box.Center.x - box.Extents.x, box.Center.y - box.Extents.y, box.Center.z - box.Extents.z);
+        PrimitiveBounds[i].Max = XMFLOAT3(box.Center.x + box.Extents.x, box.Center.y + box.Extents.y, box.Center.z + box.Extents.z);
+        Centroids[i] = box.Center;
+    }
+}
+
+void BVH::SetTriangleBounds(const std::vector<XMFLOAT3>& positions)
+{
+    size_t triangleCount = TriangleIndices.size() / 3;
+    PrimitiveBounds.assign(triangleCount, Bounds());
+    Centroids.resize(triangleCount);
+
+    for (size_t i = 0; i < triangleCount; i++)
+    {
+        const XMFLOAT3& a = positions[TriangleIndices[i * 3]];
+        const XMFLOAT3& b = positions[TriangleIndices[i * 3 + 1]];
+        const XMFLOAT3& c = positions[TriangleIndices[i * 3 + 2]];
+
+        PrimitiveBounds[i].Grow(a);
+        PrimitiveBounds[i].Grow(b);
+        PrimitiveBounds[i].Grow(c);
+        Centroids[i] = XMFLOAT3((a.x + b.x + c.x) / 3.0f, (a.y + b.y + c.y) / 3.0f, (a.z + b.z + c.z) / 3.0f);
+    }
+}
+
+void BVH::GatherInstanceBounds(const Scene& scene, std::vector<BoundingBox>& outBounds) const
+{
+    const std::vector<BoundingBox>& meshBounds = scene.GetMeshBounds();
+    const std::vector<uint32_t>& meshNodeIndices = scene.GetMeshNodeIndices();
+    const std::vector<XMFLOAT4X4>& worldTransforms = scene.GetWorldTransforms();
+
+    outBounds.resize(meshBounds.size());
+    for (size_t i = 0; i < meshBounds.size(); i++)
+        meshBounds[i].Transform(outBounds[i], XMLoadFloat4x4(&worldTransforms[meshNodeIndices[i]]));
+}
+
+float BVH::IntersectNode(const Node& node, const XMFLOAT3& origin, const XMFLOAT3& inverseDirection, float maxDistance) const
+{
+    return IntersectBounds(node.Min, node.Max, origin, inverseDirection, maxDistance);
+}
+
+float BVH::IntersectPrimitive(uint32_t primitive, const BVHRay& ray, const XMFLOAT3& inverseDirection, float maxDistance) const
+{
+    if (!TriangleMode)
+        return IntersectBounds(PrimitiveBounds[primitive].Min, PrimitiveBounds[primitive].Max, ray.Origin, inverseDirection, maxDistance);
+
+    // Moller-Trumbore, double sided
+    const XMFLOAT3& v0 = TrianglePositions[TriangleIndices[primitive * 3]];
+    const XMFLOAT3& v1 = TrianglePositions[TriangleIndices[primitive * 3 + 1]];
+    const XMFLOAT3& v2 = TrianglePositions[TriangleIndices[primitive * 3 + 2]];
+    const XMFLOAT3& direction = ray.Direction;
+
+    XMFLOAT3 edge1(v1.x - v0.x, v1.y - v0.y, v1.z - v0.z);
+    XMFLOAT3 edge2(v2.x - v0.x, v2.y - v0.y, v2.z - v0.z);
+    XMFLOAT3 p(direction.y * edge2.z - direction.z * edge2.y, direction.z * edge2.x - direction.x * edge2.z, direction.x * edge2.y - direction.y * edge2.x);
+
+    float determinant = edge1.x * p.x + edge1.y * p.y + edge1.z * p.z;
+    if (std::abs(determinant) < 1e-12f)
+        return FLT_MAX;
+
+    float inverseDeterminant = 1.0f / determinant;
+    XMFLOAT3 t(ray.Origin.x - v0.x, ray.Origin.y - v0.y, ray.Origin.z - v0.z);
+    float u = (t.x * p.x + t.y * p.y + t.z * p.z) * inverseDeterminant;
+    if (u < 0.0f || u > 1.0f)
+        return FLT_MAX;
+
+    XMFLOAT3 q(t.y * edge1.z - t.z * edge1.y, t.z * edge1.x - t.x * edge1.z, t.x * edge1.y - t.y * edge1.x);
+    float v = (direction.x * q.x + direction.y * q.y + direction.z * q.z) * inverseDeterminant;
+    if (v < 0.0f || u + v > 1.0f)
+        return FLT_MAX;
+
+    float distance = (edge2.x * q.x + edge2.y * q.y + edge2.z * q.z) * inverseDeterminant;
+    return (distance >= 0.0f && distance < maxDistance) ? distance : FLT_MAX;
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <atomic>
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+
+class Scene;
+
+struct BVHRay
+{
+    DirectX::XMFLOAT3 Origin = {0, 0, 0};
+    DirectX::XMFLOAT3 Direction = {0, 0, 1};
+    float MaxDistance = FLT_MAX;
+};
+
+struct BVHHit
+{
+    uint32_t Primitive = UINT32_MAX;
+    float Distance = FLT_MAX;
+
+    bool IsHit() const { return Primitive != UINT32_MAX; }
+};
+
+// Bounding volume hierarchy built with binned SAH, subtrees above a size threshold are built in parallel.
+// Primitives are either mesh instances of a Scene (world AABBs), triangles, or caller supplied boxes.
+// Refit keeps the topology and only recomputes bounds, for nodes that moved without being rebuilt.
+class BVH
+{
+public:
+
+    struct Statistics
+    {
+        uint32_t PrimitiveCount = 0;
+        uint32_t NodeCount = 0;
+        uint32_t Depth = 0;
+        double BuildMilliseconds = 0.0;
+        double RefitMilliseconds = 0.0;
+        uint64_t RaysCast = 0;
+        double RayMilliseconds = 0.0;
+        double RaysPerSecond = 0.0;
+    };
+
+    void Build(const std::vector<DirectX::BoundingBox>& primitiveBounds);
+    void BuildTriangles(const std::vector<DirectX::XMFLOAT3>& positions, const std::vector<uint32_t>& indices);
+    void BuildInstances(const Scene& scene);
+
+    void Refit(const std::vector<DirectX::BoundingBox>& primitiveBounds);
+    void RefitTriangles(const std::vector<DirectX::XMFLOAT3>& positions);
+    void RefitInstances(const Scene& scene);
+
+    // Direction does not need to be normalized, hit distances are in units of its length
+    bool Raycast(const BVHRay& ray, BVHHit& outHit) const;
+    void RaycastBatch(const std::vector<BVHRay>& rays, std::vector<BVHHit>& outHits);
+    void QueryBox(const DirectX::BoundingBox& box, std::vector<uint32_t>& outPrimitives) const;
+    void QuerySphere(const DirectX::BoundingSphere& sphere, std::vector<uint32_t>& outPrimitives) const;
+
+    const Statistics& GetStatistics() const             { return LastStatistics; }
+
+private:
+
+    static constexpr uint32_t BinCount = 16;
+    static constexpr uint32_t MaxLeafSize = 4;
+    static constexpr uint32_t ForceSplitSize = 64;
+    static constexpr uint32_t ParallelBuildThreshold = 4096;
+    // Inline traversal stack, deeper trees fall back to the heap
+    static constexpr uint32_t TraversalStackSize = 64;
+
+    struct Bounds
+    {
+        DirectX::XMFLOAT3 Min = { FLT_MAX, FLT_MAX, FLT_MAX };
+        DirectX::XMFLOAT3 Max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+        void Grow(const DirectX::XMFLOAT3& point);
+        void Grow(const Bounds& other);
+        float SurfaceArea() const;
+    };
+
+    // Leaf when Count > 0 with LeftFirst indexing PrimitiveIndices, otherwise LeftFirst is the left child and the right follows it
+    struct Node
+    {
+        DirectX::XMFLOAT3 Min;
+        uint32_t LeftFirst;
+        DirectX::XMFLOAT3 Max;
+        uint32_t Count;
+    };
+
+    void BuildHierarchy();
+    void Subdivide(uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t depth);
+    // Each level leaves at most one sibling pending and a visited node pushes both children
+    uint32_t GetTraversalStackSize() const              { return MaxDepth.load() + 2; }
+    void RefitNodes();
+    void SetPrimitiveBounds(const std::vector<DirectX::BoundingBox>& primitiveBounds);
+    void SetTriangleBounds(const std::vector<DirectX::XMFLOAT3>& positions);
+    void GatherInstanceBounds(const Scene& scene, std::vector<DirectX::BoundingBox>& outBounds) const;
+
+    float IntersectNode(const Node& node, const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& inverseDirection, float maxDistance) const;
+    float IntersectPrimitive(uint32_t primitive, const BVHRay& ray, const DirectX::XMFLOAT3& inverseDirection, float maxDistance) const;
+
+    std::vector<Node> Nodes;
+    std::atomic<uint32_t> NodesUsed { 0 };
+    // Depth of the deepest leaf, the root is at depth 0
+    std::atomic<uint32_t> MaxDepth { 0 };
+    std::vector<uint32_t> PrimitiveIndices;
+    std::vector<Bounds> PrimitiveBounds;
+    std::vector<DirectX::XMFLOAT3> Centroids;
+
+    bool TriangleMode = false;
+    std::vector<DirectX::XMFLOAT3> TrianglePositions;
+    std::vector<uint32_t> TriangleIndices;
+
+    Statistics LastStatistics;
+};
@@ -0,0 +1,108 @@
+#include "FrustumCuller.h"
+
+#include <chrono>
+#include <cmath>
+#include <xmmintrin.h>
+
+using namespace DirectX;
+
+void FrustumCuller::UpdateBounds(const Scene& scene)
+{
+    const std::vector<BoundingBox>& meshBounds = scene.GetMeshBounds();
+    const std::vector<uint32_t>& meshNodeIndices = scene.GetMeshNodeIndices();
+    const std::vector<XMFLOAT4X4>& worldTransforms = scene.GetWorldTransforms();
+
+    BoundsCount = scene.GetMeshCount();
+    size_t paddedCount = (BoundsCount + 3) & ~3u;
+
+    CenterX.assign(paddedCount, 0.0f);
+    CenterY.assign(paddedCount, 0.0f);
+    CenterZ.assign(paddedCount, 0.0f);
+    ExtentX.assign(paddedCount, 0.0f);
+    ExtentY.assign(paddedCount, 0.0f);
+    ExtentZ.assign(paddedCount, 0.0f);
+
+    for (uint32_t i = 0; i < BoundsCount; i++)
+    {
+        XMMATRIX world = XMLoadFloat4x4(&worldTransforms[meshNodeIndices[i]]);
+        XMVECTOR center = XMVector3Transform(XMLoadFloat3(&meshBounds[i].Center), world);
+
+        // Extents of a transformed AABB are the local extents projected onto the absolute basis vectors
+        XMFLOAT3 localExtents = meshBounds[i].Extents;
+        XMVECTOR extents = XMVectorScale(XMVectorAbs(world.r[0]), localExtents.x);
+        extents = XMVectorMultiplyAdd(XMVectorAbs(world.r[1]), XMVectorReplicate(localExtents.y), extents);
+        extents = XMVectorMultiplyAdd(XMVectorAbs(world.r[2]), XMVectorReplicate(localExtents.z), extents);
+
+        CenterX[i] = XMVectorGetX(center);
+        CenterY[i] = XMVectorGetY(center);
+        CenterZ[i] = XMVectorGetZ(center);
+        ExtentX[i] = XMVectorGetX(extents);
+        ExtentY[i] = XMVectorGetY(extents);
+        ExtentZ[i] = XMVectorGetZ(extents);
+    }
+}
+
+void FrustumCuller::Cull(const XMFLOAT4X4& viewProjection, std::vector<uint32_t>& outVisibleMeshes)
+{
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    outVisibleMeshes.clear();
+
+    // Planes from the columns of a row vector view projection, clip volume is -w <= x,y <= w and 0 <= z <= w
+    const XMFLOAT4X4& m = viewProjection;
+    const float planes[6][4] =
+    {
+        { m._14 + m._11, m._24 + m._21, m._34 + m._31, m._44 + m._41 },   // Left
+        { m._14 - m._11, m._24 - m._21, m._34 - m._31, m._44 - m._41 },   // Right
+        { m._14 + m._12, m._24 + m._22, m._34 + m._32, m._44 + m._42 },   // Bottom
+        { m._14 - m._12, m._24 - m._22, m._34 - m._32, m._44 - m._42 },   // Top
+        { m._13,         m._23,         m._33,         m._43         },   // Near
+        { m._14 - m._13, m._24 - m._23, m._34 - m._33, m._44 - m._43 }    // Far
+    };
+
+    __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+    __m128 absPlaneX[6], absPlaneY[6], absPlaneZ[6];
+    for (uint32_t p = 0; p < 6; p++)
+    {
+        planeX[p] = _mm_set1_ps(planes[p][0]);
+        planeY[p] = _mm_set1_ps(planes[p][1]);
+        planeZ[p] = _mm_set1_ps(planes[p][2]);
+        planeW[p] = _mm_set1_ps(planes[p][3]);
+        absPlaneX[p] = _mm_set1_ps(std::abs(planes[p][0]));
+        absPlaneY[p] = _mm_set1_ps(std::abs(planes[p][1]));
+        absPlaneZ[p] = _mm_set1_ps(std::abs(planes[p][2]));
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+
+    for (uint32_t base = 0; base < BoundsCount; base += 4)
+    {
+        __m128 centerX = _mm_loadu_ps(&CenterX[base]);
+        __m128 centerY = _mm_loadu_ps(&CenterY[base]);
+        __m128 centerZ = _mm_loadu_ps(&CenterZ[base]);
+        __m128 extentX = _mm_loadu_ps(&ExtentX[base]);
+        __m128 extentY = _mm_loadu_ps(&ExtentY[base]);
+        __m128 extentZ = _mm_loadu_ps(&ExtentZ[base]);
+
+        // A box is outside when its center distance plus projected radius is behind any plane
+        __m128 outside = zero;
+        for (uint32_t p = 0; p < 6; p++)
+        {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(centerX, planeX[p]), _mm_mul_ps(centerY, planeY[p])),
+                                         _mm_add_ps(_mm_mul_ps(centerZ, planeZ[p]), planeW[p]));
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(extentX, absPlaneX[p]), _mm_mul_ps(extentY, absPlaneY[p])),
+                                       _mm_mul_ps(extentZ, absPlaneZ[p]));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+        }
+
+        int visibleMask = ~_mm_movemask_ps(outside) & 0xF;
+        for (uint32_t lane = 0; lane < 4 && base + lane < BoundsCount; lane++)
+            if (visibleMask & (1 << lane))
+                outVisibleMeshes.push_back(base + lane);
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+    LastStatistics.TestedBounds = BoundsCount;
+    LastStatistics.VisibleBounds = static_cast<uint32_t>(outVisibleMeshes.size());
+    LastStatistics.Milliseconds = elapsed.count();
+    LastStatistics.BoundsPerMillisecond = elapsed.count() > 0.0 ? BoundsCount / elapsed.count() : 0.0;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "Scene.h"
+
+// Culls world space mesh bounds against the six camera planes, four boxes per SSE iteration.
+// Bounds are kept as separate center/extent arrays padded to a multiple of four.
+class FrustumCuller
+{
+public:
+
+    struct Statistics
+    {
+        uint32_t TestedBounds = 0;
+        uint32_t VisibleBounds = 0;
+        double Milliseconds = 0.0;
+        double BoundsPerMillisecond = 0.0;
+    };
+
+    // Rebuilds world space AABBs for every mesh from the scene's world transforms
+    void UpdateBounds(const Scene& scene);
+    // Writes the indices of meshes intersecting the frustum, in mesh order
+    void Cull(const DirectX::XMFLOAT4X4& viewProjection, std::vector<uint32_t>& outVisibleMeshes);
+
+    const Statistics& GetStatistics() const             { return LastStatistics; }
+
+private:
+
+    uint32_t BoundsCount = 0;
+
+    std::vector<float> CenterX;
+    std::vector<float> CenterY;
+    std::vector<float> CenterZ;
+    std::vector<float> ExtentX;
+    std::vector<float> ExtentY;
+    std::vector<float> ExtentZ;
+
+    Statistics LastStatistics;
+};
@@ -1,5 +1,7 @@
 #include "GeometryImport.h"
 
+#include <algorithm>
+#include <filesystem>
 #include <iostream>
 #include <stdexcept>
 #include <assimp/Importer.hpp>
@@ -7,30 +9,61 @@
 #include <assimp/postprocess.h>
 #include <vector>
 #include "Mesh.h"
+#include "MeshOptimizer.h"
+#include "MeshletBuilder.h"
+#include "MeshSimplifier.h"
 #include "DirectXMath.h"
 #include "../RHIStructures.h"
+#include "../../GraphicsSettings.h"
+#include "../../Data/AssetIO.h"
 
 using namespace DirectX;
 
-SceneNode GeometryImport::LoadNode(aiNode* node, const aiScene* scene, const XMMATRIX& transform)
+void GeometryImport::LoadNode(aiNode* node, const aiScene* scene, Scene& outScene, uint32_t parentIndex, const XMMATRIX& parentSpace,
+                              const std::vector<std::string>& occluderNodeNames, MeshCache::Writer* cookWriter)
 {
-    XMMATRIX newTransform = XMMatrixTranspose(XMMATRIX(&node->mTransformation.a1)) * transform;
-    SceneNode newNode;
-    newNode.SetModelMatrix(newTransform);
+    // parentSpace is identity for every node except the root, where it carries the caller's placement
+    XMMATRIX nodeTransform = XMMatrixTranspose(XMMATRIX(&node->mTransformation.a1));
+    XMMATRIX localTransform = nodeTransform * parentSpace;
+    uint32_t nodeIndex = outScene.AddNode(parentIndex, localTransform, node->mName.C_Str());
+    if (cookWriter)
+        cookWriter->AddNode(parentIndex, nodeTransform, node->mName.C_Str());
+    
+    bool isOccluder = Scene::IsOccluderNode(occluderNodeNames, node->mName.C_Str());
+    
+    std::vector<Mesh> meshes;
     for (size_t i = 0; i < node->mNumMeshes; i++)
     {
         uint32_t meshIndex = node->mMeshes[i];
-        Mesh mesh = LoadMesh(scene->mMeshes[meshIndex], newTransform);
-        newNode.AddMesh(mesh);
+        uint32_t firstSceneMesh = outScene.GetMeshCount();
+        
+        meshes.clear();
+        if (cookWriter)
+            cookWriter->BeginSourceMesh(meshIndex);
+        try
+        {
+            LoadMesh(scene->mMeshes[meshIndex], localTransform, meshes, cookWriter);
+        }
+        catch (...)
+        {
+            // Parts uploaded before the failure are not in the scene yet
+            for (Mesh& loadedMesh : meshes)
+                loadedMesh.ReleaseGeometry();
+            throw;
+        }
+        for (Mesh& loadedMesh : meshes)
+            outScene.AddMesh(nodeIndex, std::move(loadedMesh));
+        
+        // Split parts share the node, so the occluder only needs the first one for its transform
+        if (isOccluder)
+            outScene.AddOccluder(LoadOccluder(scene->mMeshes[meshIndex], firstSceneMesh));
     }
     
     for (size_t i = 0; i < node->mNumChildren; i++)
-        newNode.AddChild(LoadNode(node->mChildren[i], scene, +newTransform));
-    
-    return newNode;
+        LoadNode(node->mChildren[i], scene, outScene, nodeIndex, XMMatrixIdentity(), occluderNodeNames, cookWriter);
 }
 
-Mesh GeometryImport::LoadMesh(aiMesh* mesh, const XMMATRIX& transform)
+void GeometryImport::LoadMesh(aiMesh* mesh, const XMMATRIX& transform, std::vector<Mesh>& outMeshes, MeshCache::Writer* cookWriter)
 {
     std::vector<Vertex> vertices;
     std::vector<uint32_t> indices;
@@ -70,17 +103,135 @@ Mesh GeometryImport::LoadMesh(aiMesh* mesh, const XMMATRIX& transform)
             indices.push_back(face.mIndices[j]);
     }
     
-    return Mesh(&vertices, &indices, mesh->mMaterialIndex);
+    bool compactVertices = GRAPHICS_SETTINGS.CompactVertices;
+    // The mesh shader reads full vertices by address, compact meshes keep the vertex pipeline only
+    bool buildMeshlets = GRAPHICS_SETTINGS.Meshlets && !compactVertices && mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE;
+    bool buildLODs = GRAPHICS_SETTINGS.MeshLODs && mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE;
+    MeshletData meshlets;
+    std::vector<uint32_t> meshletWords;
+    std::vector<uint32_t> lodIndices;
+    std::vector<MeshLOD> lods;
+    PreparedMesh prepared;
+    
+    // Meshlets cover LOD 0 only, the mesh shading path culls per meshlet instead of switching levels.
+    // The prepared arrays are exactly what gets uploaded, so the cook writer stores them as they are.
+    auto emplaceMesh = [&](std::vector<Vertex>& meshVertices, std::vector<uint32_t>& meshIndices)
+    {
+        if (buildLODs)
+        {
+            MeshSimplifier::BuildLODChain(meshVertices, meshIndices, lodIndices, lods);
+            Mesh::Prepare(meshVertices, lodIndices, mesh->mMaterialIndex, compactVertices, &lods, prepared);
+        }
+        else
+            Mesh::Prepare(meshVertices, meshIndices, mesh->mMaterialIndex, compactVertices, nullptr, prepared);
+        outMeshes.emplace_back(prepared.Upload);
+        
+        meshletWords.clear();
+        if (buildMeshlets)
+        {
+            MeshletBuilder::Build(meshVertices, meshIndices, meshlets);
+            Mesh::PackMeshlets(meshlets, meshletWords);
+            outMeshes.back().CreateMeshletBuffer(meshletWords.data(), meshletWords.size());
+        }
+        
+        if (cookWriter)
+            cookWriter->AddPart(prepared, meshletWords);
+    };
+    
+    // Point and line primitives are left in source order, the optimizer only handles triangle lists
+    if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE)
+    {
+        MeshOptimizer::OptimizeVertexCache(indices, static_cast<uint32_t>(vertices.size()));
+        MeshOptimizer::OptimizeOverdraw(indices, vertices);
+        MeshOptimizer::OptimizeVertexFetch(vertices, indices);
+        
+        std::vector<std::vector<Vertex>> partVertices;
+        std::vector<std::vector<uint32_t>> partIndices;
+        uint32_t vertexStride = compactVertices ? sizeof(CompactVertex) : sizeof(Vertex);
+        if (MeshOptimizer::SplitForShortIndices(vertices, indices, vertexStride, partVertices, partIndices))
+        {
+            for (size_t i = 0; i < partVertices.size(); i++)
+                emplaceMesh(partVertices[i], partIndices[i]);
+            return;
+        }
+    }
+    
+    emplaceMesh(vertices, indices);
 }
 
-RootNode GeometryImport::CreateMeshGroup(std::string filePath, const std::string& name, const XMMATRIX& transform)
+OccluderGeometry GeometryImport::LoadOccluder(aiMesh* mesh, uint32_t meshIndex)
 {
+    OccluderGeometry occluder;
+    occluder.MeshIndex = meshIndex;
+    occluder.Positions.resize(mesh->mNumVertices);
+    occluder.Indices.reserve(mesh->mNumFaces * 3);
+    
+    for (size_t i = 0; i < mesh->mNumVertices; i++)
+        occluder.Positions[i] = XMFLOAT3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+    
+    for (size_t i = 0; i < mesh->mNumFaces; i++)
+    {
+        const aiFace& face = mesh->mFaces[i];
+        if (face.mNumIndices != 3)
+            continue;
+        
+        occluder.Indices.push_back(face.mIndices[0]);
+        occluder.Indices.push_back(face.mIndices[1]);
+        occluder.Indices.push_back(face.mIndices[2]);
+    }
+    
+    return occluder;
+}
+
+Scene GeometryImport::CreateScene(std::string filePath, const std::string& name, const XMMATRIX& transform,
+                                  const std::vector<std::string>& occluderNodeNames)
+{
+    const uint32_t importFlags = aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | 
+        aiProcess_CalcTangentSpace | aiProcess_GenSmoothNormals | aiProcess_ConvertToLeftHanded;
+    std::string sourcePath = "Meshes/" + filePath;
+    std::string cookedPath = sourcePath + ".cooked";
+    uint64_t key = MeshCache::ComputeKey(sourcePath, importFlags);
+    
+    // A load that fails partway returns the geometry it already uploaded, the caller never sees the scene to release it
+    Scene newScene;
+    try
+    {
+        if (MeshCache::Load(cookedPath, key, name, transform, occluderNodeNames, newScene))
+            return newScene;
+    }
+    catch (...)
+    {
+        newScene.ReleaseGeometry();
+        throw;
+    }
+    
+    // Assimp parses from memory, the extension tells it the format. Side files such as .mtl still go through its own IO.
+    FileBuffer sourceFile = AssetIO::GetInstance().ReadFile(sourcePath);
+    if (sourceFile.IsEmpty())
+        throw std::runtime_error("Failed to load model: " + filePath);
+    
     Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile("Meshes/" + filePath, 
-        aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | 
-        aiProcess_CalcTangentSpace | aiProcess_GenSmoothNormals | aiProcess_ConvertToLeftHanded);
+    std::string extension = std::filesystem::path(sourcePath).extension().string();
+    const aiScene* scene = importer.ReadFileFromMemory(sourceFile.GetData(), sourceFile.GetSize(), importFlags,
+                                                       extension.empty() ? "" : extension.c_str() + 1);
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
         throw std::runtime_error("Failed to load model: " + filePath);
     
-    return RootNode(LoadNode(scene->mRootNode, scene, transform), scene->mNumMaterials);
+    MeshCache::Writer cookWriter;
+    newScene = Scene(name, scene->mNumMaterials);
+    try
+    {
+        LoadNode(scene->mRootNode, scene, newScene, Scene::NoParent, transform, occluderNodeNames, &cookWriter);
+    }
+    catch (...)
+    {
+        newScene.ReleaseGeometry();
+        throw;
+    }
+    newScene.UpdateWorldTransforms();
+    
+    if (!cookWriter.Save(cookedPath, key, scene->mNumMaterials))
+        std::cerr << "Failed to write cooked mesh: " << cookedPath << std::endl;
+    
+    return newScene;
 }
\ No newline at end of file
@@ -1,11 +1,20 @@
 #pragma once
 #include "Mesh.h"
+#include "MeshCache.h"
+#include "Scene.h"
 #include "../RenderPassExecutor.h"
 
 class GeometryImport
 {
 public:
-    static SceneNode LoadNode(aiNode* node, const aiScene* scene, const DirectX::XMMATRIX& transform);
-    static Mesh LoadMesh(aiMesh* mesh, const DirectX::XMMATRIX& transform);
-    static RootNode CreateMeshGroup(std::string filePath, const std::string& name, const DirectX::XMMATRIX& transform);
+    static void LoadNode(aiNode* node, const aiScene* scene, Scene& outScene, uint32_t parentIndex, const DirectX::XMMATRIX& parentSpace,
+                         const std::vector<std::string>& occluderNodeNames, MeshCache::Writer* cookWriter = nullptr);
+    static OccluderGeometry LoadOccluder(aiMesh* mesh, uint32_t meshIndex);
+    // Appends one mesh, or several when a large mesh is split so each part fits 16 bit indices
+    static void LoadMesh(aiMesh* mesh, const DirectX::XMMATRIX& transform, std::vector<Mesh>& outMeshes, MeshCache::Writer* cookWriter = nullptr);
+    // Meshes on nodes named in occluderNodeNames also keep a CPU copy of their triangles for occlusion culling,
+    // Scene::AllNodes keeps every mesh's until Scene::KeepOccluders picks the ones that stay.
+    // Loads Meshes/<filePath>.cooked when it matches the source, otherwise imports through Assimp and writes it.
+    static Scene CreateScene(std::string filePath, const std::string& name, const DirectX::XMMATRIX& transform,
+                             const std::vector<std::string>& occluderNodeNames = {});
 };
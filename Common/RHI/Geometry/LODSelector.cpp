@@ -0,0 +1,66 @@
+#include "LODSelector.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using namespace DirectX;
+
+void LODSelector::Select(const Scene& scene, const XMFLOAT4X4& view, const XMFLOAT4X4& projection, float viewportHeight,
+                         std::vector<uint8_t>& outLODs, const std::vector<uint32_t>* visibleMeshes)
+{
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    const std::vector<Mesh>& meshes = scene.GetMeshes();
+    const std::vector<BoundingSphere>& meshSpheres = scene.GetMeshSpheres();
+    const std::vector<uint32_t>& meshNodeIndices = scene.GetMeshNodeIndices();
+    const std::vector<XMFLOAT4X4>& worldTransforms = scene.GetWorldTransforms();
+
+    outLODs.assign(meshes.size(), 0);
+    LastStatistics = {};
+
+    // Eye is the translation of the inverse view, projection _22 scales view space y to clip space at unit depth
+    XMMATRIX inverseView = XMMatrixInverse(nullptr, XMLoadFloat4x4(&view));
+    XMVECTOR eye = inverseView.r[3];
+    float pixelsAtUnitDistance = projection._22 * viewportHeight * 0.5f;
+
+    size_t testCount = visibleMeshes ? visibleMeshes->size() : meshes.size();
+    for (size_t n = 0; n < testCount; n++)
+    {
+        uint32_t i = visibleMeshes ? (*visibleMeshes)[n] : static_cast<uint32_t>(n);
+        const Mesh& mesh = meshes[i];
+        uint32_t lodCount = mesh.GetLODCount();
+
+        LastStatistics.TestedMeshes++;
+        LastStatistics.FullTriangles += mesh.GetIndexCount() / 3;
+        if (lodCount < 2)
+        {
+            LastStatistics.SelectedTriangles += mesh.GetIndexCount() / 3;
+            continue;
+        }
+
+        XMMATRIX world = XMLoadFloat4x4(&worldTransforms[meshNodeIndices[i]]);
+        XMVECTOR center = XMVector3Transform(XMLoadFloat3(&meshSpheres[i].Center), world);
+        float scale = std::max({ XMVectorGetX(XMVector3Length(world.r[0])), XMVectorGetX(XMVector3Length(world.r[1])),
+                                 XMVectorGetX(XMVector3Length(world.r[2])) });
+
+        // Nearest point of the bounding sphere, cameras inside the sphere keep full detail
+        float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(center, eye))) - meshSpheres[i].Radius * scale;
+        uint32_t lod = 0;
+        if (distance > 0.0f)
+        {
+            float pixelsPerUnit = scale * pixelsAtUnitDistance / distance;
+            lod = lodCount - 1;
+            while (lod > 0 && mesh.GetLOD(lod).Error * pixelsPerUnit > ErrorThreshold)
+                lod--;
+        }
+
+        outLODs[i] = static_cast<uint8_t>(lod);
+        LastStatistics.SelectedTriangles += mesh.GetLOD(lod).IndexCount / 3;
+        if (lod > 0)
+            LastStatistics.ReducedMeshes++;
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+    LastStatistics.Milliseconds = elapsed.count();
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "Scene.h"
+
+// Picks a level of detail per scene mesh each frame, the coarsest level whose object space error
+// projects to no more than ErrorThreshold pixels at the mesh's bounding sphere.
+class LODSelector
+{
+public:
+
+    struct Statistics
+    {
+        uint32_t TestedMeshes = 0;
+        uint32_t ReducedMeshes = 0;
+        uint64_t FullTriangles = 0;
+        uint64_t SelectedTriangles = 0;
+        double Milliseconds = 0.0;
+    };
+
+    void SetErrorThreshold(float pixels)                { ErrorThreshold = pixels; }
+    float GetErrorThreshold() const                     { return ErrorThreshold; }
+
+    // outLODs is indexed by scene mesh, meshes outside visibleMeshes are left at LOD 0
+    void Select(const Scene& scene, const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& projection, float viewportHeight,
+                std::vector<uint8_t>& outLODs, const std::vector<uint32_t>* visibleMeshes = nullptr);
+
+    const Statistics& GetStatistics() const             { return LastStatistics; }
+
+private:
+
+    float ErrorThreshold = 1.0f;
+    Statistics LastStatistics;
+};
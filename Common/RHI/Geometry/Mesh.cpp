@@ -1,10 +1,15 @@
 ﻿#include "Mesh.h"
 
+#include <cstring>
 #include <iostream>
 
+#include "VertexCompression.h"
+#include "../AssetLoader.h"
 #include "../BufferAllocator.h"
+#include "../GeometryArena.h"
 #include <stdexcept>
 
+using namespace DirectX;
 using namespace RHIStructures;
 
 Mesh::Mesh()
@@ -12,52 +17,117 @@ Mesh::Mesh()
     VertexCount = 0;
     IndexCount = 0;
     LocalMaterialIndex = 0;
+    XMStoreFloat4x4(&Dequantize, XMMatrixIdentity());
 }
 
-Mesh::Mesh(std::vector<Vertex>* vertices, std::vector<uint32_t>* indices, uint32_t LocalMaterialIndex) :
-    LocalMaterialIndex(LocalMaterialIndex)
+Mesh::Mesh(std::vector<Vertex>* vertices, std::vector<uint32_t>* indices, uint32_t LocalMaterialIndex, bool compactVertices,
+           const std::vector<MeshLOD>* lods)
 {
-    using namespace RHIStructures;
+    PreparedMesh prepared;
+    Prepare(*vertices, *indices, LocalMaterialIndex, compactVertices, lods, prepared);
+    Upload(prepared.Upload);
+}
+
+Mesh::Mesh(const MeshUploadData& data)
+{
+    Upload(data);
+}
+
+void Mesh::Prepare(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t localMaterialIndex,
+                   bool compactVertices, const std::vector<MeshLOD>* lods, PreparedMesh& outPrepared)
+{
+    MeshUploadData& upload = outPrepared.Upload;
+    upload = {};
+    upload.VertexCount = static_cast<uint32_t>(vertices.size());
+    upload.IndexCount = static_cast<uint32_t>(indices.size());
+    upload.LocalMaterialIndex = localMaterialIndex;
+    upload.CompactVertices = compactVertices;
     
-    VertexCount = vertices->size();
-    IndexCount = indices->size();
+    // Every level indexes the same vertices, the whole chain lives in one index buffer after LOD 0
+    outPrepared.LODs.clear();
+    if (lods && !lods->empty())
+        outPrepared.LODs = *lods;
+    else if (!indices.empty())
+        outPrepared.LODs.push_back(MeshLOD { 0, upload.IndexCount, 0.0f });
     
-    MemoryAccess memoryAccess{0};
-    memoryAccess.SetGPURead(true);
-    memoryAccess.SetCPUWrite(true);
+    if (!vertices.empty())
+    {
+        DirectX::BoundingBox::CreateFromPoints(upload.Bounds, vertices.size(), &vertices[0].Position, sizeof(Vertex));
+        DirectX::BoundingSphere::CreateFromPoints(upload.Sphere, vertices.size(), &vertices[0].Position, sizeof(Vertex));
+    }
     
-    BufferAllocator* bufferAlloc = BufferAllocator::GetInstance();
+    XMStoreFloat4x4(&upload.Dequantize, XMMatrixIdentity());
+    if (compactVertices)
+    {
+        std::vector<CompactVertex> compactVertexData;
+        VertexCompression::Compress(vertices, upload.Bounds, compactVertexData, upload.Dequantize);
+        outPrepared.Vertices.resize(compactVertexData.size() * sizeof(CompactVertex));
+        memcpy(outPrepared.Vertices.data(), compactVertexData.data(), outPrepared.Vertices.size());
+    }
+    else
+    {
+        outPrepared.Vertices.resize(vertices.size() * sizeof(Vertex));
+        memcpy(outPrepared.Vertices.data(), vertices.data(), outPrepared.Vertices.size());
+    }
     
-    if (VertexCount > 0)
+    // Every index of a mesh with at most 65536 vertices fits in 16 bits
+    upload.IndexFormat = vertices.size() <= UINT16_MAX + 1 ? IndexFormat::UInt16 : IndexFormat::UInt32;
+    outPrepared.Indices.resize(indices.size() * IndexSize(upload.IndexFormat));
+    if (upload.IndexFormat == IndexFormat::UInt16)
     {
-        BufferDesc vertexBufferDesc = {};
-        vertexBufferDesc.Size = vertices->size() * sizeof(Vertex);
-        vertexBufferDesc.Usage = BufferUsage{
-            .TransferSource = false,
-            .TransferDestination = true,
-            .Type = BufferType::Vertex
-        };
-        vertexBufferDesc.Type = BufferType::Vertex;
-        vertexBufferDesc.Access = memoryAccess;
-        vertexBufferDesc.InitialData = vertices->data();
-        
-        VertexBufferID = bufferAlloc->CreateBuffer(vertexBufferDesc, false);
+        uint16_t* shortIndices = reinterpret_cast<uint16_t*>(outPrepared.Indices.data());
+        for (size_t i = 0; i < indices.size(); i++)
+            shortIndices[i] = static_cast<uint16_t>(indices[i]);
     }
+    else
+        memcpy(outPrepared.Indices.data(), indices.data(), outPrepared.Indices.size());
+    
+    upload.Vertices = outPrepared.Vertices.data();
+    upload.Indices = outPrepared.Indices.data();
+    upload.LODs = outPrepared.LODs.data();
+    upload.LODCount = static_cast<uint32_t>(outPrepared.LODs.size());
+}
+
+void Mesh::Upload(const MeshUploadData& data)
+{
+    VertexCount = data.VertexCount;
+    LocalMaterialIndex = data.LocalMaterialIndex;
+    CompactVertices = data.CompactVertices;
+    Indices = data.IndexFormat;
+    Dequantize = data.Dequantize;
+    LocalBounds = data.Bounds;
+    LocalSphere = data.Sphere;
+    LODs.assign(data.LODs, data.LODs + data.LODCount);
+    IndexCount = LODs.empty() ? 0 : LODs[0].IndexCount;
     
-    if (IndexCount > 0)
+    // Vertex and index data are sub-allocated from the shared arena buffers, the offsets select this mesh at draw time.
+    // Background loads hand the arena work to the render thread. A failed allocation returns the ones made before it.
+    try
     {
-        BufferDesc indexBufferDesc = {};
-        indexBufferDesc.Size = indices->size() * sizeof(uint32_t);
-        indexBufferDesc.Usage = BufferUsage{
-            .TransferSource = false,
-            .TransferDestination = true,
-            .Type = BufferType::Index
-        };
-        indexBufferDesc.Type = BufferType::Index;
-        indexBufferDesc.Access = memoryAccess;
-        indexBufferDesc.InitialData = indices->data();
+        AssetLoader::RunOnRenderThread([&]()
+        {
+            GeometryArena& arena = GeometryArena::GetInstance();
+        
+            if (VertexCount > 0)
+            {
+                VertexAllocation = arena.Allocate(BufferType::Vertex, data.Vertices, VertexCount * GetVertexStride(), GetVertexStride());
+                VertexBufferID = VertexAllocation.BufferID;
+                VertexOffset = static_cast<uint32_t>(VertexAllocation.Offset / GetVertexStride());
+            }
         
-        IndexBufferID = bufferAlloc->CreateBuffer(indexBufferDesc, false);
+            if (data.IndexCount > 0)
+            {
+                uint32_t indexSize = static_cast<uint32_t>(IndexSize(Indices));
+                IndexAllocation = arena.Allocate(BufferType::Index, data.Indices, static_cast<uint64_t>(data.IndexCount) * indexSize, indexSize);
+                IndexBufferID = IndexAllocation.BufferID;
+                FirstIndex = static_cast<uint32_t>(IndexAllocation.Offset / indexSize);
+            }
+        });
+    }
+    catch (...)
+    {
+        ReleaseGeometry();
+        throw;
     }
 }
 
@@ -66,16 +136,88 @@ Mesh::~Mesh()
     
 }
 
-const Mesh* SceneNode::GetMesh(uint32_t index) const
+void Mesh::ReleaseGeometry()
 {
+    AssetLoader::RunOnRenderThread([this]()
     {
-        if (index >= Meshes.size())
-            throw std::out_of_range("Mesh index: " + std::to_string(index) + " is out of range in mesh group: " + Name + ".");
-        
-        return &Meshes[index];
-    }
+        GeometryArena& arena = GeometryArena::GetInstance();
+        arena.Free(VertexAllocation);
+        arena.Free(IndexAllocation);
+        if (MeshletCount > 0)
+            arena.FreeBuffer(MeshletBufferID);
+    });
+    VertexAllocation = {};
+    IndexAllocation = {};
+    MeshletBufferID = 0;
+    MeshletCount = 0;
+}
+
+uint32_t Mesh::GetVertexStride() const
+{
+    return CompactVertices ? sizeof(CompactVertex) : sizeof(Vertex);
 }
 
+XMFLOAT4X4 Mesh::GetInstanceTransform(const XMFLOAT4X4& world) const
+{
+    if (!CompactVertices)
+        return world;
+    
+    XMFLOAT4X4 model;
+    XMStoreFloat4x4(&model, XMLoadFloat4x4(&Dequantize) * XMLoadFloat4x4(&world));
+    return model;
+}
+
+void Mesh::CreateMeshletBuffer(const MeshletData& meshlets)
+{
+    std::vector<uint32_t> words;
+    PackMeshlets(meshlets, words);
+    CreateMeshletBuffer(words.data(), words.size());
+}
+
+void Mesh::PackMeshlets(const MeshletData& meshlets, std::vector<uint32_t>& outWords)
+{
+    outWords.clear();
+    if (meshlets.Meshlets.empty())
+        return;
+    
+    uint32_t header[4] = {};
+    header[0] = static_cast<uint32_t>(meshlets.Meshlets.size());
+    header[1] = static_cast<uint32_t>((sizeof(header) + meshlets.Meshlets.size() * sizeof(Meshlet)) / sizeof(uint32_t));
+    header[2] = header[1] + static_cast<uint32_t>(meshlets.VertexIndices.size());
+    
+    outWords.resize(header[2] + meshlets.Triangles.size());
+    memcpy(outWords.data(), header, sizeof(header));
+    memcpy(&outWords[sizeof(header) / sizeof(uint32_t)], meshlets.Meshlets.data(), meshlets.Meshlets.size() * sizeof(Meshlet));
+    memcpy(&outWords[header[1]], meshlets.VertexIndices.data(), meshlets.VertexIndices.size() * sizeof(uint32_t));
+    memcpy(&outWords[header[2]], meshlets.Triangles.data(), meshlets.Triangles.size() * sizeof(uint32_t));
+}
+
+void Mesh::CreateMeshletBuffer(const uint32_t* words, size_t wordCount)
+{
+    if (CompactVertices)
+        throw std::runtime_error("Meshlets are only supported for full precision vertices.");
+    
+    if (wordCount == 0)
+        return;
+    
+    MemoryAccess memoryAccess{0};
+    memoryAccess.SetGPURead(true);
+    memoryAccess.SetCPUWrite(true);
+    
+    BufferDesc meshletBufferDesc = {};
+    meshletBufferDesc.Size = wordCount * sizeof(uint32_t);
+    meshletBufferDesc.Usage = BufferUsage{
+        .TransferSource = false,
+        .TransferDestination = true,
+        .Type = BufferType::ShaderStorage
+    };
+    meshletBufferDesc.Type = BufferType::ShaderStorage;
+    meshletBufferDesc.Access = memoryAccess;
+    meshletBufferDesc.InitialData = words;
+    
+    AssetLoader::RunOnRenderThread([&]() { MeshletBufferID = BufferAllocator::GetInstance()->CreateBuffer(meshletBufferDesc, false); });
+    MeshletCount = words[0];
+}
 
 void* Mesh::GetVertexBufferHandle() const
 {
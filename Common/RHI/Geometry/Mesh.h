@@ -3,78 +3,120 @@
 #define GLFW_INCLUDE_VULKAN
 
 #include <DirectXMath.h>
+#include <DirectXCollision.h>
 #include <string>
 #include <vector>
 #include <assimp/scene.h>
+#include "MeshletBuilder.h"
+#include "MeshSimplifier.h"
+#include "../GeometryArena.h"
 #include "../RHIStructures.h"
 
 struct aiScene;
 struct DirectX::XMMATRIX;
 
+// Mesh data in the exact layout of its GPU buffers: Vertex or CompactVertex and the whole LOD chain
+// in the final index format. Points into a PreparedMesh or a mapped cooked file.
+struct MeshUploadData
+{
+    const void* Vertices = nullptr;
+    const void* Indices = nullptr;
+    const MeshLOD* LODs = nullptr;
+    uint32_t VertexCount = 0;
+    uint32_t IndexCount = 0;
+    uint32_t LODCount = 0;
+    uint32_t LocalMaterialIndex = 0;
+    bool CompactVertices = false;
+    RHIStructures::IndexFormat IndexFormat = RHIStructures::IndexFormat::UInt32;
+    DirectX::XMFLOAT4X4 Dequantize;
+    DirectX::BoundingBox Bounds;
+    DirectX::BoundingSphere Sphere;
+};
+
+// Owns the converted arrays of one mesh between import and upload
+struct PreparedMesh
+{
+    std::vector<uint8_t> Vertices;
+    std::vector<uint8_t> Indices;
+    std::vector<MeshLOD> LODs;
+    MeshUploadData Upload;
+};
+
 class Mesh
 {
 public:
     
     Mesh();
-    Mesh(std::vector<RHIStructures::Vertex>* vertices, std::vector<uint32_t>* indices, uint32_t LocalMaterialIndex);
+    // compactVertices uploads RHIStructures::CompactVertex, bounds are still taken from the full precision positions.
+    // lods describes the index ranges when indices holds a MeshSimplifier LOD chain, without it the whole list is LOD 0.
+    Mesh(std::vector<RHIStructures::Vertex>* vertices, std::vector<uint32_t>* indices, uint32_t LocalMaterialIndex,
+         bool compactVertices = false, const std::vector<MeshLOD>* lods = nullptr);
+    explicit Mesh(const MeshUploadData& data);
     ~Mesh();
+    
+    // Does every CPU side conversion of the constructor above, outPrepared.Upload points into outPrepared's own arrays
+    static void Prepare(const std::vector<RHIStructures::Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t localMaterialIndex,
+                        bool compactVertices, const std::vector<MeshLOD>* lods, PreparedMesh& outPrepared);
 
     uint32_t GetVertexCount() const                     { return VertexCount; }
+    // Index count of LOD 0
     uint32_t GetIndexCount() const                      { return IndexCount; }
     uint32_t GetLocalMaterialIndex() const              { return LocalMaterialIndex; }
+    RHIStructures::IndexFormat GetIndexFormat() const   { return Indices; }
+    bool IsCompact() const                              { return CompactVertices; }
+    uint32_t GetVertexStride() const;
+    // World transform with the compact position dequantization folded in, meant for per-instance model matrices
+    DirectX::XMFLOAT4X4 GetInstanceTransform(const DirectX::XMFLOAT4X4& world) const;
+    
+    const DirectX::BoundingBox& GetLocalBounds() const  { return LocalBounds; }
+    const DirectX::BoundingSphere& GetLocalSphere() const { return LocalSphere; }
     
     uint64_t GetVertexBufferID() const                 { return VertexBufferID; }
     uint64_t GetIndexBufferID() const                  { return IndexBufferID; }
+    // Offsets of this mesh's data inside the shared arena buffers, in vertices and indices
+    uint32_t GetVertexOffset() const                   { return VertexOffset; }
+    uint32_t GetFirstIndex() const                     { return FirstIndex; }
     void* GetVertexBufferHandle() const;
     void* GetIndexBufferHandle() const;
     
+    const std::vector<MeshLOD>& GetLODs() const         { return LODs; }
+    uint32_t GetLODCount() const                        { return static_cast<uint32_t>(LODs.size()); }
+    const MeshLOD& GetLOD(uint32_t lod) const           { return LODs[lod < LODs.size() ? lod : LODs.size() - 1]; }
+    
+    // Uploads meshlets for the mesh shading path as one storage buffer: a uint4 header of meshlet count and the uint offsets of
+    // the vertex index and triangle arrays, then the Meshlet array, vertex indices and packed triangles. Full vertices only.
+    void CreateMeshletBuffer(const MeshletData& meshlets);
+    // Same buffer from words already laid out by PackMeshlets
+    void CreateMeshletBuffer(const uint32_t* words, size_t wordCount);
+    static void PackMeshlets(const MeshletData& meshlets, std::vector<uint32_t>& outWords);
+    uint64_t GetMeshletBufferID() const                 { return MeshletBufferID; }
+    uint32_t GetMeshletCount() const                    { return MeshletCount; }
+    
+    // Returns the vertex and index ranges to the arena and frees the meshlet buffer, both are reused only once frames in flight
+    // are done with them. Meshes are copied freely, so this is never done on destruction.
+    void ReleaseGeometry();
+    
 private:
     
+    void Upload(const MeshUploadData& data);
+    
     uint32_t VertexCount;
     uint32_t IndexCount;
     uint32_t LocalMaterialIndex;
+    bool CompactVertices = false;
+    RHIStructures::IndexFormat Indices = RHIStructures::IndexFormat::UInt32;
+    DirectX::XMFLOAT4X4 Dequantize;
+    DirectX::BoundingBox LocalBounds;
+    DirectX::BoundingSphere LocalSphere;
+    std::vector<MeshLOD> LODs;
     
     uint64_t VertexBufferID = 0;
     uint64_t IndexBufferID = 0;
+    uint32_t VertexOffset = 0;
+    uint32_t FirstIndex = 0;
+    GeometryArena::Allocation VertexAllocation;
+    GeometryArena::Allocation IndexAllocation;
+    uint64_t MeshletBufferID = 0;
+    uint32_t MeshletCount = 0;
     
 };
-
-struct SceneNode
-{
-    SceneNode() = default;
-    SceneNode(std::vector<Mesh>&& meshes, const DirectX::XMMATRIX modelMatrix, const std::string& name, uint32_t numMaterials) : Name(name), Meshes(std::move(meshes)), Model(modelMatrix), NumMaterials(numMaterials) {}
-    ~SceneNode() = default;
-
-    std::string Name;
-    void AddChild(SceneNode child)                      { Children.push_back(std::move(child)); }
-    void AddMesh(Mesh mesh)                             { Meshes.push_back(std::move(mesh)); }
-    std::vector<SceneNode> GetChildren() const          { return Children; }
-    std::vector<Mesh> GetMeshes() const                 { return Meshes; }
-    DirectX::XMMATRIX GetModelMatrix() const            { return Model; }
-    void SetModelMatrix(DirectX::XMMATRIX modelMatrix)  { Model = modelMatrix; }
-    size_t GetMeshCount() const                         { return Meshes.size(); }
-    uint32_t GetNumMaterials() const                    { return NumMaterials; }
-    const Mesh* GetMesh(uint32_t index) const;
-    
-private:
-    
-    uint32_t NumMaterials;
-    std::vector<Mesh> Meshes;
-    std::vector<SceneNode> Children;
-    DirectX::XMMATRIX Model;
-};
-
-struct RootNode
-{
-    RootNode() = default;
-    RootNode(SceneNode&& sceneNode, uint32_t numMaterials) : SceneNode(std::move(sceneNode)), NumMaterials(numMaterials) {}
-    ~RootNode() = default;
-    
-    SceneNode& GetSceneNode()                           { return SceneNode; }
-    uint32_t GetNumMaterials() const                    { return NumMaterials; }   
-
-private:
-    
-    SceneNode SceneNode;
-    uint32_t NumMaterials = 0;
-};
\ No newline at end of file
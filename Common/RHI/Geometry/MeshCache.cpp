@@ -0,0 +1,296 @@
+#include "MeshCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "../../GraphicsSettings.h"
+#include "../../Data/AssetIO.h"
+#include "../../Windows/MappedFile.h"
+
+using namespace DirectX;
+using namespace RHIStructures;
+
+namespace
+{
+    bool InRange(uint64_t offset, uint64_t size, uint64_t limit)
+    {
+        return offset <= limit && size <= limit - offset;
+    }
+
+    uint64_t VertexStride(bool compact)     { return compact ? sizeof(CompactVertex) : sizeof(Vertex); }
+}
+
+uint64_t MeshCache::ComputeKey(const std::string& sourcePath, uint32_t importFlags)
+{
+    // FNV-1a over the source's content hash, then the import flags and every setting that changes the cooked output.
+    // The hash comes from the copy CreateScene reads, an archived source wins over a loose one.
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    auto mix = [&hash](const uint8_t* bytes, uint64_t size)
+    {
+        for (uint64_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 0x100000001B3ULL;
+        }
+    };
+
+    uint64_t contentHash = 0;
+    if (!AssetIO::GetInstance().GetContentHash(sourcePath, contentHash))
+        return 0;
+    mix(reinterpret_cast<const uint8_t*>(&contentHash), sizeof(contentHash));
+
+    uint32_t settings = (GRAPHICS_SETTINGS.CompactVertices ? 1u : 0u) | (GRAPHICS_SETTINGS.Meshlets ? 2u : 0u) |
+                        (GRAPHICS_SETTINGS.MeshLODs ? 4u : 0u);
+    uint32_t tail[3] = { importFlags, settings, Version };
+    mix(reinterpret_cast<const uint8_t*>(tail), sizeof(tail));
+
+    return hash;
+}
+
+bool MeshCache::ValidatePart(const FilePart& part, const uint8_t* data, uint64_t dataSize)
+{
+    if (part.IndexFormat > static_cast<uint32_t>(IndexFormat::UInt32))
+        return false;
+
+    bool compact = part.CompactVertices != 0;
+    uint64_t indexSize = IndexSize(static_cast<IndexFormat>(part.IndexFormat));
+    if (!InRange(part.VerticesOffset, part.VertexCount * VertexStride(compact), dataSize) ||
+        !InRange(part.IndicesOffset, part.IndexCount * indexSize, dataSize) ||
+        !InRange(part.LODsOffset, part.LODCount * sizeof(MeshLOD), dataSize) ||
+        !InRange(part.MeshletsOffset, part.MeshletWordCount * sizeof(uint32_t), dataSize))
+        return false;
+
+    // Offsets come from AppendData, anything unaligned was not written by this version
+    uint64_t offsets[4] = { part.VerticesOffset, part.IndicesOffset, part.LODsOffset, part.MeshletsOffset };
+    for (uint64_t offset : offsets)
+        if (offset % DataAlignment != 0)
+            return false;
+
+    const MeshLOD* lods = reinterpret_cast<const MeshLOD*>(data + part.LODsOffset);
+    for (uint32_t i = 0; i < part.LODCount; i++)
+        if (!InRange(lods[i].FirstIndex, lods[i].IndexCount, part.IndexCount))
+            return false;
+
+    return true;
+}
+
+bool MeshCache::Load(const std::string& cookedPath, uint64_t key, const std::string& name, const XMMATRIX& transform,
+                     const std::vector<std::string>& occluderNodeNames, Scene& outScene)
+{
+    MappedFile file;
+    if (key == 0 || !file.Open(cookedPath) || file.GetSize() < sizeof(FileHeader))
+        return false;
+
+    const uint8_t* base = file.GetData();
+    FileHeader header;
+    memcpy(&header, base, sizeof(header));
+    if (header.Magic != Magic || header.Version != Version || header.Key != key || header.FileSize != file.GetSize())
+        return false;
+
+    uint64_t fileSize = header.FileSize;
+    if (!InRange(header.NodesOffset, static_cast<uint64_t>(header.NodeCount) * sizeof(FileNode), fileSize) ||
+        !InRange(header.PartsOffset, static_cast<uint64_t>(header.PartCount) * sizeof(FilePart), fileSize) ||
+        !InRange(header.NamesOffset, 0, fileSize) || !InRange(header.DataOffset, 0, fileSize) ||
+        header.NodesOffset % alignof(FileNode) != 0 || header.PartsOffset % alignof(FilePart) != 0 || header.DataOffset % DataAlignment != 0)
+        return false;
+
+    const FileNode* nodes = reinterpret_cast<const FileNode*>(base + header.NodesOffset);
+    const FilePart* parts = reinterpret_cast<const FilePart*>(base + header.PartsOffset);
+    const char* names = reinterpret_cast<const char*>(base + header.NamesOffset);
+    const uint8_t* data = base + header.DataOffset;
+    uint64_t namesSize = header.DataOffset - std::min(header.DataOffset, header.NamesOffset);
+    uint64_t dataSize = fileSize - header.DataOffset;
+
+    // Everything is checked before the first upload so a bad file falls back to a clean import
+    for (uint32_t n = 0; n < header.NodeCount; n++)
+    {
+        const FileNode& node = nodes[n];
+        if ((node.ParentIndex != Scene::NoParent && node.ParentIndex >= n) || !InRange(node.NameOffset, node.NameLength, namesSize) ||
+            !InRange(node.FirstPart, node.PartCount, header.PartCount))
+            return false;
+    }
+    for (uint32_t p = 0; p < header.PartCount; p++)
+        if (!ValidatePart(parts[p], data, dataSize))
+            return false;
+
+    outScene = Scene(name, header.NumMaterials);
+    for (uint32_t n = 0; n < header.NodeCount; n++)
+    {
+        const FileNode& node = nodes[n];
+        XMMATRIX localTransform = XMLoadFloat4x4(&node.LocalTransform);
+        if (node.ParentIndex == Scene::NoParent)
+            localTransform = localTransform * transform;
+
+        std::string nodeName(names + node.NameOffset, node.NameLength);
+        uint32_t nodeIndex = outScene.AddNode(node.ParentIndex, localTransform, nodeName);
+        bool isOccluder = Scene::IsOccluderNode(occluderNodeNames, nodeName);
+
+        OccluderGeometry occluder;
+        for (uint32_t p = node.FirstPart; p < node.FirstPart + node.PartCount; p++)
+        {
+            const FilePart& part = parts[p];
+            bool compact = part.CompactVertices != 0;
+
+            MeshUploadData upload;
+            upload.Vertices = data + part.VerticesOffset;
+            upload.Indices = data + part.IndicesOffset;
+            upload.LODs = reinterpret_cast<const MeshLOD*>(data + part.LODsOffset);
+            upload.VertexCount = part.VertexCount;
+            upload.IndexCount = part.IndexCount;
+            upload.LODCount = part.LODCount;
+            upload.LocalMaterialIndex = part.LocalMaterialIndex;
+            upload.CompactVertices = compact;
+            upload.IndexFormat = static_cast<IndexFormat>(part.IndexFormat);
+            upload.Dequantize = part.Dequantize;
+            upload.Bounds = part.Bounds;
+            upload.Sphere = part.Sphere;
+
+            uint32_t sceneMesh = outScene.GetMeshCount();
+            Mesh mesh(upload);
+            try
+            {
+                if (part.MeshletWordCount > 0)
+                    mesh.CreateMeshletBuffer(reinterpret_cast<const uint32_t*>(data + part.MeshletsOffset), part.MeshletWordCount);
+            }
+            catch (...)
+            {
+                mesh.ReleaseGeometry();
+                throw;
+            }
+            outScene.AddMesh(nodeIndex, std::move(mesh));
+
+            if (!isOccluder)
+                continue;
+
+            // Occluders cover every part of a source mesh, compact positions are expanded back through the dequantize transform
+            if (p == node.FirstPart || parts[p - 1].SourceMesh != part.SourceMesh)
+            {
+                if (!occluder.Indices.empty())
+                    outScene.AddOccluder(std::move(occluder));
+                occluder = {};
+                occluder.MeshIndex = sceneMesh;
+            }
+
+            uint32_t baseVertex = static_cast<uint32_t>(occluder.Positions.size());
+            XMMATRIX dequantize = XMLoadFloat4x4(&part.Dequantize);
+            for (uint32_t v = 0; v < part.VertexCount; v++)
+            {
+                if (compact)
+                {
+                    const CompactVertex* vertices = reinterpret_cast<const CompactVertex*>(upload.Vertices);
+                    XMVECTOR position = XMVectorScale(XMVectorSet(vertices[v].Position[0], vertices[v].Position[1], vertices[v].Position[2], 0.0f), 1.0f / 32767.0f);
+                    XMFLOAT3 local;
+                    XMStoreFloat3(&local, XMVector3TransformCoord(position, dequantize));
+                    occluder.Positions.push_back(local);
+                }
+                else
+                    occluder.Positions.push_back(reinterpret_cast<const Vertex*>(upload.Vertices)[v].Position);
+            }
+
+            uint32_t lodIndexCount = part.LODCount > 0 ? std::min(upload.LODs[0].IndexCount, part.IndexCount) : part.IndexCount;
+            for (uint32_t i = 0; i < lodIndexCount; i++)
+            {
+                uint32_t index = upload.IndexFormat == IndexFormat::UInt16 ? reinterpret_cast<const uint16_t*>(upload.Indices)[i]
+                                                                           : reinterpret_cast<const uint32_t*>(upload.Indices)[i];
+                occluder.Indices.push_back(baseVertex + index);
+            }
+        }
+
+        if (!occluder.Indices.empty())
+            outScene.AddOccluder(std::move(occluder));
+    }
+
+    outScene.UpdateWorldTransforms();
+    return true;
+}
+
+void MeshCache::Writer::AddNode(uint32_t parentIndex, const XMMATRIX& localTransform, const std::string& name)
+{
+    FileNode node = {};
+    XMStoreFloat4x4(&node.LocalTransform, localTransform);
+    node.ParentIndex = parentIndex;
+    node.NameOffset = static_cast<uint32_t>(Names.size());
+    node.NameLength = static_cast<uint32_t>(name.size());
+    node.FirstPart = static_cast<uint32_t>(Parts.size());
+    Names += name;
+    Nodes.push_back(node);
+}
+
+void MeshCache::Writer::AddPart(const PreparedMesh& prepared, const std::vector<uint32_t>& meshletWords)
+{
+    const MeshUploadData& upload = prepared.Upload;
+
+    FilePart part = {};
+    part.VerticesOffset = AppendData(prepared.Vertices.data(), prepared.Vertices.size());
+    part.IndicesOffset = AppendData(prepared.Indices.data(), prepared.Indices.size());
+    part.LODsOffset = AppendData(prepared.LODs.data(), prepared.LODs.size() * sizeof(MeshLOD));
+    part.MeshletsOffset = AppendData(meshletWords.data(), meshletWords.size() * sizeof(uint32_t));
+    part.VertexCount = upload.VertexCount;
+    part.IndexCount = upload.IndexCount;
+    part.LODCount = upload.LODCount;
+    part.MeshletWordCount = static_cast<uint32_t>(meshletWords.size());
+    part.LocalMaterialIndex = upload.LocalMaterialIndex;
+    part.SourceMesh = CurrentSourceMesh;
+    part.CompactVertices = upload.CompactVertices ? 1 : 0;
+    part.IndexFormat = static_cast<uint32_t>(upload.IndexFormat);
+    part.Dequantize = upload.Dequantize;
+    part.Bounds = upload.Bounds;
+    part.Sphere = upload.Sphere;
+
+    Parts.push_back(part);
+    Nodes.back().PartCount++;
+}
+
+uint64_t MeshCache::Writer::AppendData(const void* data, uint64_t size)
+{
+    uint64_t offset = (Data.size() + DataAlignment - 1) / DataAlignment * DataAlignment;
+    Data.resize(offset + size);
+    if (size > 0)
+        memcpy(&Data[offset], data, size);
+    return offset;
+}
+
+bool MeshCache::Writer::Save(const std::string& cookedPath, uint64_t key, uint32_t numMaterials) const
+{
+    if (key == 0)
+        return false;
+
+    FileHeader header = {};
+    header.Magic = Magic;
+    header.Version = Version;
+    header.Key = key;
+    header.NodeCount = static_cast<uint32_t>(Nodes.size());
+    header.PartCount = static_cast<uint32_t>(Parts.size());
+    header.NumMaterials = numMaterials;
+    header.NodesOffset = sizeof(FileHeader);
+    header.PartsOffset = header.NodesOffset + Nodes.size() * sizeof(FileNode);
+    header.NamesOffset = header.PartsOffset + Parts.size() * sizeof(FilePart);
+    header.DataOffset = (header.NamesOffset + Names.size() + DataAlignment - 1) / DataAlignment * DataAlignment;
+    header.FileSize = header.DataOffset + Data.size();
+
+    // With archive-only assets there is no loose Meshes directory until the first cook
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(cookedPath).parent_path(), error);
+
+    std::string temporaryPath = cookedPath + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file)
+            return false;
+
+        const char padding[DataAlignment] = {};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(Nodes.data()), Nodes.size() * sizeof(FileNode));
+        file.write(reinterpret_cast<const char*>(Parts.data()), Parts.size() * sizeof(FilePart));
+        file.write(Names.data(), Names.size());
+        file.write(padding, header.DataOffset - header.NamesOffset - Names.size());
+        file.write(reinterpret_cast<const char*>(Data.data()), Data.size());
+        if (!file)
+            return false;
+    }
+
+    std::filesystem::rename(temporaryPath, cookedPath, error);
+    return !error;
+}
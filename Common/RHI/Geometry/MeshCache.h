@@ -0,0 +1,107 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+
+#include "Mesh.h"
+#include "Scene.h"
+
+// Cooked binary form of an imported scene: node hierarchy, transforms and every mesh part in its final GPU layout
+// (vertices, LOD index chain, packed meshlets), keyed by a hash of the source file, the Assimp
+// flags and the graphics settings that change the output. Loading maps the file and uploads straight from the view.
+class MeshCache
+{
+private:
+
+    // File layout: header, node table, part table, name blob, then the 16 byte aligned data blobs the parts point into
+    struct FileHeader
+    {
+        uint32_t Magic;
+        uint32_t Version;
+        uint64_t Key;
+        uint32_t NodeCount;
+        uint32_t PartCount;
+        uint32_t NumMaterials;
+        uint32_t Padding;
+        uint64_t NodesOffset;
+        uint64_t PartsOffset;
+        uint64_t NamesOffset;
+        uint64_t DataOffset;
+        uint64_t FileSize;
+        uint64_t Reserved;
+    };
+
+    struct FileNode
+    {
+        DirectX::XMFLOAT4X4 LocalTransform;
+        uint32_t ParentIndex;
+        uint32_t NameOffset;
+        uint32_t NameLength;
+        uint32_t FirstPart;
+        uint32_t PartCount;
+        uint32_t Padding[3];
+    };
+
+    // Blob offsets are relative to the data section
+    struct FilePart
+    {
+        uint64_t VerticesOffset;
+        uint64_t IndicesOffset;
+        uint64_t LODsOffset;
+        uint64_t MeshletsOffset;
+        uint32_t VertexCount;
+        uint32_t IndexCount;
+        uint32_t LODCount;
+        uint32_t MeshletWordCount;
+        uint32_t LocalMaterialIndex;
+        uint32_t SourceMesh;
+        uint32_t CompactVertices;
+        uint32_t IndexFormat;
+        DirectX::XMFLOAT4X4 Dequantize;
+        DirectX::BoundingBox Bounds;
+        DirectX::BoundingSphere Sphere;
+    };
+
+    static_assert(sizeof(FileHeader) == 80 && sizeof(FileNode) == 96 && sizeof(FilePart) == 168, "Cooked mesh layout changed, bump Version.");
+
+    static constexpr uint64_t DataAlignment = 16;
+
+    static bool ValidatePart(const FilePart& part, const uint8_t* data, uint64_t dataSize);
+
+public:
+
+    static constexpr uint32_t Magic = 0x48534D45;       // "EMSH"
+    static constexpr uint32_t Version = 2;
+
+    static uint64_t ComputeKey(const std::string& sourcePath, uint32_t importFlags);
+
+    // Returns false when the cooked file is missing, stale or malformed. transform places the root node like CreateScene.
+    static bool Load(const std::string& cookedPath, uint64_t key, const std::string& name, const DirectX::XMMATRIX& transform,
+                     const std::vector<std::string>& occluderNodeNames, Scene& outScene);
+
+    // Collects an import in cooked layout, nodes and parts in the order they were added to the Scene
+    class Writer
+    {
+    public:
+
+        // localTransform excludes the placement CreateScene applies to the root
+        void AddNode(uint32_t parentIndex, const DirectX::XMMATRIX& localTransform, const std::string& name);
+        // Parts split from one source mesh share its index, occluders are rebuilt from the whole group
+        void BeginSourceMesh(uint32_t sourceMesh)       { CurrentSourceMesh = sourceMesh; }
+        void AddPart(const PreparedMesh& prepared, const std::vector<uint32_t>& meshletWords);
+        // Writes to a temporary file first so an interrupted save never leaves a truncated cache behind
+        bool Save(const std::string& cookedPath, uint64_t key, uint32_t numMaterials) const;
+
+    private:
+
+        uint64_t AppendData(const void* data, uint64_t size);
+
+        std::vector<FileNode> Nodes;
+        std::vector<FilePart> Parts;
+        std::string Names;
+        std::vector<uint8_t> Data;
+        uint32_t CurrentSourceMesh = 0;
+    };
+};
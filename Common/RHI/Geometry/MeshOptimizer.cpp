@@ -0,0 +1,332 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+using namespace DirectX;
+using namespace RHIStructures;
+
+namespace
+{
+    const float CacheDecayPower = 1.5f;
+    const float LastTriangleScore = 0.75f;
+    const float ValenceBoostScale = 2.0f;
+    const float ValenceBoostPower = 0.5f;
+    const uint32_t ValenceTableSize = 32;
+    const uint32_t InvalidTriangle = UINT32_MAX;
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount)
+{
+    if (indices.size() % 3 != 0)
+        throw std::runtime_error("Vertex cache optimization requires a triangle list.");
+
+    uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    if (triangleCount == 0)
+        return;
+
+    // Score tables, the last three vertices used get a flat score so the next triangle does not just reuse the same edge
+    float cacheScores[CacheSize];
+    for (uint32_t i = 0; i < CacheSize; i++)
+        cacheScores[i] = i < 3 ? LastTriangleScore : std::pow(1.0f - float(i - 3) / float(CacheSize - 3), CacheDecayPower);
+
+    float valenceScores[ValenceTableSize];
+    for (uint32_t i = 1; i < ValenceTableSize; i++)
+        valenceScores[i] = ValenceBoostScale * std::pow(float(i), -ValenceBoostPower);
+    valenceScores[0] = 0.0f;
+
+    std::vector<uint32_t> remainingValence(vertexCount, 0);
+    for (uint32_t index : indices)
+    {
+        if (index >= vertexCount)
+            throw std::out_of_range("Index references a vertex past the end of the vertex buffer.");
+        remainingValence[index]++;
+    }
+
+    // Per vertex list of triangles not yet emitted, the first remainingValence entries of each range are live
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (uint32_t v = 0; v < vertexCount; v++)
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remainingValence[v];
+
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (uint32_t t = 0; t < triangleCount; t++)
+        for (uint32_t k = 0; k < 3; k++)
+            adjacency[fill[indices[t * 3 + k]]++] = t;
+
+    std::vector<int32_t> cachePositions(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    auto scoreVertex = [&](uint32_t vertex)
+    {
+        uint32_t valence = remainingValence[vertex];
+        if (valence == 0)
+            return -1.0f;
+
+        float score = cachePositions[vertex] >= 0 ? cacheScores[cachePositions[vertex]] : 0.0f;
+        return score + valenceScores[std::min(valence, ValenceTableSize - 1)];
+    };
+
+    for (uint32_t v = 0; v < vertexCount; v++)
+        vertexScores[v] = scoreVertex(v);
+
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    uint32_t bestTriangle = 0;
+    for (uint32_t t = 0; t < triangleCount; t++)
+    {
+        triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+        if (triangleScores[t] > triangleScores[bestTriangle])
+            bestTriangle = t;
+    }
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> nextCache;
+    cache.reserve(CacheSize + 3);
+    nextCache.reserve(CacheSize + 3);
+    uint32_t cursor = 0;
+
+    for (uint32_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+    {
+        // Nothing in cache has live triangles left, restart from the first unemitted triangle
+        if (bestTriangle == InvalidTriangle)
+        {
+            while (emitted[cursor])
+                cursor++;
+            bestTriangle = cursor;
+        }
+
+        const uint32_t* triangle = &indices[bestTriangle * 3];
+        output.insert(output.end(), triangle, triangle + 3);
+        emitted[bestTriangle] = 1;
+
+        for (uint32_t k = 0; k < 3; k++)
+        {
+            uint32_t vertex = triangle[k];
+            uint32_t* begin = &adjacency[adjacencyOffsets[vertex]];
+            uint32_t* end = begin + remainingValence[vertex];
+            uint32_t* found = std::find(begin, end, bestTriangle);
+            if (found != end)
+            {
+                std::swap(*found, *(end - 1));
+                remainingValence[vertex]--;
+            }
+        }
+
+        nextCache.clear();
+        for (uint32_t k = 0; k < 3; k++)
+            if (std::find(nextCache.begin(), nextCache.end(), triangle[k]) == nextCache.end())
+                nextCache.push_back(triangle[k]);
+        for (uint32_t vertex : cache)
+            if (std::find(nextCache.begin(), nextCache.end(), vertex) == nextCache.end())
+                nextCache.push_back(vertex);
+
+        // Vertices pushed past the end of the cache lose their cache score
+        for (size_t i = CacheSize; i < nextCache.size(); i++)
+        {
+            cachePositions[nextCache[i]] = -1;
+            vertexScores[nextCache[i]] = scoreVertex(nextCache[i]);
+        }
+        if (nextCache.size() > CacheSize)
+            nextCache.resize(CacheSize);
+
+        for (size_t i = 0; i < nextCache.size(); i++)
+        {
+            cachePositions[nextCache[i]] = static_cast<int32_t>(i);
+            vertexScores[nextCache[i]] = scoreVertex(nextCache[i]);
+        }
+
+        bestTriangle = InvalidTriangle;
+        float bestScore = -1.0f;
+        for (uint32_t vertex : nextCache)
+        {
+            for (uint32_t a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex] + remainingValence[vertex]; a++)
+            {
+                uint32_t t = adjacency[a];
+                triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+                if (triangleScores[t] > bestScore)
+                {
+                    bestScore = triangleScores[t];
+                    bestTriangle = t;
+                }
+            }
+        }
+
+        std::swap(cache, nextCache);
+    }
+
+    indices = std::move(output);
+}
+
+void MeshOptimizer::OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices)
+{
+    if (indices.size() % 3 != 0)
+        throw std::runtime_error("Overdraw optimization requires a triangle list.");
+
+    uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    if (triangleCount < 2)
+        return;
+
+    // Cluster boundaries are triangles where every vertex misses the cache, reordering whole clusters leaves cache hits intact
+    std::vector<uint32_t> clusterStarts;
+    std::vector<uint32_t> cacheTimestamps(vertices.size(), 0);
+    uint32_t timestamp = OverdrawCacheSize + 1;
+    for (uint32_t t = 0; t < triangleCount; t++)
+    {
+        uint32_t misses = 0;
+        for (uint32_t k = 0; k < 3; k++)
+        {
+            uint32_t vertex = indices[t * 3 + k];
+            if (timestamp - cacheTimestamps[vertex] > OverdrawCacheSize)
+            {
+                cacheTimestamps[vertex] = timestamp++;
+                misses++;
+            }
+        }
+
+        if (t == 0 || misses == 3)
+            clusterStarts.push_back(t);
+    }
+
+    if (clusterStarts.size() < 2)
+        return;
+
+    XMVECTOR meshCentroid = XMVectorZero();
+    for (uint32_t index : indices)
+        meshCentroid += XMLoadFloat3(&vertices[index].Position);
+    meshCentroid /= float(indices.size());
+
+    // Clusters facing away from the mesh center are likely to occlude the rest, so they are drawn first
+    uint32_t clusterCount = static_cast<uint32_t>(clusterStarts.size());
+    std::vector<float> sortKeys(clusterCount);
+    for (uint32_t c = 0; c < clusterCount; c++)
+    {
+        uint32_t first = clusterStarts[c];
+        uint32_t end = c + 1 < clusterCount ? clusterStarts[c + 1] : triangleCount;
+
+        XMVECTOR centroid = XMVectorZero();
+        XMVECTOR normal = XMVectorZero();
+        for (uint32_t i = first * 3; i < end * 3; i++)
+        {
+            centroid += XMLoadFloat3(&vertices[indices[i]].Position);
+            normal += XMLoadFloat3(&vertices[indices[i]].Normal);
+        }
+        centroid /= float((end - first) * 3);
+
+        sortKeys[c] = XMVectorGetX(XMVector3Dot(centroid - meshCentroid, XMVector3Normalize(normal)));
+    }
+
+    std::vector<uint32_t> clusterOrder(clusterCount);
+    std::iota(clusterOrder.begin(), clusterOrder.end(), 0u);
+    std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    for (uint32_t c : clusterOrder)
+    {
+        uint32_t first = clusterStarts[c];
+        uint32_t end = c + 1 < clusterCount ? clusterStarts[c + 1] : triangleCount;
+        output.insert(output.end(), indices.begin() + first * 3, indices.begin() + end * 3);
+    }
+
+    indices = std::move(output);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+    std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+    std::vector<Vertex> output;
+    output.reserve(vertices.size());
+
+    for (uint32_t& index : indices)
+    {
+        if (index >= vertices.size())
+            throw std::out_of_range("Index references a vertex past the end of the vertex buffer.");
+
+        if (remap[index] == UINT32_MAX)
+        {
+            remap[index] = static_cast<uint32_t>(output.size());
+            output.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    vertices = std::move(output);
+}
+
+bool MeshOptimizer::SplitForShortIndices(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t vertexStride,
+                                         std::vector<std::vector<Vertex>>& outVertices, std::vector<std::vector<uint32_t>>& outIndices)
+{
+    outVertices.clear();
+    outIndices.clear();
+    if (vertices.size() <= ShortIndexVertexLimit || indices.size() % 3 != 0)
+        return false;
+
+    // Greedy in index order, which after OptimizeVertexFetch keeps chunks spatially coherent and borders short
+    std::vector<uint32_t> localIndices(vertices.size());
+    std::vector<uint32_t> chunkStamps(vertices.size(), UINT32_MAX);
+    uint32_t chunk = UINT32_MAX;
+    size_t emittedVertices = 0;
+
+    for (size_t t = 0; t < indices.size(); t += 3)
+    {
+        uint32_t newVertices = 0;
+        for (uint32_t k = 0; k < 3; k++)
+            if (chunk == UINT32_MAX || chunkStamps[indices[t + k]] != chunk)
+                newVertices++;
+
+        if (chunk == UINT32_MAX || outVertices.back().size() + newVertices > ShortIndexVertexLimit)
+        {
+            chunk = static_cast<uint32_t>(outVertices.size());
+            outVertices.emplace_back();
+            outIndices.emplace_back();
+        }
+
+        for (uint32_t k = 0; k < 3; k++)
+        {
+            uint32_t index = indices[t + k];
+            if (chunkStamps[index] != chunk)
+            {
+                chunkStamps[index] = chunk;
+                localIndices[index] = static_cast<uint32_t>(outVertices.back().size());
+                outVertices.back().push_back(vertices[index]);
+                emittedVertices++;
+            }
+            outIndices.back().push_back(localIndices[index]);
+        }
+    }
+
+    size_t duplicatedBytes = (emittedVertices - std::min(emittedVertices, vertices.size())) * vertexStride;
+    size_t savedBytes = indices.size() * (sizeof(uint32_t) - sizeof(uint16_t));
+    if (duplicatedBytes >= savedBytes)
+    {
+        outVertices.clear();
+        outIndices.clear();
+        return false;
+    }
+
+    return true;
+}
+
+float MeshOptimizer::ComputeACMR(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize)
+{
+    if (indices.size() < 3)
+        return 0.0f;
+
+    std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+    uint32_t timestamp = cacheSize + 1;
+    uint32_t misses = 0;
+    for (uint32_t index : indices)
+    {
+        if (timestamp - cacheTimestamps[index] > cacheSize)
+        {
+            cacheTimestamps[index] = timestamp++;
+            misses++;
+        }
+    }
+
+    return float(misses) / float(indices.size() / 3);
+}
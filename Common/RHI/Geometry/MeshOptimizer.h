@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "../RHIStructures.h"
+
+// Index and vertex reordering run on triangle lists at import.
+// Intended order is OptimizeVertexCache, OptimizeOverdraw, then OptimizeVertexFetch last since it renumbers vertices.
+class MeshOptimizer
+{
+public:
+
+    // Forsyth's linear speed ordering against a simulated LRU post-transform cache
+    static void OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount);
+    // Splits the cache ordered list at cache flushes and sorts the clusters so outward facing ones draw first
+    static void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<RHIStructures::Vertex>& vertices);
+    // Rewrites the vertex buffer in first use order and drops unreferenced vertices
+    static void OptimizeVertexFetch(std::vector<RHIStructures::Vertex>& vertices, std::vector<uint32_t>& indices);
+    // Cuts a mesh with more than 65536 vertices into chunks that each fit 16 bit indices. Returns false and leaves
+    // the outputs empty when the vertices duplicated along chunk borders would cost more than the index bytes saved.
+    static bool SplitForShortIndices(const std::vector<RHIStructures::Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t vertexStride,
+                                     std::vector<std::vector<RHIStructures::Vertex>>& outVertices, std::vector<std::vector<uint32_t>>& outIndices);
+
+    // Average transformed vertices per triangle for a FIFO cache, 0.5 is ideal and 3 is no reuse at all
+    static float ComputeACMR(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize = 16);
+
+private:
+
+    static constexpr uint32_t CacheSize = 32;
+    static constexpr uint32_t OverdrawCacheSize = 16;
+    static constexpr uint32_t ShortIndexVertexLimit = 65536;
+};
@@ -0,0 +1,361 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+#include "MeshOptimizer.h"
+
+using namespace DirectX;
+using namespace RHIStructures;
+
+namespace
+{
+    // Plane quadric, sum of squared distances to the accumulated planes weighted by triangle area
+    struct Quadric
+    {
+        double A2 = 0.0, B2 = 0.0, C2 = 0.0, D2 = 0.0;
+        double AB = 0.0, AC = 0.0, AD = 0.0, BC = 0.0, BD = 0.0, CD = 0.0;
+        double Weight = 0.0;
+
+        void AddPlane(double a, double b, double c, double d, double weight)
+        {
+            A2 += a * a * weight; B2 += b * b * weight; C2 += c * c * weight; D2 += d * d * weight;
+            AB += a * b * weight; AC += a * c * weight; AD += a * d * weight;
+            BC += b * c * weight; BD += b * d * weight; CD += c * d * weight;
+            Weight += weight;
+        }
+
+        void Add(const Quadric& other)
+        {
+            A2 += other.A2; B2 += other.B2; C2 += other.C2; D2 += other.D2;
+            AB += other.AB; AC += other.AC; AD += other.AD;
+            BC += other.BC; BD += other.BD; CD += other.CD;
+            Weight += other.Weight;
+        }
+
+        // Mean squared distance of point to the planes
+        double Error(const XMFLOAT3& point) const
+        {
+            double x = point.x, y = point.y, z = point.z;
+            double sum = A2 * x * x + B2 * y * y + C2 * z * z + D2
+                       + 2.0 * (AB * x * y + AC * x * z + BC * y * z)
+                       + 2.0 * (AD * x + BD * y + CD * z);
+            return Weight > 0.0 ? std::fabs(sum) / Weight : 0.0;
+        }
+    };
+
+    struct Collapse
+    {
+        uint32_t From;
+        uint32_t To;
+        float Cost;
+    };
+
+    XMFLOAT3 TriangleNormal(const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2)
+    {
+        float ux = p1.x - p0.x, uy = p1.y - p0.y, uz = p1.z - p0.z;
+        float vx = p2.x - p0.x, vy = p2.y - p0.y, vz = p2.z - p0.z;
+        return XMFLOAT3(uy * vz - uz * vy, uz * vx - ux * vz, ux * vy - uy * vx);
+    }
+
+    float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    // Collapse state kept across Reduce calls, so successive LODs continue from the previous level
+    // while the quadrics still measure distance to the original surface
+    class Simplification
+    {
+    public:
+
+        Simplification(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) : Vertices(vertices), Indices(indices)
+        {
+            uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+
+            // Vertices split for normals or UVs share a position, every wedge maps to the first vertex at that position
+            std::vector<uint32_t> order(vertexCount);
+            for (uint32_t i = 0; i < vertexCount; i++)
+                order[i] = i;
+            std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b)
+            {
+                const XMFLOAT3& pa = Vertices[a].Position;
+                const XMFLOAT3& pb = Vertices[b].Position;
+                if (pa.x != pb.x) return pa.x < pb.x;
+                if (pa.y != pb.y) return pa.y < pb.y;
+                if (pa.z != pb.z) return pa.z < pb.z;
+                return a < b;
+            });
+
+            Canonical.resize(vertexCount);
+            Locked.assign(vertexCount, 0);
+            for (uint32_t i = 0; i < vertexCount; )
+            {
+                const XMFLOAT3& position = Vertices[order[i]].Position;
+                uint32_t end = i + 1;
+                while (end < vertexCount && Vertices[order[end]].Position.x == position.x &&
+                       Vertices[order[end]].Position.y == position.y && Vertices[order[end]].Position.z == position.z)
+                    end++;
+
+                for (uint32_t k = i; k < end; k++)
+                    Canonical[order[k]] = order[i];
+
+                // Attribute seam, moving one wedge without the others would tear the mesh
+                if (end - i > 1)
+                    Locked[order[i]] = 1;
+                i = end;
+            }
+
+            // Edges used by one triangle are borders and edges used by more than two are non-manifold, both stay put
+            std::vector<uint64_t> edges;
+            edges.reserve(indices.size());
+            for (size_t t = 0; t < indices.size(); t += 3)
+            {
+                for (uint32_t k = 0; k < 3; k++)
+                {
+                    uint32_t a = Canonical[indices[t + k]];
+                    uint32_t b = Canonical[indices[t + (k + 1) % 3]];
+                    if (a != b)
+                        edges.push_back(a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a);
+                }
+            }
+            std::sort(edges.begin(), edges.end());
+            for (size_t i = 0; i < edges.size(); )
+            {
+                size_t end = i + 1;
+                while (end < edges.size() && edges[end] == edges[i])
+                    end++;
+
+                if (end - i != 2)
+                {
+                    Locked[static_cast<uint32_t>(edges[i] >> 32)] = 1;
+                    Locked[static_cast<uint32_t>(edges[i] & 0xFFFFFFFF)] = 1;
+                }
+                i = end;
+            }
+
+            Quadrics.resize(vertexCount);
+            for (size_t t = 0; t < indices.size(); t += 3)
+            {
+                const XMFLOAT3& p0 = Vertices[indices[t]].Position;
+                XMFLOAT3 normal = TriangleNormal(p0, Vertices[indices[t + 1]].Position, Vertices[indices[t + 2]].Position);
+                float length = std::sqrt(Dot(normal, normal));
+                if (length <= 0.0f)
+                    continue;
+
+                double a = normal.x / length, b = normal.y / length, c = normal.z / length;
+                double d = -(a * p0.x + b * p0.y + c * p0.z);
+                double area = length * 0.5;
+                for (uint32_t k = 0; k < 3; k++)
+                    Quadrics[Canonical[indices[t + k]]].AddPlane(a, b, c, d, area);
+            }
+        }
+
+        // Returns the largest error of any collapse so far
+        float Reduce(uint32_t targetIndexCount, float targetError)
+        {
+            uint32_t vertexCount = static_cast<uint32_t>(Vertices.size());
+            double targetErrorSquared = static_cast<double>(targetError) * targetError;
+            uint32_t targetTriangles = targetIndexCount / 3;
+
+            std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+            std::vector<uint32_t> adjacency;
+            std::vector<Collapse> collapses;
+            std::vector<uint32_t> collapseTarget(vertexCount, UINT32_MAX);
+            std::vector<uint8_t> touched(vertexCount);
+
+            // Each pass collapses the cheapest independent edges, a vertex takes part in at most one collapse per pass
+            while (Indices.size() / 3 > targetTriangles)
+            {
+                uint32_t triangleCount = static_cast<uint32_t>(Indices.size() / 3);
+
+                std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+                for (uint32_t index : Indices)
+                    adjacencyOffsets[index + 1]++;
+                for (uint32_t i = 0; i < vertexCount; i++)
+                    adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+                adjacency.resize(Indices.size());
+                std::vector<uint32_t> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+                for (uint32_t t = 0; t < triangleCount; t++)
+                    for (uint32_t k = 0; k < 3; k++)
+                        adjacency[cursor[Indices[t * 3 + k]]++] = t;
+
+                collapses.clear();
+                for (uint32_t t = 0; t < triangleCount; t++)
+                {
+                    for (uint32_t k = 0; k < 3; k++)
+                    {
+                        uint32_t a = Indices[t * 3 + k];
+                        uint32_t b = Indices[t * 3 + (k + 1) % 3];
+                        uint32_t canonicalA = Canonical[a];
+                        uint32_t canonicalB = Canonical[b];
+                        if (canonicalA == canonicalB)
+                            continue;
+
+                        Quadric merged = Quadrics[canonicalA];
+                        merged.Add(Quadrics[canonicalB]);
+                        if (!Locked[canonicalA])
+                            collapses.push_back(Collapse { a, b, static_cast<float>(merged.Error(Vertices[b].Position)) });
+                        if (!Locked[canonicalB])
+                            collapses.push_back(Collapse { b, a, static_cast<float>(merged.Error(Vertices[a].Position)) });
+                    }
+                }
+
+                std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.Cost < b.Cost; });
+
+                std::fill(touched.begin(), touched.end(), 0);
+                uint32_t remainingTriangles = triangleCount;
+                bool collapsed = false;
+                for (const Collapse& collapse : collapses)
+                {
+                    if (collapse.Cost > targetErrorSquared || remainingTriangles <= targetTriangles)
+                        break;
+
+                    // Unlocked vertices have a single wedge, so From is its own canonical vertex
+                    uint32_t from = collapse.From;
+                    uint32_t to = Canonical[collapse.To];
+                    if (touched[from] || touched[to])
+                        continue;
+
+                    // Reject collapses that flip or sliver a triangle that survives them
+                    const XMFLOAT3& target = Vertices[collapse.To].Position;
+                    uint32_t removed = 0;
+                    bool valid = true;
+                    for (uint32_t n = adjacencyOffsets[from]; n < adjacencyOffsets[from + 1] && valid; n++)
+                    {
+                        const uint32_t* triangle = &Indices[adjacency[n] * 3];
+                        if (Canonical[triangle[0]] == to || Canonical[triangle[1]] == to || Canonical[triangle[2]] == to)
+                        {
+                            removed++;
+                            continue;
+                        }
+
+                        XMFLOAT3 before[3] = { Vertices[triangle[0]].Position, Vertices[triangle[1]].Position, Vertices[triangle[2]].Position };
+                        XMFLOAT3 after[3] = { before[0], before[1], before[2] };
+                        for (uint32_t k = 0; k < 3; k++)
+                            if (triangle[k] == from)
+                                after[k] = target;
+
+                        XMFLOAT3 normalBefore = TriangleNormal(before[0], before[1], before[2]);
+                        XMFLOAT3 normalAfter = TriangleNormal(after[0], after[1], after[2]);
+                        valid = Dot(normalBefore, normalAfter) >= 0.25f * std::sqrt(Dot(normalBefore, normalBefore) * Dot(normalAfter, normalAfter));
+                    }
+
+                    if (!valid)
+                        continue;
+
+                    for (uint32_t n = adjacencyOffsets[from]; n < adjacencyOffsets[from + 1]; n++)
+                        for (uint32_t k = 0; k < 3; k++)
+                            touched[Canonical[Indices[adjacency[n] * 3 + k]]] = 1;
+
+                    collapseTarget[from] = collapse.To;
+                    Quadrics[to].Add(Quadrics[from]);
+                    ReachedErrorSquared = std::max(ReachedErrorSquared, static_cast<double>(collapse.Cost));
+                    remainingTriangles -= removed;
+                    collapsed = true;
+                }
+
+                if (!collapsed)
+                    break;
+
+                size_t write = 0;
+                for (size_t t = 0; t < Indices.size(); t += 3)
+                {
+                    uint32_t triangle[3];
+                    for (uint32_t k = 0; k < 3; k++)
+                    {
+                        uint32_t index = Indices[t + k];
+                        triangle[k] = collapseTarget[index] != UINT32_MAX ? collapseTarget[index] : index;
+                    }
+
+                    if (Canonical[triangle[0]] == Canonical[triangle[1]] || Canonical[triangle[1]] == Canonical[triangle[2]] ||
+                        Canonical[triangle[0]] == Canonical[triangle[2]])
+                        continue;
+
+                    Indices[write++] = triangle[0];
+                    Indices[write++] = triangle[1];
+                    Indices[write++] = triangle[2];
+                }
+                Indices.resize(write);
+
+                for (uint32_t i = 0; i < vertexCount; i++)
+                    collapseTarget[i] = UINT32_MAX;
+            }
+
+            return static_cast<float>(std::sqrt(ReachedErrorSquared));
+        }
+
+        const std::vector<uint32_t>& GetIndices() const { return Indices; }
+
+    private:
+
+        const std::vector<Vertex>& Vertices;
+        std::vector<uint32_t> Indices;
+        std::vector<uint32_t> Canonical;
+        std::vector<uint8_t> Locked;
+        std::vector<Quadric> Quadrics;
+        double ReachedErrorSquared = 0.0;
+    };
+}
+
+float MeshSimplifier::Simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t targetIndexCount,
+                               float targetError, std::vector<uint32_t>& outIndices)
+{
+    if (indices.size() % 3 != 0)
+        throw std::runtime_error("Mesh simplification requires a triangle list.");
+
+    if (indices.size() <= targetIndexCount)
+    {
+        outIndices = indices;
+        return 0.0f;
+    }
+
+    Simplification simplification(vertices, indices);
+    float error = simplification.Reduce(targetIndexCount, targetError);
+    outIndices = simplification.GetIndices();
+    return error;
+}
+
+void MeshSimplifier::BuildLODChain(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                                   std::vector<uint32_t>& outIndices, std::vector<MeshLOD>& outLODs, Statistics* outStatistics)
+{
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    outIndices = indices;
+    outLODs.clear();
+    outLODs.push_back(MeshLOD { 0, static_cast<uint32_t>(indices.size()), 0.0f });
+
+    if (indices.size() % 3 != 0)
+        throw std::runtime_error("Mesh simplification requires a triangle list.");
+
+    // Each level continues from the previous one, the quadrics still hold the original planes so the error stays absolute
+    Simplification simplification(vertices, indices);
+    std::vector<uint32_t> simplified;
+    uint32_t previousCount = static_cast<uint32_t>(indices.size());
+    for (uint32_t level = 1; level < MaxLODs; level++)
+    {
+        uint32_t targetCount = static_cast<uint32_t>(previousCount / 3 * LevelReduction) * 3;
+        float error = simplification.Reduce(targetCount, FLT_MAX);
+        simplified = simplification.GetIndices();
+        if (simplified.empty() || simplified.size() > previousCount * MinLevelReduction)
+            break;
+
+        MeshOptimizer::OptimizeVertexCache(simplified, static_cast<uint32_t>(vertices.size()));
+
+        outLODs.push_back(MeshLOD { static_cast<uint32_t>(outIndices.size()), static_cast<uint32_t>(simplified.size()), error });
+        outIndices.insert(outIndices.end(), simplified.begin(), simplified.end());
+        previousCount = static_cast<uint32_t>(simplified.size());
+    }
+
+    if (outStatistics)
+    {
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+        outStatistics->LevelCount = static_cast<uint32_t>(outLODs.size());
+        outStatistics->SourceTriangles = static_cast<uint32_t>(indices.size() / 3);
+        outStatistics->CoarsestTriangles = outLODs.back().IndexCount / 3;
+        outStatistics->Milliseconds = elapsed.count();
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "../RHIStructures.h"
+
+// One level of detail inside a mesh's index buffer. Error is the object space deviation from the full resolution surface.
+struct MeshLOD
+{
+    uint32_t FirstIndex = 0;
+    uint32_t IndexCount = 0;
+    float Error = 0.0f;
+};
+
+// Quadric error metric edge collapse. Vertices only ever collapse onto existing vertices, so every level keeps
+// indexing the original vertex buffer and only the index buffer grows. Border and attribute seam vertices are
+// locked so simplified levels do not open holes or tear UVs.
+class MeshSimplifier
+{
+public:
+
+    struct Statistics
+    {
+        uint32_t LevelCount = 0;
+        uint32_t SourceTriangles = 0;
+        uint32_t CoarsestTriangles = 0;
+        double Milliseconds = 0.0;
+    };
+
+    static constexpr uint32_t MaxLODs = 5;
+
+    // Simplifies towards targetIndexCount without exceeding targetError (object space units). Returns the error reached.
+    static float Simplify(const std::vector<RHIStructures::Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t targetIndexCount,
+                          float targetError, std::vector<uint32_t>& outIndices);
+
+    // Appends levels to outIndices, each roughly half the triangles of the previous, starting with indices itself as LOD 0.
+    // Stops early when a level can no longer be reduced meaningfully.
+    static void BuildLODChain(const std::vector<RHIStructures::Vertex>& vertices, const std::vector<uint32_t>& indices,
+                              std::vector<uint32_t>& outIndices, std::vector<MeshLOD>& outLODs, Statistics* outStatistics = nullptr);
+
+private:
+
+    // Minimum reduction for a level to be kept, smaller steps cost index memory without saving vertex work
+    static constexpr float MinLevelReduction = 0.8f;
+    static constexpr float LevelReduction = 0.5f;
+};
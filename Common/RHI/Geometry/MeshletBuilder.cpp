@@ -0,0 +1,145 @@
+#include "MeshletBuilder.h"
+
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <DirectXCollision.h>
+
+using namespace DirectX;
+using namespace RHIStructures;
+
+namespace
+{
+    // Below this the normals spread past ~84 degrees and the cone would almost never reject anything
+    const float MinConeDot = 0.1f;
+    const uint32_t UnassignedVertex = UINT32_MAX;
+}
+
+void MeshletBuilder::Build(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, MeshletData& outData,
+                           Statistics* outStatistics)
+{
+    if (indices.size() % 3 != 0)
+        throw std::runtime_error("Meshlet building requires a triangle list.");
+
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    outData.Meshlets.clear();
+    outData.VertexIndices.clear();
+    outData.Triangles.clear();
+
+    uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    outData.Meshlets.reserve(triangleCount / MaxTriangles + 1);
+    outData.VertexIndices.reserve(indices.size() / 2);
+    outData.Triangles.reserve(triangleCount);
+
+    // Mesh vertex to its slot in the open meshlet, reset through VertexIndices when the meshlet closes
+    std::vector<uint32_t> localIndex(vertices.size(), UnassignedVertex);
+
+    Meshlet current = {};
+    for (uint32_t triangle = 0; triangle < triangleCount; triangle++)
+    {
+        const uint32_t* corners = &indices[triangle * 3];
+
+        uint32_t newVertices = 0;
+        for (uint32_t k = 0; k < 3; k++)
+            if (localIndex[corners[k]] == UnassignedVertex && (k == 0 || corners[k] != corners[0]) && (k < 2 || corners[k] != corners[1]))
+                newVertices++;
+
+        if (current.VertexCount + newVertices > MaxVertices || current.TriangleCount + 1 > MaxTriangles)
+        {
+            ComputeBounds(vertices, outData, current);
+            outData.Meshlets.push_back(current);
+            for (uint32_t i = 0; i < current.VertexCount; i++)
+                localIndex[outData.VertexIndices[current.VertexOffset + i]] = UnassignedVertex;
+
+            current = {};
+            current.VertexOffset = static_cast<uint32_t>(outData.VertexIndices.size());
+            current.TriangleOffset = static_cast<uint32_t>(outData.Triangles.size());
+        }
+
+        uint32_t packed = 0;
+        for (uint32_t k = 0; k < 3; k++)
+        {
+            uint32_t vertex = corners[k];
+            if (localIndex[vertex] == UnassignedVertex)
+            {
+                localIndex[vertex] = current.VertexCount++;
+                outData.VertexIndices.push_back(vertex);
+            }
+            packed |= localIndex[vertex] << (k * 8);
+        }
+        outData.Triangles.push_back(packed);
+        current.TriangleCount++;
+    }
+
+    if (current.TriangleCount > 0)
+    {
+        ComputeBounds(vertices, outData, current);
+        outData.Meshlets.push_back(current);
+    }
+
+    if (outStatistics)
+    {
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+        uint32_t meshletCount = static_cast<uint32_t>(outData.Meshlets.size());
+        outStatistics->MeshletCount = meshletCount;
+        outStatistics->TriangleCount = triangleCount;
+        outStatistics->AverageVertices = meshletCount > 0 ? static_cast<float>(outData.VertexIndices.size()) / meshletCount : 0.0f;
+        outStatistics->AverageTriangles = meshletCount > 0 ? static_cast<float>(triangleCount) / meshletCount : 0.0f;
+        outStatistics->BuildMilliseconds = elapsed.count();
+        outStatistics->TrianglesPerSecond = elapsed.count() > 0.0 ? triangleCount / (elapsed.count() / 1000.0) : 0.0;
+    }
+}
+
+void MeshletBuilder::ComputeBounds(const std::vector<Vertex>& vertices, const MeshletData& data, Meshlet& meshlet)
+{
+    XMFLOAT3 positions[MaxVertices];
+    for (uint32_t i = 0; i < meshlet.VertexCount; i++)
+        positions[i] = vertices[data.VertexIndices[meshlet.VertexOffset + i]].Position;
+
+    BoundingSphere sphere;
+    BoundingSphere::CreateFromPoints(sphere, meshlet.VertexCount, positions, sizeof(XMFLOAT3));
+    meshlet.Sphere = XMFLOAT4(sphere.Center.x, sphere.Center.y, sphere.Center.z, sphere.Radius);
+
+    // Face normals are flipped to agree with the vertex normals so the cone does not depend on the winding convention
+    XMVECTOR faceNormals[MaxTriangles];
+    uint32_t faceCount = 0;
+    XMVECTOR axisSum = XMVectorZero();
+    for (uint32_t t = 0; t < meshlet.TriangleCount; t++)
+    {
+        uint32_t packed = data.Triangles[meshlet.TriangleOffset + t];
+        const Vertex& a = vertices[data.VertexIndices[meshlet.VertexOffset + (packed & 0xFF)]];
+        const Vertex& b = vertices[data.VertexIndices[meshlet.VertexOffset + ((packed >> 8) & 0xFF)]];
+        const Vertex& c = vertices[data.VertexIndices[meshlet.VertexOffset + ((packed >> 16) & 0xFF)]];
+
+        XMVECTOR p0 = XMLoadFloat3(&a.Position);
+        XMVECTOR normal = XMVector3Cross(XMVectorSubtract(XMLoadFloat3(&b.Position), p0), XMVectorSubtract(XMLoadFloat3(&c.Position), p0));
+        float length = XMVectorGetX(XMVector3Length(normal));
+        if (length <= 1e-12f)
+            continue;
+
+        normal = XMVectorScale(normal, 1.0f / length);
+        XMVECTOR vertexNormal = XMVectorAdd(XMVectorAdd(XMLoadFloat3(&a.Normal), XMLoadFloat3(&b.Normal)), XMLoadFloat3(&c.Normal));
+        if (XMVectorGetX(XMVector3Dot(normal, vertexNormal)) < 0.0f)
+            normal = XMVectorNegate(normal);
+
+        faceNormals[faceCount++] = normal;
+        axisSum = XMVectorAdd(axisSum, normal);
+    }
+
+    meshlet.Cone = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+    float axisLength = XMVectorGetX(XMVector3Length(axisSum));
+    if (faceCount == 0 || axisLength <= 1e-6f)
+        return;
+
+    XMVECTOR axis = XMVectorScale(axisSum, 1.0f / axisLength);
+    float minDot = 1.0f;
+    for (uint32_t i = 0; i < faceCount; i++)
+        minDot = std::fmin(minDot, XMVectorGetX(XMVector3Dot(axis, faceNormals[i])));
+
+    XMFLOAT3 axisValue;
+    XMStoreFloat3(&axisValue, axis);
+    // Sine of the spread, the task shader culls when the view direction to the sphere lies inside the cone mirrored through the center
+    float cutoff = minDot <= MinConeDot ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+    meshlet.Cone = XMFLOAT4(axisValue.x, axisValue.y, axisValue.z, cutoff);
+}
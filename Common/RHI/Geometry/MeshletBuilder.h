@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "../RHIStructures.h"
+
+// Matches the std430 layout read by ts_meshlet and ms_meshlet, 48 bytes
+struct Meshlet
+{
+    uint32_t VertexOffset;              // First entry in MeshletData::VertexIndices
+    uint32_t TriangleOffset;            // First entry in MeshletData::Triangles
+    uint32_t VertexCount;
+    uint32_t TriangleCount;
+    DirectX::XMFLOAT4 Sphere;           // Local space center and radius
+    DirectX::XMFLOAT4 Cone;             // Average normal and cutoff, a cutoff of 1 means the meshlet is never cone culled
+};
+
+struct MeshletData
+{
+    std::vector<Meshlet> Meshlets;
+    std::vector<uint32_t> VertexIndices;    // Meshlet local vertex to mesh vertex
+    std::vector<uint32_t> Triangles;        // Three 8 bit meshlet local indices per triangle, low byte first
+};
+
+// Splits a triangle list into meshlets for the mesh shader path, each with a bounding sphere and normal cone for task stage culling.
+// Triangles are taken greedily in their current order, so run it after MeshOptimizer::OptimizeVertexCache to keep neighbours together.
+class MeshletBuilder
+{
+public:
+
+    struct Statistics
+    {
+        uint32_t MeshletCount = 0;
+        uint32_t TriangleCount = 0;
+        float AverageVertices = 0.0f;
+        float AverageTriangles = 0.0f;
+        double BuildMilliseconds = 0.0;
+        double TrianglesPerSecond = 0.0;
+    };
+
+    static constexpr uint32_t MaxVertices = 64;
+    static constexpr uint32_t MaxTriangles = 124;
+
+    static void Build(const std::vector<RHIStructures::Vertex>& vertices, const std::vector<uint32_t>& indices, MeshletData& outData,
+                      Statistics* outStatistics = nullptr);
+
+private:
+
+    static void ComputeBounds(const std::vector<RHIStructures::Vertex>& vertices, const MeshletData& data, Meshlet& meshlet);
+};
@@ -0,0 +1,292 @@
+#include "OcclusionCuller.h"
+#include "../../Data/ThreadPool.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <xmmintrin.h>
+
+using namespace DirectX;
+
+OcclusionCuller::OcclusionCuller(uint32_t width, uint32_t height)
+{
+    Width = std::max(TileSize, (width + TileSize - 1) / TileSize * TileSize);
+    Height = std::max(TileSize, (height + TileSize - 1) / TileSize * TileSize);
+    TilesX = Width / TileSize;
+    TilesY = Height / TileSize;
+
+    BandCount = std::min(TilesY, ThreadPool::GetInstance().GetThreadCount() + 1);
+    TileRowsPerBand = (TilesY + BandCount - 1) / BandCount;
+
+    Depth.assign(Width * Height, 1.0f);
+    TileMaxDepth.assign(TilesX * TilesY, 1.0f);
+    XMStoreFloat4x4(&ViewProjection, XMMatrixIdentity());
+}
+
+void OcclusionCuller::RenderOccluders(const Scene& scene, const XMFLOAT4X4& viewProjection)
+{
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    ThreadPool& threadPool = ThreadPool::GetInstance();
+
+    ViewProjection = viewProjection;
+    XMMATRIX viewProjectionMatrix = XMLoadFloat4x4(&viewProjection);
+
+    const std::vector<OccluderGeometry>& occluders = scene.GetOccluders();
+    const std::vector<uint32_t>& meshNodeIndices = scene.GetMeshNodeIndices();
+    const std::vector<XMFLOAT4X4>& worldTransforms = scene.GetWorldTransforms();
+
+    OccluderTriangles.resize(occluders.size());
+    threadPool.ParallelFor(static_cast<uint32_t>(occluders.size()), [&](uint32_t i)
+    {
+        XMMATRIX world = XMLoadFloat4x4(&worldTransforms[meshNodeIndices[occluders[i].MeshIndex]]);
+        SetupOccluder(occluders[i], world * viewProjectionMatrix, OccluderTriangles[i]);
+    });
+
+    // Bands own disjoint rows of the depth buffer so they rasterize without synchronization
+    threadPool.ParallelFor(BandCount, [this](uint32_t band) { RasterizeBand(band); });
+
+    LastStatistics.OccluderTriangles = 0;
+    for (const std::vector<ScreenTriangle>& triangles : OccluderTriangles)
+        LastStatistics.OccluderTriangles += static_cast<uint32_t>(triangles.size());
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+    LastStatistics.RasterMilliseconds = elapsed.count();
+}
+
+void OcclusionCuller::Cull(const Scene& scene, std::vector<uint32_t>& inOutVisibleMeshes)
+{
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    const std::vector<BoundingBox>& meshBounds = scene.GetMeshBounds();
+    const std::vector<uint32_t>& meshNodeIndices = scene.GetMeshNodeIndices();
+    const std::vector<XMFLOAT4X4>& worldTransforms = scene.GetWorldTransforms();
+    XMMATRIX viewProjectionMatrix = XMLoadFloat4x4(&ViewProjection);
+
+    uint32_t count = static_cast<uint32_t>(inOutVisibleMeshes.size());
+    OccludedFlags.assign(count, 0);
+
+    if (LastStatistics.OccluderTriangles > 0)
+    {
+        uint32_t batchCount = (count + CullBatchSize - 1) / CullBatchSize;
+        ThreadPool::GetInstance().ParallelFor(batchCount, [&](uint32_t batch)
+        {
+            uint32_t end = std::min(count, (batch + 1) * CullBatchSize);
+            for (uint32_t i = batch * CullBatchSize; i < end; i++)
+            {
+                uint32_t meshIndex = inOutVisibleMeshes[i];
+                XMMATRIX worldViewProjection = XMLoadFloat4x4(&worldTransforms[meshNodeIndices[meshIndex]]) * viewProjectionMatrix;
+                OccludedFlags[i] = IsOccluded(meshBounds[meshIndex], worldViewProjection) ? 1 : 0;
+            }
+        });
+    }
+
+    uint32_t visibleCount = 0;
+    for (uint32_t i = 0; i < count; i++)
+        if (!OccludedFlags[i])
+            inOutVisibleMeshes[visibleCount++] = inOutVisibleMeshes[i];
+    inOutVisibleMeshes.resize(visibleCount);
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+    LastStatistics.TestedBounds = count;
+    LastStatistics.OccludedBounds = count - visibleCount;
+    LastStatistics.TestMilliseconds = elapsed.count();
+}
+
+void OcclusionCuller::SetupOccluder(const OccluderGeometry& occluder, const XMMATRIX& worldViewProjection, std::vector<ScreenTriangle>& outTriangles) const
+{
+    outTriangles.clear();
+
+    std::vector<XMFLOAT3> screen(occluder.Positions.size());
+    std::vector<uint8_t> clipped(occluder.Positions.size());
+    for (size_t i = 0; i < occluder.Positions.size(); i++)
+    {
+        XMVECTOR clip = XMVector4Transform(XMVectorSetW(XMLoadFloat3(&occluder.Positions[i]), 1.0f), worldViewProjection);
+        float w = XMVectorGetW(clip);
+
+        // Vertices in front of the near plane would write depth closer than anything real, their triangles are dropped
+        clipped[i] = w < MinClipW || XMVectorGetZ(clip) < 0.0f;
+        if (clipped[i])
+            continue;
+
+        float invW = 1.0f / w;
+        screen[i].x = (XMVectorGetX(clip) * invW * 0.5f + 0.5f) * Width;
+        screen[i].y = (0.5f - XMVectorGetY(clip) * invW * 0.5f) * Height;
+        screen[i].z = XMVectorGetZ(clip) * invW;
+    }
+
+    for (size_t i = 0; i + 2 < occluder.Indices.size(); i += 3)
+    {
+        uint32_t i0 = occluder.Indices[i];
+        uint32_t i1 = occluder.Indices[i + 1];
+        uint32_t i2 = occluder.Indices[i + 2];
+        if (clipped[i0] || clipped[i1] || clipped[i2])
+            continue;
+
+        XMFLOAT3 v[3] = { screen[i0], screen[i1], screen[i2] };
+
+        // Occluders are treated as double sided, flip clockwise triangles so every edge function is positive inside
+        float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+        if (area < 0.0f)
+        {
+            std::swap(v[1], v[2]);
+            area = -area;
+        }
+        if (area < 1e-6f)
+            continue;
+
+        ScreenTriangle triangle;
+        triangle.MinX = std::max(0, static_cast<int32_t>(std::floor(std::min({ v[0].x, v[1].x, v[2].x }))));
+        triangle.MaxX = std::min(static_cast<int32_t>(Width) - 1, static_cast<int32_t>(std::ceil(std::max({ v[0].x, v[1].x, v[2].x }))));
+        triangle.MinY = std::max(0, static_cast<int32_t>(std::floor(std::min({ v[0].y, v[1].y, v[2].y }))));
+        triangle.MaxY = std::min(static_cast<int32_t>(Height) - 1, static_cast<int32_t>(std::ceil(std::max({ v[0].y, v[1].y, v[2].y }))));
+        if (triangle.MinX > triangle.MaxX || triangle.MinY > triangle.MaxY)
+            continue;
+
+        // Edge i is opposite vertex i, so its value is vertex i's barycentric weight scaled by the area
+        for (uint32_t e = 0; e < 3; e++)
+        {
+            const XMFLOAT3& a = v[(e + 1) % 3];
+            const XMFLOAT3& b = v[(e + 2) % 3];
+            triangle.EdgeA[e] = a.y - b.y;
+            triangle.EdgeB[e] = b.x - a.x;
+            triangle.EdgeC[e] = (b.y - a.y) * a.x - (b.x - a.x) * a.y;
+            triangle.Z[e] = v[e].z / area;
+        }
+
+        outTriangles.push_back(triangle);
+    }
+}
+
+void OcclusionCuller::RasterizeBand(uint32_t band)
+{
+    uint32_t firstTileRow = band * TileRowsPerBand;
+    uint32_t lastTileRow = std::min(TilesY, firstTileRow + TileRowsPerBand);
+    if (firstTileRow >= lastTileRow)
+        return;
+
+    int32_t bandMinY = static_cast<int32_t>(firstTileRow * TileSize);
+    int32_t bandMaxY = static_cast<int32_t>(lastTileRow * TileSize) - 1;
+
+    std::fill(Depth.begin() + bandMinY * Width, Depth.begin() + (bandMaxY + 1) * Width, 1.0f);
+
+    for (const std::vector<ScreenTriangle>& triangles : OccluderTriangles)
+        for (const ScreenTriangle& triangle : triangles)
+            if (triangle.MaxY >= bandMinY && triangle.MinY <= bandMaxY)
+                RasterizeTriangle(triangle, bandMinY, bandMaxY);
+
+    for (uint32_t tileY = firstTileRow; tileY < lastTileRow; tileY++)
+        for (uint32_t tileX = 0; tileX < TilesX; tileX++)
+        {
+            __m128 tileMax = _mm_setzero_ps();
+            for (uint32_t y = tileY * TileSize; y < (tileY + 1) * TileSize; y++)
+            {
+                const float* row = &Depth[y * Width + tileX * TileSize];
+                tileMax = _mm_max_ps(tileMax, _mm_max_ps(_mm_loadu_ps(row), _mm_loadu_ps(row + 4)));
+            }
+
+            float lanes[4];
+            _mm_storeu_ps(lanes, tileMax);
+            TileMaxDepth[tileY * TilesX + tileX] = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+        }
+}
+
+void OcclusionCuller::RasterizeTriangle(const ScreenTriangle& triangle, int32_t bandMinY, int32_t bandMaxY)
+{
+    int32_t minY = std::max(triangle.MinY, bandMinY);
+    int32_t maxY = std::min(triangle.MaxY, bandMaxY);
+    int32_t startX = triangle.MinX & ~3;
+
+    const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 edgeA0 = _mm_set1_ps(triangle.EdgeA[0]);
+    const __m128 edgeA1 = _mm_set1_ps(triangle.EdgeA[1]);
+    const __m128 edgeA2 = _mm_set1_ps(triangle.EdgeA[2]);
+    const __m128 z0 = _mm_set1_ps(triangle.Z[0]);
+    const __m128 z1 = _mm_set1_ps(triangle.Z[1]);
+    const __m128 z2 = _mm_set1_ps(triangle.Z[2]);
+
+    for (int32_t y = minY; y <= maxY; y++)
+    {
+        float pixelY = static_cast<float>(y) + 0.5f;
+        __m128 rowEdge0 = _mm_set1_ps(triangle.EdgeB[0] * pixelY + triangle.EdgeC[0]);
+        __m128 rowEdge1 = _mm_set1_ps(triangle.EdgeB[1] * pixelY + triangle.EdgeC[1]);
+        __m128 rowEdge2 = _mm_set1_ps(triangle.EdgeB[2] * pixelY + triangle.EdgeC[2]);
+        float* row = &Depth[y * Width];
+
+        // Width is a multiple of the tile size, so a four pixel step never runs past the row
+        for (int32_t x = startX; x <= triangle.MaxX; x += 4)
+        {
+            __m128 pixelX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+            __m128 edge0 = _mm_add_ps(_mm_mul_ps(edgeA0, pixelX), rowEdge0);
+            __m128 edge1 = _mm_add_ps(_mm_mul_ps(edgeA1, pixelX), rowEdge1);
+            __m128 edge2 = _mm_add_ps(_mm_mul_ps(edgeA2, pixelX), rowEdge2);
+
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edge0, zero), _mm_cmpge_ps(edge1, zero)), _mm_cmpge_ps(edge2, zero));
+            if (_mm_movemask_ps(inside) == 0)
+                continue;
+
+            __m128 depth = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edge0, z0), _mm_mul_ps(edge1, z1)), _mm_mul_ps(edge2, z2));
+            __m128 current = _mm_loadu_ps(row + x);
+            __m128 nearest = _mm_min_ps(current, depth);
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+        }
+    }
+}
+
+bool OcclusionCuller::IsOccluded(const BoundingBox& localBounds, const XMMATRIX& worldViewProjection) const
+{
+    XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+    localBounds.GetCorners(corners);
+
+    float minX = FLT_MAX, minY = FLT_MAX, minZ = FLT_MAX;
+    float maxX = -FLT_MAX, maxY = -FLT_MAX;
+    for (const XMFLOAT3& corner : corners)
+    {
+        XMVECTOR clip = XMVector4Transform(XMVectorSet(corner.x, corner.y, corner.z, 1.0f), worldViewProjection);
+        float w = XMVectorGetW(clip);
+
+        // Boxes reaching the near plane are always considered visible
+        if (w < MinClipW || XMVectorGetZ(clip) < 0.0f)
+            return false;
+
+        float invW = 1.0f / w;
+        float screenX = (XMVectorGetX(clip) * invW * 0.5f + 0.5f) * Width;
+        float screenY = (0.5f - XMVectorGetY(clip) * invW * 0.5f) * Height;
+
+        minX = std::min(minX, screenX);
+        maxX = std::max(maxX, screenX);
+        minY = std::min(minY, screenY);
+        maxY = std::max(maxY, screenY);
+        minZ = std::min(minZ, XMVectorGetZ(clip) * invW);
+    }
+
+    int32_t x0 = std::max(0, static_cast<int32_t>(std::floor(minX)));
+    int32_t x1 = std::min(static_cast<int32_t>(Width) - 1, static_cast<int32_t>(std::floor(maxX)));
+    int32_t y0 = std::max(0, static_cast<int32_t>(std::floor(minY)));
+    int32_t y1 = std::min(static_cast<int32_t>(Height) - 1, static_cast<int32_t>(std::floor(maxY)));
+
+    // Entirely off screen, leave the decision to frustum culling
+    if (x0 > x1 || y0 > y1)
+        return false;
+
+    for (int32_t tileY = y0 / TileSize; tileY <= y1 / static_cast<int32_t>(TileSize); tileY++)
+        for (int32_t tileX = x0 / TileSize; tileX <= x1 / static_cast<int32_t>(TileSize); tileX++)
+        {
+            // Every occluder sample in this tile is nearer than the box, nothing to check per pixel
+            if (TileMaxDepth[tileY * TilesX + tileX] < minZ)
+                continue;
+
+            int32_t pixelX0 = std::max(x0, tileX * static_cast<int32_t>(TileSize));
+            int32_t pixelX1 = std::min(x1, (tileX + 1) * static_cast<int32_t>(TileSize) - 1);
+            int32_t pixelY0 = std::max(y0, tileY * static_cast<int32_t>(TileSize));
+            int32_t pixelY1 = std::min(y1, (tileY + 1) * static_cast<int32_t>(TileSize) - 1);
+
+            for (int32_t y = pixelY0; y <= pixelY1; y++)
+                for (int32_t x = pixelX0; x <= pixelX1; x++)
+                    if (Depth[y * Width + x] >= minZ)
+                        return false;
+        }
+
+    return true;
+}
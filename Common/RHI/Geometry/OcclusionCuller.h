@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+
+#include "Scene.h"
+
+// Software occlusion culling. Designated occluder triangles are rasterized with SSE into a low resolution
+// depth buffer split into horizontal bands, one band per job, then occludee AABBs are tested against
+// per-tile max depth first and individual pixels only where a tile is inconclusive.
+class OcclusionCuller
+{
+public:
+
+    struct Statistics
+    {
+        uint32_t OccluderTriangles = 0;
+        uint32_t TestedBounds = 0;
+        uint32_t OccludedBounds = 0;
+        double RasterMilliseconds = 0.0;
+        double TestMilliseconds = 0.0;
+    };
+
+    OcclusionCuller(uint32_t width = 320, uint32_t height = 192);
+
+    void RenderOccluders(const Scene& scene, const DirectX::XMFLOAT4X4& viewProjection);
+    // Removes meshes hidden behind the rendered occluders, survivors keep their order
+    void Cull(const Scene& scene, std::vector<uint32_t>& inOutVisibleMeshes);
+
+    uint32_t GetWidth() const                           { return Width; }
+    uint32_t GetHeight() const                          { return Height; }
+    const std::vector<float>& GetDepthBuffer() const    { return Depth; }
+    const Statistics& GetStatistics() const             { return LastStatistics; }
+
+private:
+
+    static constexpr uint32_t TileSize = 8;
+    static constexpr uint32_t CullBatchSize = 64;
+    static constexpr float MinClipW = 1e-4f;
+
+    // Edge functions and depth plane in pixel space, Z is pre-divided by twice the triangle area
+    struct ScreenTriangle
+    {
+        float EdgeA[3];
+        float EdgeB[3];
+        float EdgeC[3];
+        float Z[3];
+        int32_t MinX, MaxX, MinY, MaxY;
+    };
+
+    void SetupOccluder(const OccluderGeometry& occluder, const DirectX::XMMATRIX& worldViewProjection, std::vector<ScreenTriangle>& outTriangles) const;
+    void RasterizeBand(uint32_t band);
+    void RasterizeTriangle(const ScreenTriangle& triangle, int32_t bandMinY, int32_t bandMaxY);
+    bool IsOccluded(const DirectX::BoundingBox& localBounds, const DirectX::XMMATRIX& worldViewProjection) const;
+
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t TilesX;
+    uint32_t TilesY;
+    uint32_t BandCount;
+    uint32_t TileRowsPerBand;
+
+    std::vector<float> Depth;
+    std::vector<float> TileMaxDepth;
+    std::vector<std::vector<ScreenTriangle>> OccluderTriangles;
+    std::vector<uint8_t> OccludedFlags;
+
+    DirectX::XMFLOAT4X4 ViewProjection;
+    Statistics LastStatistics;
+};
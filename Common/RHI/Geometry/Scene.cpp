@@ -0,0 +1,160 @@
+#include "Scene.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+using namespace DirectX;
+
+namespace
+{
+    // DirtyFlags value of a node already gathered into its level during UpdateWorldTransforms
+    constexpr uint8_t Gathered = 2;
+}
+
+uint32_t Scene::AddNode(uint32_t parentIndex, const XMMATRIX& localTransform, const std::string& name)
+{
+    uint32_t nodeIndex = GetNodeCount();
+    if (parentIndex != NoParent && parentIndex >= nodeIndex)
+        throw std::runtime_error("Scene node: " + name + " added before its parent.");
+
+    XMFLOAT4X4 local;
+    XMStoreFloat4x4(&local, localTransform);
+
+    LocalTransforms.push_back(local);
+    WorldTransforms.push_back(local);
+    ParentIndices.push_back(parentIndex);
+    NodeMeshRanges.push_back(MeshRange { GetMeshCount(), 0 });
+    NodeNames.push_back(name);
+    DirtyFlags.push_back(1);
+    DirtyNodes.push_back(nodeIndex);
+
+    Depths.push_back(parentIndex == NoParent ? 0 : Depths[parentIndex] + 1);
+    FirstChildren.push_back(InvalidNode);
+    NextSiblings.push_back(parentIndex == NoParent ? InvalidNode : FirstChildren[parentIndex]);
+    if (parentIndex != NoParent)
+        FirstChildren[parentIndex] = nodeIndex;
+
+    return nodeIndex;
+}
+
+void Scene::AddMesh(uint32_t nodeIndex, Mesh&& mesh)
+{
+    if (nodeIndex + 1 != GetNodeCount())
+        throw std::runtime_error("Meshes can only be added to the most recently added node in scene: " + Name + ".");
+
+    NodeMeshRanges[nodeIndex].MeshCount++;
+    MeshNodeIndices.push_back(nodeIndex);
+    MeshBounds.push_back(mesh.GetLocalBounds());
+    MeshSpheres.push_back(mesh.GetLocalSphere());
+    Meshes.push_back(std::move(mesh));
+}
+
+void Scene::ReleaseGeometry()
+{
+    for (Mesh& mesh : Meshes)
+        mesh.ReleaseGeometry();
+}
+
+void Scene::AddOccluder(OccluderGeometry&& occluder)
+{
+    if (occluder.MeshIndex >= GetMeshCount())
+        throw std::out_of_range("Occluder mesh index: " + std::to_string(occluder.MeshIndex) + " is out of range in scene: " + Name + ".");
+
+    if (occluder.Indices.size() % 3 != 0)
+        throw std::runtime_error("Occluder geometry must be a triangle list.");
+
+    Occluders.push_back(std::move(occluder));
+}
+
+void Scene::KeepOccluders(const std::vector<std::string>& nodeNames)
+{
+    std::erase_if(Occluders, [&](const OccluderGeometry& occluder)
+    {
+        return std::find(nodeNames.begin(), nodeNames.end(), NodeNames[MeshNodeIndices[occluder.MeshIndex]]) == nodeNames.end();
+    });
+    Occluders.shrink_to_fit();
+}
+
+bool Scene::IsOccluderNode(const std::vector<std::string>& occluderNodeNames, const std::string& nodeName)
+{
+    return std::find_if(occluderNodeNames.begin(), occluderNodeNames.end(), [&](const std::string& name)
+    {
+        return name == AllNodes || name == nodeName;
+    }) != occluderNodeNames.end();
+}
+
+void Scene::SetLocalTransform(uint32_t nodeIndex, const XMMATRIX& localTransform)
+{
+    if (nodeIndex >= GetNodeCount())
+        throw std::out_of_range("Node index: " + std::to_string(nodeIndex) + " is out of range in scene: " + Name + ".");
+
+    XMStoreFloat4x4(&LocalTransforms[nodeIndex], localTransform);
+    if (!DirtyFlags[nodeIndex])
+        DirtyNodes.push_back(nodeIndex);
+    DirtyFlags[nodeIndex] = 1;
+}
+
+uint32_t Scene::FindNode(const std::string& name) const
+{
+    for (uint32_t i = 0; i < GetNodeCount(); i++)
+        if (NodeNames[i] == name)
+            return i;
+
+    return InvalidNode;
+}
+
+void Scene::UpdateWorldTransforms()
+{
+    ChangedNodes.clear();
+    if (DirtyNodes.empty())
+        return;
+
+    // Walks down from the dirty nodes only, a subtree reached from two dirty ancestors is gathered once
+    for (std::vector<uint32_t>& level : LevelNodes)
+        level.clear();
+    for (uint32_t dirtyNode : DirtyNodes)
+    {
+        WalkStack.push_back(dirtyNode);
+        while (!WalkStack.empty())
+        {
+            uint32_t node = WalkStack.back();
+            WalkStack.pop_back();
+            if (DirtyFlags[node] == Gathered)
+                continue;
+
+            DirtyFlags[node] = Gathered;
+            if (Depths[node] >= LevelNodes.size())
+                LevelNodes.resize(Depths[node] + 1);
+            LevelNodes[Depths[node]].push_back(node);
+            for (uint32_t child = FirstChildren[node]; child != InvalidNode; child = NextSiblings[child])
+                WalkStack.push_back(child);
+        }
+    }
+    DirtyNodes.clear();
+
+    // Every parent is one level up and already final, so a level's matrices are gathered into contiguous arrays
+    // and multiplied in one tight loop
+    for (const std::vector<uint32_t>& level : LevelNodes)
+    {
+        size_t count = level.size();
+        BatchLocals.resize(count);
+        BatchParents.resize(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            uint32_t parentIndex = ParentIndices[level[i]];
+            BatchLocals[i] = XMLoadFloat4x4(&LocalTransforms[level[i]]);
+            BatchParents[i] = parentIndex == NoParent ? XMMatrixIdentity() : XMLoadFloat4x4(&WorldTransforms[parentIndex]);
+        }
+
+        for (size_t i = 0; i < count; i++)
+            BatchLocals[i] = XMMatrixMultiply(BatchLocals[i], BatchParents[i]);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            XMStoreFloat4x4(&WorldTransforms[level[i]], BatchLocals[i]);
+            DirtyFlags[level[i]] = 0;
+        }
+        ChangedNodes.insert(ChangedNodes.end(), level.begin(), level.end());
+    }
+}
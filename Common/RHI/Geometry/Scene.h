@@ -0,0 +1,106 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+
+#include "Mesh.h"
+
+struct MeshRange
+{
+    uint32_t FirstMesh = 0;
+    uint32_t MeshCount = 0;
+};
+
+// CPU side copy of a mesh's triangles, kept only for meshes designated as occluders
+struct OccluderGeometry
+{
+    uint32_t MeshIndex = 0;
+    std::vector<DirectX::XMFLOAT3> Positions;
+    std::vector<uint32_t> Indices;
+};
+
+// Flattened scene hierarchy stored as parallel arrays. Nodes are kept in topological order, a parent
+// always precedes its children. Local transform edits only mark nodes dirty, UpdateWorldTransforms
+// recomputes the dirty nodes and their descendants one depth level at a time.
+class Scene
+{
+public:
+    static constexpr uint32_t NoParent = UINT32_MAX;
+    static constexpr uint32_t InvalidNode = UINT32_MAX;
+    // Occluder name list entry that makes every node an occluder candidate, for scenes whose occluders are picked
+    // once they are loaded
+    static inline const std::string AllNodes = "*";
+
+    Scene() = default;
+    Scene(const std::string& name, uint32_t numMaterials) : Name(name), NumMaterials(numMaterials) {}
+
+    uint32_t AddNode(uint32_t parentIndex, const DirectX::XMMATRIX& localTransform, const std::string& name);
+    // Meshes are appended to the most recently added node so each node's range stays contiguous
+    void AddMesh(uint32_t nodeIndex, Mesh&& mesh);
+    void AddOccluder(OccluderGeometry&& occluder);
+    // Keeps the occluders of the named nodes and frees the CPU triangles of all others
+    void KeepOccluders(const std::vector<std::string>& nodeNames);
+    static bool IsOccluderNode(const std::vector<std::string>& occluderNodeNames, const std::string& nodeName);
+    void SetLocalTransform(uint32_t nodeIndex, const DirectX::XMMATRIX& localTransform);
+    // Returns the geometry of every mesh, for scenes that are dropped
+    void ReleaseGeometry();
+    DirectX::XMMATRIX GetLocalTransform(uint32_t nodeIndex) const          { return DirectX::XMLoadFloat4x4(&LocalTransforms[nodeIndex]); }
+    DirectX::XMMATRIX GetWorldTransform(uint32_t nodeIndex) const          { return DirectX::XMLoadFloat4x4(&WorldTransforms[nodeIndex]); }
+    // Returns InvalidNode when no node has the name
+    uint32_t FindNode(const std::string& name) const;
+
+    void UpdateWorldTransforms();
+    // Nodes whose world transform changed in the last UpdateWorldTransforms, parents before children
+    const std::vector<uint32_t>& GetChangedNodes() const                    { return ChangedNodes; }
+
+    uint32_t GetNodeCount() const                                           { return static_cast<uint32_t>(ParentIndices.size()); }
+    uint32_t GetMeshCount() const                                           { return static_cast<uint32_t>(Meshes.size()); }
+    uint32_t GetNumMaterials() const                                        { return NumMaterials; }
+    const std::string& GetName() const                                      { return Name; }
+
+    const std::vector<DirectX::XMFLOAT4X4>& GetLocalTransforms() const      { return LocalTransforms; }
+    const std::vector<DirectX::XMFLOAT4X4>& GetWorldTransforms() const      { return WorldTransforms; }
+    const std::vector<uint32_t>& GetParentIndices() const                   { return ParentIndices; }
+    const std::vector<MeshRange>& GetNodeMeshRanges() const                 { return NodeMeshRanges; }
+    const std::vector<std::string>& GetNodeNames() const                    { return NodeNames; }
+
+    const std::vector<Mesh>& GetMeshes() const                              { return Meshes; }
+    const std::vector<uint32_t>& GetMeshNodeIndices() const                 { return MeshNodeIndices; }
+    const std::vector<DirectX::BoundingBox>& GetMeshBounds() const          { return MeshBounds; }
+    const std::vector<DirectX::BoundingSphere>& GetMeshSpheres() const      { return MeshSpheres; }
+    const std::vector<OccluderGeometry>& GetOccluders() const               { return Occluders; }
+
+private:
+
+    std::string Name;
+    uint32_t NumMaterials = 0;
+
+    // Per node
+    std::vector<DirectX::XMFLOAT4X4> LocalTransforms;
+    std::vector<DirectX::XMFLOAT4X4> WorldTransforms;
+    std::vector<uint32_t> ParentIndices;
+    std::vector<MeshRange> NodeMeshRanges;
+    std::vector<std::string> NodeNames;
+    std::vector<uint8_t> DirtyFlags;
+    std::vector<uint32_t> Depths;
+    std::vector<uint32_t> FirstChildren;
+    std::vector<uint32_t> NextSiblings;
+
+    std::vector<uint32_t> DirtyNodes;
+    std::vector<uint32_t> ChangedNodes;
+
+    // UpdateWorldTransforms scratch, kept to avoid reallocating every frame
+    std::vector<std::vector<uint32_t>> LevelNodes;
+    std::vector<uint32_t> WalkStack;
+    std::vector<DirectX::XMMATRIX> BatchLocals;
+    std::vector<DirectX::XMMATRIX> BatchParents;
+
+    // Per mesh
+    std::vector<Mesh> Meshes;
+    std::vector<uint32_t> MeshNodeIndices;
+    std::vector<DirectX::BoundingBox> MeshBounds;
+    std::vector<DirectX::BoundingSphere> MeshSpheres;
+    std::vector<OccluderGeometry> Occluders;
+};
@@ -0,0 +1,87 @@
+#include "VertexCompression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <DirectXPackedVector.h>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+using namespace RHIStructures;
+
+void VertexCompression::Compress(const std::vector<Vertex>& vertices, const BoundingBox& bounds,
+                                 std::vector<CompactVertex>& outVertices, XMFLOAT4X4& outDequantize)
+{
+    float scale = std::max({ bounds.Extents.x, bounds.Extents.y, bounds.Extents.z, 1e-6f });
+    float inverseScale = 1.0f / scale;
+
+    XMStoreFloat4x4(&outDequantize, XMMatrixScaling(scale, scale, scale) * XMMatrixTranslation(bounds.Center.x, bounds.Center.y, bounds.Center.z));
+
+    outVertices.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        const Vertex& vertex = vertices[i];
+        CompactVertex& compact = outVertices[i];
+
+        compact.Position[0] = ToSnorm16((vertex.Position.x - bounds.Center.x) * inverseScale);
+        compact.Position[1] = ToSnorm16((vertex.Position.y - bounds.Center.y) * inverseScale);
+        compact.Position[2] = ToSnorm16((vertex.Position.z - bounds.Center.z) * inverseScale);
+
+        // Bitangent is rebuilt as cross(normal, tangent) * sign in the shader
+        XMVECTOR normal = XMLoadFloat3(&vertex.Normal);
+        XMVECTOR tangent = XMLoadFloat3(&vertex.Tangent);
+        float handedness = XMVectorGetX(XMVector3Dot(XMVector3Cross(normal, tangent), XMLoadFloat3(&vertex.Bitangent)));
+        compact.Position[3] = handedness < 0.0f ? -32767 : 32767;
+
+        EncodeOctahedral(vertex.Normal, compact.Normal);
+        EncodeOctahedral(vertex.Tangent, compact.Tangent);
+
+        compact.TexCoord[0] = XMConvertFloatToHalf(vertex.TexCoord.x);
+        compact.TexCoord[1] = XMConvertFloatToHalf(vertex.TexCoord.y);
+    }
+}
+
+void VertexCompression::EncodeOctahedral(const XMFLOAT3& direction, int16_t outEncoded[2])
+{
+    float length = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+    if (length == 0.0f)
+    {
+        outEncoded[0] = 0;
+        outEncoded[1] = 0;
+        return;
+    }
+
+    float x = direction.x / length;
+    float y = direction.y / length;
+
+    // Fold the lower hemisphere over the diagonals
+    if (direction.z < 0.0f)
+    {
+        float foldedX = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float foldedY = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+
+    outEncoded[0] = ToSnorm16(x);
+    outEncoded[1] = ToSnorm16(y);
+}
+
+XMFLOAT3 VertexCompression::DecodeOctahedral(const int16_t encoded[2])
+{
+    float x = std::max(encoded[0] / 32767.0f, -1.0f);
+    float y = std::max(encoded[1] / 32767.0f, -1.0f);
+    float z = 1.0f - std::abs(x) - std::abs(y);
+
+    float t = std::max(-z, 0.0f);
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+
+    XMFLOAT3 direction;
+    XMStoreFloat3(&direction, XMVector3Normalize(XMVectorSet(x, y, z, 0.0f)));
+    return direction;
+}
+
+int16_t VertexCompression::ToSnorm16(float value)
+{
+    return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
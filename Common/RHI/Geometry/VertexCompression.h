@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+
+#include "../RHIStructures.h"
+
+// Packs full vertices into RHIStructures::CompactVertex. Positions are quantized against a cube around
+// the mesh bounds, so dequantizing is a uniform scale and offset that folds into the instance transform
+// without skewing the normal matrix.
+class VertexCompression
+{
+public:
+
+    static void Compress(const std::vector<RHIStructures::Vertex>& vertices, const DirectX::BoundingBox& bounds,
+                         std::vector<RHIStructures::CompactVertex>& outVertices, DirectX::XMFLOAT4X4& outDequantize);
+
+    static void EncodeOctahedral(const DirectX::XMFLOAT3& direction, int16_t outEncoded[2]);
+    static DirectX::XMFLOAT3 DecodeOctahedral(const int16_t encoded[2]);
+
+private:
+
+    static int16_t ToSnorm16(float value);
+};
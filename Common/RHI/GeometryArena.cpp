@@ -0,0 +1,186 @@
+#include "GeometryArena.h"
+
+#include <iterator>
+#include <stdexcept>
+
+#include "BufferAllocator.h"
+#include "Renderer.h"
+
+using namespace RHIStructures;
+
+GeometryArena& GeometryArena::GetInstance()
+{
+    static GeometryArena instance;
+    return instance;
+}
+
+GeometryArena::Allocation GeometryArena::Allocate(BufferType type, const void* data, uint64_t size, uint32_t alignment)
+{
+    if (type != BufferType::Vertex && type != BufferType::Index)
+        throw std::runtime_error("Geometry arena only holds vertex and index data.");
+
+    if (size == 0)
+        return {};
+
+    FreeRetired();
+
+    std::vector<Block>& blocks = GetBlocks(type);
+    Block* target = nullptr;
+    uint64_t offset = 0;
+    for (Block& block : blocks)
+    {
+        if (TryAllocate(block, size, alignment, offset))
+        {
+            target = &block;
+            break;
+        }
+    }
+
+    // Meshes larger than a block get a block of their own
+    if (!target)
+    {
+        uint64_t blockSize = type == BufferType::Index ? IndexBlockSize : VertexBlockSize;
+        target = &AddBlock(type, size > blockSize ? size : blockSize);
+        TryAllocate(*target, size, alignment, offset);
+    }
+
+    if (data)
+        BufferAllocator::GetInstance()->UpdateBuffer(target->BufferID, offset, data, size);
+
+    ArenaStatistics.UsedBytes += size;
+    ArenaStatistics.AllocationCount++;
+    return Allocation { target->BufferID, offset, size };
+}
+
+void GeometryArena::Free(const Allocation& allocation)
+{
+    if (allocation.Size == 0)
+        return;
+
+    if (!FindBlock(allocation.BufferID))
+        throw std::runtime_error("Freed allocation does not belong to the geometry arena.");
+
+    FreeRetired();
+    Retired.push_back({ Renderer::GetFrameNumber(), allocation, false });
+    ArenaStatistics.RetiredBytes += allocation.Size;
+}
+
+void GeometryArena::FreeBuffer(uint64_t bufferID)
+{
+    FreeRetired();
+    Retired.push_back({ Renderer::GetFrameNumber(), Allocation { bufferID, 0, 0 }, true });
+}
+
+GeometryArena::Block* GeometryArena::FindBlock(uint64_t bufferID)
+{
+    for (std::vector<Block>* blocks : { &VertexBlocks, &IndexBlocks })
+        for (Block& block : *blocks)
+            if (block.BufferID == bufferID)
+                return &block;
+    return nullptr;
+}
+
+void GeometryArena::Release(Block& block, const Allocation& allocation)
+{
+    uint64_t offset = allocation.Offset;
+    uint64_t size = allocation.Size;
+
+    auto next = block.FreeRanges.lower_bound(offset);
+    if (next != block.FreeRanges.end() && offset + size == next->first)
+    {
+        size += next->second;
+        next = block.FreeRanges.erase(next);
+    }
+    if (next != block.FreeRanges.begin())
+    {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset)
+        {
+            offset = previous->first;
+            size += previous->second;
+            block.FreeRanges.erase(previous);
+        }
+    }
+    block.FreeRanges[offset] = size;
+}
+
+void GeometryArena::FreeRetired()
+{
+    // Freed during frame F it may have been recorded by F, which is only known complete once frame F + framesInFlight began
+    uint64_t framesInFlight = Renderer::GetFramesInFlight();
+    uint64_t frameNumber = Renderer::GetFrameNumber();
+
+    std::erase_if(Retired, [&](const RetiredAllocation& retired)
+    {
+        if (retired.Frame + framesInFlight >= frameNumber)
+            return false;
+
+        if (retired.OwnsBuffer)
+        {
+            BufferAllocator::GetInstance()->FreeBuffer(retired.Range.BufferID);
+            return true;
+        }
+
+        Release(*FindBlock(retired.Range.BufferID), retired.Range);
+        ArenaStatistics.UsedBytes -= retired.Range.Size;
+        ArenaStatistics.RetiredBytes -= retired.Range.Size;
+        ArenaStatistics.AllocationCount--;
+        return true;
+    });
+}
+
+bool GeometryArena::TryAllocate(Block& block, uint64_t size, uint32_t alignment, uint64_t& outOffset)
+{
+    for (auto iterator = block.FreeRanges.begin(); iterator != block.FreeRanges.end(); ++iterator)
+    {
+        uint64_t rangeStart = iterator->first;
+        uint64_t rangeEnd = rangeStart + iterator->second;
+        uint64_t alignedStart = (rangeStart + alignment - 1) / alignment * alignment;
+        if (alignedStart + size > rangeEnd)
+            continue;
+
+        // Alignment padding stays free in front, the remainder stays free behind
+        block.FreeRanges.erase(iterator);
+        if (alignedStart > rangeStart)
+            block.FreeRanges[rangeStart] = alignedStart - rangeStart;
+        if (alignedStart + size < rangeEnd)
+            block.FreeRanges[alignedStart + size] = rangeEnd - alignedStart - size;
+
+        outOffset = alignedStart;
+        return true;
+    }
+
+    return false;
+}
+
+GeometryArena::Block& GeometryArena::AddBlock(BufferType type, uint64_t capacity)
+{
+    // Device local only, static geometry is written once through UpdateBuffer
+    MemoryAccess memoryAccess{0};
+    memoryAccess.SetGPURead(true);
+
+    BufferDesc blockDesc = {};
+    blockDesc.Size = capacity;
+    blockDesc.Usage = BufferUsage{
+        .TransferSource = false,
+        .TransferDestination = true,
+        .Type = type
+    };
+    blockDesc.Type = type;
+    blockDesc.Access = memoryAccess;
+
+    Block block;
+    block.BufferID = BufferAllocator::GetInstance()->CreateBuffer(blockDesc, false);
+    block.Capacity = capacity;
+    block.FreeRanges[0] = capacity;
+
+    if (type == BufferType::Index)
+        ArenaStatistics.IndexBlocks++;
+    else
+        ArenaStatistics.VertexBlocks++;
+    ArenaStatistics.ReservedBytes += capacity;
+
+    std::vector<Block>& blocks = GetBlocks(type);
+    blocks.push_back(std::move(block));
+    return blocks.back();
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "RHIStructures.h"
+
+// Sub-allocates static mesh vertex and index data out of a few large device local buffers, so meshes share
+// bindings and draws pick their data through vertex offset and first index. Blocks are only ever added.
+// Freed ranges wait until no frame in flight can still read them, then are coalesced and reused first fit.
+class GeometryArena
+{
+public:
+
+    struct Allocation
+    {
+        uint64_t BufferID = 0;
+        uint64_t Offset = 0;
+        uint64_t Size = 0;
+    };
+
+    struct Statistics
+    {
+        uint32_t VertexBlocks = 0;
+        uint32_t IndexBlocks = 0;
+        uint64_t ReservedBytes = 0;
+        uint64_t UsedBytes = 0;
+        uint32_t AllocationCount = 0;
+        // Freed but still waiting on frames in flight, included in UsedBytes
+        uint64_t RetiredBytes = 0;
+    };
+
+    static GeometryArena& GetInstance();
+
+    // Offset is a multiple of alignment, pass the vertex stride or index size so it converts to a vertex offset or first index
+    Allocation Allocate(RHIStructures::BufferType type, const void* data, uint64_t size, uint32_t alignment);
+    void Free(const Allocation& allocation);
+    // Destroys a geometry buffer kept outside the blocks, such as a mesh's meshlets, once no frame in flight reads it
+    void FreeBuffer(uint64_t bufferID);
+
+    const Statistics& GetStatistics() const             { return ArenaStatistics; }
+
+private:
+
+    struct Block
+    {
+        uint64_t BufferID = 0;
+        uint64_t Capacity = 0;
+        // Free ranges by offset, neighbours are merged on free
+        std::map<uint64_t, uint64_t> FreeRanges;
+    };
+
+    struct RetiredAllocation
+    {
+        uint64_t Frame = 0;
+        Allocation Range;
+        // Whole buffers outside the blocks are destroyed instead of returned to a block
+        bool OwnsBuffer = false;
+    };
+
+    GeometryArena() = default;
+
+    std::vector<Block>& GetBlocks(RHIStructures::BufferType type)   { return type == RHIStructures::BufferType::Index ? IndexBlocks : VertexBlocks; }
+    Block* FindBlock(uint64_t bufferID);
+    static bool TryAllocate(Block& block, uint64_t size, uint32_t alignment, uint64_t& outOffset);
+    Block& AddBlock(RHIStructures::BufferType type, uint64_t capacity);
+    static void Release(Block& block, const Allocation& allocation);
+    void FreeRetired();
+
+    std::vector<Block> VertexBlocks;
+    std::vector<Block> IndexBlocks;
+    std::vector<RetiredAllocation> Retired;
+    Statistics ArenaStatistics;
+
+    static constexpr uint64_t VertexBlockSize = 64ull << 20;
+    static constexpr uint64_t IndexBlockSize = 32ull << 20;
+};
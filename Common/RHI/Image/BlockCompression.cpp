@@ -0,0 +1,476 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+using namespace RHIStructures;
+
+namespace
+{
+    // Principal axis of the block in up to four channels, power iteration on the covariance matrix
+    void PrincipalAxis(const float (*texels)[4], uint32_t channels, float outMean[4], float outAxis[4])
+    {
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            outMean[c] = 0.0f;
+            for (uint32_t i = 0; i < 16; i++)
+                outMean[c] += texels[i][c];
+            outMean[c] /= 16.0f;
+        }
+
+        float covariance[4][4] = {};
+        for (uint32_t i = 0; i < 16; i++)
+            for (uint32_t a = 0; a < channels; a++)
+                for (uint32_t b = 0; b < channels; b++)
+                    covariance[a][b] += (texels[i][a] - outMean[a]) * (texels[i][b] - outMean[b]);
+
+        float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        for (uint32_t iteration = 0; iteration < 8; iteration++)
+        {
+            float next[4] = {};
+            float length = 0.0f;
+            for (uint32_t a = 0; a < channels; a++)
+            {
+                for (uint32_t b = 0; b < channels; b++)
+                    next[a] += covariance[a][b] * axis[b];
+                length = std::max(length, std::fabs(next[a]));
+            }
+            if (length < 1e-6f)
+                break;
+            for (uint32_t a = 0; a < channels; a++)
+                axis[a] = next[a] / length;
+        }
+
+        for (uint32_t c = 0; c < 4; c++)
+            outAxis[c] = c < channels ? axis[c] : 0.0f;
+    }
+
+    // Endpoints at the extremes of the texel projections onto the principal axis
+    void AxisEndpoints(const float (*texels)[4], uint32_t channels, float outLow[4], float outHigh[4])
+    {
+        float mean[4], axis[4];
+        PrincipalAxis(texels, channels, mean, axis);
+
+        float minProjection = 0.0f, maxProjection = 0.0f;
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            float projection = 0.0f;
+            for (uint32_t c = 0; c < channels; c++)
+                projection += (texels[i][c] - mean[c]) * axis[c];
+            minProjection = std::min(minProjection, projection);
+            maxProjection = std::max(maxProjection, projection);
+        }
+
+        float axisLength = 0.0f;
+        for (uint32_t c = 0; c < channels; c++)
+            axisLength += axis[c] * axis[c];
+        axisLength = std::max(axisLength, 1e-6f);
+
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            outLow[c] = std::clamp(mean[c] + axis[c] * minProjection / axisLength, 0.0f, 255.0f);
+            outHigh[c] = std::clamp(mean[c] + axis[c] * maxProjection / axisLength, 0.0f, 255.0f);
+        }
+    }
+
+    // Least squares endpoints for fixed interpolation weights in 0..1
+    bool RefineEndpoints(const float (*texels)[4], const float weights[16], float outLow[4], float outHigh[4])
+    {
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        float ax[4] = {}, bx[4] = {};
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            float b = weights[i];
+            float a = 1.0f - b;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                ax[c] += a * texels[i][c];
+                bx[c] += b * texels[i][c];
+            }
+        }
+
+        float determinant = aa * bb - ab * ab;
+        if (std::fabs(determinant) < 1e-6f)
+            return false;
+
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            outLow[c] = std::clamp((ax[c] * bb - bx[c] * ab) / determinant, 0.0f, 255.0f);
+            outHigh[c] = std::clamp((bx[c] * aa - ax[c] * ab) / determinant, 0.0f, 255.0f);
+        }
+        return true;
+    }
+
+    void LoadTexels(const uint8_t block[64], float outTexels[16][4])
+    {
+        for (uint32_t i = 0; i < 16; i++)
+            for (uint32_t c = 0; c < 4; c++)
+                outTexels[i][c] = block[i * 4 + c];
+    }
+
+    uint16_t PackRGB565(const float color[3])
+    {
+        uint32_t r = static_cast<uint32_t>(std::lround(color[0] * 31.0f / 255.0f));
+        uint32_t g = static_cast<uint32_t>(std::lround(color[1] * 63.0f / 255.0f));
+        uint32_t b = static_cast<uint32_t>(std::lround(color[2] * 31.0f / 255.0f));
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    }
+
+    void UnpackRGB565(uint16_t packed, int outColor[3])
+    {
+        int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+        outColor[0] = (r << 3) | (r >> 2);
+        outColor[1] = (g << 2) | (g >> 4);
+        outColor[2] = (b << 3) | (b >> 2);
+    }
+
+    // Palette of a 4 colour BC1 block and the squared error of the best index per texel
+    uint32_t FitBC1(const float (*texels)[4], uint16_t color0, uint16_t color1, uint32_t& outIndices)
+    {
+        int endpoints[2][3];
+        UnpackRGB565(color0, endpoints[0]);
+        UnpackRGB565(color1, endpoints[1]);
+
+        int palette[4][3];
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            palette[0][c] = endpoints[0][c];
+            palette[1][c] = endpoints[1][c];
+            palette[2][c] = (2 * endpoints[0][c] + endpoints[1][c]) / 3;
+            palette[3][c] = (endpoints[0][c] + 2 * endpoints[1][c]) / 3;
+        }
+
+        uint32_t totalError = 0;
+        outIndices = 0;
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            uint32_t bestError = UINT32_MAX, bestIndex = 0;
+            for (uint32_t p = 0; p < 4; p++)
+            {
+                uint32_t error = 0;
+                for (uint32_t c = 0; c < 3; c++)
+                {
+                    int difference = static_cast<int>(texels[i][c]) - palette[p][c];
+                    error += difference * difference;
+                }
+                if (error < bestError)
+                {
+                    bestError = error;
+                    bestIndex = p;
+                }
+            }
+            totalError += bestError;
+            outIndices |= bestIndex << (i * 2);
+        }
+        return totalError;
+    }
+
+    // BC7 mode 6: 7 bit endpoints with a shared low bit per endpoint, 4 bit indices
+    constexpr uint32_t BC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    struct BC7Fit
+    {
+        uint8_t Endpoints[2][4];    // 7 bit values
+        uint8_t PBits[2];
+        uint8_t Indices[16];
+        uint64_t Error;
+    };
+
+    void FitBC7(const float (*texels)[4], const float low[4], const float high[4], BC7Fit& outFit)
+    {
+        outFit.Error = UINT64_MAX;
+        const float* endpoints[2] = { low, high };
+
+        // The shared bit shifts every channel of an endpoint, so each of the four combinations quantizes differently
+        for (uint32_t pbits = 0; pbits < 4; pbits++)
+        {
+            BC7Fit fit;
+            int expanded[2][4];
+            for (uint32_t e = 0; e < 2; e++)
+            {
+                fit.PBits[e] = static_cast<uint8_t>((pbits >> e) & 1);
+                for (uint32_t c = 0; c < 4; c++)
+                {
+                    int quantized = std::clamp(static_cast<int>(std::lround((endpoints[e][c] - fit.PBits[e]) / 2.0f)), 0, 127);
+                    fit.Endpoints[e][c] = static_cast<uint8_t>(quantized);
+                    expanded[e][c] = (quantized << 1) | fit.PBits[e];
+                }
+            }
+
+            int palette[16][4];
+            for (uint32_t p = 0; p < 16; p++)
+                for (uint32_t c = 0; c < 4; c++)
+                    palette[p][c] = ((64 - BC7Weights[p]) * expanded[0][c] + BC7Weights[p] * expanded[1][c] + 32) >> 6;
+
+            fit.Error = 0;
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                uint32_t bestError = UINT32_MAX;
+                for (uint32_t p = 0; p < 16; p++)
+                {
+                    uint32_t error = 0;
+                    for (uint32_t c = 0; c < 4; c++)
+                    {
+                        int difference = static_cast<int>(texels[i][c]) - palette[p][c];
+                        error += difference * difference;
+                    }
+                    if (error < bestError)
+                    {
+                        bestError = error;
+                        fit.Indices[i] = static_cast<uint8_t>(p);
+                    }
+                }
+                fit.Error += bestError;
+            }
+
+            if (fit.Error < outFit.Error)
+                outFit = fit;
+        }
+    }
+
+    struct BitWriter
+    {
+        uint8_t* Data;
+        uint32_t Position = 0;
+
+        void Write(uint32_t value, uint32_t bitCount)
+        {
+            for (uint32_t i = 0; i < bitCount; i++, Position++)
+                if ((value >> i) & 1)
+                    Data[Position >> 3] |= static_cast<uint8_t>(1 << (Position & 7));
+        }
+    };
+}
+
+void BlockCompression::EncodeBC1(const uint8_t block[64], uint8_t outBlock[8])
+{
+    float texels[16][4];
+    LoadTexels(block, texels);
+
+    float low[4], high[4];
+    AxisEndpoints(texels, 3, low, high);
+
+    uint16_t color0 = PackRGB565(high);
+    uint16_t color1 = PackRGB565(low);
+    uint32_t indices = 0;
+    uint32_t error = FitBC1(texels, color0, color1, indices);
+
+    // One least squares pass from the first index assignment usually recovers most of the 565 quantization loss
+    static constexpr float PaletteWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+    float weights[16];
+    for (uint32_t i = 0; i < 16; i++)
+        weights[i] = PaletteWeights[(indices >> (i * 2)) & 3];
+    float refinedLow[4], refinedHigh[4];
+    if (RefineEndpoints(texels, weights, refinedLow, refinedHigh))
+    {
+        uint32_t refinedIndices = 0;
+        uint16_t refined0 = PackRGB565(refinedLow);
+        uint16_t refined1 = PackRGB565(refinedHigh);
+        uint32_t refinedError = FitBC1(texels, refined0, refined1, refinedIndices);
+        if (refinedError < error)
+        {
+            color0 = refined0;
+            color1 = refined1;
+            indices = refinedIndices;
+        }
+    }
+
+    // color0 > color1 selects the 4 colour mode, swapping the endpoints maps indices 0<->1 and 2<->3
+    if (color0 < color1)
+    {
+        std::swap(color0, color1);
+        indices ^= 0x55555555;
+    }
+    else if (color0 == color1)
+        indices = 0;
+
+    outBlock[0] = static_cast<uint8_t>(color0);
+    outBlock[1] = static_cast<uint8_t>(color0 >> 8);
+    outBlock[2] = static_cast<uint8_t>(color1);
+    outBlock[3] = static_cast<uint8_t>(color1 >> 8);
+    memcpy(&outBlock[4], &indices, 4);
+}
+
+void BlockCompression::EncodeBC4(const uint8_t block[64], uint32_t channel, uint8_t outBlock[8])
+{
+    uint8_t minimum = 255, maximum = 0;
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        minimum = std::min(minimum, block[i * 4 + channel]);
+        maximum = std::max(maximum, block[i * 4 + channel]);
+    }
+
+    // 8 value mode (red0 > red1), indices 0 and 1 are the endpoints and 2..7 step from red0 towards red1
+    int palette[8] = { maximum, minimum };
+    for (int i = 2; i < 8; i++)
+        palette[i] = ((8 - i) * maximum + (i - 1) * minimum) / 7;
+
+    uint64_t indices = 0;
+    if (maximum != minimum)
+    {
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            int value = block[i * 4 + channel];
+            uint32_t bestIndex = 0;
+            int bestError = INT32_MAX;
+            for (uint32_t p = 0; p < 8; p++)
+            {
+                int error = std::abs(value - palette[p]);
+                if (error < bestError)
+                {
+                    bestError = error;
+                    bestIndex = p;
+                }
+            }
+            indices |= static_cast<uint64_t>(bestIndex) << (i * 3);
+        }
+    }
+
+    outBlock[0] = maximum;
+    outBlock[1] = minimum;
+    for (uint32_t i = 0; i < 6; i++)
+        outBlock[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+}
+
+void BlockCompression::EncodeBC5(const uint8_t block[64], uint8_t outBlock[16])
+{
+    EncodeBC4(block, 0, outBlock);
+    EncodeBC4(block, 1, outBlock + 8);
+}
+
+void BlockCompression::EncodeBC7(const uint8_t block[64], uint8_t outBlock[16])
+{
+    float texels[16][4];
+    LoadTexels(block, texels);
+
+    float low[4], high[4];
+    AxisEndpoints(texels, 4, low, high);
+
+    BC7Fit best;
+    FitBC7(texels, low, high, best);
+
+    float weights[16];
+    for (uint32_t i = 0; i < 16; i++)
+        weights[i] = BC7Weights[best.Indices[i]] / 64.0f;
+    if (best.Error > 0 && RefineEndpoints(texels, weights, low, high))
+    {
+        BC7Fit refined;
+        FitBC7(texels, low, high, refined);
+        if (refined.Error < best.Error)
+            best = refined;
+    }
+
+    // The anchor texel stores its index without the high bit, swapping the endpoints inverts every index
+    if (best.Indices[0] & 8)
+    {
+        for (uint32_t c = 0; c < 4; c++)
+            std::swap(best.Endpoints[0][c], best.Endpoints[1][c]);
+        std::swap(best.PBits[0], best.PBits[1]);
+        for (uint32_t i = 0; i < 16; i++)
+            best.Indices[i] = static_cast<uint8_t>(15 - best.Indices[i]);
+    }
+
+    memset(outBlock, 0, 16);
+    BitWriter writer { outBlock };
+    writer.Write(1 << 6, 7);
+    for (uint32_t c = 0; c < 4; c++)
+    {
+        writer.Write(best.Endpoints[0][c], 7);
+        writer.Write(best.Endpoints[1][c], 7);
+    }
+    writer.Write(best.PBits[0], 1);
+    writer.Write(best.PBits[1], 1);
+    for (uint32_t i = 0; i < 16; i++)
+        writer.Write(best.Indices[i], i == 0 ? 3 : 4);
+}
+
+void BlockCompression::Compress(const uint8_t* rgba, uint32_t width, uint32_t height, Format format, std::vector<uint8_t>& outBlocks)
+{
+    uint32_t blocksWide = (width + 3) / 4;
+    uint32_t blocksHigh = (height + 3) / 4;
+    uint32_t blockSize = BlockSize(format);
+    outBlocks.resize(static_cast<size_t>(blocksWide) * blocksHigh * blockSize);
+
+    uint8_t block[64];
+    for (uint32_t by = 0; by < blocksHigh; by++)
+    {
+        for (uint32_t bx = 0; bx < blocksWide; bx++)
+        {
+            for (uint32_t y = 0; y < 4; y++)
+            {
+                uint32_t sourceY = std::min(by * 4 + y, height - 1);
+                for (uint32_t x = 0; x < 4; x++)
+                {
+                    uint32_t sourceX = std::min(bx * 4 + x, width - 1);
+                    memcpy(&block[(y * 4 + x) * 4], &rgba[(static_cast<size_t>(sourceY) * width + sourceX) * 4], 4);
+                }
+            }
+
+            uint8_t* output = &outBlocks[(static_cast<size_t>(by) * blocksWide + bx) * blockSize];
+            switch (format)
+            {
+            case Format::BC1_UNORM:
+                EncodeBC1(block, output);
+                break;
+            case Format::BC4_UNORM:
+                EncodeBC4(block, 0, output);
+                break;
+            case Format::BC5_UNORM:
+                EncodeBC5(block, output);
+                break;
+            case Format::BC7_UNORM:
+                EncodeBC7(block, output);
+                break;
+            default:
+                throw std::runtime_error("BlockCompression::Compress has no encoder for the requested format.");
+            }
+        }
+    }
+}
+
+bool BlockCompression::IsBlockCompressed(Format format)
+{
+    switch (format)
+    {
+    case Format::BC1_UNORM:
+    case Format::BC2_UNORM:
+    case Format::BC3_UNORM:
+    case Format::BC4_UNORM:
+    case Format::BC5_UNORM:
+    case Format::BC6H_UF16:
+    case Format::BC7_UNORM:
+        return true;
+    default:
+        return false;
+    }
+}
+
+uint32_t BlockCompression::BlockSize(Format format)
+{
+    switch (format)
+    {
+    case Format::BC1_UNORM:
+    case Format::BC4_UNORM:
+        return 8;
+    case Format::BC2_UNORM:
+    case Format::BC3_UNORM:
+    case Format::BC5_UNORM:
+    case Format::BC6H_UF16:
+    case Format::BC7_UNORM:
+        return 16;
+    default:
+        return static_cast<uint32_t>(FormatSize(format));
+    }
+}
+
+uint64_t BlockCompression::LevelSize(Format format, uint32_t width, uint32_t height)
+{
+    if (IsBlockCompressed(format))
+        return static_cast<uint64_t>((width + 3) / 4) * ((height + 3) / 4) * BlockSize(format);
+    return static_cast<uint64_t>(width) * height * BlockSize(format);
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "../RHIStructures.h"
+
+// CPU block encoders for the cooked texture formats. Every block is 4x4 texels, blocks on the right and bottom
+// edges of sizes that are not a multiple of 4 repeat their last row and column.
+class BlockCompression
+{
+public:
+
+    // Compresses one RGBA8 level into BC1, BC4 (red), BC5 (red, green) or BC7
+    static void Compress(const uint8_t* rgba, uint32_t width, uint32_t height, RHIStructures::Format format, std::vector<uint8_t>& outBlocks);
+
+    // 4 colour BC1, alpha is dropped
+    static void EncodeBC1(const uint8_t block[64], uint8_t outBlock[8]);
+    // One channel of the block, channel 0..3
+    static void EncodeBC4(const uint8_t block[64], uint32_t channel, uint8_t outBlock[8]);
+    static void EncodeBC5(const uint8_t block[64], uint8_t outBlock[16]);
+    // Mode 6 only: one RGBA subset with 4 bit indices, the best single mode for smooth albedo and mask content
+    static void EncodeBC7(const uint8_t block[64], uint8_t outBlock[16]);
+
+    static bool IsBlockCompressed(RHIStructures::Format format);
+    // Bytes per 4x4 block, or per texel for uncompressed formats
+    static uint32_t BlockSize(RHIStructures::Format format);
+    static uint64_t LevelSize(RHIStructures::Format format, uint32_t width, uint32_t height);
+};
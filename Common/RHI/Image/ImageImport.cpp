@@ -1,112 +1,196 @@
 ﻿#define STB_IMAGE_IMPLEMENTATION
 #include "ImageImport.h"
 #include "stb_image.h"
+#include "PixelKernels.h"
+#include <cstdlib>
+#include <cstring>
 #include <stdexcept>
+#include "../../Data/AssetIO.h"
+#include "../../Data/ThreadPool.h"
 
-ImageImport::ImageImport(const std::string& fileName, bool is16Bit, bool forceNotEmpty)
+ImageImport::ImageImport(const std::string& fileName, bool is16Bit, bool forceNotEmpty, bool deferConversion)
 {
-    if (is16Bit)
-        Data = LoadImage_16Bit(fileName, forceNotEmpty);
-    else
-        Data = LoadImage_8Bit(fileName, forceNotEmpty);
+    if (!deferConversion)
+    {
+        Data = is16Bit ? LoadImage_16Bit(fileName, forceNotEmpty) : LoadImage_8Bit(fileName, forceNotEmpty);
+        return;
+    }
+    
+    Data = Decode(fileName, is16Bit, forceNotEmpty);
+    if (Data && Data->Channels == 3)
+    {
+        DecodedPixels.push_back(Data->Pixels);
+        Data->Pixels = nullptr;
+        Data->Channels = 4;
+        Data->TotalSize = Data->TotalSize / 3 * 4;
+        ExpandOnWrite = true;
+    }
 }
 
-ImageImport::ImageImport(const std::vector<std::string>& fileNames, std::vector<std::vector<uint8_t>> imagecChannelDefaults)
+ImageImport::ImageImport(const std::vector<std::string>& fileNames, std::vector<std::vector<uint8_t>> imagecChannelDefaults, bool deferConversion)
 {
     // Load image data
-    Data = LoadImageSideBySide(fileNames, imagecChannelDefaults);
+    if (!deferConversion)
+    {
+        Data = LoadImageSideBySide(fileNames, imagecChannelDefaults);
+        return;
+    }
+    
+    try
+    {
+        Data = PlanSideBySide(fileNames, imagecChannelDefaults, DecodedPixels, ChannelSources);
+    }
+    catch (...)
+    {
+        for (void* pixels : DecodedPixels)
+            stbi_image_free(pixels);
+        throw;
+    }
 }
 
 ImageImport::~ImageImport()
 {
+    for (void* pixels : DecodedPixels)
+        stbi_image_free(pixels);
+    
+    if (!Data)
+        return;
     if (Data->Pixels)
-    {
-        if (Data->Is16Bit)
-            stbi_image_free(Data->Pixels);
-        else
-            stbi_image_free(Data->Pixels);
-    }
+        stbi_image_free(Data->Pixels);
     delete Data;
 }
 
-ImageData* ImageImport::LoadImage_8Bit(const std::string& imagePath, bool forceNotEmpty) {
-    ImageData* result = new ImageData{};
-    int width, height, channels;
-    uint8_t bytesPerChannel = 1;
-
-    std::string path = imagePath + ".png";
+void ImageImport::WritePixels(uint8_t* destination, uint64_t rowPitch) const
+{
+    const size_t bytesPerChannel = Data->Is16Bit ? 2 : 1;
+    const size_t rowSize = static_cast<size_t>(Data->Width) * Data->Channels * bytesPerChannel;
     
-    result->Pixels = stbi_load(path.c_str(), &width, &height, &channels, 0);
+    // Tight destination rows take the whole image in one pass, padded ones go row by row
+    const bool tight = rowPitch == rowSize;
+    const uint32_t passes = tight ? 1 : Data->Height;
+    const size_t passPixels = tight ? static_cast<size_t>(Data->Width) * Data->Height : Data->Width;
     
-    if (!result->Pixels && forceNotEmpty) {
-        throw std::runtime_error("Failed to load image at: " + path);
-    }
-    if (!result->Pixels) return nullptr;
-
-    if (channels == 3)
+    std::vector<PixelKernels::ChannelSource> passSources = ChannelSources;
+    for (uint32_t pass = 0; pass < passes; pass++)
     {
-        stbi_uc* temp = new stbi_uc[width * height * 4];
-        for (int i = 0; i < width * height; i++)
+        uint8_t* output = destination + pass * rowPitch;
+        size_t firstPixel = pass * passPixels;
+        
+        if (Data->Pixels)
+            memcpy(output, static_cast<const uint8_t*>(Data->Pixels) + firstPixel * Data->Channels * bytesPerChannel, passPixels * Data->Channels * bytesPerChannel);
+        else if (ExpandOnWrite && Data->Is16Bit)
+            PixelKernels::ExpandRGBToRGBA16(static_cast<const stbi_us*>(DecodedPixels[0]) + firstPixel * 3, reinterpret_cast<stbi_us*>(output), passPixels, 0);
+        else if (ExpandOnWrite)
+            PixelKernels::ExpandRGBToRGBA8(static_cast<const stbi_uc*>(DecodedPixels[0]) + firstPixel * 3, output, passPixels, 0);
+        else
         {
-            temp[i * 4] = static_cast<stbi_uc*>(result->Pixels)[i * 3];
-            temp[i * 4 + 1] = static_cast<stbi_uc*>(result->Pixels)[i * 3 + 1];
-            temp[i * 4 + 2] = static_cast<stbi_uc*>(result->Pixels)[i * 3 + 2];
-            temp[i * 4 + 3] = 0;
+            for (size_t channel = 0; channel < ChannelSources.size(); channel++)
+                if (ChannelSources[channel].Data)
+                    passSources[channel].Data = ChannelSources[channel].Data + firstPixel * ChannelSources[channel].Stride;
+            PixelKernels::PackChannels8(passSources.data(), Data->Channels, output, passPixels);
         }
-        delete static_cast<stbi_uc*>(result->Pixels);
-        result->Pixels = temp;
-        channels = 4;
     }
-    
-    result->Width = static_cast<uint32_t>(width);
-    result->Height = static_cast<uint32_t>(height);
-    result->Channels = static_cast<uint8_t>(channels);
-    result->TotalSize = static_cast<VkDeviceSize>(result->Width * result->Height * result->Channels * bytesPerChannel);
-    
+}
+
+ImageData* ImageImport::LoadImage_8Bit(const std::string& imagePath, bool forceNotEmpty)
+{
+    ImageData* result = Decode(imagePath, false, forceNotEmpty);
+    if (result && result->Channels == 3)
+        ExpandToRGBA(result);
     return result;
 }
 
-ImageData* ImageImport::LoadImage_16Bit(const std::string& imagePath, bool forceNotEmpty) {
+ImageData* ImageImport::LoadImage_16Bit(const std::string& imagePath, bool forceNotEmpty)
+{
+    ImageData* result = Decode(imagePath, true, forceNotEmpty);
+    if (result && result->Channels == 3)
+        ExpandToRGBA(result);
+    return result;
+}
+
+ImageData* ImageImport::Decode(const std::string& imagePath, bool is16Bit, bool forceNotEmpty)
+{
     ImageData* result = new ImageData{};
     int width, height, channels;
-    uint8_t bytesPerChannel = 2;
+    uint8_t bytesPerChannel = is16Bit ? 2 : 1;
 
     std::string path = imagePath + ".png";
     
-    result->Pixels = stbi_load_16(path.c_str(), &width, &height, &channels, 0);
+    FileBuffer file = AssetIO::GetInstance().ReadFile(path);
+    if (!file.IsEmpty() && is16Bit)
+        result->Pixels = stbi_load_16_from_memory(file.GetData(), static_cast<int>(file.GetSize()), &width, &height, &channels, 0);
+    else if (!file.IsEmpty())
+        result->Pixels = stbi_load_from_memory(file.GetData(), static_cast<int>(file.GetSize()), &width, &height, &channels, 0);
     
-    if (!result->Pixels && forceNotEmpty) {
-        throw std::runtime_error("Failed to load image at: " + path);
-    }
-    if (!result->Pixels) return nullptr;
-
-    if (channels == 3)
+    if (!result->Pixels)
     {
-        stbi_us* temp = new stbi_us[width * height * 4];
-        for (int i = 0; i < width * height; i++)
-        {
-            temp[i * 4] = static_cast<stbi_us*>(result->Pixels)[i * 3];
-            temp[i * 4 + 1] = static_cast<stbi_us*>(result->Pixels)[i * 3 + 1];
-            temp[i * 4 + 2] = static_cast<stbi_us*>(result->Pixels)[i * 3 + 2];
-            temp[i * 4 + 3] = 0;
-        }
-        delete static_cast<stbi_us*>(result->Pixels);
-        result->Pixels = temp;
-        channels = 4;
+        delete result;
+        if (forceNotEmpty)
+            throw std::runtime_error("Failed to load image at: " + path);
+        return nullptr;
     }
     
+    result->Is16Bit = is16Bit;
     result->Width = static_cast<uint32_t>(width);
     result->Height = static_cast<uint32_t>(height);
     result->Channels = static_cast<uint8_t>(channels);
-    result->TotalSize = static_cast<VkDeviceSize>(result->Width * result->Height * result->Channels * bytesPerChannel);
+    result->TotalSize = static_cast<VkDeviceSize>(result->Width) * result->Height * result->Channels * bytesPerChannel;
     
     return result;
 }
 
-ImageData* ImageImport::LoadImageSideBySide(const std::vector<std::string>& fileNames, std::vector<std::vector<uint8_t>> imagecChannelDefaults)
+void ImageImport::ExpandToRGBA(ImageData* data)
 {
-    ImageData* result = new ImageData{};
+    // Pixels are always released with stbi_image_free, so padded copies come from malloc like stb's own buffers
+    size_t pixelCount = static_cast<size_t>(data->Width) * data->Height;
+    if (data->Is16Bit)
+    {
+        stbi_us* temp = static_cast<stbi_us*>(malloc(pixelCount * 4 * sizeof(stbi_us)));
+        PixelKernels::ExpandRGBToRGBA16(static_cast<const stbi_us*>(data->Pixels), temp, pixelCount, 0);
+        stbi_image_free(data->Pixels);
+        data->Pixels = temp;
+    }
+    else
+    {
+        stbi_uc* temp = static_cast<stbi_uc*>(malloc(pixelCount * 4));
+        PixelKernels::ExpandRGBToRGBA8(static_cast<const stbi_uc*>(data->Pixels), temp, pixelCount, 0);
+        stbi_image_free(data->Pixels);
+        data->Pixels = temp;
+    }
     
+    data->Channels = 4;
+    data->TotalSize = data->TotalSize / 3 * 4;
+}
+
+ImageData* ImageImport::LoadImageSideBySide(const std::vector<std::string>& fileNames, std::vector<std::vector<uint8_t>> imagecChannelDefaults)
+{
+    std::vector<void*> decoded;
+    std::vector<PixelKernels::ChannelSource> channelSources;
+    ImageData* result = nullptr;
+    try
+    {
+        result = PlanSideBySide(fileNames, imagecChannelDefaults, decoded, channelSources);
+    }
+    catch (...)
+    {
+        for (void* pixels : decoded)
+            stbi_image_free(pixels);
+        throw;
+    }
+
+    size_t pixelCount = static_cast<size_t>(result->Width) * result->Height;
+    result->Pixels = malloc(pixelCount * result->Channels);
+    PixelKernels::PackChannels8(channelSources.data(), result->Channels, static_cast<stbi_uc*>(result->Pixels), pixelCount);
+
+    for (void* pixels : decoded)
+        stbi_image_free(pixels);
+
+    return result;
+}
+
+ImageData* ImageImport::PlanSideBySide(const std::vector<std::string>& fileNames, const std::vector<std::vector<uint8_t>>& imagecChannelDefaults,
+                                       std::vector<void*>& outDecoded, std::vector<PixelKernels::ChannelSource>& outChannelSources)
+{
     if (fileNames.empty() || fileNames.size() > 4)
         throw std::runtime_error("LoadImageSideBySide requires between 1 and 4 file names.");
 
@@ -114,23 +198,35 @@ ImageData* ImageImport::LoadImageSideBySide(const std::vector<std::string>& file
         throw std::runtime_error("LoadImageSideBySide requires a channel default for each image.");
 
     std::vector<stbi_uc*> loadedFiles(fileNames.size(), nullptr);
-    std::vector<bool> loadedFromStbi(fileNames.size(), false);
     std::vector<uint32_t> channelsPerImage(fileNames.size(), 0);
 
     uint32_t totalChannels = 0;
     int baseWidth = 0, baseHeight = 0;
 
-    for (size_t i = 0; i < fileNames.size(); ++i)
+    // Read every input in one batch, then decode them on the pool, packing starts once all of them have arrived
+    std::vector<std::string> paths;
+    for (const std::string& fileName : fileNames)
+        paths.push_back(fileName + ".png");
+    std::vector<FileBuffer> files = AssetIO::GetInstance().ReadFiles(paths);
+
+    std::vector<int> widths(fileNames.size(), 0), heights(fileNames.size(), 0), channelCounts(fileNames.size(), 0);
+    ThreadPool::GetInstance().ParallelFor(static_cast<uint32_t>(fileNames.size()), [&](uint32_t i)
     {
-        int width = 0, height = 0, channels = 0;
-        std::string path = fileNames[i] + ".png";
+        if (!files[i].IsEmpty())
+            loadedFiles[i] = stbi_load_from_memory(files[i].GetData(), static_cast<int>(files[i].GetSize()), &widths[i], &heights[i], &channelCounts[i], 0);
+    });
+
+    // The caller owns the decoded buffers from here on, also when validation below throws
+    for (stbi_uc* file : loadedFiles)
+        if (file)
+            outDecoded.push_back(file);
 
-        loadedFiles[i] = stbi_load(path.c_str(), &width, &height, &channels, 0);
+    for (size_t i = 0; i < fileNames.size(); ++i)
+    {
+        int width = widths[i], height = heights[i], channels = channelCounts[i];
 
         if (loadedFiles[i])
         {
-            loadedFromStbi[i] = true;
-
             if (baseWidth == 0)
             {
                 baseWidth = width;
@@ -173,61 +269,39 @@ ImageData* ImageImport::LoadImageSideBySide(const std::vector<std::string>& file
     if (totalChannels == 0)
         throw std::runtime_error("Total output channels is 0. Provide defaults for missing images or load at least one channel.");
 
-    if (totalChannels == 3)
-        result->Pixels = new stbi_uc[static_cast<size_t>(baseWidth) * static_cast<size_t>(baseHeight) * static_cast<size_t>(totalChannels + 1)];
-    else
-        result->Pixels = new stbi_uc[static_cast<size_t>(baseWidth) * static_cast<size_t>(baseHeight) * static_cast<size_t>(totalChannels)];
-
-    uint32_t outputStride = (totalChannels == 3) ? 4 : totalChannels;
-    for (int pixelIndex = 0; pixelIndex < baseWidth * baseHeight; ++pixelIndex)
+    // Every output channel is either a channel of a loaded image or its fallback constant
+    outChannelSources.clear();
+    for (size_t imageIndex = 0; imageIndex < loadedFiles.size(); ++imageIndex)
     {
-        uint32_t outputChannel = 0;
-
-        for (size_t imageIndex = 0; imageIndex < loadedFiles.size(); ++imageIndex)
+        const uint32_t nCh = channelsPerImage[imageIndex];
+        for (uint32_t channelIndex = 0; channelIndex < nCh; ++channelIndex)
         {
-            const uint32_t nCh = channelsPerImage[imageIndex];
-            if (nCh == 0)
-                continue;
-
+            PixelKernels::ChannelSource source;
             if (loadedFiles[imageIndex])
             {
-                for (uint32_t channelIndex = 0; channelIndex < nCh; ++channelIndex)
-                {
-                    static_cast<stbi_uc*>(result->Pixels)[pixelIndex * outputStride + outputChannel++] =
-                        loadedFiles[imageIndex][pixelIndex * nCh + channelIndex];
-                }
-            }
-            else
-            {
-                for (uint32_t channelIndex = 0; channelIndex < nCh; ++channelIndex)
-                {
-                    const uint8_t fallback =
-                        (channelIndex < imagecChannelDefaults[imageIndex].size()) ? imagecChannelDefaults[imageIndex][channelIndex] : 0;
-
-                    static_cast<stbi_uc*>(result->Pixels)[pixelIndex * outputStride + outputChannel++] =
-                        static_cast<stbi_uc>(fallback);
-                }
+                source.Data = loadedFiles[imageIndex];
+                source.Stride = nCh;
+                source.Offset = channelIndex;
             }
+            else if (channelIndex < imagecChannelDefaults[imageIndex].size())
+                source.Constant = imagecChannelDefaults[imageIndex][channelIndex];
+            outChannelSources.push_back(source);
         }
-
-        // Add an empty channel for 4 byte alignment
-        if (totalChannels == 3)
-            static_cast<stbi_uc*>(result->Pixels)[pixelIndex * 4 + 3] = 0;
     }
 
-    for (size_t i = 0; i < loadedFiles.size(); ++i)
-    {
-        if (loadedFromStbi[i] && loadedFiles[i])
-            stbi_image_free(loadedFiles[i]);
-    }
-    
+    // Add an empty channel for 4 byte alignment
     if (totalChannels == 3)
+    {
+        outChannelSources.push_back(PixelKernels::ChannelSource {});
         totalChannels = 4;
+    }
 
+    ImageData* result = new ImageData{};
+    result->Pixels = nullptr;
     result->Width = static_cast<uint32_t>(baseWidth);
     result->Height = static_cast<uint32_t>(baseHeight);
     result->Channels = static_cast<uint8_t>(totalChannels);
-    result->TotalSize = static_cast<VkDeviceSize>(result->Width * result->Height * result->Channels);
+    result->TotalSize = static_cast<VkDeviceSize>(result->Width) * result->Height * result->Channels;
 
     return result;
-}
\ No newline at end of file
+}
@@ -2,6 +2,7 @@
 #include <string>
 #include <vector>
 #include "../../Windows/WindowsHeaders.h"
+#include "PixelKernels.h"
 
 
 
@@ -17,16 +18,34 @@ struct ImageData {
 class ImageImport
 {
     ImageData* Data;
+    
+    // Deferred conversion keeps stb's decoded buffers here until WritePixels expands or packs them
+    std::vector<void*> DecodedPixels;
+    std::vector<PixelKernels::ChannelSource> ChannelSources;
+    bool ExpandOnWrite = false;
 
 public:
-    ImageImport(const std::string& fileName, bool is16Bit = false, bool forceNotEmpty = true);
-    ImageImport(const std::vector<std::string>& fileNames, std::vector<std::vector<uint8_t>> imagecChannelDefaults = {{0}, {0}, {0}, {0}});
+    // With deferConversion an image that needs expanding or packing leaves GetData()->Pixels null, WritePixels produces it
+    ImageImport(const std::string& fileName, bool is16Bit = false, bool forceNotEmpty = true, bool deferConversion = false);
+    ImageImport(const std::vector<std::string>& fileNames, std::vector<std::vector<uint8_t>> imagecChannelDefaults = {{0}, {0}, {0}, {0}},
+                bool deferConversion = false);
 
     ~ImageImport();
 
     const ImageData* GetData()       const { return Data; }
     
+    // Writes the converted image to destination with rows rowPitch bytes apart, e.g. straight into an upload staging buffer
+    void WritePixels(uint8_t* destination, uint64_t rowPitch) const;
+    
     static ImageData* LoadImage_8Bit(const std::string& imagePath, bool forceNotEmpty);
     static ImageData* LoadImage_16Bit(const std::string& imagePath, bool forceNotEmpty);
     static ImageData* LoadImageSideBySide(const std::vector<std::string>& fileNames, std::vector<std::vector<uint8_t>> imagecChannelDefaults);
+
+private:
+    // stb output as is, 3 channel images are not expanded
+    static ImageData* Decode(const std::string& imagePath, bool is16Bit, bool forceNotEmpty);
+    static void ExpandToRGBA(ImageData* data);
+    // Decodes every input and describes each output channel, Pixels is left null and outDecoded owns the stb buffers
+    static ImageData* PlanSideBySide(const std::vector<std::string>& fileNames, const std::vector<std::vector<uint8_t>>& imagecChannelDefaults,
+                                     std::vector<void*>& outDecoded, std::vector<PixelKernels::ChannelSource>& outChannelSources);
 };
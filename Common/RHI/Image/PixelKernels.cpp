@@ -0,0 +1,226 @@
+#include "PixelKernels.h"
+
+#include <algorithm>
+#include <immintrin.h>
+#include <intrin.h>
+
+namespace
+{
+    // RGB triplets of one 16 byte register (4 x 8 bit or 2 x 16 bit pixels) to RGBA with a zero alpha byte to OR into
+    const __m128i ExpandMask8 = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i ExpandMask16 = _mm_setr_epi8(0, 1, 2, 3, 4, 5, -1, -1, 6, 7, 8, 9, 10, 11, -1, -1);
+
+    void ExpandRGBScalar8(const uint8_t* rgb, uint8_t* outRGBA, size_t first, size_t last, uint8_t alpha)
+    {
+        for (size_t i = first; i < last; i++)
+        {
+            outRGBA[i * 4 + 0] = rgb[i * 3 + 0];
+            outRGBA[i * 4 + 1] = rgb[i * 3 + 1];
+            outRGBA[i * 4 + 2] = rgb[i * 3 + 2];
+            outRGBA[i * 4 + 3] = alpha;
+        }
+    }
+
+    void ExpandRGBScalar16(const uint16_t* rgb, uint16_t* outRGBA, size_t first, size_t last, uint16_t alpha)
+    {
+        for (size_t i = first; i < last; i++)
+        {
+            outRGBA[i * 4 + 0] = rgb[i * 3 + 0];
+            outRGBA[i * 4 + 1] = rgb[i * 3 + 1];
+            outRGBA[i * 4 + 2] = rgb[i * 3 + 2];
+            outRGBA[i * 4 + 3] = alpha;
+        }
+    }
+
+    // 48 input bytes to 64 output bytes. The four 12 byte groups are realigned from three loads so nothing is read past the input.
+    size_t ExpandSSSE3(const uint8_t* input, uint8_t* output, size_t groupCount, __m128i mask, __m128i alpha)
+    {
+        size_t group = 0;
+        for (; group + 4 <= groupCount; group += 4)
+        {
+            const uint8_t* source = input + group * 12;
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 16));
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 32));
+
+            __m128i* destination = reinterpret_cast<__m128i*>(output + group * 16);
+            _mm_storeu_si128(destination + 0, _mm_or_si128(_mm_shuffle_epi8(a, mask), alpha));
+            _mm_storeu_si128(destination + 1, _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12), mask), alpha));
+            _mm_storeu_si128(destination + 2, _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8), mask), alpha));
+            _mm_storeu_si128(destination + 3, _mm_or_si128(_mm_shuffle_epi8(_mm_srli_si128(c, 4), mask), alpha));
+        }
+        return group;
+    }
+
+    // Each 256 bit register takes two 12 byte groups, one per lane, since the byte shuffle cannot cross lanes.
+    // The last load of an iteration reads 4 bytes past its group, so the loop stops one group short of the end.
+    size_t ExpandAVX2(const uint8_t* input, uint8_t* output, size_t groupCount, __m128i mask, __m128i alpha)
+    {
+        __m256i wideMask = _mm256_broadcastsi128_si256(mask);
+        __m256i wideAlpha = _mm256_broadcastsi128_si256(alpha);
+
+        size_t group = 0;
+        for (; group + 9 <= groupCount; group += 8)
+        {
+            const uint8_t* source = input + group * 12;
+            __m256i* destination = reinterpret_cast<__m256i*>(output + group * 16);
+            for (uint32_t pair = 0; pair < 4; pair++)
+            {
+                const uint8_t* pairSource = source + pair * 24;
+                __m256i groups = _mm256_inserti128_si256(
+                    _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pairSource))),
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(pairSource + 12)), 1);
+                _mm256_storeu_si256(destination + pair, _mm256_or_si256(_mm256_shuffle_epi8(groups, wideMask), wideAlpha));
+            }
+        }
+        return group;
+    }
+
+    void PackScalar8(const PixelKernels::ChannelSource* channels, uint32_t channelCount, uint8_t* output, size_t first, size_t last)
+    {
+        for (uint32_t c = 0; c < channelCount; c++)
+        {
+            const PixelKernels::ChannelSource& channel = channels[c];
+            if (!channel.Data)
+            {
+                for (size_t i = first; i < last; i++)
+                    output[i * channelCount + c] = channel.Constant;
+                continue;
+            }
+
+            const uint8_t* source = channel.Data + channel.Offset;
+            for (size_t i = first; i < last; i++)
+                output[i * channelCount + c] = source[i * channel.Stride];
+        }
+    }
+
+    // Planar channel or its constant broadcast. The pack loops take and return absolute pixel indices.
+    __m128i LoadPlane16(const PixelKernels::ChannelSource& channel, size_t pixel)
+    {
+        if (!channel.Data)
+            return _mm_set1_epi8(static_cast<char>(channel.Constant));
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(channel.Data + channel.Offset + pixel));
+    }
+
+    __m256i LoadPlane32(const PixelKernels::ChannelSource& channel, size_t pixel)
+    {
+        if (!channel.Data)
+            return _mm256_set1_epi8(static_cast<char>(channel.Constant));
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(channel.Data + channel.Offset + pixel));
+    }
+
+    size_t PackPlanarSSE(const PixelKernels::ChannelSource* channels, uint8_t* output, size_t pixel, size_t pixelCount)
+    {
+        for (; pixel + 16 <= pixelCount; pixel += 16)
+        {
+            __m128i r = LoadPlane16(channels[0], pixel), g = LoadPlane16(channels[1], pixel);
+            __m128i b = LoadPlane16(channels[2], pixel), a = LoadPlane16(channels[3], pixel);
+            __m128i rgLow = _mm_unpacklo_epi8(r, g), rgHigh = _mm_unpackhi_epi8(r, g);
+            __m128i baLow = _mm_unpacklo_epi8(b, a), baHigh = _mm_unpackhi_epi8(b, a);
+
+            __m128i* destination = reinterpret_cast<__m128i*>(output + pixel * 4);
+            _mm_storeu_si128(destination + 0, _mm_unpacklo_epi16(rgLow, baLow));
+            _mm_storeu_si128(destination + 1, _mm_unpackhi_epi16(rgLow, baLow));
+            _mm_storeu_si128(destination + 2, _mm_unpacklo_epi16(rgHigh, baHigh));
+            _mm_storeu_si128(destination + 3, _mm_unpackhi_epi16(rgHigh, baHigh));
+        }
+        return pixel;
+    }
+
+    // Unpacks work per 128 bit lane, the final lane permutes put the 32 pixels back in order
+    size_t PackPlanarAVX2(const PixelKernels::ChannelSource* channels, uint8_t* output, size_t pixel, size_t pixelCount)
+    {
+        for (; pixel + 32 <= pixelCount; pixel += 32)
+        {
+            __m256i r = LoadPlane32(channels[0], pixel), g = LoadPlane32(channels[1], pixel);
+            __m256i b = LoadPlane32(channels[2], pixel), a = LoadPlane32(channels[3], pixel);
+            __m256i rgLow = _mm256_unpacklo_epi8(r, g), rgHigh = _mm256_unpackhi_epi8(r, g);
+            __m256i baLow = _mm256_unpacklo_epi8(b, a), baHigh = _mm256_unpackhi_epi8(b, a);
+
+            __m256i quad0 = _mm256_unpacklo_epi16(rgLow, baLow);
+            __m256i quad1 = _mm256_unpackhi_epi16(rgLow, baLow);
+            __m256i quad2 = _mm256_unpacklo_epi16(rgHigh, baHigh);
+            __m256i quad3 = _mm256_unpackhi_epi16(rgHigh, baHigh);
+
+            __m256i* destination = reinterpret_cast<__m256i*>(output + pixel * 4);
+            _mm256_storeu_si256(destination + 0, _mm256_permute2x128_si256(quad0, quad1, 0x20));
+            _mm256_storeu_si256(destination + 1, _mm256_permute2x128_si256(quad2, quad3, 0x20));
+            _mm256_storeu_si256(destination + 2, _mm256_permute2x128_si256(quad0, quad1, 0x31));
+            _mm256_storeu_si256(destination + 3, _mm256_permute2x128_si256(quad2, quad3, 0x31));
+        }
+        return pixel;
+    }
+}
+
+PixelKernels::InstructionSet PixelKernels::ActiveSet = PixelKernels::GetSupportedInstructionSet();
+
+PixelKernels::InstructionSet PixelKernels::GetSupportedInstructionSet()
+{
+    int registers[4];
+    __cpuid(registers, 0);
+    int highestLeaf = registers[0];
+
+    __cpuid(registers, 1);
+    bool ssse3 = (registers[2] & (1 << 9)) != 0;
+    // AVX2 also needs the OS to save the upper halves of the ymm registers
+    bool osSavesYmm = (registers[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+
+    bool avx2 = false;
+    if (highestLeaf >= 7 && osSavesYmm)
+    {
+        __cpuidex(registers, 7, 0);
+        avx2 = (registers[1] & (1 << 5)) != 0;
+    }
+
+    if (avx2)
+        return InstructionSet::AVX2;
+    return ssse3 ? InstructionSet::SSSE3 : InstructionSet::Scalar;
+}
+
+void PixelKernels::SetInstructionSet(InstructionSet instructionSet)
+{
+    ActiveSet = std::min(instructionSet, GetSupportedInstructionSet());
+}
+
+void PixelKernels::ExpandRGBToRGBA8(const uint8_t* rgb, uint8_t* outRGBA, size_t pixelCount, uint8_t alpha)
+{
+    __m128i alphaBits = _mm_set1_epi32(static_cast<int>(static_cast<uint32_t>(alpha) << 24));
+    size_t groupCount = pixelCount / 4;
+    size_t groupsDone = 0;
+    if (ActiveSet == InstructionSet::AVX2)
+        groupsDone = ExpandAVX2(rgb, outRGBA, groupCount, ExpandMask8, alphaBits);
+    if (ActiveSet >= InstructionSet::SSSE3)
+        groupsDone += ExpandSSSE3(rgb + groupsDone * 12, outRGBA + groupsDone * 16, groupCount - groupsDone, ExpandMask8, alphaBits);
+
+    ExpandRGBScalar8(rgb, outRGBA, groupsDone * 4, pixelCount, alpha);
+}
+
+void PixelKernels::ExpandRGBToRGBA16(const uint16_t* rgb, uint16_t* outRGBA, size_t pixelCount, uint16_t alpha)
+{
+    __m128i alphaBits = _mm_set1_epi64x(static_cast<long long>(static_cast<uint64_t>(alpha) << 48));
+    const uint8_t* input = reinterpret_cast<const uint8_t*>(rgb);
+    uint8_t* output = reinterpret_cast<uint8_t*>(outRGBA);
+    size_t groupCount = pixelCount / 2;
+    size_t groupsDone = 0;
+    if (ActiveSet == InstructionSet::AVX2)
+        groupsDone = ExpandAVX2(input, output, groupCount, ExpandMask16, alphaBits);
+    if (ActiveSet >= InstructionSet::SSSE3)
+        groupsDone += ExpandSSSE3(input + groupsDone * 12, output + groupsDone * 16, groupCount - groupsDone, ExpandMask16, alphaBits);
+
+    ExpandRGBScalar16(rgb, outRGBA, groupsDone * 2, pixelCount, alpha);
+}
+
+void PixelKernels::PackChannels8(const ChannelSource* channels, uint32_t channelCount, uint8_t* output, size_t pixelCount)
+{
+    bool planar = channelCount == 4;
+    for (uint32_t c = 0; c < channelCount && planar; c++)
+        planar = !channels[c].Data || channels[c].Stride == 1;
+
+    size_t pixelsDone = 0;
+    if (planar && ActiveSet == InstructionSet::AVX2)
+        pixelsDone = PackPlanarAVX2(channels, output, pixelsDone, pixelCount);
+    if (planar && ActiveSet >= InstructionSet::SSSE3)
+        pixelsDone = PackPlanarSSE(channels, output, pixelsDone, pixelCount);
+
+    PackScalar8(channels, channelCount, output, pixelsDone, pixelCount);
+}
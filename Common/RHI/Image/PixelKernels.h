@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Pixel layout conversions used by ImageImport. Each kernel has SSSE3 and AVX2 paths picked once from cpuid,
+// with a scalar loop for the tail and for CPUs that have neither.
+class PixelKernels
+{
+public:
+
+    enum class InstructionSet : uint8_t { Scalar, SSSE3, AVX2 };
+
+    // One output channel of PackChannels8, Data null writes Constant
+    struct ChannelSource
+    {
+        const uint8_t* Data = nullptr;
+        uint32_t Stride = 1;
+        uint32_t Offset = 0;
+        uint8_t Constant = 0;
+    };
+
+    static InstructionSet GetSupportedInstructionSet();
+    static InstructionSet GetInstructionSet()                   { return ActiveSet; }
+    // Lower the active set to compare paths, requests above what the CPU supports are clamped
+    static void SetInstructionSet(InstructionSet instructionSet);
+
+    static void ExpandRGBToRGBA8(const uint8_t* rgb, uint8_t* outRGBA, size_t pixelCount, uint8_t alpha);
+    static void ExpandRGBToRGBA16(const uint16_t* rgb, uint16_t* outRGBA, size_t pixelCount, uint16_t alpha);
+    // Interleaves channelCount channels per pixel into output, the SIMD paths cover 4 channels from planar or constant inputs
+    static void PackChannels8(const ChannelSource* channels, uint32_t channelCount, uint8_t* output, size_t pixelCount);
+
+private:
+
+    static InstructionSet ActiveSet;
+};
@@ -0,0 +1,284 @@
+#include "TextureCooker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "BlockCompression.h"
+#include "../RHIConstants.h"
+#include "../../Data/AssetIO.h"
+#include "../../Windows/MappedFile.h"
+
+using namespace RHIStructures;
+
+namespace
+{
+    // Formats the cooker writes, DDS stores them by DXGI value
+    constexpr Format CookedFormats[] = { Format::BC1_UNORM, Format::BC4_UNORM, Format::BC5_UNORM, Format::BC7_UNORM, Format::R8G8B8A8_UNORM };
+
+    void HashBytes(uint64_t& hash, const uint8_t* bytes, uint64_t size)
+    {
+        for (uint64_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 0x100000001B3ULL;
+        }
+    }
+}
+
+uint64_t TextureCooker::ComputeKey(const std::vector<std::string>& sourcePaths, Usage usage)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    bool anySource = false;
+    for (const std::string& path : sourcePaths)
+    {
+        // Keyed on the copy the decoder will read, an archived source wins over a loose one
+        uint64_t contentHash = 0;
+        uint8_t present = AssetIO::GetInstance().GetContentHash(path + ".png", contentHash) ? 1 : 0;
+        HashBytes(hash, &present, 1);
+        if (present)
+            HashBytes(hash, reinterpret_cast<const uint8_t*>(&contentHash), sizeof(contentHash));
+        anySource |= present != 0;
+    }
+
+    if (!anySource)
+        return 0;
+
+    uint32_t tail[2] = { static_cast<uint32_t>(usage), Version };
+    HashBytes(hash, reinterpret_cast<const uint8_t*>(tail), sizeof(tail));
+    return hash;
+}
+
+uint32_t TextureCooker::MipCount(uint32_t width, uint32_t height)
+{
+    uint32_t count = 1;
+    while ((width | height) >> count)
+        count++;
+    return count;
+}
+
+Format TextureCooker::SelectFormat(const ImageData& source, Usage usage)
+{
+    switch (usage)
+    {
+    case Usage::Normal:
+        return Format::BC5_UNORM;
+    case Usage::Mask:
+        return source.Channels == 1 ? Format::BC4_UNORM : Format::BC7_UNORM;
+    case Usage::Color:
+    default:
+        break;
+    }
+
+    // 3 channel sources are padded with a constant alpha by ImageImport, only varying alpha needs BC7
+    if (source.Channels != 4 && source.Channels != 2)
+        return Format::BC1_UNORM;
+
+    const uint8_t* pixels = static_cast<const uint8_t*>(source.Pixels);
+    uint64_t texelCount = static_cast<uint64_t>(source.Width) * source.Height;
+    uint32_t alphaChannel = source.Channels - 1;
+    for (uint64_t i = 1; i < texelCount; i++)
+        if (pixels[i * source.Channels + alphaChannel] != pixels[alphaChannel])
+            return Format::BC7_UNORM;
+
+    return Format::BC1_UNORM;
+}
+
+void TextureCooker::ExpandToRGBA(const ImageData& source, std::vector<uint8_t>& outRGBA)
+{
+    const uint8_t* pixels = static_cast<const uint8_t*>(source.Pixels);
+    uint64_t texelCount = static_cast<uint64_t>(source.Width) * source.Height;
+    outRGBA.resize(texelCount * 4);
+
+    if (source.Channels == 4)
+    {
+        memcpy(outRGBA.data(), pixels, outRGBA.size());
+        return;
+    }
+
+    for (uint64_t i = 0; i < texelCount; i++)
+    {
+        uint8_t value = pixels[i * source.Channels];
+        outRGBA[i * 4 + 0] = value;
+        outRGBA[i * 4 + 1] = value;
+        outRGBA[i * 4 + 2] = value;
+        outRGBA[i * 4 + 3] = source.Channels == 2 ? pixels[i * 2 + 1] : 255;
+    }
+}
+
+void TextureCooker::Downsample(const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height, Usage usage, std::vector<uint8_t>& outRGBA)
+{
+    uint32_t nextWidth = std::max(width / 2, 1u);
+    uint32_t nextHeight = std::max(height / 2, 1u);
+    outRGBA.resize(static_cast<size_t>(nextWidth) * nextHeight * 4);
+
+    for (uint32_t y = 0; y < nextHeight; y++)
+    {
+        uint32_t y0 = std::min(y * 2, height - 1);
+        uint32_t y1 = std::min(y * 2 + 1, height - 1);
+        for (uint32_t x = 0; x < nextWidth; x++)
+        {
+            uint32_t x0 = std::min(x * 2, width - 1);
+            uint32_t x1 = std::min(x * 2 + 1, width - 1);
+            const uint8_t* texels[4] = {
+                &rgba[(static_cast<size_t>(y0) * width + x0) * 4], &rgba[(static_cast<size_t>(y0) * width + x1) * 4],
+                &rgba[(static_cast<size_t>(y1) * width + x0) * 4], &rgba[(static_cast<size_t>(y1) * width + x1) * 4] };
+            uint8_t* output = &outRGBA[(static_cast<size_t>(y) * nextWidth + x) * 4];
+
+            if (usage == Usage::Normal)
+            {
+                float normal[3] = {};
+                for (const uint8_t* texel : texels)
+                    for (uint32_t c = 0; c < 3; c++)
+                        normal[c] += texel[c] / 127.5f - 1.0f;
+
+                float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+                if (length < 1e-6f)
+                {
+                    normal[0] = normal[1] = 0.0f;
+                    normal[2] = length = 1.0f;
+                }
+                for (uint32_t c = 0; c < 3; c++)
+                    output[c] = static_cast<uint8_t>(std::clamp(std::lround((normal[c] / length + 1.0f) * 127.5f), 0L, 255L));
+                output[3] = 255;
+                continue;
+            }
+
+            for (uint32_t c = 0; c < 4; c++)
+                output[c] = static_cast<uint8_t>((texels[0][c] + texels[1][c] + texels[2][c] + texels[3][c] + 2) / 4);
+        }
+    }
+}
+
+bool TextureCooker::Cook(const ImageData& source, Usage usage, const std::string& cookedPath, uint64_t key, Statistics* outStatistics)
+{
+    if (key == 0 || source.Is16Bit || !source.Pixels || source.Width == 0 || source.Height == 0 || source.Channels == 3)
+        return false;
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    Format format = SelectFormat(source, usage);
+    uint32_t mipLevels = MipCount(source.Width, source.Height);
+
+    std::vector<uint8_t> level, nextLevel, blocks, levels;
+    ExpandToRGBA(source, level);
+    uint32_t width = source.Width;
+    uint32_t height = source.Height;
+    for (uint32_t mip = 0; mip < mipLevels; mip++)
+    {
+        BlockCompression::Compress(level.data(), width, height, format, blocks);
+        levels.insert(levels.end(), blocks.begin(), blocks.end());
+
+        if (mip + 1 < mipLevels)
+        {
+            Downsample(level, width, height, usage, nextLevel);
+            level.swap(nextLevel);
+            width = std::max(width / 2, 1u);
+            height = std::max(height / 2, 1u);
+        }
+    }
+
+    DDSHeader header = {};
+    header.Size = sizeof(DDSHeader);
+    header.Flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;     // Caps, height, width, pixel format, mip count, linear size
+    header.Height = source.Height;
+    header.Width = source.Width;
+    header.PitchOrLinearSize = static_cast<uint32_t>(BlockCompression::LevelSize(format, source.Width, source.Height));
+    header.MipMapCount = mipLevels;
+    header.Reserved1[0] = CookerTag;
+    header.Reserved1[1] = Version;
+    header.Reserved1[2] = static_cast<uint32_t>(key);
+    header.Reserved1[3] = static_cast<uint32_t>(key >> 32);
+    header.PixelFormat.Size = sizeof(DDSPixelFormat);
+    header.PixelFormat.Flags = 0x4;                                  // FourCC
+    header.PixelFormat.FourCC = DX10FourCC;
+    header.Caps = 0x1000 | 0x400000 | 0x8;                           // Texture, mipmap, complex
+
+    DDSHeaderDX10 headerDX10 = {};
+    headerDX10.DXGIFormat = static_cast<uint32_t>(DXFormat(format));
+    headerDX10.ResourceDimension = 3;                                // Texture2D
+    headerDX10.ArraySize = 1;
+
+    // Sources may live only in an archive, so the loose directory the cooked file goes to may not exist yet
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(cookedPath).parent_path(), error);
+
+    std::string temporaryPath = cookedPath + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file)
+            return false;
+
+        file.write(reinterpret_cast<const char*>(&DDSMagic), sizeof(DDSMagic));
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(&headerDX10), sizeof(headerDX10));
+        file.write(reinterpret_cast<const char*>(levels.data()), levels.size());
+        if (!file)
+            return false;
+    }
+
+    std::filesystem::rename(temporaryPath, cookedPath, error);
+    if (error)
+        return false;
+
+    if (outStatistics)
+    {
+        outStatistics->Format = format;
+        outStatistics->MipLevels = mipLevels;
+        outStatistics->SourceBytes = static_cast<uint64_t>(source.Width) * source.Height * 4;
+        outStatistics->CookedBytes = levels.size();
+        outStatistics->Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+    }
+
+    return true;
+}
+
+bool TextureCooker::Load(const std::string& cookedPath, uint64_t key, MappedFile& outFile, ImageDesc& outDesc)
+{
+    if (key == 0 || !outFile.Open(cookedPath) || outFile.GetSize() < DataOffset)
+        return false;
+
+    const uint8_t* data = outFile.GetData();
+    uint32_t magic;
+    DDSHeader header;
+    DDSHeaderDX10 headerDX10;
+    memcpy(&magic, data, sizeof(magic));
+    memcpy(&header, data + sizeof(magic), sizeof(header));
+    memcpy(&headerDX10, data + sizeof(magic) + sizeof(header), sizeof(headerDX10));
+
+    uint64_t storedKey = header.Reserved1[2] | static_cast<uint64_t>(header.Reserved1[3]) << 32;
+    if (magic != DDSMagic || header.Size != sizeof(DDSHeader) || header.PixelFormat.FourCC != DX10FourCC || header.Reserved1[0] != CookerTag ||
+        header.Reserved1[1] != Version || storedKey != key || headerDX10.ResourceDimension != 3 || headerDX10.ArraySize != 1 ||
+        header.Width == 0 || header.Height == 0 || header.MipMapCount == 0 || header.MipMapCount > MipCount(header.Width, header.Height))
+    {
+        outFile.Close();
+        return false;
+    }
+
+    Format format = Format::Unknown;
+    for (Format cookedFormat : CookedFormats)
+        if (static_cast<uint32_t>(DXFormat(cookedFormat)) == headerDX10.DXGIFormat)
+            format = cookedFormat;
+
+    uint64_t levelsSize = 0;
+    for (uint32_t mip = 0; mip < header.MipMapCount; mip++)
+        levelsSize += BlockCompression::LevelSize(format, std::max(header.Width >> mip, 1u), std::max(header.Height >> mip, 1u));
+
+    if (format == Format::Unknown || outFile.GetSize() - DataOffset < levelsSize)
+    {
+        outFile.Close();
+        return false;
+    }
+
+    outDesc = RHIConstants::DefaultTextureDesc;
+    outDesc.Width = header.Width;
+    outDesc.Height = header.Height;
+    outDesc.MipLevels = header.MipMapCount;
+    outDesc.Format = format;
+    outDesc.Size = levelsSize;
+    outDesc.InitialData = data + DataOffset;
+    return true;
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ImageImport.h"
+#include "../RHIStructures.h"
+
+class MappedFile;
+
+// Turns decoded source images into block compressed textures with a full mip chain, stored as DDS with a DX10
+// header so the file is also readable by standard tools. The level data after the header is exactly the layout
+// CreateImage uploads, so a cooked texture is mapped and handed over without touching the texels.
+class TextureCooker
+{
+public:
+
+    // Color: albedo and emissive, BC1 when alpha is constant and BC7 otherwise.
+    // Normal: BC5, blue is rebuilt in the shader. Mask: BC4 for one channel, BC7 for packed masks like metal-rough-AO.
+    enum class Usage : uint8_t { Color, Normal, Mask };
+
+    struct Statistics
+    {
+        RHIStructures::Format Format = RHIStructures::Format::Unknown;
+        uint32_t MipLevels = 0;
+        uint64_t SourceBytes = 0;
+        uint64_t CookedBytes = 0;
+        double Milliseconds = 0.0;
+    };
+
+    static constexpr uint32_t Version = 1;
+
+    // Hashes the source PNGs (paths without extension, like ImageImport), missing sources hash as absent
+    static uint64_t ComputeKey(const std::vector<std::string>& sourcePaths, Usage usage);
+
+    // Writes through a temporary file, returns false for sources the cooker does not handle (16 bit) or failed writes
+    static bool Cook(const ImageData& source, Usage usage, const std::string& cookedPath, uint64_t key, Statistics* outStatistics = nullptr);
+
+    // Maps a cooked texture and fills outDesc from DefaultTextureDesc. InitialData points into outFile, keep it open until uploaded.
+    static bool Load(const std::string& cookedPath, uint64_t key, MappedFile& outFile, RHIStructures::ImageDesc& outDesc);
+
+    static RHIStructures::Format SelectFormat(const ImageData& source, Usage usage);
+    static uint32_t MipCount(uint32_t width, uint32_t height);
+
+private:
+
+    struct DDSPixelFormat
+    {
+        uint32_t Size;
+        uint32_t Flags;
+        uint32_t FourCC;
+        uint32_t RGBBitCount;
+        uint32_t RBitMask;
+        uint32_t GBitMask;
+        uint32_t BBitMask;
+        uint32_t ABitMask;
+    };
+
+    struct DDSHeader
+    {
+        uint32_t Size;
+        uint32_t Flags;
+        uint32_t Height;
+        uint32_t Width;
+        uint32_t PitchOrLinearSize;
+        uint32_t Depth;
+        uint32_t MipMapCount;
+        uint32_t Reserved1[11];     // [0] cooker tag, [1] Version, [2..3] key
+        DDSPixelFormat PixelFormat;
+        uint32_t Caps;
+        uint32_t Caps2;
+        uint32_t Caps3;
+        uint32_t Caps4;
+        uint32_t Reserved2;
+    };
+
+    struct DDSHeaderDX10
+    {
+        uint32_t DXGIFormat;
+        uint32_t ResourceDimension;
+        uint32_t MiscFlag;
+        uint32_t ArraySize;
+        uint32_t MiscFlags2;
+    };
+
+    static_assert(sizeof(DDSHeader) == 124 && sizeof(DDSHeaderDX10) == 20, "DDS header layout mismatch.");
+
+    static constexpr uint32_t DDSMagic = 0x20534444;        // "DDS "
+    static constexpr uint32_t DX10FourCC = 0x30315844;      // "DX10"
+    static constexpr uint32_t CookerTag = 0x544B4345;       // "ECKT"
+    static constexpr uint64_t DataOffset = sizeof(uint32_t) + sizeof(DDSHeader) + sizeof(DDSHeaderDX10);
+
+    // Expands 8 bit grey, grey-alpha and RGBA sources to RGBA8, ImageImport never hands out 3 channels
+    static void ExpandToRGBA(const ImageData& source, std::vector<uint8_t>& outRGBA);
+    // 2x2 box filter, normals are averaged as vectors and renormalized
+    static void Downsample(const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height, Usage usage, std::vector<uint8_t>& outRGBA);
+};
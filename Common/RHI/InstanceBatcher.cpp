@@ -0,0 +1,75 @@
+#include "InstanceBatcher.h"
+
+using namespace DirectX;
+using namespace RHIStructures;
+
+void InstanceBatcher::Reset()
+{
+    BatchLookup.clear();
+    Pending.clear();
+    Batches.clear();
+    Instances.clear();
+}
+
+void InstanceBatcher::AddScene(const Scene& scene, const std::vector<uint64_t>& perItemDrawSets, const std::vector<uint32_t>* visibleMeshes,
+                               const std::vector<uint8_t>* meshLODs)
+{
+    const std::vector<Mesh>& meshes = scene.GetMeshes();
+    const std::vector<uint32_t>& meshNodeIndices = scene.GetMeshNodeIndices();
+    const std::vector<XMFLOAT4X4>& worldTransforms = scene.GetWorldTransforms();
+
+    size_t addCount = visibleMeshes ? visibleMeshes->size() : meshes.size();
+    for (size_t n = 0; n < addCount; n++)
+    {
+        uint32_t i = visibleMeshes ? (*visibleMeshes)[n] : static_cast<uint32_t>(n);
+        AddInstance(meshes[i], perItemDrawSets[meshes[i].GetLocalMaterialIndex()], worldTransforms[meshNodeIndices[i]], meshLODs ? (*meshLODs)[i] : 0);
+    }
+}
+
+void InstanceBatcher::AddInstance(const Mesh& mesh, uint64_t materialSetID, const XMFLOAT4X4& model, uint32_t lod)
+{
+    // Instances of one mesh at different LODs draw different index ranges and so batch separately
+    uint32_t firstIndex = mesh.GetFirstIndex() + (mesh.GetLODCount() > 0 ? mesh.GetLOD(lod).FirstIndex : 0);
+    BatchKey key { mesh.GetVertexBufferID(), mesh.GetIndexBufferID(), materialSetID, mesh.GetVertexOffset(), firstIndex };
+    auto [iterator, inserted] = BatchLookup.try_emplace(key, static_cast<uint32_t>(Batches.size()));
+
+    if (inserted)
+    {
+        InstanceBatch batch;
+        batch.VertexBufferID = mesh.GetVertexBufferID();
+        batch.IndexBufferID = mesh.GetIndexBufferID();
+        batch.MeshletBufferID = mesh.GetMeshletBufferID();
+        batch.MeshletCount = mesh.GetMeshletCount();
+        batch.MaterialSetID = materialSetID;
+        batch.VertexCount = mesh.GetVertexCount();
+        batch.VertexOffset = mesh.GetVertexOffset();
+        batch.FirstIndex = firstIndex;
+        batch.IndexCount = mesh.GetLODCount() > 0 ? mesh.GetLOD(lod).IndexCount : mesh.GetIndexCount();
+        batch.IndexFormat = mesh.GetIndexFormat();
+        Batches.push_back(batch);
+    }
+
+    Batches[iterator->second].InstanceCount++;
+    Pending.push_back(PendingInstance { iterator->second, mesh.GetInstanceTransform(model) });
+}
+
+void InstanceBatcher::Build()
+{
+    // Counting sort of the pending instances by batch so each batch owns a contiguous instance range
+    uint32_t firstInstance = 0;
+    for (InstanceBatch& batch : Batches)
+    {
+        batch.FirstInstance = firstInstance;
+        firstInstance += batch.InstanceCount;
+    }
+
+    std::vector<uint32_t> writeCursors(Batches.size());
+    for (size_t i = 0; i < Batches.size(); i++)
+        writeCursors[i] = Batches[i].FirstInstance;
+
+    Instances.resize(Pending.size());
+    for (const PendingInstance& pending : Pending)
+        Instances[writeCursors[pending.BatchIndex]++].Model = pending.Model;
+
+    Pending.clear();
+}
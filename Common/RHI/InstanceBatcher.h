@@ -0,0 +1,82 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "RHIStructures.h"
+#include "Geometry/Mesh.h"
+#include "Geometry/Scene.h"
+
+// One instanced draw: every instance shares the same geometry range and material set. Vertex and index buffers are shared
+// arena buffers, VertexOffset and FirstIndex locate the mesh inside them.
+struct InstanceBatch
+{
+    uint64_t VertexBufferID = 0;
+    uint64_t IndexBufferID = 0;
+    uint64_t MeshletBufferID = 0;
+    uint64_t MaterialSetID = 0;
+    uint32_t MeshletCount = 0;
+    uint32_t VertexCount = 0;
+    uint32_t VertexOffset = 0;
+    uint32_t FirstIndex = 0;
+    uint32_t IndexCount = 0;
+    RHIStructures::IndexFormat IndexFormat = RHIStructures::IndexFormat::UInt32;
+    uint32_t FirstInstance = 0;
+    uint32_t InstanceCount = 0;
+};
+
+class InstanceBatcher
+{
+public:
+
+    void Reset();
+    // meshLODs optionally holds a LOD per scene mesh, as written by LODSelector
+    void AddScene(const Scene& scene, const std::vector<uint64_t>& perItemDrawSets, const std::vector<uint32_t>* visibleMeshes = nullptr,
+                  const std::vector<uint8_t>* meshLODs = nullptr);
+    void AddInstance(const Mesh& mesh, uint64_t materialSetID, const DirectX::XMFLOAT4X4& model, uint32_t lod = 0);
+    void Build();
+
+    const std::vector<InstanceBatch>& GetBatches() const                        { return Batches; }
+    const std::vector<RHIStructures::InstanceData>& GetInstances() const        { return Instances; }
+
+private:
+
+    struct BatchKey
+    {
+        uint64_t VertexBufferID;
+        uint64_t IndexBufferID;
+        uint64_t MaterialSetID;
+        uint32_t VertexOffset;
+        uint32_t FirstIndex;
+
+        bool operator==(const BatchKey& other) const
+        {
+            return VertexBufferID == other.VertexBufferID && IndexBufferID == other.IndexBufferID && MaterialSetID == other.MaterialSetID &&
+                   VertexOffset == other.VertexOffset && FirstIndex == other.FirstIndex;
+        }
+    };
+
+    struct BatchKeyHash
+    {
+        size_t operator()(const BatchKey& key) const
+        {
+            uint64_t hash = key.VertexBufferID * 0x9E3779B97F4A7C15ULL;
+            hash ^= key.IndexBufferID + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2);
+            hash ^= key.MaterialSetID + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2);
+            hash ^= (static_cast<uint64_t>(key.VertexOffset) << 32 | key.FirstIndex) + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2);
+            return static_cast<size_t>(hash);
+        }
+    };
+
+    struct PendingInstance
+    {
+        uint32_t BatchIndex;
+        DirectX::XMFLOAT4X4 Model;
+    };
+
+    std::unordered_map<BatchKey, uint32_t, BatchKeyHash> BatchLookup;
+    std::vector<PendingInstance> Pending;
+    std::vector<InstanceBatch> Batches;
+    std::vector<RHIStructures::InstanceData> Instances;
+};
@@ -1,109 +1,163 @@
 #include "Material.h"
 
+#include <exception>
+#include <memory>
+
 #include "BufferAllocator.h"
 #include "RHIConstants.h"
 #include "RHIStructures.h"
+#include "ResidencyManager.h"
 #include "Image/ImageImport.h"
+#include "../GraphicsSettings.h"
+#include "../Data/AssetIO.h"
+#include "../Data/ThreadPool.h"
+#include "../Windows/MappedFile.h"
 
 using namespace RHIStructures;
 using namespace RHIConstants;
 
-PreBufferCache::~PreBufferCache()
-{
-    // TODO handle cleanup/structure better (2 pointers to Data.Pixels)
-    delete ImportHandle;
-    delete Desc;
-}
-
 Material::Material(std::string name, MaterialFormat materialFormat) : Name(name), Format(materialFormat)
 {
-    PreBufferCache* diffuseAlphaCache = nullptr;
-    PreBufferCache* normalCache = nullptr;
-    PreBufferCache* metallnessRoughnessAOCache = nullptr;
-    PreBufferCache* emissiveCache = nullptr;
-    std::vector<std::string> metalRoughAOMaskPaths;
-    
     std::string texturePath = "Textures/" + name;
+    std::vector<std::string> metalRoughAOMaskPaths = { texturePath + "_metal", texturePath + "_rough", texturePath + "_ao" };
+    std::vector<TextureSource> sources;
+    
     switch (materialFormat)
     {
     case PBR:
         
-        diffuseAlphaCache = new PreBufferCache();
-        diffuseAlphaCache->ImportHandle = new ImageImport(texturePath + "_diff");
-        diffuseAlphaCache->Desc = new ImageDesc(DefaultTextureDesc);
-        diffuseAlphaCache->Desc->Width = diffuseAlphaCache->ImportHandle->GetData()->Width;
-        diffuseAlphaCache->Desc->Height = diffuseAlphaCache->ImportHandle->GetData()->Height;
-        diffuseAlphaCache->Desc->Size = diffuseAlphaCache->ImportHandle->GetData()->TotalSize;
-        diffuseAlphaCache->Desc->InitialData = diffuseAlphaCache->ImportHandle->GetData()->Pixels;
-        CachedTextures.push_back(diffuseAlphaCache);
-        
-        normalCache = new PreBufferCache();
-        normalCache->ImportHandle = new ImageImport(texturePath + "_norm");
-        normalCache->Desc = new ImageDesc(DefaultTextureDesc);
-        normalCache->Desc->Width = normalCache->ImportHandle->GetData()->Width;
-        normalCache->Desc->Height = normalCache->ImportHandle->GetData()->Height;
-        normalCache->Desc->Size = normalCache->ImportHandle->GetData()->TotalSize;
-        normalCache->Desc->InitialData = normalCache->ImportHandle->GetData()->Pixels;
-        CachedTextures.push_back(normalCache);
-        
-        metalRoughAOMaskPaths = { texturePath + "_metal", texturePath + "_rough", texturePath + "_ao" };
-        
-        metallnessRoughnessAOCache = new PreBufferCache();
-        metallnessRoughnessAOCache->ImportHandle = new ImageImport(metalRoughAOMaskPaths, DefaultMetalnessRoughnessOcclusion);
-        metallnessRoughnessAOCache->Desc = new ImageDesc(DefaultTextureDesc);
-        metallnessRoughnessAOCache->Desc->Width = metallnessRoughnessAOCache->ImportHandle->GetData()->Width;
-        metallnessRoughnessAOCache->Desc->Height = metallnessRoughnessAOCache->ImportHandle->GetData()->Height;
-        metallnessRoughnessAOCache->Desc->Size = metallnessRoughnessAOCache->ImportHandle->GetData()->TotalSize;
-        metallnessRoughnessAOCache->Desc->InitialData = metallnessRoughnessAOCache->ImportHandle->GetData()->Pixels;
-        CachedTextures.push_back(metallnessRoughnessAOCache);
+        sources.push_back({ { texturePath + "_diff" }, texturePath + "_diff.dds", TextureCooker::Usage::Color });
+        sources.push_back({ { texturePath + "_norm" }, texturePath + "_norm.dds", TextureCooker::Usage::Normal });
+        sources.push_back({ metalRoughAOMaskPaths, texturePath + "_mrao.dds", TextureCooker::Usage::Mask });
 
         break;
         
     case PBREmissive:
         
-        diffuseAlphaCache = new PreBufferCache();
-        diffuseAlphaCache->ImportHandle = new ImageImport(texturePath + "_diff");
-        diffuseAlphaCache->Desc = new ImageDesc(DefaultTextureDesc);
-        diffuseAlphaCache->Desc->Width = diffuseAlphaCache->ImportHandle->GetData()->Width;
-        diffuseAlphaCache->Desc->Height = diffuseAlphaCache->ImportHandle->GetData()->Height;
-        diffuseAlphaCache->Desc->Size = diffuseAlphaCache->ImportHandle->GetData()->TotalSize;
-        diffuseAlphaCache->Desc->InitialData = diffuseAlphaCache->ImportHandle->GetData()->Pixels;
-        CachedTextures.push_back(diffuseAlphaCache);
-        
-        normalCache = new PreBufferCache();
-        normalCache->ImportHandle = new ImageImport(texturePath + "_norm");
-        normalCache->Desc = new ImageDesc(DefaultTextureDesc);
-        normalCache->Desc->Width = normalCache->ImportHandle->GetData()->Width;
-        normalCache->Desc->Height = normalCache->ImportHandle->GetData()->Height;
-        normalCache->Desc->Size = normalCache->ImportHandle->GetData()->TotalSize;
-        normalCache->Desc->InitialData = normalCache->ImportHandle->GetData()->Pixels;
-        CachedTextures.push_back(normalCache);
-        
-        metalRoughAOMaskPaths = { texturePath + "_metal", texturePath + "_rough", texturePath + "_ao" };
-        
-        metallnessRoughnessAOCache = new PreBufferCache();
-        metallnessRoughnessAOCache->ImportHandle = new ImageImport(metalRoughAOMaskPaths, DefaultMetalnessRoughnessOcclusion);
-        metallnessRoughnessAOCache->Desc = new ImageDesc(DefaultTextureDesc);
-        metallnessRoughnessAOCache->Desc->Width = metallnessRoughnessAOCache->ImportHandle->GetData()->Width;
-        metallnessRoughnessAOCache->Desc->Height = metallnessRoughnessAOCache->ImportHandle->GetData()->Height;
-        metallnessRoughnessAOCache->Desc->Size = metallnessRoughnessAOCache->ImportHandle->GetData()->TotalSize;
-        metallnessRoughnessAOCache->Desc->InitialData = metallnessRoughnessAOCache->ImportHandle->GetData()->Pixels;
-        CachedTextures.push_back(metallnessRoughnessAOCache);
-        
-        emissiveCache = new PreBufferCache();
-        emissiveCache->ImportHandle = new ImageImport(texturePath + "_emissive");
-        emissiveCache->Desc = new ImageDesc(DefaultTextureDesc);
-        emissiveCache->Desc->Width = emissiveCache->ImportHandle->GetData()->Width;
-        emissiveCache->Desc->Height = emissiveCache->ImportHandle->GetData()->Height;
-        emissiveCache->Desc->Size = emissiveCache->ImportHandle->GetData()->TotalSize;
-        emissiveCache->Desc->InitialData = emissiveCache->ImportHandle->GetData()->Pixels;
-        CachedTextures.push_back(emissiveCache);
+        sources.push_back({ { texturePath + "_diff" }, texturePath + "_diff.dds", TextureCooker::Usage::Color });
+        sources.push_back({ { texturePath + "_norm" }, texturePath + "_norm.dds", TextureCooker::Usage::Normal });
+        sources.push_back({ metalRoughAOMaskPaths, texturePath + "_mrao.dds", TextureCooker::Usage::Mask });
+        sources.push_back({ { texturePath + "_emissive" }, texturePath + "_emissive.dds", TextureCooker::Usage::Color });
         
         break;
         
     default:
         throw std::runtime_error("Invalid MaterialFormat");       
     }
+    
+    // Masks without any source file are nothing but their default channels, so they collapse into a shared constant
+    for (TextureSource& source : sources)
+    {
+        if (source.Usage != TextureCooker::Usage::Mask)
+            continue;
+        
+        bool anySource = false;
+        for (const std::string& path : source.SourcePaths)
+            anySource |= AssetIO::GetInstance().Exists(path + ".png");
+        if (anySource)
+            continue;
+        
+        source.IsConstant = true;
+        for (size_t channel = 0; channel < DefaultMetalnessRoughnessOcclusion.size(); channel++)
+            source.Constant[channel] = DefaultMetalnessRoughnessOcclusion[channel][0];
+    }
+    
+    // Every texture decodes or maps on its own worker, keys keep the binding order
+    TextureCache& textureCache = TextureCache::GetInstance();
+    TextureKeys.resize(sources.size());
+    std::vector<uint8_t> acquired(sources.size(), 0);
+    std::vector<std::exception_ptr> errors(sources.size());
+    ThreadPool::GetInstance().ParallelFor(static_cast<uint32_t>(sources.size()), [&](uint32_t i)
+    {
+        try
+        {
+            const TextureSource& source = sources[i];
+            TextureKeys[i] = source.IsConstant ? TextureCache::MakeConstantKey(source.Constant) : TextureCache::MakeKey(source.SourcePaths, source.Usage);
+            textureCache.Acquire(TextureKeys[i], [&source]()
+            {
+                return source.IsConstant ? TextureCache::CreateConstant(source.Constant) : LoadTexture(source.SourcePaths, source.CookedPath, source.Usage);
+            });
+            acquired[i] = 1;
+        }
+        catch (...)
+        {
+            errors[i] = std::current_exception();
+        }
+    });
+    
+    for (const std::exception_ptr& error : errors)
+    {
+        if (!error)
+            continue;
+        for (size_t i = 0; i < TextureKeys.size(); i++)
+            if (acquired[i])
+                textureCache.Release(TextureKeys[i]);
+        TextureKeys.clear();
+        std::rethrow_exception(error);
+    }
+}
+
+std::vector<Material> Material::CreateMaterials(const std::vector<std::pair<std::string, MaterialFormat>>& materials)
+{
+    // Materials load side by side, each one fans its textures out again on the same pool
+    std::vector<std::unique_ptr<Material>> loaded(materials.size());
+    std::vector<std::exception_ptr> errors(materials.size());
+    ThreadPool::GetInstance().ParallelFor(static_cast<uint32_t>(materials.size()), [&](uint32_t i)
+    {
+        try
+        {
+            loaded[i] = std::make_unique<Material>(materials[i].first, materials[i].second);
+        }
+        catch (...)
+        {
+            errors[i] = std::current_exception();
+        }
+    });
+    
+    for (const std::exception_ptr& error : errors)
+        if (error)
+            std::rethrow_exception(error);
+    
+    std::vector<Material> outMaterials;
+    outMaterials.reserve(materials.size());
+    for (std::unique_ptr<Material>& material : loaded)
+        outMaterials.push_back(std::move(*material));
+    return outMaterials;
+}
+
+PreBufferCache* Material::LoadTexture(const std::vector<std::string>& sourcePaths, const std::string& cookedPath, TextureCooker::Usage usage)
+{
+    PreBufferCache* cache = new PreBufferCache();
+    cache->CookedFile = new MappedFile();
+    cache->Desc = new ImageDesc(DefaultTextureDesc);
+    
+    // Cooked textures upload straight from the mapped file, missing or stale ones are cooked from the decoded source first
+    const bool cook = GRAPHICS_SETTINGS.CookTextures;
+    uint64_t key = cook ? TextureCooker::ComputeKey(sourcePaths, usage) : 0;
+    if (cook && TextureCooker::Load(cookedPath, key, *cache->CookedFile, *cache->Desc))
+        return cache;
+    
+    // Several sources are the metal-rough-AO channels packed side by side. Without cooking nothing reads the converted
+    // pixels on the CPU, so expansion and packing wait until LoadMaterial hands over the staging memory.
+    if (sourcePaths.size() == 1)
+        cache->ImportHandle = new ImageImport(sourcePaths[0], false, true, !cook);
+    else
+        cache->ImportHandle = new ImageImport(sourcePaths, DefaultMetalnessRoughnessOcclusion, !cook);
+    
+    const ImageData* data = cache->ImportHandle->GetData();
+    if (cook && TextureCooker::Cook(*data, usage, cookedPath, key) && TextureCooker::Load(cookedPath, key, *cache->CookedFile, *cache->Desc))
+    {
+        delete cache->ImportHandle;
+        cache->ImportHandle = nullptr;
+        return cache;
+    }
+    
+    // Uncompressed single mip fallback when the source cannot be cooked or the cooked file cannot be written
+    cache->Desc->Width = data->Width;
+    cache->Desc->Height = data->Height;
+    cache->Desc->Size = data->TotalSize;
+    cache->Desc->InitialData = nullptr;
+    return cache;
 }
 
 uint32_t Material::GetTextureHandle(TextureType textureType)
@@ -147,18 +201,32 @@ uint64_t Material::LoadMaterial(uint32_t pipelineIndex, uint32_t setIndex)
     BufferAllocator* bufferAllocator = BufferAllocator::GetInstance();
     std::vector<DescriptorSetBinding> bindings;
     
-    bindings.reserve(CachedTextures.size());   
-    for (uint32_t i = 0; i < CachedTextures.size(); ++i)
+    // Textures shared with an already loaded material reuse its image
+    bindings.reserve(TextureKeys.size());   
+    for (uint32_t i = 0; i < TextureKeys.size(); ++i)
     {
         bindings.emplace_back(DescriptorSetBinding {
             .Binding = i,
-            .ResourceID = bufferAllocator->CreateImage(*CachedTextures[i]->Desc)
+            .ResourceID = TextureCache::GetInstance().GetImage(TextureKeys[i])
         });
-        
-        delete CachedTextures[i];
     }
-    CachedTextures.clear();
     
-    return bufferAllocator->AllocateDescriptorSet(pipelineIndex, setIndex, bindings);
+    // Streamed textures rebind the set whenever their resident levels change
+    uint64_t setID = bufferAllocator->AllocateDescriptorSet(pipelineIndex, setIndex, bindings);
+    ResidencyManager::GetInstance().TrackDescriptorSet(setID, TextureKeys);
+    DescriptorSets.push_back(setID);
+    return setID;
+}
+
+void Material::UnloadMaterial()
+{
+    // Sets go before the textures they bind, both wait for the frames in flight
+    for (uint64_t setID : DescriptorSets)
+        ResidencyManager::GetInstance().RetireDescriptorSet(setID);
+    DescriptorSets.clear();
+    
+    for (const std::string& key : TextureKeys)
+        TextureCache::GetInstance().Release(key);
+    TextureKeys.clear();
 }
 
@@ -1,26 +1,15 @@
 #pragma once
+#include <array>
 #include <cstdint>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "BufferAllocator.h"
-
-namespace RHIStructures
-{
-    struct ImageDesc;
-}
-
-class ImageImport;
+#include "TextureCache.h"
+#include "Image/TextureCooker.h"
 
 
-struct PreBufferCache
-{
-    ImageImport* ImportHandle;
-    RHIStructures::ImageDesc* Desc;
-    
-    ~PreBufferCache();
-};
-
 class Material
 {
 public:
@@ -43,12 +32,34 @@ private:
     std::string Name;
     MaterialFormat Format;
     std::vector<uint32_t> TextureHandles;
-    std::vector<PreBufferCache*> CachedTextures;
+    // TextureCache keys this material holds a reference to, in binding order
+    std::vector<std::string> TextureKeys;
+    std::vector<uint64_t> DescriptorSets;
+    
+    struct TextureSource
+    {
+        std::vector<std::string> SourcePaths;
+        std::string CookedPath;
+        TextureCooker::Usage Usage;
+        // Set when none of the sources exist, the texture becomes a shared 1x1 image of this colour
+        bool IsConstant = false;
+        std::array<uint8_t, 4> Constant {};
+    };
+    
+    static PreBufferCache* LoadTexture(const std::vector<std::string>& sourcePaths, const std::string& cookedPath, TextureCooker::Usage usage);
     
 public:
     
+    // Decodes or maps every texture of the material in parallel on the ThreadPool, textures already in the TextureCache are shared
     Material(std::string name, MaterialFormat materialFormat);
+    // Loads several materials at once, results keep the order of materials
+    static std::vector<Material> CreateMaterials(const std::vector<std::pair<std::string, MaterialFormat>>& materials);
     uint32_t GetTextureHandle(TextureType textureType);
     uint64_t LoadMaterial(uint32_t pipelineIndex, uint32_t setIndex);
+    // Sets made by LoadMaterial, in the order they were loaded
+    const std::vector<uint64_t>& GetDescriptorSets() const { return DescriptorSets; }
+    // Frees the material's descriptor sets and drops its texture references, images no other material uses are freed.
+    // Both wait for the frames in flight, so this is safe while the material may still be drawn.
+    void UnloadMaterial();
     
 };
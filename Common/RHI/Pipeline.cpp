@@ -29,6 +29,9 @@ D3DPipeline::D3DPipeline(uint32_t pipelineID, const PipelineDesc& desc, std::vec
     ComPtr<ID3D12Device> device = D3DCore::GetInstance().GetDevice();
     Topology = DXPrimitiveTopology(desc.PrimitiveTopology);
     
+    if (desc.MeshShader.ByteCode)
+        throw std::runtime_error("Mesh shading pipelines are only implemented for Vulkan.");
+    
     std::vector<ResourceLayout> resourceLayouts;
     if (desc.UseOwnResourceLayout)
         resourceLayouts.push_back(desc.ResourceLayout);
@@ -348,6 +351,11 @@ D3DPipeline::D3DPipeline(uint32_t pipelineID, const PipelineDesc& desc, std::vec
 
 VulkanPipeline::VulkanPipeline(uint32_t pipelineID, const PipelineDesc& desc, std::vector<IOResource>* inputIOResources)
 {
+    MeshShading = desc.MeshShader.ByteCode != nullptr;
+    
+    if (MeshShading && !VulkanCore::GetInstance().IsMeshShaderSupported())
+        throw std::runtime_error("Mesh shading pipeline requested, but VK_EXT_mesh_shader is not supported by the device.");
+    
     // Cache shader modules for cleanup
     // All shaders will allways be loaded. This is meh, but for my engine probably fine.
     std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
@@ -406,6 +414,28 @@ VulkanPipeline::VulkanPipeline(uint32_t pipelineID, const PipelineDesc& desc, st
         shaderStages.push_back(hullShaderStageInfo);
         ShaderModules.push_back(hullModule);
     }
+    if (desc.TaskShader.ByteCode)
+    {
+        VkShaderModule taskModule = VulkanShaderModule(desc.TaskShader);
+        VkPipelineShaderStageCreateInfo taskShaderStageInfo{};
+        taskShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        taskShaderStageInfo.stage = VK_SHADER_STAGE_TASK_BIT_EXT;
+        taskShaderStageInfo.module = taskModule;
+        taskShaderStageInfo.pName = desc.TaskShader.EntryPoint ? desc.TaskShader.EntryPoint : "main";
+        shaderStages.push_back(taskShaderStageInfo);
+        ShaderModules.push_back(taskModule);
+    }
+    if (desc.MeshShader.ByteCode)
+    {
+        VkShaderModule meshModule = VulkanShaderModule(desc.MeshShader);
+        VkPipelineShaderStageCreateInfo meshShaderStageInfo{};
+        meshShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        meshShaderStageInfo.stage = VK_SHADER_STAGE_MESH_BIT_EXT;
+        meshShaderStageInfo.module = meshModule;
+        meshShaderStageInfo.pName = desc.MeshShader.EntryPoint ? desc.MeshShader.EntryPoint : "main";
+        shaderStages.push_back(meshShaderStageInfo);
+        ShaderModules.push_back(meshModule);
+    }
 
     std::vector<VkVertexInputBindingDescription> bindingDescriptions;
     for (const VertexBinding& binding : desc.VertexBindings)
@@ -562,8 +592,9 @@ VulkanPipeline::VulkanPipeline(uint32_t pipelineID, const PipelineDesc& desc, st
     pipelineCreateInfo.pDynamicState = &dynamicState;
     pipelineCreateInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
     pipelineCreateInfo.pStages = shaderStages.data();
-    pipelineCreateInfo.pVertexInputState = &vertexInputInfo;
-    pipelineCreateInfo.pInputAssemblyState = &inputAssembly;
+    // Mesh shading pipelines must not provide vertex input or input assembly state
+    pipelineCreateInfo.pVertexInputState = MeshShading ? nullptr : &vertexInputInfo;
+    pipelineCreateInfo.pInputAssemblyState = MeshShading ? nullptr : &inputAssembly;
     pipelineCreateInfo.pTessellationState = tessellationEnabled ? &tessellation : nullptr;
     pipelineCreateInfo.pViewportState = &viewportState;
     pipelineCreateInfo.pRasterizationState = &rasterizer;
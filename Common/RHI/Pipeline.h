@@ -9,11 +9,13 @@ class Pipeline
 protected:
     std::vector<uint64_t> PipelineInputDescriptorSetIDs;
     IOResource* PipelineOutputResource;
+    bool MeshShading = false;
 public:
     static Pipeline* Create(uint32_t pipelineID, const PipelineDesc& desc, std::vector<IOResource>* inputIOResources = nullptr);
     virtual ~Pipeline() = default;
     
     IOResource* GetOutputResource() const { return PipelineOutputResource; }
+    bool IsMeshShading() const { return MeshShading; }
     virtual void* GetOwnedImage(uint32_t index) = 0;
     virtual void* GetOwnedDepthImage() = 0;
 };
@@ -67,7 +69,7 @@ public:
     VkImage GetOwnedDepthImage() const { return OwnedDepthImage; }
     VkDeviceMemory GetOwnedDepthImageMemory() const { return OwnedDepthImageMemory; }
     VkImageView GetOwnedDepthImageView() const { return OwnedDepthImageView; }
-    std::vector<uint64_t> GetInputDescriptorSetIDs() const { return PipelineInputDescriptorSetIDs; }
+    const std::vector<uint64_t>& GetInputDescriptorSetIDs() const { return PipelineInputDescriptorSetIDs; }
     void* GetOwnedDepthImage() override { return OwnedDepthImage; }
     
     std::vector<VkAttachmentDescription> GetAttachmentDescriptions() const { return AttachmentDescriptions; }
@@ -3,6 +3,7 @@
 
 #include "Pipeline.h"
 #include "RHIStructures.h"
+#include "../GraphicsSettings.h"
 
 using namespace RHIStructures;
 
@@ -206,11 +207,6 @@ namespace RHIConstants
         return Pipeline::Create(0,  TexturedQuadDesc);
     }
     
-    struct MVPData {
-        DirectX::XMFLOAT4X4 ViewProjection;
-        DirectX::XMFLOAT4X4 Model;
-    }; 
-    
     static Pipeline* PBRGeometryPipeline()
     {
         PipelineDesc PBRDescGeometry = {};
@@ -220,31 +216,80 @@ namespace RHIConstants
         PBRDescGeometry.AttachmentWidth = 1280;
         PBRDescGeometry.AttachmentHeight = 720;
 
-        // 1. Shader stages
-        PBRDescGeometry.VertexShader = ImportShader("vs_pbr", "main");
+        // 1. Shader stages, the meshlet path swaps the vertex stage for task culling and a mesh shader with the same outputs
+        bool compactVertices = GRAPHICS_SETTINGS.CompactVertices;
+        bool meshlets = GRAPHICS_SETTINGS.Meshlets && !compactVertices && GRAPHICS_SETTINGS.APIToUse == Vulkan;
+        if (meshlets)
+        {
+            PBRDescGeometry.TaskShader = ImportShader("ts_meshlet", "main");
+            PBRDescGeometry.MeshShader = ImportShader("ms_meshlet", "main");
+            
+            if (!PBRDescGeometry.TaskShader.ByteCode || PBRDescGeometry.TaskShader.ByteCodeSize == 0)
+                throw std::runtime_error("Failed to load task shader!");
+            if (!PBRDescGeometry.MeshShader.ByteCode || PBRDescGeometry.MeshShader.ByteCodeSize == 0)
+                throw std::runtime_error("Failed to load mesh shader!");
+        }
+        else
+        {
+            PBRDescGeometry.VertexShader = ImportShader(compactVertices ? "vs_pbr_compact" : "vs_pbr", "main");
+            
+            if (!PBRDescGeometry.VertexShader.ByteCode || PBRDescGeometry.VertexShader.ByteCodeSize == 0)
+                throw std::runtime_error("Failed to load vertex shader!");
+        }
         PBRDescGeometry.FragmentShader = ImportShader("ps_pbr", "main");
 
-        if (!PBRDescGeometry.VertexShader.ByteCode || PBRDescGeometry.VertexShader.ByteCodeSize == 0)
-            throw std::runtime_error("Failed to load vertex shader!");
         if (!PBRDescGeometry.FragmentShader.ByteCode || PBRDescGeometry.FragmentShader.ByteCodeSize == 0)
             throw std::runtime_error("Failed to load fragment shader!");
 
-        // 2. Vertex input layout
+        // 2. Vertex input layout. Instance transforms come from a second, per-instance stream on Vulkan; vs_pbr.hlsl still
+        // reads gModel from its constant buffer, so the D3D12 layout keeps the single vertex stream.
+        bool instanceStream = GRAPHICS_SETTINGS.APIToUse == Vulkan;
         PBRDescGeometry.VertexBindings = {
             VertexBinding{
                 .Binding   = 0,
-                .Stride    = sizeof(Vertex),
+                .Stride    = compactVertices ? static_cast<uint32_t>(sizeof(CompactVertex)) : static_cast<uint32_t>(sizeof(Vertex)),
                 .Instanced = false
             }
         };
+        if (instanceStream)
+        {
+            PBRDescGeometry.VertexBindings.push_back(VertexBinding{
+                .Binding   = 1,
+                .Stride    = sizeof(InstanceData),
+                .Instanced = true
+            });
+        }
         
-        PBRDescGeometry.VertexAttributes = {
-            VertexAttribute{.Binding = 0, .Location = 0, .Format = Format::R32G32B32_FLOAT, .Offset = 0,   .SemanticName = SemanticName::Position   },
-            VertexAttribute{.Binding = 0, .Location = 1, .Format = Format::R32G32B32_FLOAT, .Offset = 12,  .SemanticName = SemanticName::Normal     },
-            VertexAttribute{.Binding = 0, .Location = 2, .Format = Format::R32G32B32_FLOAT, .Offset = 24,  .SemanticName = SemanticName::Tangent    },
-            VertexAttribute{.Binding = 0, .Location = 3, .Format = Format::R32G32B32_FLOAT, .Offset = 36,  .SemanticName = SemanticName::Binormal   },
-            VertexAttribute{.Binding = 0, .Location = 4, .Format = Format::R32G32_FLOAT,    .Offset = 48,  .SemanticName = SemanticName::TexCoord   }
-        };
+        if (compactVertices)
+        {
+            // Bitangent is rebuilt in the shader, Position.w carries its sign
+            PBRDescGeometry.VertexAttributes = {
+                VertexAttribute{.Binding = 0, .Location = 0, .Format = Format::R16G16B16A16_SNORM, .Offset = 0,  .SemanticName = SemanticName::Position   },
+                VertexAttribute{.Binding = 0, .Location = 1, .Format = Format::R16G16_SNORM,       .Offset = 8,  .SemanticName = SemanticName::Normal     },
+                VertexAttribute{.Binding = 0, .Location = 2, .Format = Format::R16G16_SNORM,       .Offset = 12, .SemanticName = SemanticName::Tangent    },
+                VertexAttribute{.Binding = 0, .Location = 4, .Format = Format::R16G16_FLOAT,       .Offset = 16, .SemanticName = SemanticName::TexCoord   }
+            };
+        }
+        else
+        {
+            PBRDescGeometry.VertexAttributes = {
+                VertexAttribute{.Binding = 0, .Location = 0, .Format = Format::R32G32B32_FLOAT, .Offset = 0,   .SemanticName = SemanticName::Position   },
+                VertexAttribute{.Binding = 0, .Location = 1, .Format = Format::R32G32B32_FLOAT, .Offset = 12,  .SemanticName = SemanticName::Normal     },
+                VertexAttribute{.Binding = 0, .Location = 2, .Format = Format::R32G32B32_FLOAT, .Offset = 24,  .SemanticName = SemanticName::Tangent    },
+                VertexAttribute{.Binding = 0, .Location = 3, .Format = Format::R32G32B32_FLOAT, .Offset = 36,  .SemanticName = SemanticName::Binormal   },
+                VertexAttribute{.Binding = 0, .Location = 4, .Format = Format::R32G32_FLOAT,    .Offset = 48,  .SemanticName = SemanticName::TexCoord   }
+            };
+        }
+        
+        if (instanceStream)
+        {
+            PBRDescGeometry.VertexAttributes.insert(PBRDescGeometry.VertexAttributes.end(), {
+                VertexAttribute{.Binding = 1, .Location = 5, .Format = Format::R32G32B32A32_FLOAT, .Offset = 0,  .SemanticName = SemanticName::InstanceTransform },
+                VertexAttribute{.Binding = 1, .Location = 6, .Format = Format::R32G32B32A32_FLOAT, .Offset = 16, .SemanticName = SemanticName::InstanceTransform },
+                VertexAttribute{.Binding = 1, .Location = 7, .Format = Format::R32G32B32A32_FLOAT, .Offset = 32, .SemanticName = SemanticName::InstanceTransform },
+                VertexAttribute{.Binding = 1, .Location = 8, .Format = Format::R32G32B32A32_FLOAT, .Offset = 48, .SemanticName = SemanticName::InstanceTransform }
+            });
+        }
 
         // 3. Primitive topology
         PBRDescGeometry.PrimitiveTopology = PrimitiveTopology::TriangleList;
@@ -330,12 +375,15 @@ namespace RHIConstants
         PBRDescGeometry.DepthLoadOp = AttachmentLoadOp::Clear;  // Changed from Load
         PBRDescGeometry.DepthStoreOp = AttachmentStoreOp::DontCare;
         
-        // 12. Constants (ViewProjection & Model Matrices)
+        // 12. Constants (ViewProjection, model matrices are per-instance vertex data)
+        // The meshlet path pushes buffer addresses for meshlets, vertices and instances along with the camera
         ShaderStageMask constantVisibleStages = ShaderStageMask(0);
-        constantVisibleStages.SetVertex(true);
+        constantVisibleStages.SetVertex(!meshlets);
+        constantVisibleStages.SetTask(meshlets);
+        constantVisibleStages.SetMesh(meshlets);
         std::vector<PipelineConstant> constants {
                 {
-                    .Size = sizeof(MVPData),
+                    .Size = meshlets ? sizeof(MeshletConstants) : sizeof(CameraUBO),
                     .VisibleStages = constantVisibleStages
                 }
         };
@@ -1,11 +1,12 @@
 ﻿#include "RHIStructures.h"
 #include <d3d12.h>
-#include <fstream>
+#include <cstring>
 #include <string>
 #include <filesystem>
 #include "../Vulkan/VulkanStructs.h"
 #include "../Vulkan/VulkanCore.h"
 #include "../GraphicsSettings.h"
+#include "../Data/AssetIO.h"
 #include "../DirectX12/D3D12Structs.h"
 #include "../Windows/Win32ErrorHandler.h"
 
@@ -19,7 +20,7 @@ namespace RHIStructures
     //====================================//
     
     // Format Mappings
-    constexpr std::array<VkFormat, 18> VULKAN_FORMATS = {
+    constexpr std::array<VkFormat, 21> VULKAN_FORMATS = {
         VK_FORMAT_UNDEFINED,
         VK_FORMAT_R8G8B8A8_UNORM,
         VK_FORMAT_R8G8B8A8_SRGB,
@@ -37,10 +38,13 @@ namespace RHIStructures
         VK_FORMAT_BC4_UNORM_BLOCK,
         VK_FORMAT_BC5_UNORM_BLOCK,
         VK_FORMAT_BC6H_UFLOAT_BLOCK,
-        VK_FORMAT_BC7_UNORM_BLOCK
+        VK_FORMAT_BC7_UNORM_BLOCK,
+        VK_FORMAT_R16G16B16A16_SNORM,
+        VK_FORMAT_R16G16_SNORM,
+        VK_FORMAT_R16G16_SFLOAT
     };
 
-    constexpr std::array<DXGI_FORMAT, 18> DX_FORMATS = {
+    constexpr std::array<DXGI_FORMAT, 21> DX_FORMATS = {
         DXGI_FORMAT_UNKNOWN,
         DXGI_FORMAT_R8G8B8A8_UNORM,
         DXGI_FORMAT_R8G8B8A8_UNORM_SRGB,
@@ -58,7 +62,10 @@ namespace RHIStructures
         DXGI_FORMAT_BC4_UNORM,
         DXGI_FORMAT_BC5_UNORM,
         DXGI_FORMAT_BC6H_UF16,
-        DXGI_FORMAT_BC7_UNORM
+        DXGI_FORMAT_BC7_UNORM,
+        DXGI_FORMAT_R16G16B16A16_SNORM,
+        DXGI_FORMAT_R16G16_SNORM,
+        DXGI_FORMAT_R16G16_FLOAT
     };
 
     VkFormat VulkanFormat(Format format)
@@ -115,8 +122,11 @@ namespace RHIStructures
         case Format::D32_FLOAT_S8X24_UINT:
         case Format::R8G8B8A8_UNORM:
         case Format::R8G8B8A8_UNORM_SRGB:
+        case Format::R16G16_SNORM:
+        case Format::R16G16_FLOAT:
             return 4;
         case Format::R16G16B16A16_FLOAT:
+        case Format::R16G16B16A16_SNORM:
             return 8;
         case Format::R32G32B32_FLOAT:
             return 12;
@@ -127,9 +137,8 @@ namespace RHIStructures
         }
     }
 
-    ShaderStage ImportShader(const std::string& filename, const char* entryPoint)
+    static std::filesystem::path ShaderPath(const std::string& filename)
     {
-        ShaderStage shaderStage;
         std::string path;
         if (GRAPHICS_SETTINGS.APIToUse == DirectX12)
         {
@@ -146,28 +155,33 @@ namespace RHIStructures
         else
             throw std::runtime_error("Invalid API selected!");
 
-        std::filesystem::path absolutePath = std::filesystem::absolute(path);
+        return std::filesystem::absolute(path);
+    }
+
+    bool ShaderExists(const std::string& filename)
+    {
+        return AssetIO::GetInstance().Exists(ShaderPath(filename).string());
+    }
+
+    ShaderStage ImportShader(const std::string& filename, const char* entryPoint)
+    {
+        ShaderStage shaderStage;
+        std::filesystem::path absolutePath = ShaderPath(filename);
         
-        std::ifstream shaderFile(absolutePath, std::ios::binary | std::ios::ate);
-        if (!shaderFile.is_open())
+        FileBuffer shaderFile = AssetIO::GetInstance().ReadFile(absolutePath.string());
+        if (shaderFile.IsEmpty())
         {
-            std::string log = "Failed to open shader file.\n"
+            std::string log = "Failed to open shader file, Common/CompileShaders.bat builds every shader variant.\n"
                 "Expected at: " + absolutePath.string() + "\n"
                 "Current working directory: " + std::filesystem::current_path().string();
             ErrorMessage(log.c_str());
             throw std::runtime_error(log);
         }
     
-        std::streamsize fileSize = shaderFile.tellg();
-        shaderFile.seekg(0, std::ios::beg);
-    
+        // ByteCode is released with free, so it gets its own copy
+        uint64_t fileSize = shaderFile.GetSize();
         void* shaderBytecode = malloc(fileSize);
-        if (!shaderFile.read(static_cast<char*>(shaderBytecode), fileSize))
-        {
-            free(shaderBytecode);
-            throw std::runtime_error("Failed to read shader file: " + path);
-        }
-        shaderFile.close();
+        memcpy(shaderBytecode, shaderFile.GetData(), fileSize);
 
         shaderStage.ByteCode = shaderBytecode;
         shaderStage.ByteCodeSize = fileSize;
@@ -199,7 +213,7 @@ namespace RHIStructures
     }
     
     // Semantic names
-    constexpr std::array<std::string_view, 9> SEMANTIC_NAMES = {
+    constexpr std::array<std::string_view, 10> SEMANTIC_NAMES = {
         "POSITION",
         "NORMAL",
         "TEXCOORD",
@@ -208,8 +222,9 @@ namespace RHIStructures
         "COLOR",
         "BLENDWEIGHT",
         "BLENDINDICES",
-        "PSIZE"
-        
+        "PSIZE",
+        "INSTANCETRANSFORM"
+
     };
     const char* SemanticNameString(SemanticName semanticName)
     {
@@ -307,6 +322,22 @@ namespace RHIStructures
         return 0;
     }
     
+    // IndexFormat Mappings
+    VkIndexType VulkanIndexType(IndexFormat indexFormat)
+    {
+        return indexFormat == IndexFormat::UInt16 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    }
+
+    DXGI_FORMAT DXIndexFormat(IndexFormat indexFormat)
+    {
+        return indexFormat == IndexFormat::UInt16 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+    }
+
+    size_t IndexSize(IndexFormat indexFormat)
+    {
+        return indexFormat == IndexFormat::UInt16 ? 2 : 4;
+    }
+    
     // FillMode Mappings
     constexpr std::array<VkPolygonMode, 2> VULKAN_FILL_MODES = {
         VK_POLYGON_MODE_FILL,   // Solid = 0
@@ -561,6 +592,8 @@ namespace RHIStructures
         if (stages.GetTessControl()) stageCount++;
         if (stages.GetTessEval()) stageCount++;
         if (stages.GetCompute()) stageCount++;
+        if (stages.GetTask()) stageCount++;
+        if (stages.GetMesh()) stageCount++;
     
         if (stageCount > 1 || stages.GetCompute())
             return D3D12_SHADER_VISIBILITY_ALL;
@@ -575,6 +608,10 @@ namespace RHIStructures
             return D3D12_SHADER_VISIBILITY_HULL;
         if (stages.GetTessEval())
             return D3D12_SHADER_VISIBILITY_DOMAIN;
+        if (stages.GetTask())
+            return D3D12_SHADER_VISIBILITY_AMPLIFICATION;
+        if (stages.GetMesh())
+            return D3D12_SHADER_VISIBILITY_MESH;
     
         return D3D12_SHADER_VISIBILITY_ALL;
     }
@@ -589,6 +626,8 @@ namespace RHIStructures
         if (flags.GetGeometry())    vk |= VK_SHADER_STAGE_GEOMETRY_BIT;
         if (flags.GetFragment())    vk |= VK_SHADER_STAGE_FRAGMENT_BIT;
         if (flags.GetCompute())     vk |= VK_SHADER_STAGE_COMPUTE_BIT;
+        if (flags.GetTask())        vk |= VK_SHADER_STAGE_TASK_BIT_EXT;
+        if (flags.GetMesh())        vk |= VK_SHADER_STAGE_MESH_BIT_EXT;
 
         return vk;
     }
@@ -31,6 +31,16 @@ namespace RHIStructures
         DirectX::XMFLOAT3 Bitangent = {0,0,0};
         DirectX::XMFLOAT2 TexCoord = {0,0};
     };
+    
+    // 20 byte quantized vertex, Position is snorm16 over the mesh bounds with the bitangent sign in w,
+    // Normal and Tangent are octahedral snorm16 and TexCoord is half float. Decoded in vs_pbr with COMPACT_VERTICES.
+    struct CompactVertex
+    {
+        int16_t Position[4] = {0,0,0,0};
+        int16_t Normal[2] = {0,0};
+        int16_t Tangent[2] = {0,0};
+        uint16_t TexCoord[2] = {0,0};
+    };
 #pragma pack(pop)
     
     class Mask
@@ -76,7 +86,10 @@ namespace RHIStructures
         BC4_UNORM = 14,
         BC5_UNORM = 15,
         BC6H_UF16 = 16,
-        BC7_UNORM = 17
+        BC7_UNORM = 17,
+        R16G16B16A16_SNORM = 18,
+        R16G16_SNORM = 19,
+        R16G16_FLOAT = 20
     };
     VkFormat VulkanFormat(Format format);
     DXGI_FORMAT DXFormat(Format format);
@@ -92,6 +105,8 @@ namespace RHIStructures
     };
     
     ShaderStage ImportShader(const std::string& filename, const char* entryPoint);
+    // Whether the compiled binary of filename exists for the selected API, loose or archived
+    bool ShaderExists(const std::string& filename);
     VkShaderModule VulkanShaderModule(ShaderStage shaderStage);
     D3D12_SHADER_BYTECODE DXShaderBytecode(ShaderStage shaderStage);
 
@@ -106,6 +121,7 @@ namespace RHIStructures
         BlendWeight = 6,
         BlendIndices = 7,
         PointSize = 8,
+        InstanceTransform = 9,
     };
     const char* SemanticNameString(SemanticName semanticName);
 
@@ -147,6 +163,11 @@ namespace RHIStructures
     D3D12_PRIMITIVE_TOPOLOGY_TYPE DXPrimitiveTopologyType(PrimitiveTopology primitiveTopology);
     uint32_t GetPatchControlPoints(PrimitiveTopology primitiveTopology);
 
+    enum class IndexFormat : uint8_t { UInt16, UInt32 };
+    VkIndexType VulkanIndexType(IndexFormat indexFormat);
+    DXGI_FORMAT DXIndexFormat(IndexFormat indexFormat);
+    size_t IndexSize(IndexFormat indexFormat);
+
     enum class FillMode : uint8_t { Solid, Wireframe };
     VkPolygonMode VulkanFillMode(FillMode fillMode);
     D3D12_FILL_MODE DXFillMode(FillMode fillMode);
@@ -261,6 +282,8 @@ namespace RHIStructures
         bool GetGeometry() const { return (Value >> 3) & 1; }
         bool GetFragment() const { return (Value >> 4) & 1; }
         bool GetCompute() const { return (Value >> 5) & 1; }
+        bool GetTask() const { return (Value >> 6) & 1; }
+        bool GetMesh() const { return (Value >> 7) & 1; }
 
         void SetVertex(bool b) { b ? Value |= (1 << 0) : Value &= ~(1 << 0); }
         void SetTessControl(bool b) { b ? Value |= (1 << 1) : Value &= ~(1 << 1); }
@@ -268,6 +291,8 @@ namespace RHIStructures
         void SetGeometry(bool b) { b ? Value |= (1 << 3) : Value &= ~(1 << 3); }
         void SetFragment(bool b) { b ? Value |= (1 << 4) : Value &= ~(1 << 4); }
         void SetCompute(bool b) { b ? Value |= (1 << 5) : Value &= ~(1 << 5); }
+        void SetTask(bool b) { b ? Value |= (1 << 6) : Value &= ~(1 << 6); }
+        void SetMesh(bool b) { b ? Value |= (1 << 7) : Value &= ~(1 << 7); }
     };
 
     VkShaderStageFlags VulkanShaderStageFlags(ShaderStageMask flags);
@@ -345,6 +370,9 @@ namespace RHIStructures
         ShaderStage GeometryShader = {};
         ShaderStage HullShader = {};
         ShaderStage DomainShader = {};
+        // Task and mesh stages replace vertex input entirely (VK_EXT_mesh_shader), vertex attributes and topology are ignored
+        ShaderStage TaskShader = {};
+        ShaderStage MeshShader = {};
 
         std::vector<VertexAttribute> VertexAttributes = {};
         std::vector<VertexBinding> VertexBindings = {};
@@ -570,7 +598,7 @@ namespace RHIStructures
         ImageType Type = ImageType::Sampled;
         MemoryAccess Access = MemoryAccess(0);
         ImageLayout Layout = ImageLayout::Undefined;
-        const void* InitialData = nullptr;
+        const void* InitialData = nullptr;  // Every mip level tightly packed from the largest, BC levels in whole 4x4 blocks
     };
     VkImageViewType VulkanImageViewType(ImageDesc desc);
     
@@ -619,4 +647,20 @@ namespace RHIStructures
         DirectX::XMFLOAT4X4 Model;
     };
 
+    struct InstanceData {
+        DirectX::XMFLOAT4X4 Model;
+    };
+
+    // Push constant block of the mesh shading path, addresses are buffer device addresses (std430 offsets, 112 bytes)
+    struct MeshletConstants {
+        DirectX::XMFLOAT4X4 ViewProjection;
+        uint64_t MeshletAddress;
+        uint64_t VertexAddress;
+        uint64_t InstanceAddress;
+        uint32_t MeshletCount;
+        uint32_t Padding0;
+        DirectX::XMFLOAT3 CameraPosition;
+        float Padding1;
+    };
+
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "../Vulkan/VulkanCore.h"
 #include "../GraphicsSettings.h"
 #include <DirectXMath.h>
+#include <algorithm>
 
 #include "BufferAllocator.h"
 #include "RHIConstants.h"
@@ -40,6 +41,7 @@ void D3DRenderPassExecutor::Begin(Pipeline* pipeline,
 {
     ID3D12GraphicsCommandList* cmdList = GetCommandList();
     D3DPipeline* d3dPipeline = static_cast<D3DPipeline*>(pipeline);
+    CurrentPipeline = d3dPipeline;
     
     // Set root signature and pipeline state
     cmdList->SetGraphicsRootSignature(d3dPipeline->GetRootSignature());
@@ -129,6 +131,19 @@ void D3DRenderPassExecutor::End()
 
 }
 
+void D3DRenderPassExecutor::BindPipeline(Pipeline* pipeline)
+{
+    D3DPipeline* d3dPipeline = static_cast<D3DPipeline*>(pipeline);
+    if (d3dPipeline == CurrentPipeline)
+        return;
+    
+    ID3D12GraphicsCommandList* cmdList = GetCommandList();
+    cmdList->SetGraphicsRootSignature(d3dPipeline->GetRootSignature());
+    cmdList->SetPipelineState(d3dPipeline->GetPipelineState());
+    cmdList->IASetPrimitiveTopology(d3dPipeline->GetTopology());
+    CurrentPipeline = d3dPipeline;
+}
+
 void D3DRenderPassExecutor::IssueMemoryBarrier(const RHIStructures::MemoryBarrier& barrier)
 {
     ID3D12GraphicsCommandList* cmdList = GetCommandList();
@@ -161,7 +176,13 @@ void D3DRenderPassExecutor::IssueImageMemoryBarrier(const ImageMemoryBarrier& ba
     cmdList->ResourceBarrier(1, &d3dBarrier);
 }
 
-void D3DRenderPassExecutor::DrawSceneNode(const SceneNode& node, std::vector<uint64_t>& perItemDrawSets, const DirectX::XMFLOAT4X4& camera)
+// Mesh drawing has no D3D12 implementation yet, the sample only runs on Vulkan
+void D3DRenderPassExecutor::DrawScene(const Scene& scene, const std::vector<uint64_t>& perItemDrawSets, const DirectX::XMFLOAT4X4& camera, const std::vector<uint32_t>* visibleMeshes,
+                                      const std::vector<uint8_t>* meshLODs)
+{
+}
+
+void D3DRenderPassExecutor::DrawInstanced(const std::vector<InstanceBatch>& batches, const std::vector<InstanceData>& instances, const DirectX::XMFLOAT4X4& camera)
 {
 }
 
@@ -199,6 +220,16 @@ void VulkanRenderPassExecutor::Begin(Pipeline* pipeline,
     CurrentPipeline = static_cast<VulkanPipeline*>(pipeline);
     VkCommandBuffer cmdBuffer = GetCommandBuffer();
     
+    // Statistics roll over on the first pass of a new frame, bound state is not assumed to survive across passes
+    uint32_t frameIndex = VulkanCore::GetInstance().GetCurrentFrameIndex();
+    if (frameIndex != StatisticsFrameIndex)
+    {
+        LastFrameBindStatistics = FrameBindStatistics;
+        FrameBindStatistics = {};
+        StatisticsFrameIndex = frameIndex;
+    }
+    ResetBoundState();
+    
     VkRenderingInfo renderingInfo{};
     renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
     renderingInfo.renderArea.offset = {0, 0};
@@ -273,8 +304,7 @@ void VulkanRenderPassExecutor::Begin(Pipeline* pipeline,
     
     vkCmdBeginRendering(cmdBuffer, &renderingInfo);
     
-    // Bind pipeline
-    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, CurrentPipeline->GetVulkanPipeline());
+    BindVulkanPipeline(CurrentPipeline);
     
     // Set viewport
     VkViewport viewport{};
@@ -299,6 +329,12 @@ void VulkanRenderPassExecutor::End()
     vkCmdEndRendering(cmdBuffer);
 }
 
+void VulkanRenderPassExecutor::BindPipeline(Pipeline* pipeline)
+{
+    CurrentPipeline = static_cast<VulkanPipeline*>(pipeline);
+    BindVulkanPipeline(CurrentPipeline);
+}
+
 void VulkanRenderPassExecutor::IssueMemoryBarrier(const RHIStructures::MemoryBarrier& barrier)
 {
     VkMemoryBarrier memBarrier{};
@@ -357,58 +393,155 @@ void VulkanRenderPassExecutor::IssueImageMemoryBarrier(const ImageMemoryBarrier&
     );
 }
 
-void VulkanRenderPassExecutor::DrawSceneNode(const SceneNode& node, std::vector<uint64_t>& perItemDrawSets, const DirectX::XMFLOAT4X4& camera)
+void VulkanRenderPassExecutor::DrawScene(const Scene& scene, const std::vector<uint64_t>& perItemDrawSets, const DirectX::XMFLOAT4X4& camera, const std::vector<uint32_t>* visibleMeshes,
+                                         const std::vector<uint8_t>* meshLODs)
+{
+    SceneBatcher.Reset();
+    SceneBatcher.AddScene(scene, perItemDrawSets, visibleMeshes, meshLODs);
+    SceneBatcher.Build();
+    
+    DrawInstanced(SceneBatcher.GetBatches(), SceneBatcher.GetInstances(), camera);
+}
+
+void VulkanRenderPassExecutor::DrawInstanced(const std::vector<InstanceBatch>& batches, const std::vector<InstanceData>& instances, const DirectX::XMFLOAT4X4& camera)
 {
+    if (batches.empty() || instances.empty())
+        return;
+    
     VkCommandBuffer cmdBuffer = GetCommandBuffer();
     BufferAllocator* bufferAlloc = BufferAllocator::GetInstance();
-
-    // Render meshes on this node
-    for (size_t i = 0; i < node.GetMeshCount(); i++)
+    
+    // Stream this draw's model matrices into the frame's instance buffer and bind it to the per-instance slot
+    VkDeviceSize instanceOffset = 0;
+    uint64_t instanceBufferID = AcquireInstanceRange(static_cast<uint32_t>(instances.size()), instanceOffset);
+    BufferAllocation instanceBufferAlloc = bufferAlloc->GetBufferAllocation(instanceBufferID);
+    memcpy(static_cast<uint8_t*>(instanceBufferAlloc.Address) + instanceOffset, instances.data(), instances.size() * sizeof(InstanceData));
+    
+    // Mesh shading pipelines pull vertices and instances by address instead of through bound vertex buffers
+    if (CurrentPipeline->IsMeshShading())
     {
-        const Mesh* mesh = node.GetMesh(i);
-        uint32_t materialIndex = mesh->GetLocalMaterialIndex();
-        
-        DirectX::XMFLOAT4X4 model;
-        DirectX::XMStoreFloat4x4(&model, node.GetModelMatrix());
-        
-        std::vector<uint64_t> descriptorSets = {perItemDrawSets[materialIndex]};
-        BindDescriptorSets(&descriptorSets);
-        
-        RHIConstants::MVPData mvpData {camera, model};
-        
-
-        
-        vkCmdPushConstants(cmdBuffer, CurrentPipeline->GetPipelineLayout(),
-            VK_SHADER_STAGE_VERTEX_BIT,
-            0,
-            sizeof(RHIConstants::MVPData),
-            &mvpData);
+        DrawMeshlets(batches, VulkanBuffer(instanceBufferAlloc)->DeviceAddress + instanceOffset, camera);
+        return;
+    }
+    
+    VkBuffer instanceBuffer = static_cast<VulkanBufferData*>(instanceBufferAlloc.Buffer)->Buffer;
+    BindVertexBuffer(1, instanceBuffer, instanceOffset);
+    
+    CameraUBO cameraData {camera};
+    vkCmdPushConstants(cmdBuffer, CurrentPipeline->GetPipelineLayout(),
+        VK_SHADER_STAGE_VERTEX_BIT,
+        0,
+        sizeof(CameraUBO),
+        &cameraData);
+    
+    for (const InstanceBatch& batch : batches)
+    {
+        BindDescriptorSets(&batch.MaterialSetID, 1);
         
-        BufferAllocation vertexBufferAlloc = bufferAlloc->GetBufferAllocation(mesh->GetVertexBufferID());
-        VkBuffer vertexBuffer = static_cast<VulkanBufferData*>(vertexBufferAlloc.Buffer)->Buffer;
-        VkDeviceSize offset = 0;
-        vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vertexBuffer, &offset);
+        // Arena buffers are bound at offset zero, so consecutive meshes from the same block skip the rebind
+        BufferAllocation vertexBufferAlloc = bufferAlloc->GetBufferAllocation(batch.VertexBufferID);
+        BindVertexBuffer(0, static_cast<VulkanBufferData*>(vertexBufferAlloc.Buffer)->Buffer, 0);
         
-        if (mesh->GetIndexCount() > 0)
+        if (batch.IndexCount > 0)
         {
-            BufferAllocation indexBufferAlloc = bufferAlloc->GetBufferAllocation(mesh->GetIndexBufferID());
-            VkBuffer indexBuffer = static_cast<VulkanBufferData*>(indexBufferAlloc.Buffer)->Buffer;
-            vkCmdBindIndexBuffer(cmdBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-            vkCmdDrawIndexed(cmdBuffer, mesh->GetIndexCount(), 1, 0, 0, 0);
+            BufferAllocation indexBufferAlloc = bufferAlloc->GetBufferAllocation(batch.IndexBufferID);
+            BindIndexBuffer(static_cast<VulkanBufferData*>(indexBufferAlloc.Buffer)->Buffer, 0, VulkanIndexType(batch.IndexFormat));
+            vkCmdDrawIndexed(cmdBuffer, batch.IndexCount, batch.InstanceCount, batch.FirstIndex, static_cast<int32_t>(batch.VertexOffset), batch.FirstInstance);
         }
         else
         {
-            vkCmdDraw(cmdBuffer, mesh->GetVertexCount(), 1, 0, 0);
+            vkCmdDraw(cmdBuffer, batch.VertexCount, batch.InstanceCount, batch.VertexOffset, batch.FirstInstance);
         }
     }
+}
 
-    std::vector<SceneNode> children = node.GetChildren();
-    for (const SceneNode& child : children)
+void VulkanRenderPassExecutor::DrawMeshlets(const std::vector<InstanceBatch>& batches, VkDeviceAddress instanceAddress, const DirectX::XMFLOAT4X4& camera)
+{
+    using namespace DirectX;
+    
+    VkCommandBuffer cmdBuffer = GetCommandBuffer();
+    BufferAllocator* bufferAlloc = BufferAllocator::GetInstance();
+    PFN_vkCmdDrawMeshTasksEXT drawMeshTasks = VulkanCore::GetInstance().GetVkCmdDrawMeshTasksEXT();
+    
+    // The eye is the point the projection sends to w = 0, the task stage needs it for the normal cone test
+    XMVECTOR eye = XMVector4Transform(XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), XMMatrixInverse(nullptr, XMLoadFloat4x4(&camera)));
+    
+    MeshletConstants constants = {};
+    constants.ViewProjection = camera;
+    XMStoreFloat3(&constants.CameraPosition, XMVectorDivide(eye, XMVectorSplatW(eye)));
+    
+    for (const InstanceBatch& batch : batches)
     {
-        DrawSceneNode(child, perItemDrawSets, camera);
+        if (batch.MeshletBufferID == 0)
+            throw std::runtime_error("Mesh shading pipeline drawn with a mesh that has no meshlets.");
+        
+        BindDescriptorSets(&batch.MaterialSetID, 1);
+        
+        constants.MeshletAddress = VulkanBuffer(bufferAlloc->GetBufferAllocation(batch.MeshletBufferID))->DeviceAddress;
+        constants.VertexAddress = VulkanBuffer(bufferAlloc->GetBufferAllocation(batch.VertexBufferID))->DeviceAddress + batch.VertexOffset * sizeof(Vertex);
+        constants.InstanceAddress = instanceAddress + batch.FirstInstance * sizeof(InstanceData);
+        constants.MeshletCount = batch.MeshletCount;
+        vkCmdPushConstants(cmdBuffer, CurrentPipeline->GetPipelineLayout(),
+            VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT,
+            0,
+            sizeof(MeshletConstants),
+            &constants);
+        
+        // Task groups along x cover the meshlets, y is the instance within the batch
+        drawMeshTasks(cmdBuffer, (batch.MeshletCount + MeshletsPerTaskGroup - 1) / MeshletsPerTaskGroup, batch.InstanceCount, 1);
     }
 }
 
+uint64_t VulkanRenderPassExecutor::AcquireInstanceRange(uint32_t instanceCount, VkDeviceSize& outByteOffset)
+{
+    BufferAllocator* bufferAlloc = BufferAllocator::GetInstance();
+    uint32_t frameIndex = VulkanCore::GetInstance().GetCurrentFrameIndex();
+    
+    if (InstanceBuffers.empty())
+        InstanceBuffers.resize(VulkanCore::GetInstance().GetSwapchainImageCount());
+    
+    InstanceBufferSlot& slot = InstanceBuffers[frameIndex];
+    
+    // First draw in this frame slot, its fence has been waited on so nothing it holds is still in flight
+    if (frameIndex != InstanceFrameIndex)
+    {
+        for (uint64_t retiredBufferID : slot.RetiredBufferIDs)
+            bufferAlloc->FreeBuffer(retiredBufferID);
+        
+        slot.RetiredBufferIDs.clear();
+        slot.WriteOffset = 0;
+        InstanceFrameIndex = frameIndex;
+    }
+    
+    if (slot.WriteOffset + instanceCount > slot.Capacity)
+    {
+        if (slot.Capacity > 0)
+            slot.RetiredBufferIDs.push_back(slot.BufferID);
+        
+        MemoryAccess memoryAccess{0};
+        memoryAccess.SetCPUWrite(true);
+        
+        uint64_t newCapacity = std::max<uint64_t>(std::max<uint64_t>(slot.Capacity * 2, MinInstanceCapacity), instanceCount);
+        
+        BufferDesc instanceBufferDesc = {};
+        instanceBufferDesc.Size = newCapacity * sizeof(InstanceData);
+        instanceBufferDesc.Usage = BufferUsage{
+            .TransferSource = false,
+            .TransferDestination = false,
+            .Type = BufferType::Vertex
+        };
+        instanceBufferDesc.Type = BufferType::Vertex;
+        instanceBufferDesc.Access = memoryAccess;
+        
+        slot.BufferID = bufferAlloc->CreateBuffer(instanceBufferDesc, false);
+        slot.Capacity = newCapacity;
+        slot.WriteOffset = 0;
+    }
+    
+    outByteOffset = slot.WriteOffset * sizeof(InstanceData);
+    slot.WriteOffset += instanceCount;
+    return slot.BufferID;
+}
 
 void VulkanRenderPassExecutor::DrawQuad(std::vector<uint64_t>* descriptorSets)
 {
@@ -421,35 +554,111 @@ void VulkanRenderPassExecutor::DrawQuad(std::vector<uint64_t>* descriptorSets)
 
 void VulkanRenderPassExecutor::BindDescriptorSets(std::vector<uint64_t>* descriptorSets)
 {
-    VkCommandBuffer cmdBuffer = GetCommandBuffer();
-    BufferAllocator* bufferAlloc = BufferAllocator::GetInstance();
-    
-    uint32_t numSets = 0;
-    std::vector<VkDescriptorSet> combinedDescriptorSets;
-    
     if (descriptorSets)
-        for (uint64_t ID : *descriptorSets)
-        {
-            combinedDescriptorSets.push_back(reinterpret_cast<VkDescriptorSet>(bufferAlloc->GetDescriptorSet(ID).DescriptorAddress));
-            numSets++;
-        }
-        
-    for (uint64_t ID : CurrentPipeline->GetInputDescriptorSetIDs())
+        BindDescriptorSets(descriptorSets->data(), static_cast<uint32_t>(descriptorSets->size()));
+    else
+        BindDescriptorSets(nullptr, 0);
+}
+
+void VulkanRenderPassExecutor::BindDescriptorSets(const uint64_t* descriptorSetIDs, uint32_t count)
+{
+    BufferAllocator* bufferAlloc = BufferAllocator::GetInstance();
+    const std::vector<uint64_t>& inputSetIDs = CurrentPipeline->GetInputDescriptorSetIDs();
+    
+    uint32_t numSets = count + static_cast<uint32_t>(inputSetIDs.size());
+    if (numSets > MaxBoundDescriptorSets)
+        throw std::runtime_error("Too many descriptor sets bound at once: " + std::to_string(numSets) + ".");
+    
+    std::array<VkDescriptorSet, MaxBoundDescriptorSets> combinedDescriptorSets;
+    for (uint32_t i = 0; i < count; i++)
+        combinedDescriptorSets[i] = reinterpret_cast<VkDescriptorSet>(bufferAlloc->GetDescriptorSet(descriptorSetIDs[i]).DescriptorAddress);
+    for (uint32_t i = 0; i < inputSetIDs.size(); i++)
+        combinedDescriptorSets[count + i] = reinterpret_cast<VkDescriptorSet>(bufferAlloc->GetDescriptorSet(inputSetIDs[i]).DescriptorAddress);
+    
+    // Sets below the first changed one stay bound, a layout change invalidates them all
+    VkPipelineLayout layout = CurrentPipeline->GetPipelineLayout();
+    uint32_t firstChanged = 0;
+    if (layout == Bound.DescriptorSetLayout)
+        while (firstChanged < numSets && firstChanged < Bound.DescriptorSetCount && combinedDescriptorSets[firstChanged] == Bound.DescriptorSets[firstChanged])
+            firstChanged++;
+    
+    if (firstChanged == numSets)
     {
-        combinedDescriptorSets.push_back(reinterpret_cast<VkDescriptorSet>(bufferAlloc->GetDescriptorSet(ID).DescriptorAddress));
-        numSets++;
+        RecordBind(true);
+        return;
     }
     
     vkCmdBindDescriptorSets(
-        cmdBuffer,
+        GetCommandBuffer(),
         VK_PIPELINE_BIND_POINT_GRAPHICS,
-        CurrentPipeline->GetPipelineLayout(),
-        0,                              // First set (set = 0 in shader)
-        numSets,                        // Descriptor set count
-        combinedDescriptorSets.data(),  // Descriptor sets array
-        0,                              // Dynamic offset count
-        nullptr                         // Dynamic offsets
+        layout,
+        firstChanged,                                   // First set that differs from what is bound
+        numSets - firstChanged,                         // Descriptor set count
+        combinedDescriptorSets.data() + firstChanged,   // Descriptor sets array
+        0,                                              // Dynamic offset count
+        nullptr                                         // Dynamic offsets
     );
+    RecordBind(false);
+    
+    Bound.DescriptorSetLayout = layout;
+    Bound.DescriptorSets = combinedDescriptorSets;
+    Bound.DescriptorSetCount = numSets;
+}
+
+void VulkanRenderPassExecutor::BindVulkanPipeline(VulkanPipeline* pipeline)
+{
+    VkPipeline pipelineHandle = pipeline->GetVulkanPipeline();
+    if (pipelineHandle == Bound.PipelineHandle)
+    {
+        RecordBind(true);
+        return;
+    }
+    
+    vkCmdBindPipeline(GetCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineHandle);
+    RecordBind(false);
+    Bound.PipelineHandle = pipelineHandle;
+}
+
+void VulkanRenderPassExecutor::BindVertexBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset)
+{
+    if (Bound.VertexBuffers[binding] == buffer && Bound.VertexBufferOffsets[binding] == offset)
+    {
+        RecordBind(true);
+        return;
+    }
+    
+    vkCmdBindVertexBuffers(GetCommandBuffer(), binding, 1, &buffer, &offset);
+    RecordBind(false);
+    Bound.VertexBuffers[binding] = buffer;
+    Bound.VertexBufferOffsets[binding] = offset;
+}
+
+void VulkanRenderPassExecutor::BindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType)
+{
+    if (Bound.IndexBuffer == buffer && Bound.IndexBufferOffset == offset && Bound.IndexType == indexType)
+    {
+        RecordBind(true);
+        return;
+    }
+    
+    vkCmdBindIndexBuffer(GetCommandBuffer(), buffer, offset, indexType);
+    RecordBind(false);
+    Bound.IndexBuffer = buffer;
+    Bound.IndexBufferOffset = offset;
+    Bound.IndexType = indexType;
+}
+
+void VulkanRenderPassExecutor::ResetBoundState()
+{
+    Bound = {};
+}
+
+void VulkanRenderPassExecutor::RecordBind(bool skipped)
+{
+    if (skipped)
+        FrameBindStatistics.Skipped++;
+    else
+        FrameBindStatistics.Issued++;
 }
 
 VkCommandBuffer VulkanRenderPassExecutor::GetCommandBuffer()
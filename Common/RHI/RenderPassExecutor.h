@@ -1,7 +1,10 @@
 ﻿#pragma once
+#include <array>
 #include "Pipeline.h"
 #include "../RHI/RHIStructures.h"
 #include "Geometry/Mesh.h"
+#include "Geometry/Scene.h"
+#include "InstanceBatcher.h"
 
 namespace DirectX { struct XMFLOAT4; }
 class RenderPassExecutor
@@ -21,11 +24,16 @@ public:
     
     // End current rendering operation
     virtual void End() = 0;
+    
+    // Switch pipeline inside the current rendering operation, the pipeline must match the bound attachments
+    virtual void BindPipeline(Pipeline* pipeline) = 0;
 
     virtual void IssueMemoryBarrier(const RHIStructures::MemoryBarrier& barrier) = 0;
     virtual void IssueImageMemoryBarrier(const ImageMemoryBarrier& barrier) = 0;
     
-    virtual void DrawSceneNode(const SceneNode& node, std::vector<uint64_t>& perItemDrawSets, const DirectX::XMFLOAT4X4& camera) = 0;
+    virtual void DrawScene(const Scene& scene, const std::vector<uint64_t>& perItemDrawSets, const DirectX::XMFLOAT4X4& camera, const std::vector<uint32_t>* visibleMeshes = nullptr,
+                           const std::vector<uint8_t>* meshLODs = nullptr) = 0;
+    virtual void DrawInstanced(const std::vector<InstanceBatch>& batches, const std::vector<RHIStructures::InstanceData>& instances, const DirectX::XMFLOAT4X4& camera) = 0;
     virtual void DrawQuad(std::vector<uint64_t>* descriptorSets = nullptr) = 0;
 };
 
@@ -42,14 +50,17 @@ public:
                const std::vector<DirectX::XMFLOAT4>& clearColors,
                float clearDepth) override;
     void End() override;
+    void BindPipeline(Pipeline* pipeline) override;
     void IssueMemoryBarrier(const RHIStructures::MemoryBarrier& barrier) override;
     void IssueImageMemoryBarrier(const ImageMemoryBarrier& barrier) override;
-    void DrawSceneNode(const SceneNode& node, std::vector<uint64_t>& perItemDrawSets, const DirectX::XMFLOAT4X4& camera) override;
+    void DrawScene(const Scene& scene, const std::vector<uint64_t>& perItemDrawSets, const DirectX::XMFLOAT4X4& camera, const std::vector<uint32_t>* visibleMeshes = nullptr,
+                   const std::vector<uint8_t>* meshLODs = nullptr) override;
+    void DrawInstanced(const std::vector<InstanceBatch>& batches, const std::vector<RHIStructures::InstanceData>& instances, const DirectX::XMFLOAT4X4& camera) override;
     void DrawQuad(std::vector<uint64_t>* descriptorSets = nullptr) override;
     
 private:
     ID3D12GraphicsCommandList* GetCommandList();
-    D3DPipeline* CurrentPipeline;
+    D3DPipeline* CurrentPipeline = nullptr;
 };
 
 class VulkanRenderPassExecutor : public RenderPassExecutor
@@ -65,14 +76,74 @@ public:
                const std::vector<DirectX::XMFLOAT4>& clearColors,
                float clearDepth) override;
     void End() override;
+    void BindPipeline(Pipeline* pipeline) override;
     void IssueMemoryBarrier(const RHIStructures::MemoryBarrier& barrier) override;
     void IssueImageMemoryBarrier(const ImageMemoryBarrier& barrier) override;
-    void DrawSceneNode(const SceneNode& node, std::vector<uint64_t>& perItemDrawSets, const DirectX::XMFLOAT4X4& camera) override;
+    void DrawScene(const Scene& scene, const std::vector<uint64_t>& perItemDrawSets, const DirectX::XMFLOAT4X4& camera, const std::vector<uint32_t>* visibleMeshes = nullptr,
+                   const std::vector<uint8_t>* meshLODs = nullptr) override;
+    void DrawInstanced(const std::vector<InstanceBatch>& batches, const std::vector<RHIStructures::InstanceData>& instances, const DirectX::XMFLOAT4X4& camera) override;
     void DrawQuad(std::vector<uint64_t>* descriptorSets = nullptr) override;
     void BindDescriptorSets(std::vector<uint64_t>* descriptorSets);
+    
+    struct BindStatistics
+    {
+        uint32_t Issued = 0;
+        uint32_t Skipped = 0;
+    };
+    
+    // Bind counts of the last completed frame
+    const BindStatistics& GetBindStatistics() const { return LastFrameBindStatistics; }
 
 private:
     
-    VulkanPipeline* CurrentPipeline;
+    static constexpr uint32_t MaxBoundDescriptorSets = 8;
+    static constexpr uint32_t MaxBoundVertexBuffers = 2;
+    
+    // Mirror of what is currently bound on the command buffer, used to drop redundant binds
+    struct BoundState
+    {
+        VkPipeline PipelineHandle = VK_NULL_HANDLE;
+        VkPipelineLayout DescriptorSetLayout = VK_NULL_HANDLE;
+        std::array<VkDescriptorSet, MaxBoundDescriptorSets> DescriptorSets {};
+        uint32_t DescriptorSetCount = 0;
+        std::array<VkBuffer, MaxBoundVertexBuffers> VertexBuffers {};
+        std::array<VkDeviceSize, MaxBoundVertexBuffers> VertexBufferOffsets {};
+        VkBuffer IndexBuffer = VK_NULL_HANDLE;
+        VkDeviceSize IndexBufferOffset = 0;
+        VkIndexType IndexType = VK_INDEX_TYPE_UINT32;
+    };
+    
+    BoundState Bound;
+    BindStatistics FrameBindStatistics;
+    BindStatistics LastFrameBindStatistics;
+    uint32_t StatisticsFrameIndex = UINT32_MAX;
+    
+
+    // Per-frame instance data ring. Buffers outgrown mid-frame are retired until the frame slot comes around again.
+    struct InstanceBufferSlot
+    {
+        uint64_t BufferID = 0;
+        uint64_t Capacity = 0;
+        uint64_t WriteOffset = 0;
+        std::vector<uint64_t> RetiredBufferIDs;
+    };
+    
+    static constexpr uint64_t MinInstanceCapacity = 1024;
+    // Matches local_size_x of ts_meshlet, one task invocation culls one meshlet
+    static constexpr uint32_t MeshletsPerTaskGroup = 32;
+    
+    VulkanPipeline* CurrentPipeline = nullptr;
+    InstanceBatcher SceneBatcher;
+    std::vector<InstanceBufferSlot> InstanceBuffers;
+    uint32_t InstanceFrameIndex = UINT32_MAX;
+    
     VkCommandBuffer GetCommandBuffer();
+    void ResetBoundState();
+    void RecordBind(bool skipped);
+    void BindVulkanPipeline(VulkanPipeline* pipeline);
+    void BindDescriptorSets(const uint64_t* descriptorSetIDs, uint32_t count);
+    void BindVertexBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset);
+    void BindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType);
+    uint64_t AcquireInstanceRange(uint32_t instanceCount, VkDeviceSize& outByteOffset);
+    void DrawMeshlets(const std::vector<InstanceBatch>& batches, VkDeviceAddress instanceAddress, const DirectX::XMFLOAT4X4& camera);
 };
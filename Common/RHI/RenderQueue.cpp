@@ -0,0 +1,174 @@
+#include "RenderQueue.h"
+#include "RenderPassExecutor.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+using namespace DirectX;
+using namespace RHIStructures;
+
+void RenderQueue::Reset()
+{
+    Items.clear();
+    SortEntries.clear();
+}
+
+void RenderQueue::Submit(uint32_t pass, Pipeline* pipeline, const Mesh& mesh, uint64_t materialSetID, const XMFLOAT4X4& model, float viewDepth,
+                         uint32_t lod)
+{
+    if (pass > RenderSortKey::FieldMask(RenderSortKey::PassBits))
+        throw std::runtime_error("Render pass index " + std::to_string(pass) + " does not fit in the sort key.");
+
+    RenderItem item;
+    item.TargetPipeline = pipeline;
+    item.MaterialSetID = materialSetID;
+    item.VertexBufferID = mesh.GetVertexBufferID();
+    item.IndexBufferID = mesh.GetIndexBufferID();
+    item.MeshletBufferID = mesh.GetMeshletBufferID();
+    item.MeshletCount = mesh.GetMeshletCount();
+    item.VertexCount = mesh.GetVertexCount();
+    item.VertexOffset = mesh.GetVertexOffset();
+    item.FirstIndex = mesh.GetFirstIndex() + (mesh.GetLODCount() > 0 ? mesh.GetLOD(lod).FirstIndex : 0);
+    item.IndexCount = mesh.GetLODCount() > 0 ? mesh.GetLOD(lod).IndexCount : mesh.GetIndexCount();
+    item.IndexFormat = mesh.GetIndexFormat();
+    item.Model = mesh.GetInstanceTransform(model);
+
+    // Meshes share arena buffers, so the mesh field hashes the vertex offset and first index, which differ per mesh and LOD.
+    // Instances at the same level stay adjacent and batch together.
+    uint64_t meshKey = ((static_cast<uint64_t>(item.VertexOffset) << 32 | item.FirstIndex) * 0x9E3779B97F4A7C15ULL) >> 48;
+    uint64_t key = RenderSortKey::Make(pass, GetPipelineSlot(pipeline), materialSetID, meshKey, GetDepthBucket(viewDepth));
+    SortEntries.push_back(SortEntry { key, static_cast<uint32_t>(Items.size()) });
+    Items.push_back(item);
+}
+
+void RenderQueue::SubmitScene(uint32_t pass, Pipeline* pipeline, const Scene& scene, const std::vector<uint64_t>& perItemDrawSets, const XMFLOAT4X4& viewProjection,
+                              const std::vector<uint32_t>* visibleMeshes, const std::vector<uint8_t>* meshLODs)
+{
+    const std::vector<Mesh>& meshes = scene.GetMeshes();
+    const std::vector<uint32_t>& meshNodeIndices = scene.GetMeshNodeIndices();
+    const std::vector<XMFLOAT4X4>& worldTransforms = scene.GetWorldTransforms();
+    XMMATRIX viewProjectionMatrix = XMLoadFloat4x4(&viewProjection);
+
+    size_t submitCount = visibleMeshes ? visibleMeshes->size() : meshes.size();
+    for (size_t n = 0; n < submitCount; n++)
+    {
+        uint32_t i = visibleMeshes ? (*visibleMeshes)[n] : static_cast<uint32_t>(n);
+        const XMFLOAT4X4& model = worldTransforms[meshNodeIndices[i]];
+
+        // Clip space w of the node origin is its view depth under a perspective projection
+        XMVECTOR origin = XMVectorSet(model._41, model._42, model._43, 1.0f);
+        float viewDepth = XMVectorGetW(XMVector4Transform(origin, viewProjectionMatrix));
+
+        Submit(pass, pipeline, meshes[i], perItemDrawSets[meshes[i].GetLocalMaterialIndex()], model, viewDepth, meshLODs ? (*meshLODs)[i] : 0);
+    }
+}
+
+void RenderQueue::Sort()
+{
+    // LSD radix sort, 8 bits per digit. All digit histograms are built in one sweep and
+    // digits every key shares (e.g. a single pass or pipeline) are skipped entirely.
+    const size_t count = SortEntries.size();
+    if (count < 2)
+        return;
+
+    uint32_t histograms[8][256] = {};
+    for (const SortEntry& entry : SortEntries)
+        for (uint32_t digit = 0; digit < 8; digit++)
+            histograms[digit][(entry.Key >> (digit * 8)) & 0xFF]++;
+
+    SortScratch.resize(count);
+
+    for (uint32_t digit = 0; digit < 8; digit++)
+    {
+        uint32_t* histogram = histograms[digit];
+        uint32_t shift = digit * 8;
+
+        if (histogram[(SortEntries[0].Key >> shift) & 0xFF] == count)
+            continue;
+
+        uint32_t offset = 0;
+        for (uint32_t bucket = 0; bucket < 256; bucket++)
+        {
+            uint32_t bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+
+        for (const SortEntry& entry : SortEntries)
+            SortScratch[histogram[(entry.Key >> shift) & 0xFF]++] = entry;
+
+        SortEntries.swap(SortScratch);
+    }
+}
+
+void RenderQueue::Execute(RenderPassExecutor* executor, uint32_t pass, const XMFLOAT4X4& camera)
+{
+    auto passBegin = std::lower_bound(SortEntries.begin(), SortEntries.end(), pass,
+        [](const SortEntry& entry, uint32_t value) { return RenderSortKey::GetPass(entry.Key) < value; });
+
+    auto iterator = passBegin;
+    while (iterator != SortEntries.end() && RenderSortKey::GetPass(iterator->Key) == pass)
+    {
+        Pipeline* pipeline = Items[iterator->ItemIndex].TargetPipeline;
+        executor->BindPipeline(pipeline);
+
+        Batches.clear();
+        Instances.clear();
+
+        // Adjacent items sharing material and geometry collapse into one instanced draw
+        for (; iterator != SortEntries.end() && RenderSortKey::GetPass(iterator->Key) == pass; ++iterator)
+        {
+            const RenderItem& item = Items[iterator->ItemIndex];
+            if (item.TargetPipeline != pipeline)
+                break;
+
+            bool sameBatch = !Batches.empty() &&
+                Batches.back().MaterialSetID == item.MaterialSetID &&
+                Batches.back().VertexBufferID == item.VertexBufferID &&
+                Batches.back().IndexBufferID == item.IndexBufferID &&
+                Batches.back().VertexOffset == item.VertexOffset &&
+                Batches.back().FirstIndex == item.FirstIndex;
+
+            if (!sameBatch)
+            {
+                InstanceBatch batch;
+                batch.VertexBufferID = item.VertexBufferID;
+                batch.IndexBufferID = item.IndexBufferID;
+                batch.MeshletBufferID = item.MeshletBufferID;
+                batch.MeshletCount = item.MeshletCount;
+                batch.MaterialSetID = item.MaterialSetID;
+                batch.VertexCount = item.VertexCount;
+                batch.VertexOffset = item.VertexOffset;
+                batch.FirstIndex = item.FirstIndex;
+                batch.IndexCount = item.IndexCount;
+                batch.IndexFormat = item.IndexFormat;
+                batch.FirstInstance = static_cast<uint32_t>(Instances.size());
+                Batches.push_back(batch);
+            }
+
+            Batches.back().InstanceCount++;
+            Instances.push_back(InstanceData { item.Model });
+        }
+
+        executor->DrawInstanced(Batches, Instances, camera);
+    }
+}
+
+uint32_t RenderQueue::GetPipelineSlot(Pipeline* pipeline)
+{
+    auto [iterator, inserted] = PipelineSlots.try_emplace(pipeline, static_cast<uint32_t>(PipelineSlots.size()));
+
+    if (iterator->second > RenderSortKey::FieldMask(RenderSortKey::PipelineBits))
+        throw std::runtime_error("Too many pipelines for the render queue sort key.");
+
+    return iterator->second;
+}
+
+uint32_t RenderQueue::GetDepthBucket(float viewDepth) const
+{
+    float normalized = (viewDepth - NearPlane) / (FarPlane - NearPlane);
+    normalized = std::clamp(normalized, 0.0f, 1.0f);
+
+    return static_cast<uint32_t>(normalized * static_cast<float>(RenderSortKey::FieldMask(RenderSortKey::DepthBits)));
+}
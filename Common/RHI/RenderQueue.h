@@ -0,0 +1,103 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "RHIStructures.h"
+#include "InstanceBatcher.h"
+#include "Geometry/Mesh.h"
+#include "Geometry/Scene.h"
+
+class Pipeline;
+class RenderPassExecutor;
+
+// 64-bit draw sort key, most significant field first: pass | pipeline | material | mesh | depth bucket.
+// Material and mesh fields hold the low bits of their resource IDs, collisions only cost a batch split.
+namespace RenderSortKey
+{
+    inline constexpr uint32_t PassBits = 4;
+    inline constexpr uint32_t PipelineBits = 8;
+    inline constexpr uint32_t MaterialBits = 16;
+    inline constexpr uint32_t MeshBits = 16;
+    inline constexpr uint32_t DepthBits = 20;
+
+    inline constexpr uint32_t DepthShift = 0;
+    inline constexpr uint32_t MeshShift = DepthShift + DepthBits;
+    inline constexpr uint32_t MaterialShift = MeshShift + MeshBits;
+    inline constexpr uint32_t PipelineShift = MaterialShift + MaterialBits;
+    inline constexpr uint32_t PassShift = PipelineShift + PipelineBits;
+
+    static_assert(PassShift + PassBits == 64, "Sort key fields must fill 64 bits.");
+
+    inline constexpr uint64_t FieldMask(uint32_t bits) { return (uint64_t(1) << bits) - 1; }
+
+    inline constexpr uint64_t Make(uint32_t pass, uint32_t pipeline, uint64_t material, uint64_t mesh, uint32_t depthBucket)
+    {
+        return ((pass & FieldMask(PassBits)) << PassShift) |
+               ((pipeline & FieldMask(PipelineBits)) << PipelineShift) |
+               ((material & FieldMask(MaterialBits)) << MaterialShift) |
+               ((mesh & FieldMask(MeshBits)) << MeshShift) |
+               ((depthBucket & FieldMask(DepthBits)) << DepthShift);
+    }
+
+    inline constexpr uint32_t GetPass(uint64_t key) { return static_cast<uint32_t>(key >> PassShift); }
+}
+
+struct RenderItem
+{
+    Pipeline* TargetPipeline = nullptr;
+    uint64_t MaterialSetID = 0;
+    uint64_t VertexBufferID = 0;
+    uint64_t IndexBufferID = 0;
+    uint64_t MeshletBufferID = 0;
+    uint32_t MeshletCount = 0;
+    uint32_t VertexCount = 0;
+    uint32_t VertexOffset = 0;
+    uint32_t FirstIndex = 0;
+    uint32_t IndexCount = 0;
+    RHIStructures::IndexFormat IndexFormat = RHIStructures::IndexFormat::UInt32;
+    DirectX::XMFLOAT4X4 Model;
+};
+
+class RenderQueue
+{
+public:
+
+    void Reset();
+    void SetDepthRange(float nearPlane, float farPlane)     { NearPlane = nearPlane; FarPlane = farPlane; }
+
+    void Submit(uint32_t pass, Pipeline* pipeline, const Mesh& mesh, uint64_t materialSetID, const DirectX::XMFLOAT4X4& model, float viewDepth,
+                uint32_t lod = 0);
+    // visibleMeshes optionally restricts submission to a culled list of scene mesh indices, meshLODs holds a LOD per scene mesh
+    void SubmitScene(uint32_t pass, Pipeline* pipeline, const Scene& scene, const std::vector<uint64_t>& perItemDrawSets, const DirectX::XMFLOAT4X4& viewProjection,
+                     const std::vector<uint32_t>* visibleMeshes = nullptr, const std::vector<uint8_t>* meshLODs = nullptr);
+
+    // Radix sorts the submitted keys, must be called before Execute
+    void Sort();
+    void Execute(RenderPassExecutor* executor, uint32_t pass, const DirectX::XMFLOAT4X4& camera);
+
+    size_t GetItemCount() const                             { return Items.size(); }
+
+private:
+
+    struct SortEntry
+    {
+        uint64_t Key;
+        uint32_t ItemIndex;
+    };
+
+    uint32_t GetPipelineSlot(Pipeline* pipeline);
+    uint32_t GetDepthBucket(float viewDepth) const;
+
+    std::vector<RenderItem> Items;
+    std::vector<SortEntry> SortEntries;
+    std::vector<SortEntry> SortScratch;
+    std::unordered_map<Pipeline*, uint32_t> PipelineSlots;
+
+    std::vector<InstanceBatch> Batches;
+    std::vector<RHIStructures::InstanceData> Instances;
+
+    float NearPlane = 0.1f;
+    float FarPlane = 100.0f;
+};
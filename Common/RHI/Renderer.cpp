@@ -1,11 +1,29 @@
 ﻿#include "Renderer.h"
 
+#include <iostream>
+
+#include "RHIStructures.h"
 #include "../GraphicsSettings.h"
 #include "../DirectX12/D3DCore.h"
 #include "../Vulkan/VulkanCore.h"
 
+uint64_t Renderer::FrameNumber = 0;
+
 void Renderer::StartRender(Window* window, CoreInitData data)
 {
+    // A vertex format whose shader variant was never compiled would only fail once the pipeline is created, after
+    // every mesh was already imported in it
+    if (GRAPHICS_SETTINGS.CompactVertices && !RHIStructures::ShaderExists("vs_pbr_compact"))
+    {
+        std::cerr << "vs_pbr_compact has not been compiled, run Common/CompileShaders.bat. Using full vertices." << std::endl;
+        GRAPHICS_SETTINGS.CompactVertices = false;
+    }
+    if (GRAPHICS_SETTINGS.Meshlets && (!RHIStructures::ShaderExists("ts_meshlet") || !RHIStructures::ShaderExists("ms_meshlet")))
+    {
+        std::cerr << "ts_meshlet or ms_meshlet has not been compiled, run Common/CompileShaders.bat. Drawing without meshlets." << std::endl;
+        GRAPHICS_SETTINGS.Meshlets = false;
+    }
+    
     switch (GRAPHICS_SETTINGS.APIToUse)
     {
     case DirectX12:
@@ -54,6 +72,19 @@ void Renderer::EndFrame()
         VulkanCore::GetInstance().EndFrame();
         break;
     }
+    FrameNumber++;
+}
+
+uint32_t Renderer::GetFramesInFlight()
+{
+    switch (GRAPHICS_SETTINGS.APIToUse)
+    {
+    case DirectX12:
+        return D3DCore::GetFrameCount();
+    case Vulkan:
+        return VulkanCore::GetInstance().GetSwapchainImageCount();
+    }
+    return 0;
 }
 
 void Renderer::GetSwapChainRenderTargets(void*& outBackBufferView, void*& outBackBuffer)
@@ -1,4 +1,5 @@
 ﻿#pragma once
+#include <cstdint>
 #include <vector>
 
 class Window;
@@ -18,4 +19,12 @@ public:
     static void EndFrame();
     static void GetSwapChainRenderTargets(void*& outBackBufferView, void*& outBackBuffer);
     static void Wait();
+    // Frames the CPU may record ahead of the GPU, resources a frame used are safe to free this many frames later
+    static uint32_t GetFramesInFlight();
+    // Frames submitted so far, counted by EndFrame
+    static uint64_t GetFrameNumber()                    { return FrameNumber; }
+
+private:
+
+    static uint64_t FrameNumber;
 };
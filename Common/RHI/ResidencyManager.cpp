@@ -0,0 +1,302 @@
+#include "ResidencyManager.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+#include "BufferAllocator.h"
+#include "Renderer.h"
+#include "TextureCache.h"
+#include "Image/BlockCompression.h"
+#include "../Windows/MappedFile.h"
+
+using namespace DirectX;
+using namespace RHIStructures;
+
+ResidencyManager& ResidencyManager::GetInstance()
+{
+    static ResidencyManager instance;
+    return instance;
+}
+
+uint64_t ResidencyManager::Register(const std::string& key, MappedFile* file, const ImageDesc& desc)
+{
+    StreamedTexture& texture = Textures[key];
+    texture.File = file;
+    texture.Desc = desc;
+
+    uint32_t topSize = std::max(desc.Width, desc.Height);
+    while (texture.TailMip + 1 < desc.MipLevels && (topSize >> texture.TailMip) > MinResidentSize)
+        texture.TailMip++;
+
+    texture.ResidentMip = texture.TailMip;
+    texture.WantedMip = texture.TailMip;
+    texture.ImageID = UploadLevels(texture, texture.TailMip);
+    ResidentBytes += ChainSize(desc, texture.TailMip);
+    return texture.ImageID;
+}
+
+void ResidencyManager::Unregister(const std::string& key)
+{
+    auto it = Textures.find(key);
+    if (it == Textures.end())
+        return;
+
+    // The mapping only backs uploads, the image itself may still be sampled by frames in flight
+    StreamedTexture& texture = it->second;
+    Retired.push_back({ FrameNumber, texture.ImageID, {} });
+    ResidentBytes -= ChainSize(texture.Desc, texture.ResidentMip);
+    delete texture.File;
+    Textures.erase(it);
+}
+
+void ResidencyManager::TrackDescriptorSet(uint64_t setID, const std::vector<std::string>& textureKeys)
+{
+    DescriptorSetKeys[setID] = textureKeys;
+    for (const std::string& key : textureKeys)
+    {
+        auto it = Textures.find(key);
+        if (it != Textures.end())
+            it->second.DescriptorSets.push_back(setID);
+    }
+}
+
+void ResidencyManager::UntrackDescriptorSet(uint64_t setID)
+{
+    auto it = DescriptorSetKeys.find(setID);
+    if (it == DescriptorSetKeys.end())
+        return;
+
+    for (const std::string& key : it->second)
+    {
+        auto texture = Textures.find(key);
+        if (texture != Textures.end())
+            std::erase(texture->second.DescriptorSets, setID);
+    }
+    DescriptorSetKeys.erase(it);
+}
+
+void ResidencyManager::RetireDescriptorSet(uint64_t setID)
+{
+    UntrackDescriptorSet(setID);
+    Retired.push_back({ FrameNumber, NoImage, { setID } });
+}
+
+void ResidencyManager::MarkUsed(uint64_t setID, float screenPixels)
+{
+    auto it = DescriptorSetKeys.find(setID);
+    if (it == DescriptorSetKeys.end())
+        return;
+
+    for (const std::string& key : it->second)
+    {
+        auto texture = Textures.find(key);
+        if (texture == Textures.end())
+            continue;
+        texture->second.LastUsedFrame = FrameNumber;
+        texture->second.FrameScreenPixels = std::max(texture->second.FrameScreenPixels, screenPixels);
+    }
+}
+
+void ResidencyManager::MarkScene(const Scene& scene, const std::vector<uint64_t>& perItemDrawSets, const XMFLOAT4X4& view,
+                                 const XMFLOAT4X4& projection, float viewportHeight, const std::vector<uint32_t>* visibleMeshes)
+{
+    const std::vector<Mesh>& meshes = scene.GetMeshes();
+    const std::vector<BoundingSphere>& meshSpheres = scene.GetMeshSpheres();
+    const std::vector<uint32_t>& meshNodeIndices = scene.GetMeshNodeIndices();
+    const std::vector<XMFLOAT4X4>& worldTransforms = scene.GetWorldTransforms();
+
+    // Same projection as LODSelector, the sphere's diameter in pixels at its nearest point
+    XMMATRIX inverseView = XMMatrixInverse(nullptr, XMLoadFloat4x4(&view));
+    XMVECTOR eye = inverseView.r[3];
+    float pixelsAtUnitDistance = projection._22 * viewportHeight * 0.5f;
+
+    size_t markCount = visibleMeshes ? visibleMeshes->size() : meshes.size();
+    for (size_t n = 0; n < markCount; n++)
+    {
+        uint32_t i = visibleMeshes ? (*visibleMeshes)[n] : static_cast<uint32_t>(n);
+
+        XMMATRIX world = XMLoadFloat4x4(&worldTransforms[meshNodeIndices[i]]);
+        XMVECTOR center = XMVector3Transform(XMLoadFloat3(&meshSpheres[i].Center), world);
+        float scale = std::max({ XMVectorGetX(XMVector3Length(world.r[0])), XMVectorGetX(XMVector3Length(world.r[1])),
+                                 XMVectorGetX(XMVector3Length(world.r[2])) });
+        float radius = meshSpheres[i].Radius * scale;
+
+        // Cameras inside the sphere want full resolution
+        float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(center, eye))) - radius;
+        float screenPixels = distance > 0.0f ? 2.0f * radius * pixelsAtUnitDistance / distance : FLT_MAX;
+        MarkUsed(perItemDrawSets[meshes[i].GetLocalMaterialIndex()], screenPixels);
+    }
+}
+
+void ResidencyManager::Update()
+{
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    LastStatistics = {};
+    FreeRetired();
+
+    // Textures drawn this frame ask for their level again, unused ones keep their last request until evicted
+    std::vector<std::pair<const std::string*, StreamedTexture*>> candidates;
+    for (auto& [key, texture] : Textures)
+    {
+        if (texture.LastUsedFrame == FrameNumber)
+        {
+            texture.ScreenPixels = texture.FrameScreenPixels;
+            texture.WantedMip = MipForPixels(texture, texture.ScreenPixels);
+            texture.FrameScreenPixels = 0.0f;
+        }
+        if (texture.WantedMip < texture.ResidentMip)
+            candidates.emplace_back(&key, &texture);
+    }
+
+    // Most recently used and largest on screen first
+    std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b)
+    {
+        if (a.second->LastUsedFrame != b.second->LastUsedFrame)
+            return a.second->LastUsedFrame > b.second->LastUsedFrame;
+        return a.second->ScreenPixels > b.second->ScreenPixels;
+    });
+
+    // One level per texture per frame keeps single uploads small, the view swaps as each level arrives
+    for (auto& [key, texture] : candidates)
+    {
+        if (LastStatistics.UploadedBytes >= UploadLimit)
+            break;
+
+        uint32_t target = texture->ResidentMip - 1;
+        uint64_t growth = ChainSize(texture->Desc, target) - ChainSize(texture->Desc, texture->ResidentMip);
+        if (!MakeRoom(growth, texture))
+            break;
+        Restream(*key, *texture, target);
+    }
+
+    // A lowered budget sheds levels even when nothing streams in
+    MakeRoom(0, nullptr);
+
+    FrameNumber++;
+
+    LastStatistics.Textures = static_cast<uint32_t>(Textures.size());
+    LastStatistics.ResidentBytes = ResidentBytes;
+    LastStatistics.BudgetBytes = BudgetBytes;
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+    LastStatistics.Milliseconds = elapsed.count();
+}
+
+uint64_t ResidencyManager::ChainSize(const ImageDesc& desc, uint32_t firstMip)
+{
+    uint64_t size = 0;
+    for (uint32_t mip = firstMip; mip < desc.MipLevels; mip++)
+        size += BlockCompression::LevelSize(desc.Format, std::max(desc.Width >> mip, 1u), std::max(desc.Height >> mip, 1u));
+    return size;
+}
+
+uint32_t ResidencyManager::MipForPixels(const StreamedTexture& texture, float screenPixels)
+{
+    // One texel per pixel across the object, assuming its UVs cover the texture about once
+    float topSize = static_cast<float>(std::max(texture.Desc.Width, texture.Desc.Height));
+    if (screenPixels >= topSize)
+        return 0;
+
+    float mip = std::floor(std::log2(topSize / std::max(screenPixels, 1.0f)));
+    return std::min(static_cast<uint32_t>(mip), texture.TailMip);
+}
+
+uint64_t ResidencyManager::UploadLevels(const StreamedTexture& texture, uint32_t firstMip)
+{
+    // Levels are tightly packed in the cooked file, the new image starts firstMip levels in
+    uint64_t skipped = texture.Desc.Size - ChainSize(texture.Desc, firstMip);
+
+    ImageDesc desc = texture.Desc;
+    desc.Width = std::max(texture.Desc.Width >> firstMip, 1u);
+    desc.Height = std::max(texture.Desc.Height >> firstMip, 1u);
+    desc.MipLevels = texture.Desc.MipLevels - firstMip;
+    desc.Size = texture.Desc.Size - skipped;
+    desc.InitialData = static_cast<const uint8_t*>(texture.Desc.InitialData) + skipped;
+
+    LastStatistics.UploadedBytes += desc.Size;
+    return BufferAllocator::GetInstance()->CreateImage(desc);
+}
+
+void ResidencyManager::Restream(const std::string& key, StreamedTexture& texture, uint32_t firstMip)
+{
+    BufferAllocator* bufferAllocator = BufferAllocator::GetInstance();
+
+    RetiredResources retired;
+    retired.Frame = FrameNumber;
+    retired.ImageID = texture.ImageID;
+
+    ResidentBytes = ResidentBytes - ChainSize(texture.Desc, texture.ResidentMip) + ChainSize(texture.Desc, firstMip);
+    if (firstMip < texture.ResidentMip)
+        LastStatistics.StreamedIn++;
+    else
+        LastStatistics.StreamedOut++;
+
+    texture.ImageID = UploadLevels(texture, firstMip);
+    texture.ResidentMip = firstMip;
+
+    // Every set using the texture gets a new set with the current image of each binding
+    for (uint64_t setID : texture.DescriptorSets)
+    {
+        const std::vector<std::string>& keys = DescriptorSetKeys.at(setID);
+        std::vector<DescriptorSetBinding> bindings;
+        bindings.reserve(keys.size());
+        for (uint32_t i = 0; i < keys.size(); i++)
+        {
+            bindings.emplace_back(DescriptorSetBinding {
+                .Binding = i,
+                .ResourceID = keys[i] == key ? texture.ImageID : TextureCache::GetInstance().GetImage(keys[i])
+            });
+        }
+        retired.DescriptorSets.push_back(bufferAllocator->RebindDescriptorSet(setID, bindings));
+    }
+
+    Retired.push_back(std::move(retired));
+}
+
+bool ResidencyManager::MakeRoom(uint64_t bytes, const StreamedTexture* requester)
+{
+    while (ResidentBytes + bytes > BudgetBytes)
+    {
+        // Least recently used first, then the smallest on screen. Only textures less important than the requester give way.
+        const std::string* victimKey = nullptr;
+        StreamedTexture* victim = nullptr;
+        for (auto& [key, texture] : Textures)
+        {
+            if (&texture == requester || texture.ResidentMip >= texture.TailMip)
+                continue;
+            if (requester && (texture.LastUsedFrame > requester->LastUsedFrame ||
+                (texture.LastUsedFrame == requester->LastUsedFrame && texture.ScreenPixels >= requester->ScreenPixels)))
+                continue;
+            if (!victim || texture.LastUsedFrame < victim->LastUsedFrame ||
+                (texture.LastUsedFrame == victim->LastUsedFrame && texture.ScreenPixels < victim->ScreenPixels))
+            {
+                victimKey = &key;
+                victim = &texture;
+            }
+        }
+
+        if (!victim)
+            return false;
+        Restream(*victimKey, *victim, victim->ResidentMip + 1);
+    }
+    return true;
+}
+
+void ResidencyManager::FreeRetired()
+{
+    BufferAllocator* bufferAllocator = BufferAllocator::GetInstance();
+    uint64_t framesInFlight = Renderer::GetFramesInFlight();
+
+    std::erase_if(Retired, [&](const RetiredResources& retired)
+    {
+        if (retired.Frame + framesInFlight > FrameNumber)
+            return false;
+        for (uint64_t setID : retired.DescriptorSets)
+            bufferAllocator->FreeDescriptorSet(setID);
+        if (retired.ImageID != NoImage)
+            bufferAllocator->FreeImage(retired.ImageID);
+        return true;
+    });
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <DirectXMath.h>
+
+#include "RHIStructures.h"
+#include "Geometry/Scene.h"
+
+class MappedFile;
+
+// Streams mip levels of cooked textures against a VRAM budget. A texture starts with its mip tail resident and moves
+// towards the level its largest on screen use needs, one level per frame. Over budget, the least recently used and then
+// smallest on screen textures give up their top levels first. A residency change uploads a new image from the mapped
+// cooked file and rebinds the descriptor sets using it, the replaced image and sets are freed once no frame in flight
+// can reference them. Render thread only.
+class ResidencyManager
+{
+public:
+
+    struct Statistics
+    {
+        uint32_t Textures = 0;
+        uint64_t ResidentBytes = 0;
+        uint64_t BudgetBytes = 0;
+        uint32_t StreamedIn = 0;
+        uint32_t StreamedOut = 0;
+        uint64_t UploadedBytes = 0;
+        double Milliseconds = 0.0;
+    };
+
+    static ResidencyManager& GetInstance();
+
+    void SetBudget(uint64_t bytes)                  { BudgetBytes = bytes; }
+    uint64_t GetBudget() const                      { return BudgetBytes; }
+    // Bounds the upload work of a single Update
+    void SetUploadLimit(uint64_t bytesPerFrame)     { UploadLimit = bytesPerFrame; }
+
+    // Takes over a cooked texture, desc describes the full mip chain inside file. Uploads the mip tail and returns its image.
+    uint64_t Register(const std::string& key, MappedFile* file, const RHIStructures::ImageDesc& desc);
+    // Frees the texture's image once the frames in flight are done with it
+    void Unregister(const std::string& key);
+    bool IsStreamed(const std::string& key) const   { return Textures.contains(key); }
+    uint64_t GetImage(const std::string& key) const { return Textures.at(key).ImageID; }
+
+    // Descriptor set whose bindings are the given TextureCache keys in binding order, rebound as those textures change
+    void TrackDescriptorSet(uint64_t setID, const std::vector<std::string>& textureKeys);
+    void UntrackDescriptorSet(uint64_t setID);
+    // Untracks the set and frees it once the frames in flight are done binding it
+    void RetireDescriptorSet(uint64_t setID);
+
+    // setID is drawn this frame covering screenPixels, the projected diameter of the object it is drawn on
+    void MarkUsed(uint64_t setID, float screenPixels);
+    // MarkUsed for the material set of every visible mesh, sized by its bounding sphere
+    void MarkScene(const Scene& scene, const std::vector<uint64_t>& perItemDrawSets, const DirectX::XMFLOAT4X4& view,
+                   const DirectX::XMFLOAT4X4& projection, float viewportHeight, const std::vector<uint32_t>* visibleMeshes = nullptr);
+
+    // Once per frame after the frame's uses were marked
+    void Update();
+
+    const Statistics& GetStatistics() const         { return LastStatistics; }
+
+private:
+
+    struct StreamedTexture
+    {
+        MappedFile* File = nullptr;
+        RHIStructures::ImageDesc Desc {};
+        uint64_t ImageID = 0;
+        uint32_t ResidentMip = 0;
+        uint32_t WantedMip = 0;
+        // Coarsest level that ever needs to go, everything from here down always stays resident
+        uint32_t TailMip = 0;
+        uint64_t LastUsedFrame = 0;
+        float FrameScreenPixels = 0.0f;
+        float ScreenPixels = 0.0f;
+        std::vector<uint64_t> DescriptorSets;
+    };
+
+    static constexpr uint64_t NoImage = UINT64_MAX;
+
+    struct RetiredResources
+    {
+        uint64_t Frame = 0;
+        uint64_t ImageID = NoImage;
+        std::vector<uint64_t> DescriptorSets;
+    };
+
+    static constexpr uint32_t MinResidentSize = 64;
+    static constexpr uint64_t DefaultBudget = 512ull * 1024 * 1024;
+    static constexpr uint64_t DefaultUploadLimit = 32ull * 1024 * 1024;
+
+    ResidencyManager() = default;
+
+    std::unordered_map<std::string, StreamedTexture> Textures;
+    std::unordered_map<uint64_t, std::vector<std::string>> DescriptorSetKeys;
+    std::vector<RetiredResources> Retired;
+
+    uint64_t BudgetBytes = DefaultBudget;
+    uint64_t UploadLimit = DefaultUploadLimit;
+    uint64_t ResidentBytes = 0;
+    uint64_t FrameNumber = 1;
+    Statistics LastStatistics;
+
+    static uint64_t ChainSize(const RHIStructures::ImageDesc& desc, uint32_t firstMip);
+    static uint32_t MipForPixels(const StreamedTexture& texture, float screenPixels);
+    uint64_t UploadLevels(const StreamedTexture& texture, uint32_t firstMip);
+    // Uploads levels firstMip and below as the texture's new image, rebinds its sets and retires the old ones
+    void Restream(const std::string& key, StreamedTexture& texture, uint32_t firstMip);
+    // Drops top levels of less important textures until bytes more fit in the budget, false when nothing can go
+    bool MakeRoom(uint64_t bytes, const StreamedTexture* requester);
+    void FreeRetired();
+};
@@ -0,0 +1,163 @@
+#include "TextureCache.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+
+#include "BufferAllocator.h"
+#include "RHIConstants.h"
+#include "RHIStructures.h"
+#include "ResidencyManager.h"
+#include "Image/ImageImport.h"
+#include "../GraphicsSettings.h"
+#include "../Windows/MappedFile.h"
+
+using namespace RHIStructures;
+using namespace RHIConstants;
+
+PreBufferCache::~PreBufferCache()
+{
+    delete ImportHandle;
+    delete CookedFile;
+    delete Desc;
+}
+
+TextureCache& TextureCache::GetInstance()
+{
+    static TextureCache instance;
+    return instance;
+}
+
+std::string TextureCache::MakeKey(const std::vector<std::string>& sourcePaths, TextureCooker::Usage usage)
+{
+    // Cooking changes the uploaded format, so the same sources cooked and uncooked are different textures
+    std::string key = std::to_string(static_cast<uint32_t>(usage)) + (GRAPHICS_SETTINGS.CookTextures ? "c" : "u");
+    for (const std::string& path : sourcePaths)
+    {
+        std::error_code error;
+        std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+        key += '|';
+        key += error ? path : canonical.generic_string();
+    }
+    return key;
+}
+
+std::string TextureCache::MakeConstantKey(const std::array<uint8_t, 4>& colour)
+{
+    char key[24];
+    snprintf(key, sizeof(key), "constant|%02x%02x%02x%02x", colour[0], colour[1], colour[2], colour[3]);
+    return key;
+}
+
+PreBufferCache* TextureCache::CreateConstant(const std::array<uint8_t, 4>& colour)
+{
+    PreBufferCache* cache = new PreBufferCache();
+    cache->Constant = colour;
+    cache->Desc = new ImageDesc(DefaultTextureDesc);
+    cache->Desc->Width = 1;
+    cache->Desc->Height = 1;
+    cache->Desc->Size = sizeof(cache->Constant);
+    cache->Desc->InitialData = cache->Constant.data();
+    return cache;
+}
+
+void TextureCache::Acquire(const std::string& key, const std::function<PreBufferCache*()>& load)
+{
+    Entry* entry;
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        std::unique_ptr<Entry>& slot = Entries[key];
+        if (!slot)
+            slot = std::make_unique<Entry>();
+        entry = slot.get();
+
+        if (entry->References++ == 0)
+            Counters.Misses++;
+        else
+            Counters.Hits++;
+    }
+
+    // A failed load leaves the flag unset so the next reference retries
+    try
+    {
+        std::call_once(entry->LoadOnce, [&]() { entry->Loaded = load(); });
+    }
+    catch (...)
+    {
+        Release(key);
+        throw;
+    }
+}
+
+uint64_t TextureCache::GetImage(const std::string& key)
+{
+    Entry* entry = Find(key);
+    if (!entry || !entry->References)
+        throw std::runtime_error("Texture " + key + " was not acquired.");
+
+    if (entry->Uploaded)
+        return entry->Streamed ? ResidencyManager::GetInstance().GetImage(key) : entry->ImageID;
+
+    // Cooked textures stream from their mapping, which the ResidencyManager keeps from here on
+    MappedFile* cookedFile = entry->Loaded->CookedFile;
+    if (GRAPHICS_SETTINGS.TextureStreaming && cookedFile && cookedFile->GetData())
+    {
+        entry->ImageID = ResidencyManager::GetInstance().Register(key, cookedFile, *entry->Loaded->Desc);
+        entry->Loaded->CookedFile = nullptr;
+        entry->Streamed = true;
+        entry->Uploaded = true;
+        
+        delete entry->Loaded;
+        entry->Loaded = nullptr;
+        return entry->ImageID;
+    }
+
+    // Decoded sources write their texels once, straight into the staging memory, cooked ones copy out of the mapping
+    BufferAllocator* bufferAllocator = BufferAllocator::GetInstance();
+    const ImageImport* import = entry->Loaded->ImportHandle;
+    entry->ImageID = import
+        ? bufferAllocator->CreateImage(*entry->Loaded->Desc, [import](uint8_t* destination, uint32_t, uint64_t rowPitch) { import->WritePixels(destination, rowPitch); })
+        : bufferAllocator->CreateImage(*entry->Loaded->Desc);
+    entry->Uploaded = true;
+
+    delete entry->Loaded;
+    entry->Loaded = nullptr;
+    return entry->ImageID;
+}
+
+void TextureCache::Release(const std::string& key)
+{
+    std::unique_ptr<Entry> released;
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        auto it = Entries.find(key);
+        if (it == Entries.end() || it->second->References == 0)
+            return;
+        if (--it->second->References > 0)
+            return;
+
+        released = std::move(it->second);
+        Entries.erase(it);
+    }
+
+    if (released->Streamed)
+        ResidencyManager::GetInstance().Unregister(key);
+    else if (released->Uploaded)
+        BufferAllocator::GetInstance()->FreeImage(released->ImageID);
+    delete released->Loaded;
+}
+
+TextureCache::Statistics TextureCache::GetStatistics()
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    Statistics statistics = Counters;
+    statistics.ResidentTextures = static_cast<uint32_t>(Entries.size());
+    return statistics;
+}
+
+TextureCache::Entry* TextureCache::Find(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    auto it = Entries.find(key);
+    return it == Entries.end() ? nullptr : it->second.get();
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Image/TextureCooker.h"
+
+namespace RHIStructures
+{
+    struct ImageDesc;
+}
+
+class ImageImport;
+class MappedFile;
+
+// CPU side of a texture between loading and the upload
+struct PreBufferCache
+{
+    ImageImport* ImportHandle = nullptr;
+    // Holds the cooked texture Desc->InitialData points into until the upload
+    MappedFile* CookedFile = nullptr;
+    RHIStructures::ImageDesc* Desc = nullptr;
+    // Texel of constant colour 1x1 images
+    std::array<uint8_t, 4> Constant {};
+
+    ~PreBufferCache();
+};
+
+// Refcounted images shared between materials. Textures are keyed by their canonical source paths and import options,
+// constant colour fallbacks by their value, so every distinct texture decodes and uploads once.
+class TextureCache
+{
+public:
+
+    struct Statistics
+    {
+        uint32_t Hits = 0;
+        uint32_t Misses = 0;
+        uint32_t ResidentTextures = 0;
+    };
+
+    static TextureCache& GetInstance();
+
+    static std::string MakeKey(const std::vector<std::string>& sourcePaths, TextureCooker::Usage usage);
+    static std::string MakeConstantKey(const std::array<uint8_t, 4>& colour);
+    // 1x1 RGBA8 texture of colour
+    static PreBufferCache* CreateConstant(const std::array<uint8_t, 4>& colour);
+
+    // Adds a reference to key. The first reference runs load on the calling thread, concurrent ones wait for it.
+    // Safe to call from ThreadPool workers.
+    void Acquire(const std::string& key, const std::function<PreBufferCache*()>& load);
+    // Current image of an acquired key, uploaded and stripped of its CPU data on first call. Render thread only, like BufferAllocator.
+    uint64_t GetImage(const std::string& key);
+    // Drops a reference, the last one frees the image
+    void Release(const std::string& key);
+
+    Statistics GetStatistics();
+
+private:
+
+    struct Entry
+    {
+        uint32_t References = 0;
+        std::once_flag LoadOnce;
+        PreBufferCache* Loaded = nullptr;
+        bool Uploaded = false;
+        // Streamed textures hand their image over to the ResidencyManager, which swaps it as levels come and go
+        bool Streamed = false;
+        uint64_t ImageID = 0;
+    };
+
+    TextureCache() = default;
+
+    std::mutex Mutex;
+    // Entries stay put while referenced, so loads and uploads run outside the lock
+    std::unordered_map<std::string, std::unique_ptr<Entry>> Entries;
+    Statistics Counters;
+
+    Entry* Find(const std::string& key);
+};
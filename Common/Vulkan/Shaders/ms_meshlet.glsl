@@ -0,0 +1,88 @@
+#version 460
+#extension GL_EXT_mesh_shader : require
+#extension GL_EXT_buffer_reference : require
+
+// One workgroup per meshlet that survived the task stage, one invocation per meshlet vertex
+layout(local_size_x = 64) in;
+layout(triangles, max_vertices = 64, max_primitives = 124) out;
+
+layout(buffer_reference, std430) readonly buffer MeshletBuffer {
+    uint data[];
+};
+
+// Full RHIStructures::Vertex, 14 floats: position, normal, tangent, binormal, uv
+layout(buffer_reference, std430) readonly buffer VertexBuffer {
+    float data[];
+};
+
+layout(buffer_reference, std430) readonly buffer InstanceBuffer {
+    mat4 models[];
+};
+
+layout(push_constant, row_major) uniform MeshletConstants {
+    mat4 viewProjection;
+    MeshletBuffer meshlets;
+    VertexBuffer vertices;
+    InstanceBuffer instances;
+    uint meshletCount;
+    vec3 cameraPosition;
+} constants;
+
+struct TaskPayload {
+    uint meshletIndices[32];
+    uint instanceIndex;
+};
+
+taskPayloadSharedEXT TaskPayload payload;
+
+// Same outputs as vs_pbr so ps_pbr is shared between both paths
+layout(location = 0) out vec3 outWorldPosition[];
+layout(location = 1) out vec3 outNormal[];
+layout(location = 2) out vec3 outTangent[];
+layout(location = 3) out vec3 outBinormal[];
+layout(location = 4) out vec2 outUV[];
+
+const uint MESHLET_HEADER_WORDS = 4;
+const uint MESHLET_WORDS = 12;
+const uint VERTEX_FLOATS = 14;
+
+vec3 readVec3(uint offset)
+{
+    return vec3(constants.vertices.data[offset], constants.vertices.data[offset + 1], constants.vertices.data[offset + 2]);
+}
+
+void main() {
+    uint meshletIndex = payload.meshletIndices[gl_WorkGroupID.x];
+    uint base = MESHLET_HEADER_WORDS + meshletIndex * MESHLET_WORDS;
+    uint vertexOffset = constants.meshlets.data[base + 0];
+    uint triangleOffset = constants.meshlets.data[base + 1];
+    uint vertexCount = constants.meshlets.data[base + 2];
+    uint triangleCount = constants.meshlets.data[base + 3];
+    uint vertexIndexStart = constants.meshlets.data[1] + vertexOffset;
+    uint triangleStart = constants.meshlets.data[2] + triangleOffset;
+
+    SetMeshOutputsEXT(vertexCount, triangleCount);
+
+    mat4 model = constants.instances.models[payload.instanceIndex];
+    uint local = gl_LocalInvocationIndex;
+    if (local < vertexCount)
+    {
+        uint vertex = constants.meshlets.data[vertexIndexStart + local] * VERTEX_FLOATS;
+
+        vec4 worldPosition = model * vec4(readVec3(vertex), 1.0);
+        mat3 normalMatrix = mat3(transpose(inverse(model)));
+
+        gl_MeshVerticesEXT[local].gl_Position = worldPosition * constants.viewProjection;
+        outWorldPosition[local] = worldPosition.xyz;
+        outNormal[local]   = normalize(normalMatrix * readVec3(vertex + 3));
+        outTangent[local]  = normalize(normalMatrix * readVec3(vertex + 6));
+        outBinormal[local] = normalize(normalMatrix * readVec3(vertex + 9));
+        outUV[local] = vec2(constants.vertices.data[vertex + 12], constants.vertices.data[vertex + 13]);
+    }
+
+    for (uint triangle = local; triangle < triangleCount; triangle += 64)
+    {
+        uint packed = constants.meshlets.data[triangleStart + triangle];
+        gl_PrimitiveTriangleIndicesEXT[triangle] = uvec3(packed & 0xFF, (packed >> 8) & 0xFF, (packed >> 16) & 0xFF);
+    }
+}
@@ -21,8 +21,9 @@ layout(location = 3) out vec4 outPosition;         // R32G32B32A32_FLOAT
 void main() {
     vec3 albedo = texture(albedoMap, inUV).rgb;
 
-    // Sample and decode normal map
-    vec3 tangentNormal = texture(normalMap, inUV).rgb * 2 - 1;
+    // Sample and decode normal map, z is rebuilt so two channel BC5 maps decode the same as RGBA ones
+    vec2 tangentXY = texture(normalMap, inUV).rg * 2 - 1;
+    vec3 tangentNormal = vec3(tangentXY, sqrt(max(1.0 - dot(tangentXY, tangentXY), 0.0)));
 
     // Build TBN matrix - use TRANSPOSE if columns are wrong
     mat3 TBN = mat3(
@@ -0,0 +1,94 @@
+#version 460
+#extension GL_EXT_mesh_shader : require
+#extension GL_EXT_buffer_reference : require
+
+// One invocation per meshlet, x covers the meshlets of the mesh and y is the instance
+layout(local_size_x = 32) in;
+
+// uint4 header (meshlet count, vertex index offset, triangle offset), then 12 uints per meshlet:
+// vertex offset, triangle offset, vertex count, triangle count, sphere xyz radius, cone axis xyz cutoff
+layout(buffer_reference, std430) readonly buffer MeshletBuffer {
+    uint data[];
+};
+
+layout(buffer_reference, std430) readonly buffer VertexBuffer {
+    float data[];
+};
+
+layout(buffer_reference, std430) readonly buffer InstanceBuffer {
+    mat4 models[];
+};
+
+layout(push_constant, row_major) uniform MeshletConstants {
+    mat4 viewProjection;
+    MeshletBuffer meshlets;
+    VertexBuffer vertices;
+    InstanceBuffer instances;
+    uint meshletCount;
+    vec3 cameraPosition;
+} constants;
+
+struct TaskPayload {
+    uint meshletIndices[32];
+    uint instanceIndex;
+};
+
+taskPayloadSharedEXT TaskPayload payload;
+
+shared uint visibleCount;
+
+const uint MESHLET_HEADER_WORDS = 4;
+const uint MESHLET_WORDS = 12;
+
+bool isVisible(uint meshletIndex, mat4 model)
+{
+    uint base = MESHLET_HEADER_WORDS + meshletIndex * MESHLET_WORDS;
+    vec4 sphere = uintBitsToFloat(uvec4(constants.meshlets.data[base + 4], constants.meshlets.data[base + 5],
+                                        constants.meshlets.data[base + 6], constants.meshlets.data[base + 7]));
+    vec4 cone = uintBitsToFloat(uvec4(constants.meshlets.data[base + 8], constants.meshlets.data[base + 9],
+                                      constants.meshlets.data[base + 10], constants.meshlets.data[base + 11]));
+
+    vec3 center = (model * vec4(sphere.xyz, 1.0)).xyz;
+    float scale = max(length(model[0].xyz), max(length(model[1].xyz), length(model[2].xyz)));
+    float radius = sphere.w * scale;
+
+    // Frustum planes straight from the view projection columns (row vector convention, 0..1 depth)
+    mat4 vp = constants.viewProjection;
+    vec4 planes[6] = vec4[6](vp[3] + vp[0], vp[3] - vp[0], vp[3] + vp[1], vp[3] - vp[1], vp[2], vp[3] - vp[2]);
+    for (int i = 0; i < 6; i++)
+    {
+        if (dot(vec4(center, 1.0), planes[i]) < -radius * length(planes[i].xyz))
+            return false;
+    }
+
+    // Backface cone, every triangle faces away when the view direction falls inside the cone around the axis
+    if (cone.w < 1.0)
+    {
+        vec3 axis = normalize(mat3(model) * cone.xyz);
+        vec3 toCenter = center - constants.cameraPosition;
+        if (dot(toCenter, axis) >= cone.w * length(toCenter) + radius)
+            return false;
+    }
+
+    return true;
+}
+
+void main() {
+    if (gl_LocalInvocationIndex == 0)
+    {
+        visibleCount = 0;
+        payload.instanceIndex = gl_WorkGroupID.y;
+    }
+    barrier();
+
+    uint meshletIndex = gl_GlobalInvocationID.x;
+    mat4 model = constants.instances.models[gl_WorkGroupID.y];
+    if (meshletIndex < constants.meshletCount && isVisible(meshletIndex, model))
+    {
+        uint slot = atomicAdd(visibleCount, 1);
+        payload.meshletIndices[slot] = meshletIndex;
+    }
+    barrier();
+
+    EmitMeshTasksEXT(visibleCount, 1, 1);
+}
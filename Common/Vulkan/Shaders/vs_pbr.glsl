@@ -1,17 +1,27 @@
 #version 450
 
 // Vertex inputs
+#ifdef COMPACT_VERTICES
+// Quantized position with bitangent sign in w, octahedral normal and tangent, half UVs
+// Dequantization is folded into inModel on the CPU
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec2 inNormal;
+layout(location = 2) in vec2 inTangent;
+#else
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec3 inTangent;
 layout(location = 3) in vec3 inBinormal;
+#endif
 layout(location = 4) in vec2 inUV;
 
+// Per-instance inputs (one row of the model matrix per location)
+layout(location = 5) in mat4 inModel;
+
 // Uniform buffers
-layout(push_constant, row_major) uniform MVPData {
+layout(push_constant, row_major) uniform CameraData {
     mat4 viewProjection;
-    mat4 model;
-} mvpData;
+} cameraData;
 
 // Outputs to fragment shader
 layout(location = 0) out vec3 outWorldPosition;
@@ -20,17 +30,38 @@ layout(location = 2) out vec3 outTangent;
 layout(location = 3) out vec3 outBinormal;
 layout(location = 4) out vec2 outUV;
 
+#ifdef COMPACT_VERTICES
+vec3 decodeOctahedral(vec2 encoded)
+{
+    vec3 direction = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = max(-direction.z, 0.0);
+    direction.xy += mix(vec2(t), vec2(-t), greaterThanEqual(direction.xy, vec2(0.0)));
+    return normalize(direction);
+}
+#endif
 
 void main() {
-    vec4 worldPosition = vec4(inPosition, 1.0) * mvpData.model;
+#ifdef COMPACT_VERTICES
+    vec3 position = inPosition.xyz;
+    vec3 normal = decodeOctahedral(inNormal);
+    vec3 tangent = decodeOctahedral(inTangent);
+    vec3 binormal = cross(normal, tangent) * inPosition.w;
+#else
+    vec3 position = inPosition;
+    vec3 normal = inNormal;
+    vec3 tangent = inTangent;
+    vec3 binormal = inBinormal;
+#endif
+
+    vec4 worldPosition = inModel * vec4(position, 1.0);
     outWorldPosition = worldPosition.xyz;
 
-    mat3 normalMatrix = mat3(inverse(mvpData.model));
+    mat3 normalMatrix = mat3(transpose(inverse(inModel)));
     
-    gl_Position = worldPosition * mvpData.viewProjection;
-    outNormal   = normalize(normalMatrix * inNormal);
-    outTangent  = normalize(normalMatrix * inTangent);
-    outBinormal = normalize(normalMatrix * inBinormal);
+    gl_Position = worldPosition * cameraData.viewProjection;
+    outNormal   = normalize(normalMatrix * normal);
+    outTangent  = normalize(normalMatrix * tangent);
+    outBinormal = normalize(normalMatrix * binormal);
 
     outUV = inUV;
 }
\ No newline at end of file
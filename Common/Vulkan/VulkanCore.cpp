@@ -43,6 +43,7 @@ void VulkanCore::Cleanup()
 {
     vkQueueWaitIdle(GraphicsQueue);
     vkQueueWaitIdle(PresentQueue);
+    FlushDeferredReleases();
     
     vkDestroySampler(Device, PointSampler, nullptr);
     vkDestroySampler(Device, LinearSampler, nullptr);
@@ -145,9 +146,22 @@ void VulkanCore::CreateLogicalDevice()
         
         queueCreateInfos.push_back(queueInfo);
     }
+    std::vector<const char*> enabledExtensions = DEVICE_EXTENSIONS;
+    MeshShaderSupported = CheckMeshShaderSupport(PhysicalDevice);
+    
+    VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures = {};
+    meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+    meshShaderFeatures.taskShader = VK_TRUE;
+    meshShaderFeatures.meshShader = VK_TRUE;
+    
     VkPhysicalDeviceDescriptorBufferFeaturesEXT descriptorBufferFeatures = {};
     descriptorBufferFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT;
     descriptorBufferFeatures.descriptorBuffer = VK_TRUE;
+    if (MeshShaderSupported)
+    {
+        enabledExtensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+        descriptorBufferFeatures.pNext = &meshShaderFeatures;
+    }
     
     VkPhysicalDeviceVulkan12Features deviceFeatures12 = {};
     deviceFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
@@ -159,6 +173,7 @@ void VulkanCore::CreateLogicalDevice()
     deviceFeatures.samplerAnisotropy = VK_TRUE;     // Enable anisotropy feature
     deviceFeatures.geometryShader = VK_TRUE;        // Enable geometry shader feature
     deviceFeatures.depthClamp = VK_TRUE;            // Enable depth clamp feature
+    deviceFeatures.textureCompressionBC = VK_TRUE;  // Enable BC formats for cooked textures
 
     // Enable dynamic rendering feature
     VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeature{};
@@ -171,8 +186,8 @@ void VulkanCore::CreateLogicalDevice()
     deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     deviceInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     deviceInfo.pQueueCreateInfos = queueCreateInfos.data();
-    deviceInfo.enabledExtensionCount = static_cast<uint32_t>(DEVICE_EXTENSIONS.size());
-    deviceInfo.ppEnabledExtensionNames = DEVICE_EXTENSIONS.data();
+    deviceInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+    deviceInfo.ppEnabledExtensionNames = enabledExtensions.data();
     deviceInfo.pEnabledFeatures = &deviceFeatures;
     deviceInfo.pNext = &dynamicRenderingFeature;
 
@@ -195,6 +210,14 @@ void VulkanCore::CreateLogicalDevice()
 
     if (!vkCmdBindDescriptorBuffersEXT_FnPtr || !vkCmdSetDescriptorBufferOffsetsEXT_FnPtr || !vkGetDescriptorEXT_FnPtr)
         throw std::runtime_error("VK_EXT_descriptor_buffer functions not available (extension not enabled or unsupported).");
+    
+    if (MeshShaderSupported)
+    {
+        vkCmdDrawMeshTasksEXT_FnPtr =
+            reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT>(
+                vkGetDeviceProcAddr(Device, "vkCmdDrawMeshTasksEXT"));
+        MeshShaderSupported = vkCmdDrawMeshTasksEXT_FnPtr != nullptr;
+    }
 
     // Assign queue handles
     vkGetDeviceQueue(Device, indices.GraphicsFamily, 0, &GraphicsQueue);
@@ -666,6 +689,38 @@ bool VulkanCore::CheckDeviceExtensionSupport(VkPhysicalDevice device)
     return true;
 }
 
+bool VulkanCore::CheckMeshShaderSupport(VkPhysicalDevice device)
+{
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+    
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+    bool extensionFound = false;
+    for (const auto& availableExtension : availableExtensions)
+    {
+        if (strcmp(availableExtension.extensionName, VK_EXT_MESH_SHADER_EXTENSION_NAME) == 0)
+        {
+            extensionFound = true;
+            break;
+        }
+    }
+    
+    if (!extensionFound)
+        return false;
+    
+    VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures = {};
+    meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+    
+    VkPhysicalDeviceFeatures2 features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &meshShaderFeatures;
+    vkGetPhysicalDeviceFeatures2(device, &features);
+    
+    return meshShaderFeatures.taskShader && meshShaderFeatures.meshShader;
+}
+
 bool VulkanCore::CheckDeviceSuitability(VkPhysicalDevice device)
 {
     VkPhysicalDeviceProperties deviceProperties;
@@ -848,6 +903,19 @@ void VulkanCore::BeginFrame()
 {
     WaitForFrame(CurrentFrameIndex);
     
+    // The fence just waited on belongs to the frame submitted SwapChainImageCount frames ago, everything up to it is done.
+    // Releases run after the sweep, so they may queue further releases.
+    std::vector<DeferredRelease> ready;
+    std::erase_if(DeferredReleases, [&](DeferredRelease& deferred)
+    {
+        if (deferred.Frame + SwapChainImageCount > SubmittedFrames)
+            return false;
+        ready.push_back(std::move(deferred));
+        return true;
+    });
+    for (DeferredRelease& deferred : ready)
+        deferred.Release();
+    
     VkResult result = vkAcquireNextImageKHR(
         Device,
         Swapchain,
@@ -932,6 +1000,20 @@ void VulkanCore::EndFrame()
 
     // Advance to next frame
     CurrentFrameIndex = (CurrentFrameIndex + 1) % SwapChainImageCount;
+    SubmittedFrames++;
+}
+
+void VulkanCore::DeferRelease(std::function<void()> release)
+{
+    DeferredReleases.push_back({ SubmittedFrames, std::move(release) });
+}
+
+void VulkanCore::FlushDeferredReleases()
+{
+    std::vector<DeferredRelease> releases = std::move(DeferredReleases);
+    DeferredReleases.clear();
+    for (DeferredRelease& deferred : releases)
+        deferred.Release();
 }
 
 void VulkanCore::WaitForFrame(uint32_t frameIndex)
@@ -1,6 +1,7 @@
 ﻿#pragma once
 #include "../Windows/WindowsHeaders.h"
 #include <algorithm>
+#include <functional>
 #include <limits>
 #include <vector>
 #include <iostream>
@@ -71,6 +72,19 @@ class VulkanCore
     PFN_vkCmdBindDescriptorBuffersEXT        vkCmdBindDescriptorBuffersEXT_FnPtr = nullptr;
     PFN_vkCmdSetDescriptorBufferOffsetsEXT   vkCmdSetDescriptorBufferOffsetsEXT_FnPtr = nullptr;
     PFN_vkGetDescriptorEXT vkGetDescriptorEXT_FnPtr = nullptr;
+    
+    // VK_EXT_mesh_shader is optional, only enabled when the device exposes both task and mesh stages
+    bool MeshShaderSupported = false;
+    PFN_vkCmdDrawMeshTasksEXT vkCmdDrawMeshTasksEXT_FnPtr = nullptr;
+    
+    // Destruction of objects frames in flight may still use, each tagged with the number of frames submitted when it was queued
+    struct DeferredRelease
+    {
+        uint64_t Frame;
+        std::function<void()> Release;
+    };
+    std::vector<DeferredRelease> DeferredReleases;
+    uint64_t SubmittedFrames = 0;
 public:
 
     static VulkanCore& GetInstance();
@@ -80,6 +94,10 @@ public:
     void BeginFrame();
     void EndFrame();
     void WaitForGPU();
+    // Runs release once every frame recorded so far has finished on the GPU
+    void DeferRelease(std::function<void()> release);
+    // Runs every pending release now, only once the device is idle
+    void FlushDeferredReleases();
 
     // Getters
     VkDevice GetDevice() const { return Device; }
@@ -104,6 +122,8 @@ public:
     PFN_vkCmdBindDescriptorBuffersEXT GetVkCmdBindDescriptorBuffersEXT() const { return vkCmdBindDescriptorBuffersEXT_FnPtr; }
     PFN_vkCmdSetDescriptorBufferOffsetsEXT GetVkCmdSetDescriptorBufferOffsetsEXT() const { return vkCmdSetDescriptorBufferOffsetsEXT_FnPtr; }
     const VkPhysicalDeviceDescriptorBufferPropertiesEXT& GetDescriptorBufferProperties() const{ return DescriptorBufferProperties; }
+    bool IsMeshShaderSupported() const { return MeshShaderSupported; }
+    PFN_vkCmdDrawMeshTasksEXT GetVkCmdDrawMeshTasksEXT() const { return vkCmdDrawMeshTasksEXT_FnPtr; }
     const VkSampler* GetLinearSampler() const { return &LinearSampler; }
     const VkSampler* GetNearestSampler() const { return &PointSampler; }
     
@@ -141,6 +161,7 @@ private:
     // Compatability support
     bool CheckInstanceExtensionSupport(std::vector<const char*> extensionsToCheck, uint32_t& erroneousIndex);
     bool CheckDeviceExtensionSupport(VkPhysicalDevice device);
+    bool CheckMeshShaderSupport(VkPhysicalDevice device);
     bool CheckDeviceSuitability(VkPhysicalDevice device);
     bool CheckValidationLayerSupport();
 public:
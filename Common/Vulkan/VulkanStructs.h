@@ -37,5 +37,6 @@ namespace VulkanStructs
     {
         VkBuffer Buffer = VK_NULL_HANDLE;
         VkDeviceMemory Memory = VK_NULL_HANDLE;
+        VkDeviceAddress DeviceAddress = 0;      // Only for buffer types created with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
     };
 }
@@ -0,0 +1,98 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include "Win32Utils.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+
+#ifdef _WIN32
+    FileHandle = CreateFileW(Win32Utils::WidenString(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (FileHandle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(FileHandle, &fileSize) || fileSize.QuadPart == 0)
+    {
+        Close();
+        return false;
+    }
+
+    MappingHandle = CreateFileMappingW(FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!MappingHandle)
+    {
+        Close();
+        return false;
+    }
+
+    Data = static_cast<const uint8_t*>(MapViewOfFile(MappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (!Data)
+    {
+        Close();
+        return false;
+    }
+
+    Size = static_cast<uint64_t>(fileSize.QuadPart);
+    return true;
+#else
+    // Asset archives are read off Linux through the same view as on Windows
+    Descriptor = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (Descriptor < 0)
+        return false;
+
+    struct stat status {};
+    if (fstat(Descriptor, &status) != 0 || status.st_size <= 0)
+    {
+        Close();
+        return false;
+    }
+
+    void* view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_SHARED, Descriptor, 0);
+    if (view == MAP_FAILED)
+    {
+        Close();
+        return false;
+    }
+
+    Data = static_cast<const uint8_t*>(view);
+    Size = static_cast<uint64_t>(status.st_size);
+    return true;
+#endif
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+    if (Data)
+        UnmapViewOfFile(Data);
+    if (MappingHandle)
+        CloseHandle(MappingHandle);
+    if (FileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(FileHandle);
+
+    FileHandle = INVALID_HANDLE_VALUE;
+    MappingHandle = nullptr;
+#else
+    if (Data)
+        munmap(const_cast<uint8_t*>(Data), static_cast<size_t>(Size));
+    if (Descriptor >= 0)
+        close(Descriptor);
+
+    Descriptor = -1;
+#endif
+    Data = nullptr;
+    Size = 0;
+}
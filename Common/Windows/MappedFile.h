@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#ifdef _WIN32
+#include "WindowsHeaders.h"
+#endif
+
+// Read only view of a whole file. The pages are faulted in on first touch, so data can be copied from the view
+// straight into staging memory without an intermediate read buffer.
+class MappedFile
+{
+public:
+
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Returns false when the file does not exist or is empty
+    bool Open(const std::string& path);
+    void Close();
+
+    const uint8_t* GetData() const                      { return Data; }
+    uint64_t GetSize() const                            { return Size; }
+
+private:
+
+#ifdef _WIN32
+    HANDLE FileHandle = INVALID_HANDLE_VALUE;
+    HANDLE MappingHandle = nullptr;
+#else
+    int Descriptor = -1;
+#endif
+    const uint8_t* Data = nullptr;
+    uint64_t Size = 0;
+};
@@ -3,7 +3,9 @@
 #include "../../Common/RHI/Pipeline.h"
 #include "../../Common/RHI/RHIConstants.h"
 #include "../../Common/RHI/RenderPassExecutor.h"
+#include "../../Common/RHI/RenderQueue.h"
 #include <DirectXMath.h>
+#include <algorithm>
 #include <iostream>
 #include "../../Common/RHI/Uniform.h"
 #include "../../Common/GraphicsSettings.h"
@@ -11,15 +13,62 @@
 #include "../../Common/Vulkan/VulkanCore.h"
 #include "../../Common/RHI/BufferAllocator.h"
 #include "../../Common/RHI/Material.h"
+#include "../../Common/RHI/AssetLoader.h"
+#include "../../Common/RHI/ResidencyManager.h"
 #include "../../Common/RHI/Geometry/Mesh.h"
-#include "../../Common/RHI/Geometry/GeometryImport.h"
+#include "../../Common/RHI/Geometry/FrustumCuller.h"
+#include "../../Common/RHI/Geometry/OcclusionCuller.h"
+#include "../../Common/RHI/Geometry/LODSelector.h"
+#include "../../Common/Data/ArchivePacker.h"
+#include "../../Common/Data/AssetIO.h"
 
 using namespace RHIConstants;
 
+// Names of the count mesh nodes with the largest world bounds, largest first
+static std::vector<std::string> LargestNodes(const Scene& scene, uint32_t count)
+{
+    std::vector<float> nodeSizes(scene.GetNodeCount(), 0.0f);
+    for (uint32_t i = 0; i < scene.GetMeshCount(); i++)
+    {
+        uint32_t node = scene.GetMeshNodeIndices()[i];
+        DirectX::BoundingBox worldBounds;
+        scene.GetMeshBounds()[i].Transform(worldBounds, scene.GetWorldTransform(node));
+        DirectX::XMVECTOR extents = DirectX::XMLoadFloat3(&worldBounds.Extents);
+        nodeSizes[node] = std::max(nodeSizes[node], DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(extents)));
+    }
+
+    std::vector<uint32_t> nodes;
+    for (uint32_t node = 0; node < scene.GetNodeCount(); node++)
+        if (nodeSizes[node] > 0.0f && !scene.GetNodeNames()[node].empty())
+            nodes.push_back(node);
+
+    count = std::min(count, static_cast<uint32_t>(nodes.size()));
+    std::partial_sort(nodes.begin(), nodes.begin() + count, nodes.end(), [&](uint32_t a, uint32_t b) { return nodeSizes[a] > nodeSizes[b]; });
+
+    std::vector<std::string> names;
+    for (uint32_t i = 0; i < count; i++)
+        names.push_back(scene.GetNodeNames()[nodes[i]]);
+    return names;
+}
+
 int main()
 {
     try
     {
+        // Asset paths are relative to the working directory, so is the archive's root
+        if (GRAPHICS_SETTINGS.PackAssetArchive)
+        {
+            ArchivePacker packer;
+            packer.AddDirectory("Textures", { ".png" });
+            packer.AddDirectory("Meshes", { ".fbx", ".obj", ".gltf", ".glb", ".bin" });
+            packer.AddDirectory("../../Common/Vulkan/Shaders/SPIRV", { ".spv" });
+            packer.AddDirectory("../../Common/DirectX12/Shaders/CSO", { ".cso" });
+            if (!packer.Write("Assets.earc"))
+                std::cerr << "Failed to write asset archive." << std::endl;
+        }
+        if (GRAPHICS_SETTINGS.AssetArchive)
+            AssetIO::GetInstance().Mount("Assets.earc");
+        
         Window* window = new Window(L"MyWindow", Win32, 1280, 720);
 
         ShowWindow(window->GetWindowHandle(), 5);
@@ -41,14 +90,22 @@ int main()
         DirectX::XMMATRIX projection = DirectX::XMMatrixPerspectiveFovLH(DirectX::XM_PIDIV2, 1280.0f / 720.0f, 0.1f, 100.0f);
         DirectX::XMMATRIX vp = view * projection;
         DirectX::XMStoreFloat4x4(&cameraData.ViewProjection, vp);
+        DirectX::XMFLOAT4X4 viewMatrix;
+        DirectX::XMFLOAT4X4 projectionMatrix;
+        DirectX::XMStoreFloat4x4(&viewMatrix, view);
+        DirectX::XMStoreFloat4x4(&projectionMatrix, projection);
         
         std::vector<uint64_t> pbrUniformBuffers {};
         
-        std::vector<Material> materials;
-        materials.push_back(Material("shells_0", Material::PBR));
-        materials.push_back(Material("shells_1", Material::PBR));
-        
-        RootNode meshRoot = GeometryImport::CreateMeshGroup("shells.fbx", "Shells", DirectX::XMMatrixIdentity());
+        // shells.fbx has no nodes authored as occluders. Every node keeps its CPU triangles through the load, once
+        // it is in only the largest shells stay on as occluders.
+        AssetLoader& assetLoader = AssetLoader::GetInstance();
+        std::vector<AssetLoader::Handle<Material>> materialLoads = {
+            assetLoader.LoadMaterial("shells_0", Material::PBR, 0, 0, 1.0f),
+            assetLoader.LoadMaterial("shells_1", Material::PBR, 0, 0, 1.0f)
+        };
+        AssetLoader::Handle<Scene> sceneLoad = assetLoader.LoadScene("shells.fbx", "Shells", DirectX::XMMatrixIdentity(), { Scene::AllNodes });
+        Scene shellsScene;
         
         void* backBufferView;
         void* backBuffer;
@@ -60,17 +117,43 @@ int main()
         std::vector<uint64_t> materialDescriptorSets;
         Uniform uniform;
         
+        const uint32_t GEOMETRY_PASS = 0;
+        RenderQueue renderQueue;
+        renderQueue.SetDepthRange(0.1f, 100.0f);
+        
+        FrustumCuller frustumCuller;
+        OcclusionCuller occlusionCuller;
+        std::vector<uint32_t> visibleMeshes;
+        LODSelector lodSelector;
+        std::vector<uint8_t> meshLODs;
+        
         while (!window->PeekMessages())
         {
             if (GRAPHICS_SETTINGS.APIToUse != Vulkan) 
                 throw std::runtime_error("Vulkan is the only supported API for this sample");
             Renderer::BeginFrame();
             
+            // Loads finish their GPU work here, before this frame records anything that could use them
+            assetLoader.Update();
+            if (materialDescriptorSets.empty() &&
+                std::all_of(materialLoads.begin(), materialLoads.end(), [](const AssetLoader::Handle<Material>& load) { return load.IsReady(); }))
+            {
+                for (const AssetLoader::Handle<Material>& load : materialLoads)
+                    materialDescriptorSets.push_back(load.Get()->GetDescriptorSets()[0]);
+            }
+            if (sceneLoad.IsReady())
+            {
+                shellsScene = std::move(*sceneLoad.Get());
+                shellsScene.KeepOccluders(LargestNodes(shellsScene, 4));
+                frustumCuller.UpdateBounds(shellsScene);
+                sceneLoad = {};
+            }
+            for (const AssetLoader::Handle<Material>& load : materialLoads)
+                load.Rethrow();
+            sceneLoad.Rethrow();
+            
             if (!initialized)
             {
-                materialDescriptorSets.push_back(materials[0].LoadMaterial(0, 0));
-                materialDescriptorSets.push_back(materials[1].LoadMaterial(0, 0));
-                
                 ImageMemoryBarrier initBarrier = INIT_BARRIER;
                 initBarrier.ImageResource = PBRGeometryPipe->GetOwnedImage(0);
                 executor->IssueImageMemoryBarrier(initBarrier);
@@ -104,8 +187,22 @@ int main()
             readToAttachmentBarrier.ImageResource = PBRGeometryPipe->GetOwnedImage(3);
             executor->IssueImageMemoryBarrier(readToAttachmentBarrier);
             
+            // The G-buffer only clears until the materials and the scene are in
+            renderQueue.Reset();
+            if (!materialDescriptorSets.empty() && shellsScene.GetMeshCount() > 0)
+            {
+                frustumCuller.Cull(cameraData.ViewProjection, visibleMeshes);
+                occlusionCuller.RenderOccluders(shellsScene, cameraData.ViewProjection);
+                occlusionCuller.Cull(shellsScene, visibleMeshes);
+                lodSelector.Select(shellsScene, viewMatrix, projectionMatrix, static_cast<float>(window->GetHeight()), meshLODs, &visibleMeshes);
+                ResidencyManager::GetInstance().MarkScene(shellsScene, materialDescriptorSets, viewMatrix, projectionMatrix, static_cast<float>(window->GetHeight()), &visibleMeshes);
+                
+                renderQueue.SubmitScene(GEOMETRY_PASS, PBRGeometryPipe, shellsScene, materialDescriptorSets, cameraData.ViewProjection, &visibleMeshes, &meshLODs);
+                renderQueue.Sort();
+            }
+            
             executor->Begin(PBRGeometryPipe, {}, nullptr, window->GetWidth(), window->GetHeight(), clearColors, 1.0);
-            executor->DrawSceneNode(meshRoot.GetSceneNode(), materialDescriptorSets, cameraData.ViewProjection);
+            renderQueue.Execute(executor, GEOMETRY_PASS, cameraData.ViewProjection);
             executor->End();
             
             ImageMemoryBarrier gBufferBarrier = ATTACHMENT_TO_READ_BARRIER;
@@ -127,8 +224,13 @@ int main()
             executor->IssueImageMemoryBarrier(postBarrier);
             
             Renderer::EndFrame();
+            
+            // After submission, sets swapped here are only picked up by the next frame's recording
+            ResidencyManager::GetInstance().Update();
         }
 
+        // Loads still running need the render thread to finish, they are settled before the GPU goes idle
+        assetLoader.Flush();
         Renderer::Wait();
         // Delete pipelines FIRST (before buffer allocator)
         delete PBRGeometryPipe;